@@ -135,6 +135,15 @@ namespace detail {
         return reinterpret_cast<T*>(aligned_malloc(size * sizeof(T), Alignment(alignment)));
     }
 
+    // -----------------------------------------------------------------------
+    // page allocation
+    // -----------------------------------------------------------------------
+
+    // Allocate memory directly from the virtual memory system; the size is rounded up to
+    // whole pages. Large pages (2 MB) are used when requested and available.
+    Memory page_allocate(size_t bytes, bool large_pages = false);
+    void page_free(Memory memory);
+
     // -----------------------------------------------------------------------
     // AlignedStorage
     // -----------------------------------------------------------------------
@@ -0,0 +1,85 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <memory>
+#include <string>
+#include "../core/object.hpp"
+#include "../core/stream.hpp"
+#include "encoder.hpp"
+#include "surface.hpp"
+
+namespace mango
+{
+
+    // Animation frame after inter-frame optimization. The image covers only the part of
+    // the canvas which changed from the previous frame.
+    struct AnimationFrame
+    {
+        int x;
+        int y;
+        Bitmap image; // FORMAT_R8G8B8A8
+
+        // blend over the previous frame; unchanged pixels are transparent (zero)
+        bool blend;
+
+        // frame duration in (numerator / denominator) seconds
+        int delay_numerator;
+        int delay_denominator;
+
+        AnimationFrame(int x, int y, int width, int height, bool blend, int numerator, int denominator);
+    };
+
+    class AnimationEncoderInterface : protected NonCopyable
+    {
+    public:
+        AnimationEncoderInterface() = default;
+        virtual ~AnimationEncoderInterface() = default;
+
+        // compress a frame; called concurrently from the ThreadPool
+        virtual ImageEncodeStatus compress(Stream& output, const AnimationFrame& frame) = 0;
+
+        // write a compressed frame into the file; called in presentation order
+        virtual void write(Stream& output, const AnimationFrame& frame, ConstMemory data) = 0;
+
+        // complete the file after the last frame
+        virtual void finish(Stream& output) = 0;
+
+        // optional
+        virtual int alignment() const; // frame position alignment on the canvas
+    };
+
+    class AnimationEncoder : protected NonCopyable
+    {
+    public:
+        using CreateEncoderFunc = AnimationEncoderInterface* (*)(Stream& output, int width, int height, const ImageEncodeOptions& options);
+
+        AnimationEncoder(Stream& output, const std::string& extension, int width, int height,
+                         const ImageEncodeOptions& options = ImageEncodeOptions());
+        ~AnimationEncoder();
+
+        bool isEncoder() const;
+
+        // The frame is compared against the previous one and only the changed rectangle is
+        // compressed. Frames are compressed in the ThreadPool and written into the output
+        // in order as soon as they are ready, so the animation is never buffered as a whole.
+        // Errors from compressing earlier frames are reported by the following calls.
+        ImageEncodeStatus append(const Surface& frame, int delay_numerator, int delay_denominator);
+
+        // wait until all frames are written and complete the file; called by the destructor
+        ImageEncodeStatus finish();
+
+    protected:
+        struct Context;
+        std::unique_ptr<Context> m_context;
+
+        AnimationEncoder(Stream& output, CreateEncoderFunc func, int width, int height,
+                         const ImageEncodeOptions& options);
+    };
+
+    void registerAnimationEncoder(AnimationEncoder::CreateEncoderFunc func, const std::string& extension);
+    bool isAnimationEncoder(const std::string& extension);
+
+} // namespace mango
@@ -67,6 +67,9 @@ namespace mango
         FastFunc custom;
         ConvertFunc convertFunc;
 
+        // name of the conversion innerloop selected for the format pair
+        const char* path;
+
         Blitter(const Format& dest, const Format& source);
         ~Blitter();
 
@@ -75,6 +78,29 @@ namespace mango
             if (convertFunc)
                 convertFunc(*this, rect);
         }
+
+        // convert a single scanline of count pixels
+        void convert(u8* dest, const u8* source, int count) const
+        {
+            BlitRect rect;
+
+            rect.dest.address = dest;
+            rect.dest.stride = 0;
+            rect.src.address = const_cast<u8*>(source);
+            rect.src.stride = 0;
+            rect.width = count;
+            rect.height = 1;
+
+            convert(rect);
+        }
     };
 
+    // Returns a conversion plan from a process-wide cache; the plan is created on first
+    // use and shared between threads. Use this instead of constructing a Blitter per blit.
+    const Blitter& getBlitter(const Format& dest, const Format& source);
+
+    // Returns a table of the conversion innerloops selected between the common formats. The pairs
+    // which fall back to the scalar floating-point innerloops are marked as "slow".
+    std::string getBlitterCoverageReport();
+
 } // namespace mango
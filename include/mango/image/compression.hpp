@@ -210,6 +210,13 @@ namespace mango
             BC7_UNORM_SRGB                = BPTC_SRGB_ALPHA_UNORM
         };
 
+        enum class CompressionQuality
+        {
+            FAST,   // single pass endpoint selection
+            NORMAL, // principal axis endpoints with palette search and refinement
+            HIGH    // more iterations and alternative block modes
+        };
+
         using DecodeFunc = void (*)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
         using EncodeFunc = void (*)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
 
@@ -234,7 +241,13 @@ namespace mango
         TextureCompressionInfo(vulkan::TextureFormat format);
 
         TextureCompressionStatus decompress(const Surface& surface, ConstMemory memory) const;
-        TextureCompressionStatus compress(Memory memory, const Surface& surface) const;
+
+        // the pixels with alpha below 128 are transparent in the formats with 1 bit alpha
+        TextureCompressionStatus compress(Memory memory, const Surface& surface,
+            CompressionQuality quality = CompressionQuality::NORMAL) const;
+
+        // decode a row of count blocks into the decoding format; the output is count * width pixels wide
+        void decodeRow(u8* output, const u8* input, int stride, int count) const;
 
         CompressionFormat getCompressionFormat() const
         {
@@ -251,6 +264,7 @@ namespace mango
     using TextureCompressionFormat = TextureCompressionInfo::CompressionFormat;
     using TextureCompressionFlags = TextureCompressionInfo::CompressionFlags;
     using TextureCompression = TextureCompressionInfo::TextureCompression;
+    using TextureCompressionQuality = TextureCompressionInfo::CompressionQuality;
 
     namespace opengl
     {
@@ -49,6 +49,29 @@ namespace mango
         // - palette is resolved into the provided palette object
         // - decode() destination surface must be indexed
         Palette* palette = nullptr; // enable indexed decoding by pointing to a palette
+
+        // request region-of-interest decoding
+        // - only the crop rectangle of the image is decoded into the destination surface
+        // - empty crop rectangle (default) decodes the whole image
+        // - decoders which cannot skip data outside the rectangle decode the whole image
+        //   into a temporary surface and copy the rectangle from there
+        int crop_x = 0;
+        int crop_y = 0;
+        int crop_width = 0;
+        int crop_height = 0;
+
+        // request EXIF orientation
+        // - the image is decoded as it is displayed; destination surface has the width and
+        //   height swapped for the orientations which rotate the image by 90 degrees
+        // - crop rectangle is in the stored image before the orientation is applied
+        // - decoders which cannot write the pixels in the displayed orientation decode
+        //   into a temporary surface and copy it with Surface::orient()
+        bool orientation = false;
+
+        bool isCropped() const
+        {
+            return crop_width > 0 && crop_height > 0;
+        }
     };
 
     class ImageDecoderInterface : protected NonCopyable
@@ -58,17 +81,21 @@ namespace mango
         virtual ~ImageDecoderInterface() = default;
 
         virtual ImageHeader header() = 0;
-        virtual ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) = 0;
+        virtual ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) = 0;
 
         // optional
         virtual ConstMemory memory(int level, int depth, int face); // get compressed data
         virtual ConstMemory icc(); // get ICC data
         virtual ConstMemory exif(); // get exif data
+        virtual bool crop(); // decode() handles ImageDecodeOptions crop rectangle
+        virtual bool orientation(); // decode() handles ImageDecodeOptions orientation
     };
 
     class ImageDecoder : protected NonCopyable
     {
     public:
+        // The decoder is selected from the signature (magic bytes) of the content; the
+        // extension is used for formats without one and to confirm short signatures.
         ImageDecoder(ConstMemory memory, const std::string& extension);
         ~ImageDecoder();
 
@@ -89,4 +116,14 @@ namespace mango
     void registerImageDecoder(ImageDecoder::CreateDecoderFunc func, const std::string& extension);
     bool isImageDecoder(const std::string& extension);
 
+    // Magic bytes at the offset identify the content as the format decoded with the
+    // extension; the decoder must be registered first.
+    void registerImageSignature(const std::string& extension, const std::string& magic, u32 offset = 0);
+
+    // Returns the extension of the decoder for the content (".png") or empty string when
+    // there is no matching signature. With the filename the result is the decoder which
+    // ImageDecoder selects, including the extension fallback.
+    std::string detectImageFormat(ConstMemory memory);
+    std::string detectImageFormat(ConstMemory memory, const std::string& filename);
+
 } // namespace mango
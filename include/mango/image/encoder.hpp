@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <functional>
 #include "../core/object.hpp"
 #include "../core/stream.hpp"
 #include "../core/exception.hpp"
@@ -15,6 +16,7 @@
 namespace mango
 {
     class Surface;
+    class ImageDecoder;
 
     struct ImageEncodeStatus : Status
     {
@@ -25,12 +27,35 @@ namespace mango
     {
         Palette palette;
         float quality = 0.90f; // jpeg: [0.0, 1.0]
+        bool optimize = false; // jpeg: two-pass encoding with optimized huffman tables
+        bool progressive = false; // jpeg: progressive encoding (implies optimize)
+        int subsampling = 444; // jpeg: chroma subsampling (444, 422 or 420)
         int compression = 5; // png: [0, 10]
         bool filtering = true; // png
         bool dithering = true; // gif
         bool lossless = false; // webp
     };
 
+    // Compressed texture which is written into a container without decoding it. The level
+    // data is stored as-is, so transcoding between containers only copies the payload.
+    struct CompressedImage
+    {
+        int width = 0;
+        int height = 0;
+        int levels = 1;
+        int faces = 1; // 1 or 6 (cubemap)
+        TextureCompression compression = TextureCompression::NONE;
+
+        // compressed data for a level / face; same layout as ImageDecoder::memory()
+        std::function<ConstMemory(int level, int face)> memory;
+
+        CompressedImage() = default;
+        CompressedImage(ImageDecoder& decoder); // the decoder must outlive the image
+
+        // size of one face of a level in bytes
+        size_t getLevelSize(int level) const;
+    };
+
     class ImageEncoder : protected NonCopyable
     {
     public:
@@ -38,15 +63,22 @@ namespace mango
         ~ImageEncoder();
 
         bool isEncoder() const;
+        bool isCompressedEncoder() const;
+
         ImageEncodeStatus encode(Stream& output, const Surface& source, const ImageEncodeOptions& options);
+        ImageEncodeStatus encode(Stream& output, const CompressedImage& source);
 
         using EncodeFunc = ImageEncodeStatus (*)(Stream& output, const Surface& source, const ImageEncodeOptions& options);
+        using EncodeCompressedFunc = ImageEncodeStatus (*)(Stream& output, const CompressedImage& source);
 
     protected:
         EncodeFunc m_encode_func;
+        EncodeCompressedFunc m_encode_compressed_func;
     };
 
     void registerImageEncoder(ImageEncoder::EncodeFunc func, const std::string& extension);
+    void registerImageEncoder(ImageEncoder::EncodeCompressedFunc func, const std::string& extension);
     bool isImageEncoder(const std::string& extension);
+    bool isCompressedImageEncoder(const std::string& extension);
 
 } // namespace mango
@@ -10,7 +10,12 @@
 #include "format.hpp"
 #include "compression.hpp"
 #include "decoder.hpp"
+#include "probe.hpp"
 #include "encoder.hpp"
 #include "blitter.hpp"
 #include "surface.hpp"
+#include "loader.hpp"
 #include "quantize.hpp"
+#include "mipmap.hpp"
+#include "animation.hpp"
+#include "resample.hpp"
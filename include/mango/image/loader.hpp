@@ -0,0 +1,148 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../core/configure.hpp"
+#include "../core/object.hpp"
+#include "../core/memory.hpp"
+#include "../filesystem/path.hpp"
+#include "decoder.hpp"
+#include "surface.hpp"
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // ImageAllocator
+    // ----------------------------------------------------------------------------
+
+    class ImageAllocator : protected NonCopyable
+    {
+    public:
+        ImageAllocator() = default;
+        virtual ~ImageAllocator() = default;
+
+        // empty memory fails the load; called concurrently when the allocator is shared
+        virtual Memory allocate(size_t bytes) = 0;
+        virtual void release(Memory memory) = 0;
+    };
+
+    // Released buffers are kept and handed out again. Images of the same size reuse
+    // memory which is already mapped instead of faulting in fresh pages every time.
+    class ImagePool : public ImageAllocator
+    {
+    protected:
+        std::mutex m_mutex;
+        std::vector<Memory> m_used;
+        std::vector<Memory> m_free;
+        bool m_large_pages;
+
+    public:
+        ImagePool(bool large_pages = false); // large_pages: 2 MB pages when available
+        ~ImagePool();
+
+        Memory allocate(size_t bytes) override;
+        void release(Memory memory) override;
+
+        // free the buffers which are not in use
+        void trim();
+    };
+
+    // ----------------------------------------------------------------------------
+    // PooledBitmap
+    // ----------------------------------------------------------------------------
+
+    // Surface with storage from an ImageAllocator; the storage is released when the
+    // bitmap is destroyed or loaded again.
+    class PooledBitmap : private NonCopyable, public Surface
+    {
+    protected:
+        friend class ImageLoader;
+
+        ImageAllocator* m_allocator;
+        Memory m_memory;
+
+    public:
+        PooledBitmap();
+        PooledBitmap(PooledBitmap&& bitmap);
+        ~PooledBitmap();
+
+        PooledBitmap& operator = (PooledBitmap&& bitmap);
+
+        void release();
+    };
+
+    // ----------------------------------------------------------------------------
+    // ImageLoader
+    // ----------------------------------------------------------------------------
+
+    class ImageLoader : protected NonCopyable
+    {
+    protected:
+        ImageAllocator& m_allocator;
+
+        ImageDecodeStatus load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension, const Format* format);
+
+    public:
+        // Called after the header is parsed; returns the destination for the image. The
+        // surface is usually header.width x header.height; a surface without image
+        // memory cancels the load.
+        using SurfaceCallback = std::function<Surface (const ImageHeader& header)>;
+
+        ImageLoader(ImageAllocator& allocator);
+        ~ImageLoader();
+
+        // decode into storage from the allocator; the format defaults to header.format
+        ImageDecodeStatus load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension);
+        ImageDecodeStatus load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension, const Format& format);
+        ImageDecodeStatus load(PooledBitmap& bitmap, const std::string& filename);
+        ImageDecodeStatus load(PooledBitmap& bitmap, const std::string& filename, const Format& format);
+
+        // decode into caller memory, for example a mapped GPU staging buffer
+        ImageDecodeStatus load(ConstMemory memory, const std::string& extension, const SurfaceCallback& callback);
+        ImageDecodeStatus load(const std::string& filename, const SurfaceCallback& callback);
+    };
+
+    // ----------------------------------------------------------------------------
+    // ImageBatchLoader
+    // ----------------------------------------------------------------------------
+
+    struct ImageBatchOptions
+    {
+        Format format;                  // FORMAT_NONE decodes in header.format
+        size_t max_memory = 256 << 20;  // file and image bytes not yet delivered
+        bool ordered = true;            // deliver in the order of the files
+    };
+
+    // Reads, decodes and converts many files concurrently in the ThreadPool. New files
+    // are scheduled only while the images waiting for delivery fit in max_memory.
+    class ImageBatchLoader : protected NonCopyable
+    {
+    public:
+        // Called from one thread at a time but not from the thread which called load().
+        // The bitmap is released after the callback returns unless it is moved out.
+        using Callback = std::function<void (size_t index, const std::string& filename, PooledBitmap& bitmap, const ImageDecodeStatus& status)>;
+
+    protected:
+        ImageAllocator& m_allocator;
+        ImageBatchOptions m_options;
+
+        void load(const filesystem::Path* path, const std::vector<std::string>& filenames, const Callback& callback);
+
+    public:
+        ImageBatchLoader(ImageAllocator& allocator, const ImageBatchOptions& options = ImageBatchOptions());
+        ~ImageBatchLoader();
+
+        // load() returns when every file has been delivered to the callback
+        void load(const std::vector<std::string>& filenames, const Callback& callback);
+        void load(const filesystem::Path& path, const Callback& callback);
+        void load(const filesystem::Path& path, const filesystem::FileIndex& index, const Callback& callback);
+    };
+
+} // namespace mango
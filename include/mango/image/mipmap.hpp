@@ -0,0 +1,46 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "../core/object.hpp"
+#include "../core/memory.hpp"
+#include "compression.hpp"
+#include "surface.hpp"
+
+namespace mango
+{
+
+    struct MipmapOptions
+    {
+        bool srgb = false; // color is sRGB encoded; filtering is done in linear space
+        bool normalmap = false; // xyz is a normal vector packed into [0, 1]; levels are renormalized
+        float alphaCoverage = 0.0f; // alpha test reference value; 0.0 disables coverage preservation
+        int levels = 0; // maximum number of levels including the base; 0 generates the full chain
+    };
+
+    class MipmapChain : private NonCopyable
+    {
+    protected:
+        Surface m_base;
+        std::vector<std::unique_ptr<Bitmap>> m_levels;
+
+    public:
+        // The levels are generated from the base surface and stored in the same format.
+        // The base surface is referenced and must remain valid for the lifetime of the chain.
+        MipmapChain(const Surface& base, const MipmapOptions& options = MipmapOptions());
+        ~MipmapChain();
+
+        int getLevelCount() const;
+        const Surface& getLevel(int level) const;
+
+        // Compress all levels into consecutive memory; the levels are compressed in parallel.
+        size_t getCompressedSize(const TextureCompressionInfo& info) const;
+        TextureCompressionStatus compress(Memory memory, const TextureCompressionInfo& info,
+            TextureCompressionQuality quality = TextureCompressionQuality::NORMAL) const;
+    };
+
+} // namespace mango
@@ -0,0 +1,37 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include "../core/configure.hpp"
+#include "../core/memory.hpp"
+#include "../filesystem/path.hpp"
+#include "decoder.hpp"
+
+namespace mango
+{
+
+    struct ImageProbe
+    {
+        std::string filename;
+        std::string extension; // decoder selected from the content, for example ".jpg"
+        ImageHeader header;
+        int orientation = 1; // EXIF orientation (1..8); 1 when not present
+    };
+
+    // Read the header of an image without decoding it. The decoder is selected from
+    // the magic bytes; the filename extension is used only for formats without one.
+    // Files are probed from the first 64 KB and read completely only when the header
+    // does not fit in there.
+    ImageProbe probeImage(ConstMemory memory, const std::string& filename);
+    ImageProbe probeImage(const filesystem::Path& path, const std::string& filename);
+
+    // Probe the files concurrently in the ThreadPool; the results are in the same order
+    // as the files and directories are skipped.
+    std::vector<ImageProbe> probeImages(const filesystem::Path& path);
+    std::vector<ImageProbe> probeImages(const filesystem::Path& path, const filesystem::FileIndex& index);
+
+} // namespace mango
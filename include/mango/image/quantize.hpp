@@ -4,6 +4,7 @@
 */
 #pragma once
 
+#include <vector>
 #include "format.hpp"
 #include "surface.hpp"
 
@@ -13,11 +14,11 @@ namespace image {
     class ColorQuantizer
     {
     protected:
-        enum { NETSIZE = 256 };
-
         Palette m_palette;
-        int m_network[NETSIZE][4];
-        int m_netindex[NETSIZE];
+
+        // inverse color map: palette entries which can be nearest to a color in each 32x32x32 cell
+        std::vector<u32> m_offset;
+        std::vector<u32> m_candidate;
 
     public:
         ColorQuantizer(const Surface& source, float quality = 0.90f);
@@ -27,7 +28,7 @@ namespace image {
         // get generated palette
         Palette getPalette() const;
 
-        // quantize ANY image with the quantization network (the original color image is recommended)
+        // quantize ANY image with the palette (the original color image is recommended)
         void quantize(const Surface& dest, const Surface& source, bool dithering = true);
 
     protected:
@@ -0,0 +1,32 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include "surface.hpp"
+
+namespace mango
+{
+
+    struct ResampleOptions
+    {
+        enum Filter
+        {
+            BOX,
+            TRIANGLE,
+            CATMULL_ROM,
+            MITCHELL,
+            LANCZOS3
+        };
+
+        Filter filter = MITCHELL;
+        bool srgb = false; // color is sRGB encoded; filtering is done in linear space
+        bool premultiplied = false; // color is premultiplied with alpha
+    };
+
+    // Resample the source surface into the destination surface using separable filter.
+    // The surfaces can have different dimensions and any format supported by the Blitter.
+    void resample(const Surface& dest, const Surface& source, const ResampleOptions& options = ResampleOptions());
+
+} // namespace mango
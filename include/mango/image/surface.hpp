@@ -53,6 +53,14 @@ namespace mango
         void blit(int x, int y, const Surface& source) const;
         void xflip() const;
         void yflip() const;
+
+        // Copy the source with EXIF orientation (1..8) applied; the surface is the source
+        // size with width and height swapped for orientations 5..8. Different format or
+        // size is converted and clipped like in blit().
+        void orient(const Surface& source, int orientation) const;
+        void transpose(const Surface& source) const;
+        void rotate90(const Surface& source) const;  // clockwise
+        void rotate270(const Surface& source) const; // clockwise
     };
 
     class Bitmap : private NonCopyable, public Surface
@@ -72,4 +80,8 @@ namespace mango
         Bitmap& operator = (Bitmap&& bitmap);
     };
 
+    // Repeat a pixel of "bytes" bytes count times with wide stores; returns the end of
+    // the run. The run-length decoders expand their runs with this.
+    u8* fillPixels(u8* dest, const u8* pixel, int bytes, int count);
+
 } // namespace mango
@@ -4,6 +4,7 @@
 */
 #pragma once
 
+#include <limits>
 #include "simd.hpp"
 
 namespace mango {
@@ -1168,6 +1168,7 @@ namespace
 
     // NOTE: calls to this routine can be reduced when the DX encoder supports stride.
     // TODO: support rgba8888 input in the encoder to completely eliminate this.
+    // The encoder expects normalized colors in the [0, 1] range.
 
     void convert_block(float4* temp, const u8* input, int stride)
     {
@@ -1177,7 +1178,7 @@ namespace
             for (int x = 0; x < 4; ++x)
             {
                 const int32x4 v = simd::unpack(image[x]);
-                temp[y * 4 + x] = convert<float32x4>(v);
+                temp[y * 4 + x] = convert<float32x4>(v) * (1.0f / 255.0f);
             }
         }
     }
@@ -1219,7 +1220,7 @@ namespace mango
         MANGO_UNREFERENCED(info);
         float4 temp[16];
         convert_block(temp, input, stride);
-        DirectX::D3DXEncodeBC1(output, temp, 1.0f, DirectX::BC_FLAGS_NONE);
+        DirectX::D3DXEncodeBC1(output, temp, 0.5f, DirectX::BC_FLAGS_NONE);
     }
 
     void encode_block_bc2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
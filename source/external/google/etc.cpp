@@ -124,9 +124,9 @@ namespace
                 const u32 tableNdx	  = table[subBlock];
                 const u32 modifierNdx = getBits(src, pixelNdx, 1);
                 const u32 modifierSgn = getBits(src, pixelNdx + 16, 1);
-                const int modifier	  = modifierTable[modifierNdx][tableNdx] ^ (0 - modifierSgn);
+                const int modifier	  = modifierSgn ? -modifierTable[modifierNdx][tableNdx] : modifierTable[modifierNdx][tableNdx];
 
-                int32x4 c = clamp(base[subBlock] + modifier, 0, 255);
+                int32x4 c = clamp(base[subBlock] + int32x4(modifier, modifier, modifier, 0), 0, 255);
                 dest[x] = c.pack();
             }
         }
@@ -144,7 +144,7 @@ namespace
                 const u32 tableNdx	  = table[subBlock];
                 const u32 modifierNdx = getBits(src, pixelNdx, 1);
                 const u32 modifierSgn = getBits(src, pixelNdx + 16, 1);
-                const int modifier	  = modifierTable[modifierNdx][tableNdx] ^ (0 - modifierSgn);
+                const int modifier	  = modifierSgn ? -modifierTable[modifierNdx][tableNdx] : modifierTable[modifierNdx][tableNdx];
 
                 dest[0] = byteclamp(baseR[subBlock] + modifier);
                 dest[1] = byteclamp(baseG[subBlock] + modifier);
@@ -265,7 +265,7 @@ namespace
                         else
                             modifier = modifierTable[tableNdx][modifierNdx];
 
-                        int32x4 c = clamp(base[subBlock] + modifier, 0, 255);
+                        int32x4 c = clamp(base[subBlock] + int32x4(modifier, modifier, modifier, 0), 0, 255);
                         dest[x] = c.pack();
                     }
                 }
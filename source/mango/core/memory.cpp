@@ -6,6 +6,11 @@
 #include <mango/core/bits.hpp>
 #include <mango/core/memory.hpp>
 
+#if defined(MANGO_PLATFORM_UNIX)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
 namespace mango
 {
 
@@ -107,6 +112,142 @@ namespace mango
         }
     }
 
+#endif
+
+    // -----------------------------------------------------------------------
+    // page allocation
+    // -----------------------------------------------------------------------
+
+#if defined(MANGO_PLATFORM_WINDOWS)
+
+    Memory page_allocate(size_t bytes, bool large_pages)
+    {
+        if (large_pages)
+        {
+            // requires the "Lock pages in memory" privilege
+            const size_t page = GetLargePageMinimum();
+            if (page)
+            {
+                const size_t size = (bytes + page - 1) & ~(page - 1);
+                void* address = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (address)
+                {
+                    return Memory(reinterpret_cast<u8*>(address), size);
+                }
+            }
+        }
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        const size_t page = info.dwPageSize;
+        const size_t size = (bytes + page - 1) & ~(page - 1);
+
+        void* address = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!address)
+        {
+            return Memory();
+        }
+
+        return Memory(reinterpret_cast<u8*>(address), size);
+    }
+
+    void page_free(Memory memory)
+    {
+        if (memory.address)
+        {
+            VirtualFree(memory.address, 0, MEM_RELEASE);
+        }
+    }
+
+#elif defined(MANGO_PLATFORM_UNIX)
+
+    Memory page_allocate(size_t bytes, bool large_pages)
+    {
+        const int protection = PROT_READ | PROT_WRITE;
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+        if (large_pages)
+        {
+            constexpr size_t page = 2 * 1024 * 1024;
+            const size_t size = (bytes + page - 1) & ~(page - 1);
+
+#if defined(MAP_HUGETLB)
+            // pages reserved for the huge page pool
+            void* address = ::mmap(nullptr, size, protection, flags | MAP_HUGETLB, -1, 0);
+            if (address != MAP_FAILED)
+            {
+                return Memory(reinterpret_cast<u8*>(address), size);
+            }
+#endif
+
+#if defined(MADV_HUGEPAGE)
+            // transparent huge pages; the kernel uses them only for aligned ranges
+            void* block = ::mmap(nullptr, size + page, protection, flags, -1, 0);
+            if (block != MAP_FAILED)
+            {
+                u8* start = reinterpret_cast<u8*>(block);
+                u8* aligned = reinterpret_cast<u8*>((reinterpret_cast<uintptr_t>(start) + page - 1) & ~uintptr_t(page - 1));
+
+                size_t head = aligned - start;
+                size_t tail = page - head;
+
+                if (head)
+                {
+                    ::munmap(start, head);
+                }
+
+                if (tail)
+                {
+                    ::munmap(aligned + size, tail);
+                }
+
+                ::madvise(aligned, size, MADV_HUGEPAGE);
+                return Memory(aligned, size);
+            }
+#endif
+        }
+
+        const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        const size_t size = (bytes + page - 1) & ~(page - 1);
+
+        void* address = ::mmap(nullptr, size, protection, flags, -1, 0);
+        if (address == MAP_FAILED)
+        {
+            return Memory();
+        }
+
+        return Memory(reinterpret_cast<u8*>(address), size);
+    }
+
+    void page_free(Memory memory)
+    {
+        if (memory.address)
+        {
+            ::munmap(memory.address, memory.size);
+        }
+    }
+
+#else
+
+    // generic implementation
+
+    Memory page_allocate(size_t bytes, bool large_pages)
+    {
+        MANGO_UNREFERENCED(large_pages);
+
+        constexpr size_t page = 4096;
+        const size_t size = (bytes + page - 1) & ~(page - 1);
+
+        void* address = aligned_malloc(size, page);
+        return Memory(reinterpret_cast<u8*>(address), address ? size : 0);
+    }
+
+    void page_free(Memory memory)
+    {
+        aligned_free(memory.address);
+    }
+
 #endif
 
 } // namespace mango
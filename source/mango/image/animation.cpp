@@ -0,0 +1,402 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <mango/core/buffer.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include <mango/simd/simd.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // frame difference
+    // ----------------------------------------------------------------------------
+
+    constexpr u32 ALPHA_MASK = 0xff000000; // FORMAT_R8G8B8A8 as u32
+
+    struct DirtyRect
+    {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+
+        // every changed pixel is opaque; the frame can be blended over the previous one
+        bool opaque = true;
+
+        bool empty() const
+        {
+            return x0 >= x1 || y0 >= y1;
+        }
+    };
+
+    // Expand the rectangle with the changed pixels of a scanline
+    void diff_scanline(DirtyRect& rect, int y, const u32* prev, const u32* curr, int width)
+    {
+        int left = width;
+        int right = -1;
+        u32 translucent = 0;
+
+        int x = 0;
+
+        const simd::u32x4 alpha = simd::u32x4_set(ALPHA_MASK);
+
+        for ( ; x <= width - 4; x += 4)
+        {
+            simd::u32x4 a = simd::u32x4_uload(prev + x);
+            simd::u32x4 b = simd::u32x4_uload(curr + x);
+
+            u32 changed = ~simd::get_mask(simd::compare_eq(a, b)) & 0xf;
+            if (changed)
+            {
+                u32 opaque = simd::get_mask(simd::compare_eq(simd::bitwise_and(b, alpha), alpha));
+                translucent |= changed & ~opaque;
+
+                left = std::min(left, x + u32_tzcnt(changed));
+                right = x + 31 - u32_lzcnt(changed);
+            }
+        }
+
+        for ( ; x < width; ++x)
+        {
+            if (prev[x] != curr[x])
+            {
+                translucent |= (curr[x] & ALPHA_MASK) != ALPHA_MASK;
+                left = std::min(left, x);
+                right = x;
+            }
+        }
+
+        if (right >= 0)
+        {
+            if (rect.empty())
+            {
+                rect.x0 = left;
+                rect.x1 = right + 1;
+                rect.y0 = y;
+            }
+            else
+            {
+                rect.x0 = std::min(rect.x0, left);
+                rect.x1 = std::max(rect.x1, right + 1);
+            }
+
+            rect.y1 = y + 1;
+            rect.opaque &= translucent == 0;
+        }
+    }
+
+    DirtyRect compute_dirty_rect(const Surface& prev, const Surface& curr)
+    {
+        DirtyRect rect;
+
+        const size_t bytes = curr.width * 4;
+
+        for (int y = 0; y < curr.height; ++y)
+        {
+            const u32* a = prev.address<u32>(0, y);
+            const u32* b = curr.address<u32>(0, y);
+
+            // most scanlines are identical; let the libc compare them first
+            if (std::memcmp(a, b, bytes))
+            {
+                diff_scanline(rect, y, a, b, curr.width);
+            }
+        }
+
+        return rect;
+    }
+
+    // Changed pixels are copied and the unchanged ones cleared to transparent
+    void delta_scanline(u32* dest, const u32* prev, const u32* curr, int width)
+    {
+        int x = 0;
+
+        const simd::u32x4 zero = simd::u32x4_zero();
+
+        for ( ; x <= width - 4; x += 4)
+        {
+            simd::u32x4 a = simd::u32x4_uload(prev + x);
+            simd::u32x4 b = simd::u32x4_uload(curr + x);
+            simd::u32x4_ustore(dest + x, simd::select(simd::compare_eq(a, b), zero, b));
+        }
+
+        for ( ; x < width; ++x)
+        {
+            dest[x] = prev[x] == curr[x] ? 0 : curr[x];
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // AnimationFrame
+    // ----------------------------------------------------------------------------
+
+    AnimationFrame::AnimationFrame(int x, int y, int width, int height, bool blend, int numerator, int denominator)
+        : x(x)
+        , y(y)
+        , image(width, height, FORMAT_R8G8B8A8)
+        , blend(blend)
+        , delay_numerator(numerator)
+        , delay_denominator(denominator)
+    {
+    }
+
+    // ----------------------------------------------------------------------------
+    // AnimationEncoderInterface
+    // ----------------------------------------------------------------------------
+
+    int AnimationEncoderInterface::alignment() const
+    {
+        return 1;
+    }
+
+    // ----------------------------------------------------------------------------
+    // AnimationEncoder
+    // ----------------------------------------------------------------------------
+
+    struct AnimationEncoder::Context
+    {
+        struct Job
+        {
+            AnimationFrame frame;
+            MemoryStream data;
+            std::promise<void> compressed;
+
+            Job(int x, int y, int width, int height, bool blend, int numerator, int denominator)
+                : frame(x, y, width, height, blend, numerator, denominator)
+            {
+            }
+        };
+
+        Stream& output;
+        std::unique_ptr<AnimationEncoderInterface> encoder;
+
+        int width;
+        int height;
+        Bitmap previous;
+        bool first = true;
+        bool finished = false;
+
+        // frames being compressed or waiting to be written; bounds the memory usage
+        // when frames are appended faster than they can be compressed
+        int pending = 0;
+        int max_pending;
+
+        // frames are compressed concurrently and written in order by the serial queue
+        ConcurrentQueue queue;
+        SerialQueue writer;
+
+        std::mutex mutex;
+        ImageEncodeStatus status;
+
+        Context(Stream& output, AnimationEncoderInterface* encoder, int width, int height)
+            : output(output)
+            , encoder(encoder)
+            , width(width)
+            , height(height)
+            , previous(width, height, FORMAT_R8G8B8A8)
+            , max_pending(ThreadPool::getHardwareConcurrency() + 1)
+            , queue("animation", Priority::HIGH)
+            , writer("animation.writer")
+        {
+        }
+
+        void setError(const ImageEncodeStatus& error)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (status)
+            {
+                status = error;
+            }
+        }
+
+        ImageEncodeStatus getStatus()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return status;
+        }
+
+        void flush()
+        {
+            queue.wait();
+            writer.wait();
+            pending = 0;
+        }
+
+        std::shared_ptr<Job> createJob(const Surface& current, int numerator, int denominator)
+        {
+            std::shared_ptr<Job> job;
+
+            if (first)
+            {
+                // the first frame covers the whole canvas
+                job = std::make_shared<Job>(0, 0, width, height, false, numerator, denominator);
+                job->frame.image.blit(0, 0, current);
+                first = false;
+                return job;
+            }
+
+            DirtyRect rect = compute_dirty_rect(previous, current);
+
+            if (rect.empty())
+            {
+                // nothing changed; a transparent pixel holds the delay
+                job = std::make_shared<Job>(0, 0, 1, 1, true, numerator, denominator);
+                *job->frame.image.address<u32>(0, 0) = 0;
+                return job;
+            }
+
+            // align the frame position
+            const int align = encoder->alignment();
+            rect.x0 -= rect.x0 % align;
+            rect.y0 -= rect.y0 % align;
+
+            const int w = rect.x1 - rect.x0;
+            const int h = rect.y1 - rect.y0;
+
+            // Translucent changes would be blended with the previous frame; those frames
+            // replace the rectangle instead, which is exact because nothing outside changed.
+            const bool blend = rect.opaque;
+
+            job = std::make_shared<Job>(rect.x0, rect.y0, w, h, blend, numerator, denominator);
+            Surface& image = job->frame.image;
+
+            for (int y = 0; y < h; ++y)
+            {
+                u32* dest = image.address<u32>(0, y);
+                const u32* prev = previous.address<u32>(rect.x0, rect.y0 + y);
+                const u32* curr = current.address<u32>(rect.x0, rect.y0 + y);
+
+                if (blend)
+                {
+                    delta_scanline(dest, prev, curr, w);
+                }
+                else
+                {
+                    std::memcpy(dest, curr, w * 4);
+                }
+            }
+
+            return job;
+        }
+    };
+
+    AnimationEncoder::AnimationEncoder(Stream& output, CreateEncoderFunc func, int width, int height,
+                                       const ImageEncodeOptions& options)
+    {
+        if (func && width > 0 && height > 0)
+        {
+            AnimationEncoderInterface* encoder = func(output, width, height, options);
+            m_context.reset(new Context(output, encoder, width, height));
+        }
+    }
+
+    AnimationEncoder::~AnimationEncoder()
+    {
+        finish();
+    }
+
+    bool AnimationEncoder::isEncoder() const
+    {
+        return m_context != nullptr;
+    }
+
+    ImageEncodeStatus AnimationEncoder::append(const Surface& frame, int delay_numerator, int delay_denominator)
+    {
+        ImageEncodeStatus status;
+
+        if (!m_context)
+        {
+            status.setError("[WARNING] AnimationEncoder::append() is not supported for this extension.");
+            return status;
+        }
+
+        Context& context = *m_context;
+
+        if (context.finished)
+        {
+            status.setError("[WARNING] AnimationEncoder::append() called after finish().");
+            return status;
+        }
+
+        if (frame.width != context.width || frame.height != context.height)
+        {
+            status.setError("[WARNING] AnimationEncoder::append() frame size (%d x %d) does not match the animation (%d x %d).",
+                frame.width, frame.height, context.width, context.height);
+            return status;
+        }
+
+        if (delay_numerator < 0 || delay_denominator <= 0)
+        {
+            status.setError("[WARNING] AnimationEncoder::append() incorrect delay (%d / %d).",
+                delay_numerator, delay_denominator);
+            return status;
+        }
+
+        Bitmap current(frame, FORMAT_R8G8B8A8);
+        std::shared_ptr<Context::Job> job = context.createJob(current, delay_numerator, delay_denominator);
+        context.previous = std::move(current);
+
+        if (context.pending >= context.max_pending)
+        {
+            context.flush();
+        }
+
+        ++context.pending;
+
+        Context* ptr = &context;
+
+        context.queue.enqueue([ptr, job]
+        {
+            ImageEncodeStatus result = ptr->encoder->compress(job->data, job->frame);
+            if (!result)
+            {
+                ptr->setError(result);
+            }
+
+            job->compressed.set_value();
+        });
+
+        context.writer.enqueue([ptr, job]
+        {
+            job->compressed.get_future().wait();
+            ptr->encoder->write(ptr->output, job->frame, job->data);
+        });
+
+        return context.getStatus();
+    }
+
+    ImageEncodeStatus AnimationEncoder::finish()
+    {
+        ImageEncodeStatus status;
+
+        if (!m_context)
+        {
+            status.setError("[WARNING] AnimationEncoder::finish() is not supported for this extension.");
+            return status;
+        }
+
+        Context& context = *m_context;
+
+        if (!context.finished)
+        {
+            context.flush();
+            context.encoder->finish(context.output);
+            context.finished = true;
+        }
+
+        return context.getStatus();
+    }
+
+} // namespace mango
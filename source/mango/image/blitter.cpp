@@ -3,8 +3,11 @@
     Copyright (C) 2012-2017 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <map>
+#include <memory>
 #include <mango/core/system.hpp>
 #include <mango/core/cpuinfo.hpp>
+#include <mango/core/atomic.hpp>
+#include <mango/core/string.hpp>
 #include <mango/core/half.hpp>
 #include <mango/image/blitter.hpp>
 #include <mango/math/vector.hpp>
@@ -329,6 +332,100 @@ namespace
         }
     }
 
+    // unorm <- unorm, components are only copied or initialized to default
+
+    template <typename DestType, typename SourceType>
+    void convert_template_mask(const Blitter& blitter, const BlitRect& rect)
+    {
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        const u32 initMask = blitter.initMask;
+        const u32 copyMask = blitter.copyMask;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            DestType* dst = reinterpret_cast<DestType*>(dest);
+
+            for (int x = 0; x < rect.width; ++x)
+            {
+                dst[x] = DestType(initMask | (u32(src[x]) & copyMask));
+            }
+
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
+    // unorm <- unorm, single component is scaled in integer arithmetic
+
+    struct IntegerScale
+    {
+        // round(v * dmax / smax) computed as (v * dmax + smax / 2) / smax where the division
+        // is replaced with a multiply by the rounded up reciprocal; the masks are odd so
+        // the result never lands exactly halfway between two integers.
+        u32 srcMask;
+        int srcShift;
+        int destShift;
+        u64 multiplier;
+        u64 bias;
+        int shift;
+        bool exact;
+
+        IntegerScale(const Blitter::Component& component)
+        {
+            srcMask = component.srcMask;
+            srcShift = u32_tzcnt(component.srcMask);
+            destShift = u32_tzcnt(component.destMask);
+
+            const u64 smax = component.srcMask >> srcShift;
+            const u64 dmax = component.destMask >> destShift;
+
+            // the numerator must fit in 31 bits so that the product fits in 64 bits
+            const int N = u64_log2(smax * dmax + smax / 2) + 1;
+            const int L = u64_log2(smax) + 1;
+            exact = N <= 31;
+            shift = exact ? N + L : 0;
+
+            const u64 m = exact ? ((1ull << shift) + smax - 1) / smax : 0;
+            multiplier = dmax * m;
+            bias = (smax / 2) * m;
+        }
+
+        u32 compute(u32 s) const
+        {
+            const u64 v = (s & srcMask) >> srcShift;
+            return u32((v * multiplier + bias) >> shift) << destShift;
+        }
+    };
+
+    template <typename DestType, typename SourceType>
+    void convert_template_unorm_unorm_integer(const Blitter& blitter, const BlitRect& rect)
+    {
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        const IntegerScale scale(blitter.component[0]);
+        const u32 initMask = blitter.initMask;
+        const u32 copyMask = blitter.copyMask;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            DestType* dst = reinterpret_cast<DestType*>(dest);
+
+            for (int x = 0; x < rect.width; ++x)
+            {
+                u32 s = src[x];
+                dst[x] = DestType(initMask | (s & copyMask) | scale.compute(s));
+            }
+
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
     // unorm <- fp
 
     template <typename DestType, typename SourceType>
@@ -566,6 +663,60 @@ namespace
         return func;
     }
 
+    Blitter::ConvertFunc convert_mask(int modeMask)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (modeMask)
+        {
+            case MAKE_MODEMASK( 8,  8): func = convert_template_mask<u8, u8>; break;
+            case MAKE_MODEMASK( 8, 16): func = convert_template_mask<u8, u16>; break;
+            case MAKE_MODEMASK( 8, 24): func = convert_template_mask<u8, u24>; break;
+            case MAKE_MODEMASK( 8, 32): func = convert_template_mask<u8, u32>; break;
+            case MAKE_MODEMASK(16,  8): func = convert_template_mask<u16, u8>; break;
+            case MAKE_MODEMASK(16, 16): func = convert_template_mask<u16, u16>; break;
+            case MAKE_MODEMASK(16, 24): func = convert_template_mask<u16, u24>; break;
+            case MAKE_MODEMASK(16, 32): func = convert_template_mask<u16, u32>; break;
+            case MAKE_MODEMASK(24,  8): func = convert_template_mask<u24, u8>; break;
+            case MAKE_MODEMASK(24, 16): func = convert_template_mask<u24, u16>; break;
+            case MAKE_MODEMASK(24, 24): func = convert_template_mask<u24, u24>; break;
+            case MAKE_MODEMASK(24, 32): func = convert_template_mask<u24, u32>; break;
+            case MAKE_MODEMASK(32,  8): func = convert_template_mask<u32, u8>; break;
+            case MAKE_MODEMASK(32, 16): func = convert_template_mask<u32, u16>; break;
+            case MAKE_MODEMASK(32, 24): func = convert_template_mask<u32, u24>; break;
+            case MAKE_MODEMASK(32, 32): func = convert_template_mask<u32, u32>; break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc convert_integer(int modeMask)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (modeMask)
+        {
+            case MAKE_MODEMASK( 8,  8): func = convert_template_unorm_unorm_integer<u8, u8>; break;
+            case MAKE_MODEMASK( 8, 16): func = convert_template_unorm_unorm_integer<u8, u16>; break;
+            case MAKE_MODEMASK( 8, 24): func = convert_template_unorm_unorm_integer<u8, u24>; break;
+            case MAKE_MODEMASK( 8, 32): func = convert_template_unorm_unorm_integer<u8, u32>; break;
+            case MAKE_MODEMASK(16,  8): func = convert_template_unorm_unorm_integer<u16, u8>; break;
+            case MAKE_MODEMASK(16, 16): func = convert_template_unorm_unorm_integer<u16, u16>; break;
+            case MAKE_MODEMASK(16, 24): func = convert_template_unorm_unorm_integer<u16, u24>; break;
+            case MAKE_MODEMASK(16, 32): func = convert_template_unorm_unorm_integer<u16, u32>; break;
+            case MAKE_MODEMASK(24,  8): func = convert_template_unorm_unorm_integer<u24, u8>; break;
+            case MAKE_MODEMASK(24, 16): func = convert_template_unorm_unorm_integer<u24, u16>; break;
+            case MAKE_MODEMASK(24, 24): func = convert_template_unorm_unorm_integer<u24, u24>; break;
+            case MAKE_MODEMASK(24, 32): func = convert_template_unorm_unorm_integer<u24, u32>; break;
+            case MAKE_MODEMASK(32,  8): func = convert_template_unorm_unorm_integer<u32, u8>; break;
+            case MAKE_MODEMASK(32, 16): func = convert_template_unorm_unorm_integer<u32, u16>; break;
+            case MAKE_MODEMASK(32, 24): func = convert_template_unorm_unorm_integer<u32, u24>; break;
+            case MAKE_MODEMASK(32, 32): func = convert_template_unorm_unorm_integer<u32, u32>; break;
+        }
+
+        return func;
+    }
+
 #ifdef MANGO_ENABLE_SSE2
     template <typename DestType, typename SourceType>
     void convert_template_sse2(const Blitter& blitter, const BlitRect& rect)
@@ -630,6 +781,164 @@ namespace
     }
 #endif
 
+#ifdef MANGO_ENABLE_AVX2
+
+    // The AVX2 innerloop converts eight pixels at a time; each register holds one component
+    // for eight pixels instead of four components for one pixel as in the SSE2 innerloop.
+    // The arithmetic is identical so the results are the same.
+
+    template <typename T>
+    __m256i avx2_load8(const T* src)
+    {
+        return _mm256_setr_epi32(u32(src[0]), u32(src[1]), u32(src[2]), u32(src[3]),
+                                 u32(src[4]), u32(src[5]), u32(src[6]), u32(src[7]));
+    }
+
+    template <>
+    __m256i avx2_load8<u8>(const u8* src)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+    }
+
+    template <>
+    __m256i avx2_load8<u16>(const u16* src)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+    }
+
+    template <>
+    __m256i avx2_load8<u32>(const u32* src)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    }
+
+    template <typename T>
+    void avx2_store8(T* dest, __m256i value)
+    {
+        alignas(32) u32 temp[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(temp), value);
+        for (int i = 0; i < 8; ++i)
+        {
+            dest[i] = T(temp[i]);
+        }
+    }
+
+    template <>
+    void avx2_store8<u16>(u16* dest, __m256i value)
+    {
+        value = _mm256_permute4x64_epi64(_mm256_packus_epi32(value, value), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm256_castsi256_si128(value));
+    }
+
+    template <>
+    void avx2_store8<u32>(u32* dest, __m256i value)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), value);
+    }
+
+    template <typename DestType, typename SourceType>
+    void convert_template_avx2(const Blitter& blitter, const BlitRect& rect)
+    {
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        alignas(16) float scale[4];
+        alignas(16) u32 src_mask[4];
+        alignas(16) u32 dest_mask[4];
+        alignas(16) u32 shift_mask[4];
+
+        _mm_store_ps(scale, blitter.sseScale);
+        _mm_store_si128(reinterpret_cast<__m128i *>(src_mask), blitter.sseSrcMask);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dest_mask), blitter.sseDestMask);
+        _mm_store_si128(reinterpret_cast<__m128i *>(shift_mask), blitter.sseShiftMask);
+
+        __m256 vscale[4];
+        __m256i vsrc_mask[4];
+        __m256i vdest_mask[4];
+        __m256i vshift_mask[4];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            vscale[i] = _mm256_set1_ps(scale[i]);
+            vsrc_mask[i] = _mm256_set1_epi32(src_mask[i]);
+            vdest_mask[i] = _mm256_set1_epi32(dest_mask[i]);
+            vshift_mask[i] = _mm256_set1_epi32(shift_mask[i]);
+        }
+
+        const __m256i init_mask = _mm256_set1_epi32(blitter.initMask);
+
+        const int xcount = rect.width & ~7;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            DestType* dst = reinterpret_cast<DestType*>(dest);
+
+            for (int x = 0; x < xcount; x += 8)
+            {
+                __m256i s = avx2_load8<SourceType>(src + x);
+                __m256i v = init_mask;
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    __m256 m = _mm256_cvtepi32_ps(_mm256_and_si256(s, vsrc_mask[i]));
+                    __m256i r = _mm256_cvtps_epi32(_mm256_mul_ps(m, vscale[i]));
+                    r = _mm256_and_si256(r, vdest_mask[i]);
+                    r = _mm256_add_epi32(r, _mm256_and_si256(r, vshift_mask[i]));
+                    v = _mm256_or_si256(v, r);
+                }
+
+                avx2_store8<DestType>(dst + x, v);
+            }
+
+            if (xcount < rect.width)
+            {
+                BlitRect tail;
+
+                tail.src.address = source + xcount * sizeof(SourceType);
+                tail.src.stride = rect.src.stride;
+                tail.dest.address = dest + xcount * sizeof(DestType);
+                tail.dest.stride = rect.dest.stride;
+                tail.width = rect.width - xcount;
+                tail.height = 1;
+
+                convert_template_sse2<DestType, SourceType>(blitter, tail);
+            }
+
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
+    Blitter::ConvertFunc convert_avx2(int modeMask)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (modeMask)
+        {
+            case MAKE_MODEMASK( 8,  8): func = convert_template_avx2<u8, u8>; break;
+            case MAKE_MODEMASK( 8, 16): func = convert_template_avx2<u8, u16>; break;
+            case MAKE_MODEMASK( 8, 24): func = convert_template_avx2<u8, u24>; break;
+            case MAKE_MODEMASK( 8, 32): func = convert_template_avx2<u8, u32>; break;
+            case MAKE_MODEMASK(16,  8): func = convert_template_avx2<u16, u8>; break;
+            case MAKE_MODEMASK(16, 16): func = convert_template_avx2<u16, u16>; break;
+            case MAKE_MODEMASK(16, 24): func = convert_template_avx2<u16, u24>; break;
+            case MAKE_MODEMASK(16, 32): func = convert_template_avx2<u16, u32>; break;
+            case MAKE_MODEMASK(24,  8): func = convert_template_avx2<u24, u8>; break;
+            case MAKE_MODEMASK(24, 16): func = convert_template_avx2<u24, u16>; break;
+            case MAKE_MODEMASK(24, 24): func = convert_template_avx2<u24, u24>; break;
+            case MAKE_MODEMASK(24, 32): func = convert_template_avx2<u24, u32>; break;
+            case MAKE_MODEMASK(32,  8): func = convert_template_avx2<u32, u8>; break;
+            case MAKE_MODEMASK(32, 16): func = convert_template_avx2<u32, u16>; break;
+            case MAKE_MODEMASK(32, 24): func = convert_template_avx2<u32, u24>; break;
+            case MAKE_MODEMASK(32, 32): func = convert_template_avx2<u32, u32>; break;
+        }
+
+        return func;
+    }
+
+#endif // MANGO_ENABLE_AVX2
+
     void convert_custom(const Blitter& blitter, const BlitRect& rect)
     {
         u8* src = rect.src.address;
@@ -644,354 +953,1622 @@ namespace
     }
 
     // ----------------------------------------------------------------------------
-    // custom conversion functions
+    // Blitter Engine v2
     // ----------------------------------------------------------------------------
 
-#define INIT_POINTERS(DEST, SRC) \
-    const SRC* s = reinterpret_cast<const SRC*>(src); \
-    DEST* d = reinterpret_cast<DEST*>(dest);
+    /*
 
-    template <int bytes>
-    void blit_memcpy(u8* dest, const u8* src, int count)
+    The v2 conversion kernels are generated from a decoder and an encoder template. The decoder
+    expands the source pixel into normalized RGBA in a float32x4 register and the encoder converts
+    the register into the destination pixel. The compiler fuses the two into one innerloop so that
+    the pixel never leaves the SIMD registers.
+
+    The pixel storage is classified into a small number of layouts:
+
+    - packed: unorm color with all components in 8, 16, 24 or 32 bit integer (max. 24 bits per component)
+    - component: every component in separate 16 bit unorm, 16 bit half, 32 bit float or 64 bit double
+
+    The cross product of the layouts is instantiated at compile time and selected with a table
+    lookup when the Blitter is constructed. The component order is resolved at construction as well,
+    the RGBA component layout is loaded and stored without any permutation.
+
+    */
+
+    enum : int
     {
-        std::memcpy(dest, src, count * bytes);
-    }
+        STORAGE_NONE,
+        STORAGE_PACKED8,
+        STORAGE_PACKED16,
+        STORAGE_PACKED24,
+        STORAGE_PACKED32,
+        STORAGE_UNORM16,
+        STORAGE_FP16,
+        STORAGE_FP32,
+        STORAGE_FP64
+    };
 
-    void blit_bgra8888_from_bgrx8888(u8* dest, const u8* src, int count)
+    int storage(const Format& format)
     {
-        INIT_POINTERS(u32, u32);
-        for (int x = 0; x < count; ++x)
+        if (format.type == Format::UNORM && format.bits <= 32)
         {
-            u32 v = s[x];
-            d[x] = v | 0xff000000;
+            for (int i = 0; i < 4; ++i)
+            {
+                if (format.size[i] > 24)
+                    return STORAGE_NONE;
+            }
+
+            switch (format.bits)
+            {
+                case  8: return STORAGE_PACKED8;
+                case 16: return STORAGE_PACKED16;
+                case 24: return STORAGE_PACKED24;
+                case 32: return STORAGE_PACKED32;
+            }
+
+            return STORAGE_NONE;
         }
-    }
 
-    void blit_bgra8888_to_and_from_rgba8888(u8* dest, const u8* src, int count)
-    {
-        INIT_POINTERS(u32, u32);
-        for (int x = 0; x < count; ++x)
+        int bits = 0;
+        int layout = STORAGE_NONE;
+
+        switch (format.type)
         {
-            u32 v = s[x];
-            d[x] = (v & 0xff00ff00) | (((v << 16) | (v >> 16)) & 0x00ff00ff);
+            case Format::UNORM:   bits = 16; layout = STORAGE_UNORM16; break;
+            case Format::FLOAT16: bits = 16; layout = STORAGE_FP16; break;
+            case Format::FLOAT32: bits = 32; layout = STORAGE_FP32; break;
+            case Format::FLOAT64: bits = 64; layout = STORAGE_FP64; break;
+            default: return STORAGE_NONE;
         }
-    }
 
-    void blit_bgra8888_from_bgra4444(u8* dest, const u8* src, int count)
-    {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        // every component must be stored in its own element
+        for (int i = 0; i < 4; ++i)
         {
-            u32 v = s[x];
-            u32 u = ((v & 0xf000) << 16) | ((v & 0x0f00) << 12) | ((v & 0x00f0) << 8) | ((v & 0x000f) << 4);
-            d[x] = u | (u >> 4);
+            if (format.size[i])
+            {
+                if (format.size[i] != bits || (format.offset[i] % bits) || format.offset[i] >= format.bits)
+                    return STORAGE_NONE;
+            }
         }
+
+        if (format.bits % bits)
+            return STORAGE_NONE;
+
+        return layout;
     }
 
-    void blit_bgra8888_from_bgra5551(u8* dest, const u8* src, int count)
+    // packed
+
+    template <typename T>
+    struct PackedDecoder
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        using Type = T;
+        enum { step = 1 };
+
+        uint32x4 mask;
+        float32x4 scale;
+        float32x4 bias;
+
+        PackedDecoder(const Format& format)
         {
-            u32 v = s[x];
-            u32 u = v & 0x8000 ? 0xff000000 : 0;
-            u |= ((v & 0x7c00) << 9) | ((v & 0x03e0) << 6) | ((v & 0x001f) << 3);
-            d[x] = u | ((u & 0x00e0e0e0) >> 5);
+            u32 m[4];
+            float s[4];
+
+            for (int i = 0; i < 4; ++i)
+            {
+                m[i] = format.size[i] ? format.mask(i) : 0;
+                s[i] = m[i] ? 1.0f / float(m[i]) : 0.0f;
+            }
+
+            mask = uint32x4(m[0], m[1], m[2], m[3]);
+            scale = float32x4(s[0], s[1], s[2], s[3]);
+
+            // missing alpha defaults to 1.0
+            bias = float32x4(0.0f, 0.0f, 0.0f, m[3] ? 0.0f : 1.0f);
         }
-    }
 
-    void blit_bgra8888_from_bgr888(u8* dest, const u8* src, int count)
-    {
-        INIT_POINTERS(u32, u24);
-        for (int x = 0; x < count; ++x)
+        float32x4 operator () (const T* src) const
         {
-            u32 v = s[x];
-            d[x] = 0xff000000 | v;
+            const uint32x4 s = u32(src[0]);
+            return convert<float32x4>(s & mask) * scale + bias;
         }
-    }
+    };
 
-    void blit_rgba8888_from_bgr888(u8* dest, const u8* src, int count)
+    template <typename T>
+    struct PackedEncoder
     {
-        INIT_POINTERS(u8, u8);
-        for (int x = 0; x < count; ++x)
+        using Type = T;
+        enum { step = 1 };
+
+        float32x4 scale;
+        float32x4 unit;
+
+        PackedEncoder(const Format& format)
         {
-            d[0] = s[2];
-            d[1] = s[1];
-            d[2] = s[0];
-            d[3] = 0xff;
-            s += 3;
-            d += 4;
+            float s[4];
+            float u[4];
+
+            for (int i = 0; i < 4; ++i)
+            {
+                // the component is rounded to integer and then moved into position with an exact
+                // floating-point multiply by the weight of its least significant bit
+                s[i] = float((1u << format.size[i]) - 1);
+                u[i] = float(u64(1) << format.offset[i]);
+            }
+
+            if (format.isLuminance())
+            {
+                // luminance is stored from the red component
+                s[1] = 0.0f;
+                s[2] = 0.0f;
+            }
+
+            scale = float32x4(s[0], s[1], s[2], s[3]);
+            unit = float32x4(u[0], u[1], u[2], u[3]);
         }
-    }
 
-    void blit_bgra8888_from_bgr565(u8* dest, const u8* src, int count)
-    {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        void operator () (T* dest, float32x4 v) const
         {
-            u32 v = s[x];
-            u32 u = ((v & 0xf800) << 8) | ((v & 0x07e0) << 5) | ((v & 0x001f) << 3);
-            u |= ((v & 0xe000) << 3) | ((v & 0x0600) >> 1) | ((v & 0x001c) >> 2);
-            d[x] = 0xff000000 | u;
+            v = round(clamp(v, 0.0f, 1.0f) * scale) * unit;
+            uint32x4 u = convert<uint32x4>(v);
+            u = u | shuffle<2, 3, 0, 1>(u);
+            u = u | shuffle<1, 0, 3, 2>(u);
+            dest[0] = T(u32(u.x));
         }
+    };
+
+    // component
+
+    inline float32x4 load_component4(const u16* src)
+    {
+        return convert<float32x4>(uint32x4(src[0], src[1], src[2], src[3])) * (1.0f / 65535.0f);
     }
 
-    void blit_bgr888_from_bgra8888(u8* dest, const u8* src, int count)
+    inline float32x4 load_component4(const float16* src)
     {
-        INIT_POINTERS(u24, u32);
-        for (int x = 0; x < count; ++x)
-        {
+        return convert<float32x4>(*reinterpret_cast<const float16x4*>(src));
+    }
+
+    inline float32x4 load_component4(const float* src)
+    {
+        return simd::f32x4_uload(src);
+    }
+
+    inline float32x4 load_component4(const double* src)
+    {
+        return float32x4(float(src[0]), float(src[1]), float(src[2]), float(src[3]));
+    }
+
+    inline void store_component4(u16* dest, float32x4 v)
+    {
+        int32x4 i = convert<int32x4>(clamp(v, 0.0f, 1.0f) * 65535.0f);
+        dest[0] = u16(s32(i.x));
+        dest[1] = u16(s32(i.y));
+        dest[2] = u16(s32(i.z));
+        dest[3] = u16(s32(i.w));
+    }
+
+    inline void store_component4(float16* dest, float32x4 v)
+    {
+        *reinterpret_cast<float16x4*>(dest) = convert<float16x4>(v);
+    }
+
+    inline void store_component4(float* dest, float32x4 v)
+    {
+        simd::f32x4_ustore(dest, v);
+    }
+
+    inline void store_component4(double* dest, float32x4 v)
+    {
+        dest[0] = double(float(v.x));
+        dest[1] = double(float(v.y));
+        dest[2] = double(float(v.z));
+        dest[3] = double(float(v.w));
+    }
+
+    inline float load_component(const u16* src)
+    {
+        return float(src[0]) * (1.0f / 65535.0f);
+    }
+
+    template <typename T>
+    float load_component(const T* src)
+    {
+        return float(src[0]);
+    }
+
+    inline void store_component(u16* dest, float s)
+    {
+        dest[0] = u16(clamp(s, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    template <typename T>
+    void store_component(T* dest, float s)
+    {
+        dest[0] = T(s);
+    }
+
+    void compute_component_layout(int* offset, const Format& format, int bits)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            offset[i] = format.size[i] ? format.offset[i] / bits : -1;
+        }
+    }
+
+    bool is_component_rgba(const int* offset, const Format& format, int bits)
+    {
+        return int(format.bits) == bits * 4 &&
+               offset[0] == 0 && offset[1] == 1 && offset[2] == 2 && offset[3] == 3;
+    }
+
+    template <typename T>
+    struct ComponentDecoder
+    {
+        using Type = T;
+
+        int step;
+        int offset[4];
+        bool rgba;
+        mask32x4 present;
+        float32x4 defaults;
+
+        ComponentDecoder(const Format& format)
+        {
+            const int bits = sizeof(T) * 8;
+            step = format.bits / bits;
+            compute_component_layout(offset, format, bits);
+            rgba = is_component_rgba(offset, format, bits);
+
+            // missing components are read from the first element and replaced with defaults
+            present = uint32x4(offset[0] >= 0, offset[1] >= 0, offset[2] >= 0, offset[3] >= 0) != uint32x4(0);
+            defaults = float32x4(0.0f, 0.0f, 0.0f, 1.0f);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                offset[i] = std::max(0, offset[i]);
+            }
+        }
+
+        float32x4 operator () (const T* src) const
+        {
+            if (rgba)
+            {
+                return load_component4(src);
+            }
+
+            float32x4 v(load_component(src + offset[0]),
+                        load_component(src + offset[1]),
+                        load_component(src + offset[2]),
+                        load_component(src + offset[3]));
+            return select(present, v, defaults);
+        }
+    };
+
+    template <typename T>
+    struct ComponentEncoder
+    {
+        using Type = T;
+
+        int step;
+        int offset[4];
+        bool rgba;
+
+        ComponentEncoder(const Format& format)
+        {
+            const int bits = sizeof(T) * 8;
+            step = format.bits / bits;
+            compute_component_layout(offset, format, bits);
+            rgba = is_component_rgba(offset, format, bits);
+
+            if (format.isLuminance())
+            {
+                // luminance is stored from the red component
+                offset[1] = -1;
+                offset[2] = -1;
+            }
+        }
+
+        void operator () (T* dest, float32x4 v) const
+        {
+            if (rgba)
+            {
+                store_component4(dest, v);
+                return;
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                if (offset[i] >= 0)
+                {
+                    store_component(dest + offset[i], v[i]);
+                }
+            }
+        }
+    };
+
+    template <typename Encoder, typename Decoder>
+    void convert_template_v2(const Blitter& blitter, const BlitRect& rect)
+    {
+        using DestType = typename Encoder::Type;
+        using SourceType = typename Decoder::Type;
+
+        const Decoder decode(blitter.srcFormat);
+        const Encoder encode(blitter.destFormat);
+
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            DestType* dst = reinterpret_cast<DestType*>(dest);
+
+            for (int x = 0; x < rect.width; ++x)
+            {
+                encode(dst, decode(src));
+                src += decode.step;
+                dst += encode.step;
+            }
+
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
+    template <typename Encoder>
+    Blitter::ConvertFunc select_decoder_v2(int source)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (source)
+        {
+            case STORAGE_PACKED8:  func = convert_template_v2<Encoder, PackedDecoder<u8>>; break;
+            case STORAGE_PACKED16: func = convert_template_v2<Encoder, PackedDecoder<u16>>; break;
+            case STORAGE_PACKED24: func = convert_template_v2<Encoder, PackedDecoder<u24>>; break;
+            case STORAGE_PACKED32: func = convert_template_v2<Encoder, PackedDecoder<u32>>; break;
+            case STORAGE_UNORM16:  func = convert_template_v2<Encoder, ComponentDecoder<u16>>; break;
+            case STORAGE_FP16:     func = convert_template_v2<Encoder, ComponentDecoder<float16>>; break;
+            case STORAGE_FP32:     func = convert_template_v2<Encoder, ComponentDecoder<float>>; break;
+            case STORAGE_FP64:     func = convert_template_v2<Encoder, ComponentDecoder<double>>; break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc convert_v2(const Format& dest, const Format& source)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        const int sourceStorage = storage(source);
+
+        switch (storage(dest))
+        {
+            case STORAGE_PACKED8:  func = select_decoder_v2<PackedEncoder<u8>>(sourceStorage); break;
+            case STORAGE_PACKED16: func = select_decoder_v2<PackedEncoder<u16>>(sourceStorage); break;
+            case STORAGE_PACKED24: func = select_decoder_v2<PackedEncoder<u24>>(sourceStorage); break;
+            case STORAGE_PACKED32: func = select_decoder_v2<PackedEncoder<u32>>(sourceStorage); break;
+            case STORAGE_UNORM16:  func = select_decoder_v2<ComponentEncoder<u16>>(sourceStorage); break;
+            case STORAGE_FP16:     func = select_decoder_v2<ComponentEncoder<float16>>(sourceStorage); break;
+            case STORAGE_FP32:     func = select_decoder_v2<ComponentEncoder<float>>(sourceStorage); break;
+            case STORAGE_FP64:     func = select_decoder_v2<ComponentEncoder<double>>(sourceStorage); break;
+        }
+
+        return func;
+    }
+
+    // ----------------------------------------------------------------------------
+    // byte shuffle innerloops
+    // ----------------------------------------------------------------------------
+
+    /*
+        Formats where every component is 8 or 16 bits wide and starts at a byte boundary are
+        converted without going through float. Two pixels are shuffled into 16 bit RGBA at a time;
+        the 8 bit components are replicated into both bytes which is the exact v * 257 expansion.
+        The destination gathers 16 bit components with a second shuffle and 8 bit components
+        from round(v / 257), which is computed as ((v + 128) * 0xff01) >> 24.
+    */
+
+#if defined(MANGO_ENABLE_SSSE3)
+
+    bool is_byte_aligned(const Format& format)
+    {
+        if (format.type != Format::UNORM || format.bits % 8 || format.bits > 64)
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int size = format.size[i];
+            if (size && ((size != 8 && size != 16) || format.offset[i] % 8))
+                return false;
+        }
+
+        return true;
+    }
+
+    struct ShufflePlan
+    {
+        int srcBytes;
+        int destBytes;
+        __m128i expand;
+        __m128i alpha;
+        __m128i gather16;
+        __m128i gather8;
+
+        ShufflePlan(const Format& dest, const Format& source)
+        {
+            srcBytes = source.bits / 8;
+            destBytes = dest.bits / 8;
+
+            s8 e[16];
+            s8 g16[16];
+            s8 g8[16];
+            u16 a[8];
+
+            std::memset(e, -1, 16);
+            std::memset(g16, -1, 16);
+            std::memset(g8, -1, 16);
+
+            for (int p = 0; p < 2; ++p)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    const int c = p * 8 + i * 2;
+
+                    // alpha defaults to 1.0 and color to 0.0
+                    a[p * 4 + i] = i == 3 && !source.size[3] ? 0xffff : 0;
+
+                    if (source.size[i])
+                    {
+                        const int offset = p * srcBytes + source.offset[i] / 8;
+                        e[c + 0] = s8(offset);
+                        e[c + 1] = s8(source.size[i] == 16 ? offset + 1 : offset);
+                    }
+
+                    // luminance is stored from the red component
+                    if (dest.size[i] && !(dest.isLuminance() && (i == 1 || i == 2)))
+                    {
+                        const int offset = p * destBytes + dest.offset[i] / 8;
+                        if (dest.size[i] == 16)
+                        {
+                            g16[offset + 0] = s8(c + 0);
+                            g16[offset + 1] = s8(c + 1);
+                        }
+                        else
+                        {
+                            g8[offset] = s8(c);
+                        }
+                    }
+                }
+            }
+
+            expand = _mm_loadu_si128(reinterpret_cast<const __m128i*>(e));
+            alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+            gather16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g16));
+            gather8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g8));
+        }
+
+        void convert(u8* dest, const u8* src) const
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            v = _mm_or_si128(_mm_shuffle_epi8(v, expand), alpha);
+            __m128i r = _mm_adds_epu16(v, _mm_set1_epi16(128));
+            r = _mm_srli_epi16(_mm_mulhi_epu16(r, _mm_set1_epi16(s16(0xff01))), 8);
+            v = _mm_or_si128(_mm_shuffle_epi8(v, gather16), _mm_shuffle_epi8(r, gather8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), v);
+        }
+    };
+
+    void convert_shuffle_ssse3(const Blitter& blitter, const BlitRect& rect)
+    {
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        const ShufflePlan plan(blitter.destFormat, blitter.srcFormat);
+        const int srcBytes = plan.srcBytes;
+        const int destBytes = plan.destBytes;
+
+        // the loads and stores are 16 bytes wide; the pixels closer than that to the end
+        // of the scanline are converted through a temporary buffer
+        const int last = rect.width - std::max((15 + srcBytes) / srcBytes, (15 + destBytes) / destBytes);
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = source;
+            u8* dst = dest;
+            int x = 0;
+
+            for ( ; x <= last; x += 2)
+            {
+                plan.convert(dst, src);
+                src += srcBytes * 2;
+                dst += destBytes * 2;
+            }
+
+            for ( ; x < rect.width; x += 2)
+            {
+                const int count = std::min(2, rect.width - x);
+                u8 input[16] = { 0 };
+                u8 output[16];
+                std::memcpy(input, src, count * srcBytes);
+                plan.convert(output, input);
+                std::memcpy(dst, output, count * destBytes);
+                src += srcBytes * 2;
+                dst += destBytes * 2;
+            }
+
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
+#endif // MANGO_ENABLE_SSSE3
+
+    // ----------------------------------------------------------------------------
+    // custom conversion functions
+    // ----------------------------------------------------------------------------
+
+#define INIT_POINTERS(DEST, SRC) \
+    const SRC* s = reinterpret_cast<const SRC*>(src); \
+    DEST* d = reinterpret_cast<DEST*>(dest);
+
+    template <int bytes>
+    void blit_memcpy(u8* dest, const u8* src, int count)
+    {
+        std::memcpy(dest, src, count * bytes);
+    }
+
+    void blit_bgra8888_from_bgrx8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            d[x] = v | 0xff000000;
+        }
+    }
+
+    void blit_bgra8888_to_and_from_rgba8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            d[x] = (v & 0xff00ff00) | (((v << 16) | (v >> 16)) & 0x00ff00ff);
+        }
+    }
+
+    void blit_bgra8888_from_bgra4444(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = ((v & 0xf000) << 16) | ((v & 0x0f00) << 12) | ((v & 0x00f0) << 8) | ((v & 0x000f) << 4);
+            d[x] = u | (u >> 4);
+        }
+    }
+
+    void blit_bgra8888_from_bgra5551(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = v & 0x8000 ? 0xff000000 : 0;
+            u |= ((v & 0x7c00) << 9) | ((v & 0x03e0) << 6) | ((v & 0x001f) << 3);
+            d[x] = u | ((u & 0x00e0e0e0) >> 5);
+        }
+    }
+
+    void blit_bgra8888_from_bgr888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u24);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            d[x] = 0xff000000 | v;
+        }
+    }
+
+    void blit_rgba8888_from_bgr888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u8, u8);
+        for (int x = 0; x < count; ++x)
+        {
+            d[0] = s[2];
+            d[1] = s[1];
+            d[2] = s[0];
+            d[3] = 0xff;
+            s += 3;
+            d += 4;
+        }
+    }
+
+    void blit_bgra8888_from_bgr565(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = ((v & 0xf800) << 8) | ((v & 0x07e0) << 5) | ((v & 0x001f) << 3);
+            u |= ((v & 0xe000) << 3) | ((v & 0x0600) >> 1) | ((v & 0x001c) >> 2);
+            d[x] = 0xff000000 | u;
+        }
+    }
+
+    void blit_bgr888_from_bgra8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u24, u32);
+        for (int x = 0; x < count; ++x)
+        {
             d[x] = s[x];
         }
     }
 
-    void blit_rgb888_from_bgra8888(u8* dest, const u8* src, int count)
+    void blit_rgb888_from_bgra8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u8, u8);
+        for (int x = 0; x < count; ++x)
+        {
+            d[0] = s[2];
+            d[1] = s[1];
+            d[2] = s[0];
+            s += 4;
+            d += 3;
+        }
+    }
+
+    void blit_bgr888_to_and_from_rgb888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u8, u8);
+        for (int x = 0; x < count; ++x)
+        {
+            d[0] = s[2];
+            d[1] = s[1];
+            d[2] = s[0];
+            s += 3;
+            d += 3;
+        }
+    }
+
+    void blit_bgr565_from_bgra8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u16, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = ((v >> 8) & 0xf800) | ((v >> 5) & 0x07e0) | ((v >> 3) & 0x001f);
+            d[x] = u16(u);
+        }
+    }
+
+    void blit_bgra5551_from_bgra8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u16, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = ((v >> 16) & 0x8000) | ((v >> 9) & 0x7c00) | ((v >> 6) & 0x03e0) | ((v >> 3) & 0x001f);
+            d[x] = u16(u);
+        }
+    }
+
+    void blit_bgra4444_from_bgra8888(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u16, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            u32 u = ((v >> 16) & 0xf000) | ((v >> 12) & 0x0f00) | ((v >> 8) & 0x00f0) | ((v >> 4) & 0x000f);
+            d[x] = u16(u);
+        }
+    }
+
+    void blit_yyy888_from_y8(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u24, u8);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            d[x] = u24(v * 0x010101);
+        }
+    }
+
+    void blit_yyya8888_from_y8(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u8);
+        for (int x = 0; x < count; ++x)
+        {
+            u32 v = s[x];
+            d[x] = 0xff000000 | v * 0x010101;
+        }
+    }
+
+    void blit_rgba8888_from_y16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 i = s[x] >> 8;
+            d[x] = 0xff000000 | i * 0x010101;
+        }
+    }
+
+    void blit_bgra8888_from_y16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 i = s[x] >> 8;
+            d[x] = 0xff000000 | i * 0x010101;
+        }
+    }
+
+    void blit_rgba8888_from_ya16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 a = s[x] & 0xff000000;
+            const u32 i = (s[x] & 0x0000ff00) >> 8;
+            d[x] = a | i * 0x010101;
+        }
+    }
+
+    void blit_bgra8888_from_ya16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u32);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 a = s[x] & 0xff000000;
+            const u32 i = (s[x] & 0x0000ff00) >> 8;
+            d[x] = a | i * 0x010101;
+        }
+    }
+
+    void blit_rgba8888_from_rgb16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 r = s[0];
+            const u32 g = s[1] & 0x0000ff00;
+            const u32 b = s[2] & 0x0000ff00;
+            d[x] = 0xff000000 | (b << 8) | g | (r >> 8);
+            s += 3;
+        }
+    }
+
+    void blit_bgra8888_from_rgb16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 r = s[0] & 0x0000ff00;
+            const u32 g = s[1] & 0x0000ff00;
+            const u32 b = s[2];
+            d[x] = 0xff000000 | (r << 8) | g | (b >> 8);
+            s += 3;
+        }
+    }
+
+    void blit_rgba8888_from_rgba16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 r = s[0];
+            const u32 g = s[1] & 0x0000ff00;
+            const u32 b = s[2] & 0x0000ff00;
+            const u32 a = s[3] & 0x0000ff00;
+            d[x] = (a << 16) | (b << 8) | g | (r >> 8);
+            s += 4;
+        }
+    }
+
+    void blit_bgra8888_from_rgba16ui(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, u16);
+        for (int x = 0; x < count; ++x)
+        {
+            const u32 r = s[0] & 0x0000ff00;
+            const u32 g = s[1] & 0x0000ff00;
+            const u32 b = s[2];
+            const u32 a = s[3] & 0x0000ff00;
+            d[x] = (a << 16) | (r << 8) | g | (b >> 8);
+            s += 4;
+        }
+    }
+
+    void blit_rgba8888_from_rgba16f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, float16x4);
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 f = convert<float32x4>(s[x]);
+            f = clamp(f, 0.0f, 1.0f);
+            f = f * 255.0f;
+            int32x4 i = convert<int32x4>(f);
+            d[x] = i.pack();
+        }
+    }
+
+    void blit_bgra8888_from_rgba16f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, float16x4);
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 f = convert<float32x4>(s[x]);
+            f = f.zyxw;
+            f = clamp(f, 0.0f, 1.0f);
+            f = f * 255.0f;
+            int32x4 i = convert<int32x4>(f);
+            d[x] = i.pack();
+        }
+    }
+
+    void blit_rgba8888_from_rgba32f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, float32x4);
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 f = s[x];
+            f = clamp(f, 0.0f, 1.0f);
+            f = f * 255.0f;
+            int32x4 i = convert<int32x4>(f);
+            d[x] = i.pack();
+        }
+    }
+
+    void blit_bgra8888_from_rgba32f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(u32, float32x4);
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 f = s[x];
+            f = f.zyxw;
+            f = clamp(f, 0.0f, 1.0f);
+            f = f * 255.0f;
+            int32x4 i = convert<int32x4>(f);
+            d[x] = i.pack();
+        }
+    }
+
+    void blit_rgba16f_from_rgba32f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(float16x4, float32x4);
+        for (int x = 0; x < count; ++x)
+        {
+            d[x] = convert<float16x4>(s[x]);
+        }
+    }
+
+    void blit_rgba32f_from_rgba16f(u8* dest, const u8* src, int count)
+    {
+        INIT_POINTERS(float32x4, float16x4);
+        for (int x = 0; x < count; ++x)
+        {
+            d[x] = convert<float32x4>(s[x]);
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // SIMD conversion functions
+    // ----------------------------------------------------------------------------
+
+    // The SIMD functions convert the pixels in batches and let the scalar version
+    // above handle the remaining pixels at the end of the scanline.
+
+#if defined(MANGO_ENABLE_SSE2)
+
+    inline __m128i sse2_load(const u8* src)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    }
+
+    inline void sse2_store(u8* dest, __m128i value)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), value);
+    }
+
+    inline __m128i sse2_pack_u32_u16(__m128i a, __m128i b)
+    {
+        // sign-extend the low 16 bits so that the saturating pack keeps them intact
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        return _mm_packs_epi32(a, b);
+    }
+
+    inline __m128i sse2_swap_rb(__m128i v)
+    {
+        __m128i rb = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+        rb = _mm_and_si128(rb, _mm_set1_epi32(0x00ff00ff));
+        return _mm_or_si128(rb, _mm_and_si128(v, _mm_set1_epi32(0xff00ff00)));
+    }
+
+    void blit_bgra8888_from_bgrx8888_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        for ( ; count >= 4; count -= 4)
+        {
+            sse2_store(dest, _mm_or_si128(sse2_load(src), alpha));
+            src += 16;
+            dest += 16;
+        }
+
+        blit_bgra8888_from_bgrx8888(dest, src, count);
+    }
+
+    void blit_bgra8888_to_and_from_rgba8888_sse2(u8* dest, const u8* src, int count)
+    {
+        for ( ; count >= 4; count -= 4)
+        {
+            sse2_store(dest, sse2_swap_rb(sse2_load(src)));
+            src += 16;
+            dest += 16;
+        }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
+    }
+
+    void blit_bgra8888_from_bgra4444_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask = _mm_set1_epi16(0x0f0f);
+
+        for ( ; count >= 8; count -= 8)
+        {
+            __m128i v = sse2_load(src);
+            __m128i br = _mm_and_si128(v, mask);
+            __m128i ga = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+            br = _mm_or_si128(br, _mm_slli_epi16(br, 4));
+            ga = _mm_or_si128(ga, _mm_slli_epi16(ga, 4));
+            sse2_store(dest +  0, _mm_unpacklo_epi8(br, ga));
+            sse2_store(dest + 16, _mm_unpackhi_epi8(br, ga));
+            src += 16;
+            dest += 32;
+        }
+
+        blit_bgra8888_from_bgra4444(dest, src, count);
+    }
+
+    void blit_bgra8888_from_bgra5551_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask5 = _mm_set1_epi16(0x1f);
+        const __m128i mask8 = _mm_set1_epi16(0xff);
+
+        for ( ; count >= 8; count -= 8)
+        {
+            __m128i v = sse2_load(src);
+            __m128i b = _mm_slli_epi16(_mm_and_si128(v, mask5), 3);
+            __m128i g = _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), mask5), 3);
+            __m128i r = _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v, 10), mask5), 3);
+            __m128i a = _mm_and_si128(_mm_srai_epi16(v, 15), mask8);
+            b = _mm_or_si128(b, _mm_srli_epi16(b, 5));
+            g = _mm_or_si128(g, _mm_srli_epi16(g, 5));
+            r = _mm_or_si128(r, _mm_srli_epi16(r, 5));
+            __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+            __m128i ra = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+            sse2_store(dest +  0, _mm_unpacklo_epi16(bg, ra));
+            sse2_store(dest + 16, _mm_unpackhi_epi16(bg, ra));
+            src += 16;
+            dest += 32;
+        }
+
+        blit_bgra8888_from_bgra5551(dest, src, count);
+    }
+
+    void blit_bgra8888_from_bgr565_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask5 = _mm_set1_epi16(0x1f);
+        const __m128i mask6 = _mm_set1_epi16(0x3f);
+        const __m128i alpha = _mm_set1_epi16(short(0xff00));
+
+        for ( ; count >= 8; count -= 8)
+        {
+            __m128i v = sse2_load(src);
+            __m128i b = _mm_and_si128(v, mask5);
+            __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+            __m128i r = _mm_srli_epi16(v, 11);
+            b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+            g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+            r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+            __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+            __m128i ra = _mm_or_si128(r, alpha);
+            sse2_store(dest +  0, _mm_unpacklo_epi16(bg, ra));
+            sse2_store(dest + 16, _mm_unpackhi_epi16(bg, ra));
+            src += 16;
+            dest += 32;
+        }
+
+        blit_bgra8888_from_bgr565(dest, src, count);
+    }
+
+    inline __m128i sse2_bgr565_from_bgra8888(__m128i v)
+    {
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xf800));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07e0));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001f));
+        return _mm_or_si128(_mm_or_si128(r, g), b);
+    }
+
+    inline __m128i sse2_bgra5551_from_bgra8888(__m128i v)
+    {
+        __m128i a = _mm_and_si128(_mm_srli_epi32(v, 16), _mm_set1_epi32(0x8000));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 9), _mm_set1_epi32(0x7c00));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 6), _mm_set1_epi32(0x03e0));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001f));
+        return _mm_or_si128(_mm_or_si128(a, r), _mm_or_si128(g, b));
+    }
+
+    inline __m128i sse2_bgra4444_from_bgra8888(__m128i v)
+    {
+        __m128i a = _mm_and_si128(_mm_srli_epi32(v, 16), _mm_set1_epi32(0xf000));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 12), _mm_set1_epi32(0x0f00));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0x00f0));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi32(0x000f));
+        return _mm_or_si128(_mm_or_si128(a, r), _mm_or_si128(g, b));
+    }
+
+#define BLIT_PACK16_FROM_BGRA8888_SSE2(name) \
+    void blit_##name##_from_bgra8888_sse2(u8* dest, const u8* src, int count) \
+    { \
+        for ( ; count >= 8; count -= 8) \
+        { \
+            __m128i a = sse2_##name##_from_bgra8888(sse2_load(src +  0)); \
+            __m128i b = sse2_##name##_from_bgra8888(sse2_load(src + 16)); \
+            sse2_store(dest, sse2_pack_u32_u16(a, b)); \
+            src += 32; \
+            dest += 16; \
+        } \
+        blit_##name##_from_bgra8888(dest, src, count); \
+    }
+
+    BLIT_PACK16_FROM_BGRA8888_SSE2(bgr565)
+    BLIT_PACK16_FROM_BGRA8888_SSE2(bgra5551)
+    BLIT_PACK16_FROM_BGRA8888_SSE2(bgra4444)
+
+#undef BLIT_PACK16_FROM_BGRA8888_SSE2
+
+    void blit_yyya8888_from_y8_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i alpha = _mm_set1_epi8(-1);
+
+        for ( ; count >= 16; count -= 16)
+        {
+            __m128i y = sse2_load(src);
+            __m128i yy0 = _mm_unpacklo_epi8(y, y);
+            __m128i yy1 = _mm_unpackhi_epi8(y, y);
+            __m128i ya0 = _mm_unpacklo_epi8(y, alpha);
+            __m128i ya1 = _mm_unpackhi_epi8(y, alpha);
+            sse2_store(dest +  0, _mm_unpacklo_epi16(yy0, ya0));
+            sse2_store(dest + 16, _mm_unpackhi_epi16(yy0, ya0));
+            sse2_store(dest + 32, _mm_unpacklo_epi16(yy1, ya1));
+            sse2_store(dest + 48, _mm_unpackhi_epi16(yy1, ya1));
+            src += 16;
+            dest += 64;
+        }
+
+        blit_yyya8888_from_y8(dest, src, count);
+    }
+
+    void blit_yyya8888_from_y16ui_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i alpha = _mm_set1_epi16(short(0xff00));
+
+        for ( ; count >= 8; count -= 8)
+        {
+            __m128i y = _mm_srli_epi16(sse2_load(src), 8);
+            __m128i yy = _mm_or_si128(y, _mm_slli_epi16(y, 8));
+            __m128i ya = _mm_or_si128(y, alpha);
+            sse2_store(dest +  0, _mm_unpacklo_epi16(yy, ya));
+            sse2_store(dest + 16, _mm_unpackhi_epi16(yy, ya));
+            src += 16;
+            dest += 32;
+        }
+
+        blit_bgra8888_from_y16ui(dest, src, count);
+    }
+
+    void blit_yyya8888_from_ya16ui_sse2(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128i v = sse2_load(src);
+            __m128i a = _mm_and_si128(v, alpha);
+            __m128i i = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+            i = _mm_or_si128(i, _mm_slli_epi32(i, 8));
+            i = _mm_or_si128(i, _mm_slli_epi32(i, 8));
+            sse2_store(dest, _mm_or_si128(a, i));
+            src += 16;
+            dest += 16;
+        }
+
+        blit_bgra8888_from_ya16ui(dest, src, count);
+    }
+
+    void blit_rgba8888_from_rgba16ui_sse2(u8* dest, const u8* src, int count)
+    {
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128i a = _mm_srli_epi16(sse2_load(src +  0), 8);
+            __m128i b = _mm_srli_epi16(sse2_load(src + 16), 8);
+            sse2_store(dest, _mm_packus_epi16(a, b));
+            src += 32;
+            dest += 16;
+        }
+
+        blit_rgba8888_from_rgba16ui(dest, src, count);
+    }
+
+    void blit_bgra8888_from_rgba16ui_sse2(u8* dest, const u8* src, int count)
+    {
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128i a = _mm_srli_epi16(sse2_load(src +  0), 8);
+            __m128i b = _mm_srli_epi16(sse2_load(src + 16), 8);
+            sse2_store(dest, sse2_swap_rb(_mm_packus_epi16(a, b)));
+            src += 32;
+            dest += 16;
+        }
+
+        blit_bgra8888_from_rgba16ui(dest, src, count);
+    }
+
+    inline __m128i sse2_unorm8_from_float(__m128 f)
+    {
+        // the conversion rounds to nearest
+        const __m128 scale = _mm_set1_ps(255.0f);
+        f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvtps_epi32(_mm_mul_ps(f, scale));
+    }
+
+    inline void sse2_store_rgba8888(u8* dest, __m128 f0, __m128 f1, __m128 f2, __m128 f3)
+    {
+        __m128i a = _mm_packs_epi32(sse2_unorm8_from_float(f0), sse2_unorm8_from_float(f1));
+        __m128i b = _mm_packs_epi32(sse2_unorm8_from_float(f2), sse2_unorm8_from_float(f3));
+        sse2_store(dest, _mm_packus_epi16(a, b));
+    }
+
+    void blit_rgba8888_from_rgba32f_sse2(u8* dest, const u8* src, int count)
+    {
+        const float* s = reinterpret_cast<const float*>(src);
+
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128 f0 = _mm_loadu_ps(s +  0);
+            __m128 f1 = _mm_loadu_ps(s +  4);
+            __m128 f2 = _mm_loadu_ps(s +  8);
+            __m128 f3 = _mm_loadu_ps(s + 12);
+            sse2_store_rgba8888(dest, f0, f1, f2, f3);
+            s += 16;
+            dest += 16;
+        }
+
+        blit_rgba8888_from_rgba32f(dest, reinterpret_cast<const u8*>(s), count);
+    }
+
+    void blit_bgra8888_from_rgba32f_sse2(u8* dest, const u8* src, int count)
+    {
+        const float* s = reinterpret_cast<const float*>(src);
+
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128 f0 = _mm_loadu_ps(s +  0);
+            __m128 f1 = _mm_loadu_ps(s +  4);
+            __m128 f2 = _mm_loadu_ps(s +  8);
+            __m128 f3 = _mm_loadu_ps(s + 12);
+            f0 = _mm_shuffle_ps(f0, f0, _MM_SHUFFLE(3, 0, 1, 2));
+            f1 = _mm_shuffle_ps(f1, f1, _MM_SHUFFLE(3, 0, 1, 2));
+            f2 = _mm_shuffle_ps(f2, f2, _MM_SHUFFLE(3, 0, 1, 2));
+            f3 = _mm_shuffle_ps(f3, f3, _MM_SHUFFLE(3, 0, 1, 2));
+            sse2_store_rgba8888(dest, f0, f1, f2, f3);
+            s += 16;
+            dest += 16;
+        }
+
+        blit_bgra8888_from_rgba32f(dest, reinterpret_cast<const u8*>(s), count);
+    }
+
+#endif // MANGO_ENABLE_SSE2
+
+#if defined(MANGO_ENABLE_F16C)
+
+    void blit_rgba8888_from_rgba16f_f16c(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u8, u8);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 4; count -= 4)
         {
-            d[0] = s[2];
-            d[1] = s[1];
-            d[2] = s[0];
-            s += 4;
-            d += 3;
+            __m128i h0 = sse2_load(src +  0);
+            __m128i h1 = sse2_load(src + 16);
+            __m128 f0 = _mm_cvtph_ps(h0);
+            __m128 f1 = _mm_cvtph_ps(_mm_unpackhi_epi64(h0, h0));
+            __m128 f2 = _mm_cvtph_ps(h1);
+            __m128 f3 = _mm_cvtph_ps(_mm_unpackhi_epi64(h1, h1));
+            sse2_store_rgba8888(dest, f0, f1, f2, f3);
+            src += 32;
+            dest += 16;
         }
+
+        blit_rgba8888_from_rgba16f(dest, src, count);
     }
 
-    void blit_bgr888_to_and_from_rgb888(u8* dest, const u8* src, int count)
+    void blit_bgra8888_from_rgba16f_f16c(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u8, u8);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 4; count -= 4)
         {
-            d[0] = s[2];
-            d[1] = s[1];
-            d[2] = s[0];
-            s += 3;
-            d += 3;
+            __m128i h0 = sse2_load(src +  0);
+            __m128i h1 = sse2_load(src + 16);
+            __m128 f0 = _mm_cvtph_ps(h0);
+            __m128 f1 = _mm_cvtph_ps(_mm_unpackhi_epi64(h0, h0));
+            __m128 f2 = _mm_cvtph_ps(h1);
+            __m128 f3 = _mm_cvtph_ps(_mm_unpackhi_epi64(h1, h1));
+            f0 = _mm_shuffle_ps(f0, f0, _MM_SHUFFLE(3, 0, 1, 2));
+            f1 = _mm_shuffle_ps(f1, f1, _MM_SHUFFLE(3, 0, 1, 2));
+            f2 = _mm_shuffle_ps(f2, f2, _MM_SHUFFLE(3, 0, 1, 2));
+            f3 = _mm_shuffle_ps(f3, f3, _MM_SHUFFLE(3, 0, 1, 2));
+            sse2_store_rgba8888(dest, f0, f1, f2, f3);
+            src += 32;
+            dest += 16;
         }
+
+        blit_bgra8888_from_rgba16f(dest, src, count);
     }
 
-    void blit_bgr565_from_bgra8888(u8* dest, const u8* src, int count)
+    void blit_rgba16f_from_rgba32f_f16c(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u16, u32);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 2; count -= 2)
         {
-            u32 v = s[x];
-            u32 u = ((v >> 8) & 0xf800) | ((v >> 5) & 0x07e0) | ((v >> 3) & 0x001f);
-            d[x] = u16(u);
+            __m128 f0 = _mm_loadu_ps(reinterpret_cast<const float*>(src) + 0);
+            __m128 f1 = _mm_loadu_ps(reinterpret_cast<const float*>(src) + 4);
+            __m128i h0 = _mm_cvtps_ph(f0, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m128i h1 = _mm_cvtps_ph(f1, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            sse2_store(dest, _mm_unpacklo_epi64(h0, h1));
+            src += 32;
+            dest += 16;
         }
+
+        blit_rgba16f_from_rgba32f(dest, src, count);
     }
 
-    void blit_bgra5551_from_bgra8888(u8* dest, const u8* src, int count)
+    void blit_rgba32f_from_rgba16f_f16c(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u16, u32);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 2; count -= 2)
         {
-            u32 v = s[x];
-            u32 u = ((v >> 16) & 0x8000) | ((v >> 9) & 0x7c00) | ((v >> 6) & 0x03e0) | ((v >> 3) & 0x001f);
-            d[x] = u16(u);
+            __m128i h = sse2_load(src);
+            _mm_storeu_ps(reinterpret_cast<float*>(dest) + 0, _mm_cvtph_ps(h));
+            _mm_storeu_ps(reinterpret_cast<float*>(dest) + 4, _mm_cvtph_ps(_mm_unpackhi_epi64(h, h)));
+            src += 16;
+            dest += 32;
         }
+
+        blit_rgba32f_from_rgba16f(dest, src, count);
     }
 
-    void blit_bgra4444_from_bgra8888(u8* dest, const u8* src, int count)
+#endif // MANGO_ENABLE_F16C
+
+#if defined(MANGO_ENABLE_SSSE3)
+
+    // 16 pixels of 24 bits are read as four groups of 12 bytes
+    inline void ssse3_load_rgb888(__m128i* v, const u8* src)
     {
-        INIT_POINTERS(u16, u32);
-        for (int x = 0; x < count; ++x)
-        {
-            u32 v = s[x];
-            u32 u = ((v >> 16) & 0xf000) | ((v >> 12) & 0x0f00) | ((v >> 8) & 0x00f0) | ((v >> 4) & 0x000f);
-            d[x] = u16(u);
-        }
+        __m128i a = sse2_load(src +  0);
+        __m128i b = sse2_load(src + 16);
+        __m128i c = sse2_load(src + 32);
+        v[0] = a;
+        v[1] = _mm_alignr_epi8(b, a, 12);
+        v[2] = _mm_alignr_epi8(c, b, 8);
+        v[3] = _mm_srli_si128(c, 4);
     }
 
-    void blit_yyy888_from_y8(u8* dest, const u8* src, int count)
+    // four groups of 12 bytes (the low bytes of each register) are written as 48 bytes
+    inline void ssse3_store_rgb888(u8* dest, const __m128i* v)
     {
-        INIT_POINTERS(u24, u8);
-        for (int x = 0; x < count; ++x)
-        {
-            u32 v = s[x];
-            d[x] = u24(v * 0x010101);
-        }
+        sse2_store(dest +  0, _mm_or_si128(v[0], _mm_slli_si128(v[1], 12)));
+        sse2_store(dest + 16, _mm_or_si128(_mm_srli_si128(v[1], 4), _mm_slli_si128(v[2], 8)));
+        sse2_store(dest + 32, _mm_or_si128(_mm_srli_si128(v[2], 8), _mm_slli_si128(v[3], 4)));
     }
 
-    void blit_yyya8888_from_y8(u8* dest, const u8* src, int count)
+    void blit_bgra8888_to_and_from_rgba8888_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u8);
-        for (int x = 0; x < count; ++x)
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        for ( ; count >= 4; count -= 4)
         {
-            u32 v = s[x];
-            d[x] = 0xff000000 | v * 0x010101;
+            sse2_store(dest, _mm_shuffle_epi8(sse2_load(src), mask));
+            src += 16;
+            dest += 16;
         }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
     }
 
-    void blit_rgba8888_from_y16ui(u8* dest, const u8* src, int count)
+    template <bool swap>
+    void blit_bgra8888_from_rgb888_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        const __m128i mask = swap ?
+            _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+            _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        for ( ; count >= 16; count -= 16)
         {
-            const u32 i = s[x] >> 8;
-            d[x] = 0xff000000 | i * 0x010101;
+            __m128i v[4];
+            ssse3_load_rgb888(v, src);
+            sse2_store(dest +  0, _mm_or_si128(_mm_shuffle_epi8(v[0], mask), alpha));
+            sse2_store(dest + 16, _mm_or_si128(_mm_shuffle_epi8(v[1], mask), alpha));
+            sse2_store(dest + 32, _mm_or_si128(_mm_shuffle_epi8(v[2], mask), alpha));
+            sse2_store(dest + 48, _mm_or_si128(_mm_shuffle_epi8(v[3], mask), alpha));
+            src += 48;
+            dest += 64;
         }
+
+        if (swap)
+            blit_rgba8888_from_bgr888(dest, src, count);
+        else
+            blit_bgra8888_from_bgr888(dest, src, count);
     }
 
-    void blit_bgra8888_from_y16ui(u8* dest, const u8* src, int count)
+    template <bool swap>
+    void blit_rgb888_from_bgra8888_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        const __m128i mask = swap ?
+            _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+            _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        for ( ; count >= 16; count -= 16)
         {
-            const u32 i = s[x] >> 8;
-            d[x] = 0xff000000 | i * 0x010101;
+            __m128i v[4];
+            v[0] = _mm_shuffle_epi8(sse2_load(src +  0), mask);
+            v[1] = _mm_shuffle_epi8(sse2_load(src + 16), mask);
+            v[2] = _mm_shuffle_epi8(sse2_load(src + 32), mask);
+            v[3] = _mm_shuffle_epi8(sse2_load(src + 48), mask);
+            ssse3_store_rgb888(dest, v);
+            src += 64;
+            dest += 48;
         }
+
+        if (swap)
+            blit_rgb888_from_bgra8888(dest, src, count);
+        else
+            blit_bgr888_from_bgra8888(dest, src, count);
     }
 
-    void blit_rgba8888_from_ya16ui(u8* dest, const u8* src, int count)
+    void blit_bgr888_to_and_from_rgb888_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u32);
-        for (int x = 0; x < count; ++x)
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+
+        for ( ; count >= 16; count -= 16)
         {
-            const u32 a = s[x] & 0xff000000;
-            const u32 i = (s[x] & 0x0000ff00) >> 8;
-            d[x] = a | i * 0x010101;
+            __m128i v[4];
+            ssse3_load_rgb888(v, src);
+            v[0] = _mm_shuffle_epi8(v[0], mask);
+            v[1] = _mm_shuffle_epi8(v[1], mask);
+            v[2] = _mm_shuffle_epi8(v[2], mask);
+            v[3] = _mm_shuffle_epi8(v[3], mask);
+            ssse3_store_rgb888(dest, v);
+            src += 48;
+            dest += 48;
         }
+
+        blit_bgr888_to_and_from_rgb888(dest, src, count);
     }
 
-    void blit_bgra8888_from_ya16ui(u8* dest, const u8* src, int count)
+    void blit_yyy888_from_y8_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u32);
-        for (int x = 0; x < count; ++x)
+        const __m128i mask0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        const __m128i mask1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        const __m128i mask2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+        for ( ; count >= 16; count -= 16)
         {
-            const u32 a = s[x] & 0xff000000;
-            const u32 i = (s[x] & 0x0000ff00) >> 8;
-            d[x] = a | i * 0x010101;
+            __m128i y = sse2_load(src);
+            sse2_store(dest +  0, _mm_shuffle_epi8(y, mask0));
+            sse2_store(dest + 16, _mm_shuffle_epi8(y, mask1));
+            sse2_store(dest + 32, _mm_shuffle_epi8(y, mask2));
+            src += 16;
+            dest += 48;
         }
+
+        blit_yyy888_from_y8(dest, src, count);
     }
 
-    void blit_rgba8888_from_rgb16ui(u8* dest, const u8* src, int count)
+    template <bool swap>
+    void blit_bgra8888_from_rgb16ui_ssse3(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        // high bytes of the 16 bit components; pixels 0-1 from the first load, 2-3 from the second
+        const __m128i mask0 = swap ?
+            _mm_setr_epi8(5, 3, 1, -1, 11, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1) :
+            _mm_setr_epi8(1, 3, 5, -1, 7, 9, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i mask1 = swap ?
+            _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 9, 7, 5, -1, 15, 13, 11, -1) :
+            _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 5, 7, 9, -1, 11, 13, 15, -1);
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        for ( ; count >= 4; count -= 4)
         {
-            const u32 r = s[0];
-            const u32 g = s[1] & 0x0000ff00;
-            const u32 b = s[2] & 0x0000ff00;
-            d[x] = 0xff000000 | (b << 8) | g | (r >> 8);
-            s += 3;
+            __m128i a = _mm_shuffle_epi8(sse2_load(src + 0), mask0);
+            __m128i b = _mm_shuffle_epi8(sse2_load(src + 8), mask1);
+            sse2_store(dest, _mm_or_si128(_mm_or_si128(a, b), alpha));
+            src += 24;
+            dest += 16;
         }
+
+        if (swap)
+            blit_bgra8888_from_rgb16ui(dest, src, count);
+        else
+            blit_rgba8888_from_rgb16ui(dest, src, count);
     }
 
-    void blit_bgra8888_from_rgb16ui(u8* dest, const u8* src, int count)
+#endif // MANGO_ENABLE_SSSE3
+
+#if defined(MANGO_ENABLE_AVX2)
+
+    void blit_bgra8888_from_bgrx8888_avx2(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        const __m256i alpha = _mm256_set1_epi32(0xff000000);
+
+        for ( ; count >= 8; count -= 8)
         {
-            const u32 r = s[0] & 0x0000ff00;
-            const u32 g = s[1] & 0x0000ff00;
-            const u32 b = s[2];
-            d[x] = 0xff000000 | (r << 8) | g | (b >> 8);
-            s += 3;
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), _mm256_or_si256(v, alpha));
+            src += 32;
+            dest += 32;
         }
+
+        blit_bgra8888_from_bgrx8888(dest, src, count);
     }
 
-    void blit_rgba8888_from_rgba16ui(u8* dest, const u8* src, int count)
+    void blit_bgra8888_to_and_from_rgba8888_avx2(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        const __m256i mask = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        for ( ; count >= 8; count -= 8)
         {
-            const u32 r = s[0];
-            const u32 g = s[1] & 0x0000ff00;
-            const u32 b = s[2] & 0x0000ff00;
-            const u32 a = s[3] & 0x0000ff00;
-            d[x] = (a << 16) | (b << 8) | g | (r >> 8);
-            s += 4;
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), _mm256_shuffle_epi8(v, mask));
+            src += 32;
+            dest += 32;
         }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
     }
 
-    void blit_bgra8888_from_rgba16ui(u8* dest, const u8* src, int count)
+#endif // MANGO_ENABLE_AVX2
+
+#if defined(MANGO_ENABLE_NEON)
+
+    void blit_bgra8888_from_bgrx8888_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, u16);
-        for (int x = 0; x < count; ++x)
+        const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+
+        for ( ; count >= 4; count -= 4)
         {
-            const u32 r = s[0] & 0x0000ff00;
-            const u32 g = s[1] & 0x0000ff00;
-            const u32 b = s[2];
-            const u32 a = s[3] & 0x0000ff00;
-            d[x] = (a << 16) | (r << 8) | g | (b >> 8);
-            s += 4;
+            uint32x4_t v = vld1q_u32(reinterpret_cast<const u32*>(src));
+            vst1q_u32(reinterpret_cast<u32*>(dest), vorrq_u32(v, alpha));
+            src += 16;
+            dest += 16;
         }
+
+        blit_bgra8888_from_bgrx8888(dest, src, count);
     }
 
-    void blit_rgba8888_from_rgba16f(u8* dest, const u8* src, int count)
+    void blit_bgra8888_to_and_from_rgba8888_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, float16x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            float32x4 f = convert<float32x4>(s[x]);
-            f = clamp(f, 0.0f, 1.0f);
-            f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
-            d[x] = i.pack();
+            uint8x16x4_t v = vld4q_u8(src);
+            uint8x16_t temp = v.val[0];
+            v.val[0] = v.val[2];
+            v.val[2] = temp;
+            vst4q_u8(dest, v);
+            src += 64;
+            dest += 64;
         }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
     }
 
-    void blit_bgra8888_from_rgba16f(u8* dest, const u8* src, int count)
+    template <bool swap>
+    void blit_bgra8888_from_rgb888_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, float16x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            float32x4 f = convert<float32x4>(s[x]);
-            f = f.zyxw;
-            f = clamp(f, 0.0f, 1.0f);
-            f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
-            d[x] = i.pack();
+            uint8x16x3_t v = vld3q_u8(src);
+            uint8x16x4_t w;
+            w.val[0] = swap ? v.val[2] : v.val[0];
+            w.val[1] = v.val[1];
+            w.val[2] = swap ? v.val[0] : v.val[2];
+            w.val[3] = vdupq_n_u8(0xff);
+            vst4q_u8(dest, w);
+            src += 48;
+            dest += 64;
         }
+
+        if (swap)
+            blit_rgba8888_from_bgr888(dest, src, count);
+        else
+            blit_bgra8888_from_bgr888(dest, src, count);
     }
 
-    void blit_rgba8888_from_rgba32f(u8* dest, const u8* src, int count)
+    template <bool swap>
+    void blit_rgb888_from_bgra8888_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, float32x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            float32x4 f = s[x];
-            f = clamp(f, 0.0f, 1.0f);
-            f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
-            d[x] = i.pack();
+            uint8x16x4_t v = vld4q_u8(src);
+            uint8x16x3_t w;
+            w.val[0] = swap ? v.val[2] : v.val[0];
+            w.val[1] = v.val[1];
+            w.val[2] = swap ? v.val[0] : v.val[2];
+            vst3q_u8(dest, w);
+            src += 64;
+            dest += 48;
         }
+
+        if (swap)
+            blit_rgb888_from_bgra8888(dest, src, count);
+        else
+            blit_bgr888_from_bgra8888(dest, src, count);
     }
 
-    void blit_bgra8888_from_rgba32f(u8* dest, const u8* src, int count)
+    void blit_bgr888_to_and_from_rgb888_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(u32, float32x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            float32x4 f = s[x];
-            f = f.zyxw;
-            f = clamp(f, 0.0f, 1.0f);
-            f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
-            d[x] = i.pack();
+            uint8x16x3_t v = vld3q_u8(src);
+            uint8x16_t temp = v.val[0];
+            v.val[0] = v.val[2];
+            v.val[2] = temp;
+            vst3q_u8(dest, v);
+            src += 48;
+            dest += 48;
         }
+
+        blit_bgr888_to_and_from_rgb888(dest, src, count);
     }
 
-    void blit_rgba16f_from_rgba32f(u8* dest, const u8* src, int count)
+    void blit_yyy888_from_y8_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(float16x4, float32x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            d[x] = convert<float16x4>(s[x]);
+            uint8x16_t y = vld1q_u8(src);
+            uint8x16x3_t w;
+            w.val[0] = y;
+            w.val[1] = y;
+            w.val[2] = y;
+            vst3q_u8(dest, w);
+            src += 16;
+            dest += 48;
         }
+
+        blit_yyy888_from_y8(dest, src, count);
     }
 
-    void blit_rgba32f_from_rgba16f(u8* dest, const u8* src, int count)
+    void blit_yyya8888_from_y8_neon(u8* dest, const u8* src, int count)
     {
-        INIT_POINTERS(float32x4, float16x4);
-        for (int x = 0; x < count; ++x)
+        for ( ; count >= 16; count -= 16)
         {
-            d[x] = convert<float32x4>(s[x]);
+            uint8x16_t y = vld1q_u8(src);
+            uint8x16x4_t w;
+            w.val[0] = y;
+            w.val[1] = y;
+            w.val[2] = y;
+            w.val[3] = vdupq_n_u8(0xff);
+            vst4q_u8(dest, w);
+            src += 16;
+            dest += 64;
         }
+
+        blit_yyya8888_from_y8(dest, src, count);
     }
 
+#endif // MANGO_ENABLE_NEON
+
     // ----------------------------------------------------------------------------
     // custom conversion function lookup
     // ----------------------------------------------------------------------------
@@ -1044,6 +2621,85 @@ namespace
         { FORMAT_B8G8R8A8, FORMAT_RGBA32F,    0, blit_bgra8888_from_rgba32f },
         { FORMAT_RGBA16F,  FORMAT_RGBA32F,    0, blit_rgba16f_from_rgba32f },
         { FORMAT_RGBA32F,  FORMAT_RGBA16F,    0, blit_rgba32f_from_rgba16f },
+
+        // SIMD conversion functions; these replace the above when the CPU supports them
+
+#if defined(MANGO_ENABLE_SSE2)
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8X8,   INTEL_SSE2, blit_bgra8888_from_bgrx8888_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_R8G8B8X8,   INTEL_SSE2, blit_bgra8888_from_bgrx8888_sse2 },
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   INTEL_SSE2, blit_bgra8888_to_and_from_rgba8888_sse2 },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   INTEL_SSE2, blit_bgra8888_to_and_from_rgba8888_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   INTEL_SSE2, blit_bgra8888_to_and_from_rgba8888_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   INTEL_SSE2, blit_bgra8888_to_and_from_rgba8888_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_B4G4R4A4,   INTEL_SSE2, blit_bgra8888_from_bgra4444_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_B5G5R5A1,   INTEL_SSE2, blit_bgra8888_from_bgra5551_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_B5G6R5,     INTEL_SSE2, blit_bgra8888_from_bgr565_sse2 },
+        { FORMAT_B5G6R5,   FORMAT_B8G8R8A8,   INTEL_SSE2, blit_bgr565_from_bgra8888_sse2 },
+        { FORMAT_B5G5R5A1, FORMAT_B8G8R8A8,   INTEL_SSE2, blit_bgra5551_from_bgra8888_sse2 },
+        { FORMAT_B4G4R4A4, FORMAT_B8G8R8A8,   INTEL_SSE2, blit_bgra4444_from_bgra8888_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_L8,         INTEL_SSE2, blit_yyya8888_from_y8_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_L8,         INTEL_SSE2, blit_yyya8888_from_y8_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_L16,        INTEL_SSE2, blit_yyya8888_from_y16ui_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_L16,        INTEL_SSE2, blit_yyya8888_from_y16ui_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_L16A16,     INTEL_SSE2, blit_yyya8888_from_ya16ui_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_L16A16,     INTEL_SSE2, blit_yyya8888_from_ya16ui_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_RGBA16,     INTEL_SSE2, blit_rgba8888_from_rgba16ui_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA16,     INTEL_SSE2, blit_bgra8888_from_rgba16ui_sse2 },
+        { FORMAT_R8G8B8A8, FORMAT_RGBA32F,    INTEL_SSE2, blit_rgba8888_from_rgba32f_sse2 },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA32F,    INTEL_SSE2, blit_bgra8888_from_rgba32f_sse2 },
+#endif
+
+#if defined(MANGO_ENABLE_F16C)
+        { FORMAT_R8G8B8A8, FORMAT_RGBA16F,    INTEL_F16C, blit_rgba8888_from_rgba16f_f16c },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA16F,    INTEL_F16C, blit_bgra8888_from_rgba16f_f16c },
+        { FORMAT_RGBA16F,  FORMAT_RGBA32F,    INTEL_F16C, blit_rgba16f_from_rgba32f_f16c },
+        { FORMAT_RGBA32F,  FORMAT_RGBA16F,    INTEL_F16C, blit_rgba32f_from_rgba16f_f16c },
+#endif
+
+#if defined(MANGO_ENABLE_SSSE3)
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   INTEL_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   INTEL_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   INTEL_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   INTEL_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8,     INTEL_SSSE3, blit_bgra8888_from_rgb888_ssse3<false> },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8,     INTEL_SSSE3, blit_bgra8888_from_rgb888_ssse3<true> },
+        { FORMAT_B8G8R8,   FORMAT_B8G8R8A8,   INTEL_SSSE3, blit_rgb888_from_bgra8888_ssse3<false> },
+        { FORMAT_R8G8B8,   FORMAT_B8G8R8A8,   INTEL_SSSE3, blit_rgb888_from_bgra8888_ssse3<true> },
+        { FORMAT_R8G8B8,   FORMAT_B8G8R8,     INTEL_SSSE3, blit_bgr888_to_and_from_rgb888_ssse3 },
+        { FORMAT_B8G8R8,   FORMAT_R8G8B8,     INTEL_SSSE3, blit_bgr888_to_and_from_rgb888_ssse3 },
+        { FORMAT_B8G8R8,   FORMAT_L8,         INTEL_SSSE3, blit_yyy888_from_y8_ssse3 },
+        { FORMAT_R8G8B8,   FORMAT_L8,         INTEL_SSSE3, blit_yyy888_from_y8_ssse3 },
+        { FORMAT_R8G8B8A8, FORMAT_RGB16,      INTEL_SSSE3, blit_bgra8888_from_rgb16ui_ssse3<false> },
+        { FORMAT_B8G8R8A8, FORMAT_RGB16,      INTEL_SSSE3, blit_bgra8888_from_rgb16ui_ssse3<true> },
+#endif
+
+#if defined(MANGO_ENABLE_AVX2)
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8X8,   INTEL_AVX2, blit_bgra8888_from_bgrx8888_avx2 },
+        { FORMAT_R8G8B8A8, FORMAT_R8G8B8X8,   INTEL_AVX2, blit_bgra8888_from_bgrx8888_avx2 },
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   INTEL_AVX2, blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   INTEL_AVX2, blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   INTEL_AVX2, blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   INTEL_AVX2, blit_bgra8888_to_and_from_rgba8888_avx2 },
+#endif
+
+#if defined(MANGO_ENABLE_NEON)
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8X8,   ARM_NEON, blit_bgra8888_from_bgrx8888_neon },
+        { FORMAT_R8G8B8A8, FORMAT_R8G8B8X8,   ARM_NEON, blit_bgra8888_from_bgrx8888_neon },
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   ARM_NEON, blit_bgra8888_to_and_from_rgba8888_neon },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   ARM_NEON, blit_bgra8888_to_and_from_rgba8888_neon },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   ARM_NEON, blit_bgra8888_to_and_from_rgba8888_neon },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   ARM_NEON, blit_bgra8888_to_and_from_rgba8888_neon },
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8,     ARM_NEON, blit_bgra8888_from_rgb888_neon<false> },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8,     ARM_NEON, blit_bgra8888_from_rgb888_neon<true> },
+        { FORMAT_B8G8R8,   FORMAT_B8G8R8A8,   ARM_NEON, blit_rgb888_from_bgra8888_neon<false> },
+        { FORMAT_R8G8B8,   FORMAT_B8G8R8A8,   ARM_NEON, blit_rgb888_from_bgra8888_neon<true> },
+        { FORMAT_R8G8B8,   FORMAT_B8G8R8,     ARM_NEON, blit_bgr888_to_and_from_rgb888_neon },
+        { FORMAT_B8G8R8,   FORMAT_R8G8B8,     ARM_NEON, blit_bgr888_to_and_from_rgb888_neon },
+        { FORMAT_B8G8R8,   FORMAT_L8,         ARM_NEON, blit_yyy888_from_y8_neon },
+        { FORMAT_R8G8B8,   FORMAT_L8,         ARM_NEON, blit_yyy888_from_y8_neon },
+        { FORMAT_B8G8R8A8, FORMAT_L8,         ARM_NEON, blit_yyya8888_from_y8_neon },
+        { FORMAT_R8G8B8A8, FORMAT_L8,         ARM_NEON, blit_yyya8888_from_y8_neon },
+#endif
     };
 
     using FastConversionMap = std::map< std::pair<Format, Format>, Blitter::FastFunc >;
@@ -1115,12 +2771,14 @@ namespace mango
         , destFormat(dest)
         , custom(nullptr)
         , convertFunc(nullptr)
+        , path("none")
     {
         custom = find_custom_blitter(dest, source);
         if (custom)
         {
             // found custom blitter
             convertFunc = convert_custom;
+            path = "custom";
             return;
         }
 
@@ -1130,6 +2788,32 @@ namespace mango
 
         sampleSize = 0;
 
+        const int destStorage = storage(dest);
+        const int sourceStorage = storage(source);
+        const bool packed = destStorage >= STORAGE_PACKED8 && destStorage <= STORAGE_PACKED32 &&
+                            sourceStorage >= STORAGE_PACKED8 && sourceStorage <= STORAGE_PACKED32;
+
+#if defined(MANGO_ENABLE_SSSE3)
+        if ((getCPUFlags() & INTEL_SSSE3) && is_byte_aligned(dest) && is_byte_aligned(source))
+        {
+            // 8 and 16 bit components are converted with byte shuffles
+            convertFunc = convert_shuffle_ssse3;
+            path = "ssse3";
+            return;
+        }
+#endif
+
+        if (!packed)
+        {
+            // formats with separately stored components are converted with the v2 innerloops
+            convertFunc = convert_v2(dest, source);
+            if (convertFunc)
+            {
+                path = "v2";
+                return;
+            }
+        }
+
         const int source_float_shift = source.type - Format::FLOAT16 + 4;
 
         if (dest.isFloat() && source.isFloat())
@@ -1160,6 +2844,7 @@ namespace mango
             int modeMask = MAKE_MODEMASK(destBits, sourceBits);
 
             convertFunc = convert_fpu(modeMask);
+            path = convertFunc ? "fpu" : "none";
 
             return;
         }
@@ -1231,6 +2916,23 @@ namespace mango
         int modeMask = MAKE_MODEMASK(destBits, sourceBits);
 
         convertFunc = convert_fpu(modeMask);
+        path = convertFunc ? "fpu" : "none";
+
+        if (packed)
+        {
+            if (components == 0)
+            {
+                // the components are only copied or initialized to default
+                convertFunc = convert_mask(modeMask);
+                path = "mask";
+            }
+            else if (components == 1 && IntegerScale(component[0]).exact)
+            {
+                // single channel is scaled with one integer multiply; this is faster than any of the vector loops
+                convertFunc = convert_integer(modeMask);
+                path = "integer";
+            }
+        }
 
 #ifdef MANGO_ENABLE_SSE2
         if (sse2)
@@ -1241,6 +2943,7 @@ namespace mango
             if (func)
             {
                 convertFunc = func;
+                path = "sse2";
 
                 initMask = 0;
 
@@ -1281,10 +2984,30 @@ namespace mango
                 sseSrcMask = _mm_set_epi32(src_mask[0], src_mask[1], src_mask[2], src_mask[3]);
                 sseDestMask = _mm_set_epi32(dest_mask[0], dest_mask[1], dest_mask[2], dest_mask[3]);
                 sseShiftMask = _mm_set_epi32(shift_mask[0], shift_mask[1], shift_mask[2], shift_mask[3]);
+
+#ifdef MANGO_ENABLE_AVX2
+                if (cpuFlags & INTEL_AVX2)
+                {
+                    // same setup as SSE2, processes eight pixels at a time
+                    func = convert_avx2(modeMask);
+                    if (func)
+                    {
+                        convertFunc = func;
+                        path = "avx2";
+                    }
+                }
+#endif
             }
         }
 #else
         MANGO_UNREFERENCED(sse2);
+
+        if (packed && components >= 2)
+        {
+            // the v2 innerloops are vectorized with the portable SIMD abstraction
+            convertFunc = convert_v2(dest, source);
+            path = "v2";
+        }
 #endif
     }
 
@@ -1292,4 +3015,107 @@ namespace mango
     {
     }
 
+    // ----------------------------------------------------------------------------
+    // getBlitter()
+    // ----------------------------------------------------------------------------
+
+    const Blitter& getBlitter(const Format& dest, const Format& source)
+    {
+        using BlitterMap = std::map< std::pair<Format, Format>, std::unique_ptr<Blitter> >;
+
+        static ReadWriteSpinLock lock;
+        static BlitterMap cache;
+
+        const auto key = std::make_pair(dest, source);
+
+        {
+            ReadSpinLockGuard guard(lock);
+
+            auto i = cache.find(key);
+            if (i != cache.end())
+            {
+                return *i->second;
+            }
+        }
+
+        WriteSpinLockGuard guard(lock);
+
+        // another thread may have created the plan while we were waiting for the lock
+        std::unique_ptr<Blitter>& blitter = cache[key];
+        if (!blitter)
+        {
+            blitter.reset(new Blitter(dest, source));
+        }
+
+        return *blitter;
+    }
+
+    // ----------------------------------------------------------------------------
+    // getBlitterCoverageReport()
+    // ----------------------------------------------------------------------------
+
+    std::string getBlitterCoverageReport()
+    {
+        static const struct
+        {
+            Format format;
+            const char* name;
+        }
+        formats[] =
+        {
+            { FORMAT_B8G8R8,       "B8G8R8" },
+            { FORMAT_R8G8B8,       "R8G8B8" },
+            { FORMAT_B8G8R8A8,     "B8G8R8A8" },
+            { FORMAT_B8G8R8X8,     "B8G8R8X8" },
+            { FORMAT_R8G8B8A8,     "R8G8B8A8" },
+            { FORMAT_R8G8B8X8,     "R8G8B8X8" },
+            { FORMAT_BGRA_UNSIGNED_INT_8_8_8_8, "A8R8G8B8" },
+            { FORMAT_B5G6R5,       "B5G6R5" },
+            { FORMAT_B5G5R5X1,     "B5G5R5X1" },
+            { FORMAT_B5G5R5A1,     "B5G5R5A1" },
+            { FORMAT_B4G4R4A4,     "B4G4R4A4" },
+            { FORMAT_B4G4R4X4,     "B4G4R4X4" },
+            { FORMAT_B2G3R3,       "B2G3R3" },
+            { FORMAT_R10G10B10A2,  "R10G10B10A2" },
+            { FORMAT_B10G10R10A2,  "B10G10R10A2" },
+            { FORMAT_R16G16,       "R16G16" },
+            { FORMAT_A8,           "A8" },
+            { FORMAT_R16,          "R16" },
+            { FORMAT_RGB16,        "RGB16" },
+            { FORMAT_RGBA16,       "RGBA16" },
+            { FORMAT_L8,           "L8" },
+            { FORMAT_L8A8,         "L8A8" },
+            { FORMAT_L4A4,         "L4A4" },
+            { FORMAT_L16,          "L16" },
+            { FORMAT_L16A16,       "L16A16" },
+            { FORMAT_L16F,         "L16F" },
+            { FORMAT_L32F,         "L32F" },
+            { FORMAT_RGBA16F,      "RGBA16F" },
+            { FORMAT_RGBA32F,      "RGBA32F" },
+        };
+
+        const int count = int(sizeof(formats) / sizeof(formats[0]));
+
+        std::string report;
+        int fast = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            for (int j = 0; j < count; ++j)
+            {
+                Blitter blitter(formats[i].format, formats[j].format);
+
+                // the scalar float innerloops are slow regardless of the path name
+                const int modeMask = MAKE_MODEMASK(modeBits(formats[i].format), modeBits(formats[j].format));
+                const bool slow = !blitter.convertFunc || blitter.convertFunc == convert_fpu(modeMask);
+                fast += !slow;
+
+                report += makeString("  %-4s  %-6s  %-12s <- %s\n",
+                    slow ? "slow" : "fast", blitter.path, formats[i].name, formats[j].name);
+            }
+        }
+
+        return makeString("Blitter coverage: %d / %d fast conversions\n", fast, count * count) + report;
+    }
+
 } // namespace mango
@@ -36,6 +36,28 @@ namespace mango
 
     void encode_block_etc1           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
 
+    void decode_blocks_dxt1          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_dxt3          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_dxt5          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_3dc_x         (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_3dc_xy        (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_etc1          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_etc2          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_etc2_eac      (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+
+    void encode_blocks_bc1           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc2           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc3           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc4           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc5           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc6h          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_bc7           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_etc2          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_etc2_eac      (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_eac_r11       (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_eac_rg11      (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+    void encode_blocks_astc          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+
 } // namespace mango
 
 namespace
@@ -899,7 +921,6 @@ namespace
 
     void directBlockDecode(const TextureCompressionInfo& block, const Surface& surface, ConstMemory memory, int xsize, int ysize)
     {
-        const int blockImageSize = block.width * surface.format.bytes();
         const int blockImageStride = block.height * surface.stride;
 
         const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
@@ -923,15 +944,10 @@ namespace
                 image += y * blockImageStride;
             }
 
-            queue.enqueue([&] (u8* image, const u8* data)
+            queue.enqueue([&block, image, data, stride, xsize]
             {
-                for (int x = 0; x < xsize; ++x)
-                {
-                    block.decode(block, image, data, stride);
-                    image += blockImageSize;
-                    data += block.bytes;
-                }
-            }, image, data);
+                block.decodeRow(image, data, stride, xsize);
+            });
 
             data += block.bytes * xsize;
         }
@@ -941,20 +957,18 @@ namespace
 
     void clipConvertBlockDecode(const TextureCompressionInfo& block, const Surface& surface, ConstMemory memory, int xsize, int ysize)
     {
-        MANGO_UNREFERENCED(xsize);
         MANGO_UNREFERENCED(ysize);
 
-        Blitter blitter(surface.format, block.format);
+        const Blitter& blitter = getBlitter(surface.format, block.format);
 
         const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
         const u8* data = memory.address;
 
+        // a whole row of blocks is decoded and converted with one blit
         BlitRect rect;
         rect.dest.stride = origin ? -surface.stride : surface.stride;
-        rect.src.stride = block.width * block.format.bytes();
-
-        const int blockStride = block.width * surface.format.bytes();
-        const int xblocks = ceil_div(surface.width, block.width);
+        rect.src.stride = xsize * block.width * block.format.bytes();
+        rect.width = surface.width; // horizontal clipping
 
         ConcurrentQueue queue;
 
@@ -963,24 +977,16 @@ namespace
             rect.dest.address = surface.image + (origin ? surface.height - y - 1 : y) * surface.stride;
             rect.height = std::min(y + block.height, surface.height) - y; // vertical clipping
 
-            queue.enqueue([&] (BlitRect rect, const u8* data)
+            queue.enqueue([&block, &blitter, rect, data, xsize] () mutable
             {
                 Buffer temp(block.height * rect.src.stride);
                 rect.src.address = temp;
 
-                for (int x = 0; x < surface.width; x += block.width)
-                {
-                    block.decode(block, temp, data, rect.src.stride);
-
-                    rect.width = std::min(x + block.width, surface.width) - x; // horizontal clipping
-                    blitter.convert(rect);
-
-                    rect.dest.address += blockStride;
-                    data += block.bytes;
-                }
-            }, rect, data);
+                block.decodeRow(temp, data, rect.src.stride, xsize);
+                blitter.convert(rect);
+            });
 
-            data += block.bytes * xblocks;
+            data += block.bytes * xsize;
         }
 
         queue.wait();
@@ -1013,6 +1019,202 @@ namespace
         Surface(surface).blit(0, 0, bitmap);
     }
 
+    // batch decode
+
+    using DecodeBatchFunc = void (*)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+
+    DecodeBatchFunc getBatchDecoder(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_SRGB:
+            case TextureCompression::DXT1_ALPHA1:
+            case TextureCompression::DXT1_ALPHA1_SRGB:
+                return decode_blocks_dxt1;
+
+            case TextureCompression::DXT3:
+            case TextureCompression::DXT3_SRGB:
+                return decode_blocks_dxt3;
+
+            case TextureCompression::DXT5:
+            case TextureCompression::DXT5_SRGB:
+                return decode_blocks_dxt5;
+
+            case TextureCompression::AMD_3DC_X:
+                return decode_blocks_3dc_x;
+
+            case TextureCompression::AMD_3DC_XY:
+                return decode_blocks_3dc_xy;
+
+#ifdef MANGO_ENABLE_LICENSE_APACHE
+            case TextureCompression::ETC1_RGB:
+                return decode_blocks_etc1;
+
+            case TextureCompression::ETC2_RGB:
+            case TextureCompression::ETC2_SRGB:
+                return decode_blocks_etc2;
+
+            case TextureCompression::ETC2_RGBA:
+            case TextureCompression::ETC2_SRGB_ALPHA8:
+                return decode_blocks_etc2_eac;
+#endif
+
+            default:
+                return nullptr;
+        }
+    }
+
+    // batch encode
+
+    using EncodeBatchFunc = void (*)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality);
+
+    struct BatchEncoder
+    {
+        EncodeBatchFunc func;
+        Format format; // the encoder reads whole block rows in this format
+    };
+
+    BatchEncoder getBatchEncoder(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_SRGB:
+                return { encode_blocks_bc1, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::DXT3:
+            case TextureCompression::DXT3_SRGB:
+                return { encode_blocks_bc2, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::DXT5:
+            case TextureCompression::DXT5_SRGB:
+                return { encode_blocks_bc3, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::RGTC1_RED:
+            case TextureCompression::AMD_3DC_X:
+                return { encode_blocks_bc4, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::RGTC2_RG:
+            case TextureCompression::AMD_3DC_XY:
+                return { encode_blocks_bc5, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::BPTC_RGBA_UNORM:
+            case TextureCompression::BPTC_SRGB_ALPHA_UNORM:
+                return { encode_blocks_bc7, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::BPTC_RGB_UNSIGNED_FLOAT:
+                return { encode_blocks_bc6h, FORMAT_RGBA32F };
+
+            case TextureCompression::ETC2_RGB:
+            case TextureCompression::ETC2_SRGB:
+            case TextureCompression::ETC2_RGB_ALPHA1:
+            case TextureCompression::ETC2_SRGB_ALPHA1:
+                return { encode_blocks_etc2, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::ETC2_RGBA:
+            case TextureCompression::ETC2_SRGB_ALPHA8:
+                return { encode_blocks_etc2_eac, FORMAT_R8G8B8A8 };
+
+            case TextureCompression::EAC_R11:
+                return { encode_blocks_eac_r11, FORMAT_RGBA32F };
+
+            case TextureCompression::EAC_RG11:
+                return { encode_blocks_eac_rg11, FORMAT_RGBA32F };
+
+            case TextureCompression::ASTC_RGBA_4x4:
+            case TextureCompression::ASTC_RGBA_5x4:
+            case TextureCompression::ASTC_RGBA_5x5:
+            case TextureCompression::ASTC_RGBA_6x5:
+            case TextureCompression::ASTC_RGBA_6x6:
+            case TextureCompression::ASTC_RGBA_8x5:
+            case TextureCompression::ASTC_RGBA_8x6:
+            case TextureCompression::ASTC_RGBA_8x8:
+            case TextureCompression::ASTC_RGBA_10x5:
+            case TextureCompression::ASTC_RGBA_10x6:
+            case TextureCompression::ASTC_RGBA_10x8:
+            case TextureCompression::ASTC_RGBA_10x10:
+            case TextureCompression::ASTC_RGBA_12x10:
+            case TextureCompression::ASTC_RGBA_12x12:
+            case TextureCompression::ASTC_SRGB_ALPHA_4x4:
+            case TextureCompression::ASTC_SRGB_ALPHA_5x4:
+            case TextureCompression::ASTC_SRGB_ALPHA_5x5:
+            case TextureCompression::ASTC_SRGB_ALPHA_6x5:
+            case TextureCompression::ASTC_SRGB_ALPHA_6x6:
+            case TextureCompression::ASTC_SRGB_ALPHA_8x5:
+            case TextureCompression::ASTC_SRGB_ALPHA_8x6:
+            case TextureCompression::ASTC_SRGB_ALPHA_8x8:
+            case TextureCompression::ASTC_SRGB_ALPHA_10x5:
+            case TextureCompression::ASTC_SRGB_ALPHA_10x6:
+            case TextureCompression::ASTC_SRGB_ALPHA_10x8:
+            case TextureCompression::ASTC_SRGB_ALPHA_10x10:
+            case TextureCompression::ASTC_SRGB_ALPHA_12x10:
+            case TextureCompression::ASTC_SRGB_ALPHA_12x12:
+                return { encode_blocks_astc, FORMAT_R8G8B8A8 };
+
+            default:
+                return { nullptr, Format() };
+        }
+    }
+
+    void batchEncode(const TextureCompressionInfo& block, Memory memory, const Surface& surface,
+                     const BatchEncoder& encoder, TextureCompressionQuality quality)
+    {
+        if (surface.width < 1 || surface.height < 1)
+            return;
+
+        const int xblocks = ceil_div(surface.width, block.width);
+        const int yblocks = ceil_div(surface.height, block.height);
+
+        const Blitter& blitter = getBlitter(encoder.format, surface.format);
+        const int bpp = encoder.format.bytes();
+
+        // the blocks are stored from the bottom of the image (see directBlockDecode)
+        const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
+
+        ConcurrentQueue queue;
+
+        for (int y = 0; y < yblocks; ++y)
+        {
+            queue.enqueue([&, y]
+            {
+                Bitmap temp(xblocks * block.width, block.height, encoder.format);
+
+                const int width = surface.width;
+                const int height = std::min(block.height, surface.height - y * block.height);
+
+                BlitRect rect;
+                rect.src.address = surface.address(0, origin ? surface.height - 1 - y * block.height : y * block.height);
+                rect.src.stride = origin ? -surface.stride : surface.stride;
+                rect.dest.address = temp.image;
+                rect.dest.stride = temp.stride;
+                rect.width = width;
+                rect.height = height;
+                blitter.convert(rect);
+
+                // replicate the edge pixels into the partial blocks
+                for (int i = 0; i < height; ++i)
+                {
+                    u8* scan = temp.address(0, i);
+                    for (int x = width; x < temp.width; ++x)
+                    {
+                        std::memcpy(scan + x * bpp, scan + (width - 1) * bpp, bpp);
+                    }
+                }
+
+                for (int i = height; i < block.height; ++i)
+                {
+                    std::memcpy(temp.address(0, i), temp.address(0, height - 1), temp.stride);
+                }
+
+                u8* data = memory.address + y * xblocks * block.bytes;
+                encoder.func(block, data, temp.image, temp.stride, xblocks, quality);
+            });
+        }
+
+        queue.wait();
+    }
+
 } // namespace
 
 namespace mango
@@ -1116,6 +1318,25 @@ namespace mango
         *this = *info;
     }
 
+    void TextureCompressionInfo::decodeRow(u8* output, const u8* input, int stride, int count) const
+    {
+        DecodeBatchFunc func = getBatchDecoder(compression);
+        if (func)
+        {
+            func(*this, output, input, stride, count);
+            return;
+        }
+
+        const int size = width * format.bytes();
+
+        for (int i = 0; i < count; ++i)
+        {
+            decode(*this, output, input, stride);
+            output += size;
+            input += bytes;
+        }
+    }
+
     TextureCompressionStatus TextureCompressionInfo::decompress(const Surface& surface, ConstMemory memory) const
     {
         TextureCompressionStatus status;
@@ -1162,10 +1383,17 @@ namespace mango
         return status;
     }
 
-    TextureCompressionStatus TextureCompressionInfo::compress(Memory memory, const Surface& surface) const
+    TextureCompressionStatus TextureCompressionInfo::compress(Memory memory, const Surface& surface, CompressionQuality quality) const
     {
         TextureCompressionStatus status;
 
+        BatchEncoder batch = getBatchEncoder(compression);
+        if (batch.func)
+        {
+            batchEncode(*this, memory, surface, batch, quality);
+            return status;
+        }
+
         if (!encode)
         {
             status.setError("No encoder for 0x%x.", compression);
@@ -1179,17 +1407,29 @@ namespace mango
         const int xblocks = ceil_div(surface.width, width);
         const int yblocks = ceil_div(surface.height, height);
 
+        // the same conversion is used for every block
+        const Blitter& blitter = getBlitter(format, surface.format);
+
         for (int y = 0; y < yblocks; ++y)
         {
-            queue.enqueue([this, y, xblocks, &surface, address]
+            queue.enqueue([this, y, xblocks, &surface, &blitter, address]
             {
                 Bitmap temp(width, height, format);
                 u8* data = address + y * xblocks * bytes;
 
+                BlitRect rect;
+                rect.dest.address = temp.image;
+                rect.dest.stride = temp.stride;
+
                 for (int x = 0; x < xblocks; ++x)
                 {
                     Surface source(surface, x * width, y * height, width, height);
-                    temp.blit(0, 0, source);
+
+                    rect.src.address = source.image;
+                    rect.src.stride = source.stride;
+                    rect.width = source.width;
+                    rect.height = source.height;
+                    blitter.convert(rect);
 
                     u8* image = temp.address<u8>();
                     encode(*this, data, image, temp.stride);
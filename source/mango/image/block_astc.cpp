@@ -0,0 +1,1186 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <mango/core/endian.hpp>
+#include <mango/core/bits.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/compression.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // integer sequence encoding
+    // ----------------------------------------------------------------------------
+
+    // ASTC stores the endpoints and the weights with a mix of bits, trits and quints.
+    // The unquantized values are computed with the same bit manipulation as the decoder
+    // and the nearest quantized value is looked up from tables which are built once.
+
+    struct QuantLevel
+    {
+        int levels;
+        int trits;
+        int quints;
+        int bits;
+    };
+
+    const QuantLevel g_quant_level[] =
+    {
+        {   2, 0, 0, 1 },
+        {   3, 1, 0, 0 },
+        {   4, 0, 0, 2 },
+        {   5, 0, 1, 0 },
+        {   6, 1, 0, 1 },
+        {   8, 0, 0, 3 },
+        {  10, 0, 1, 1 },
+        {  12, 1, 0, 2 },
+        {  16, 0, 0, 4 },
+        {  20, 0, 1, 2 },
+        {  24, 1, 0, 3 },
+        {  32, 0, 0, 5 },
+        {  40, 0, 1, 3 },
+        {  48, 1, 0, 4 },
+        {  64, 0, 0, 6 },
+        {  80, 0, 1, 4 },
+        {  96, 1, 0, 5 },
+        { 128, 0, 0, 7 },
+        { 160, 0, 1, 5 },
+        { 192, 1, 0, 6 },
+        { 256, 0, 0, 8 },
+    };
+
+    constexpr int NUM_QUANT_LEVELS = 21;
+    constexpr int NUM_WEIGHT_LEVELS = 12;
+
+    int ise_bits(int level, int count)
+    {
+        const QuantLevel& q = g_quant_level[level];
+        int bits = count * q.bits;
+        if (q.trits)
+            bits += (count * 8 + 4) / 5;
+        if (q.quints)
+            bits += (count * 7 + 2) / 3;
+        return bits;
+    }
+
+    // the largest endpoint range which fits in the available bits
+    int endpoint_level(int bits, int count)
+    {
+        for (int level = NUM_QUANT_LEVELS - 1; level > 0; --level)
+        {
+            if (ise_bits(level, count) <= bits)
+                return level;
+        }
+        return 0;
+    }
+
+    int bit_replicate(int value, int bits, int target)
+    {
+        int result = 0;
+        for (int shift = target - bits; shift > -bits; shift -= bits)
+        {
+            result |= shift >= 0 ? value << shift : value >> -shift;
+        }
+        return result;
+    }
+
+    int unquantize_endpoint(int level, int value)
+    {
+        const QuantLevel& q = g_quant_level[level];
+
+        if (!q.trits && !q.quints)
+            return bit_replicate(value, q.bits, 8);
+
+        static const int table[] = { 204, 113, 93, 54, 44, 26, 22, 13, 11, 6, 5 };
+
+        const int m = value & ((1 << q.bits) - 1);
+        const int tq = value >> q.bits;
+        const int range = q.bits * 2 - (q.trits ? 2 : 1);
+
+        const int a = (m >> 0) & 1;
+        const int b = (m >> 1) & 1;
+        const int c = (m >> 2) & 1;
+        const int d = (m >> 3) & 1;
+        const int e = (m >> 4) & 1;
+        const int f = (m >> 5) & 1;
+
+        const int A = a ? 0x1ff : 0;
+        int B = 0;
+
+        switch (range)
+        {
+            case 2:  B = (b << 8) | (b << 4) | (b << 2) | (b << 1); break;
+            case 3:  B = (b << 8) | (b << 3) | (b << 2); break;
+            case 4:  B = (c << 8) | (b << 7) | (c << 3) | (b << 2) | (c << 1) | b; break;
+            case 5:  B = (c << 8) | (b << 7) | (c << 2) | (b << 1) | c; break;
+            case 6:  B = (d << 8) | (c << 7) | (b << 6) | (d << 2) | (c << 1) | b; break;
+            case 7:  B = (d << 8) | (c << 7) | (b << 6) | (d << 1) | c; break;
+            case 8:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | (e << 1) | d; break;
+            case 9:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | e; break;
+            case 10: B = (f << 8) | (e << 7) | (d << 6) | (c << 5) | (b << 4) | f; break;
+            default: break;
+        }
+
+        return (((tq * table[range] + B) ^ A) >> 2) | (A & 0x80);
+    }
+
+    int unquantize_weight(int level, int value)
+    {
+        const QuantLevel& q = g_quant_level[level];
+
+        int result;
+
+        if (!q.trits && !q.quints)
+        {
+            result = bit_replicate(value, q.bits, 6);
+        }
+        else if (q.bits == 0)
+        {
+            static const int map3[] = { 0, 32, 63 };
+            static const int map5[] = { 0, 16, 32, 47, 63 };
+            result = q.trits ? map3[value] : map5[value];
+        }
+        else
+        {
+            static const int table[] = { 50, 28, 23, 13, 11 };
+
+            const int m = value & ((1 << q.bits) - 1);
+            const int tq = value >> q.bits;
+            const int range = q.bits * 2 + (q.quints ? 1 : 0);
+
+            const int a = (m >> 0) & 1;
+            const int b = (m >> 1) & 1;
+            const int c = (m >> 2) & 1;
+
+            const int A = a ? 0x7f : 0;
+            int B = 0;
+
+            switch (range)
+            {
+                case 4: B = (b << 6) | (b << 2) | b; break;
+                case 5: B = (b << 6) | (b << 1); break;
+                case 6: B = (c << 6) | (b << 5) | (c << 1) | b; break;
+                default: break;
+            }
+
+            result = (((tq * table[range - 2] + B) ^ A) >> 2) | (A & 0x20);
+        }
+
+        return result + (result > 32);
+    }
+
+    // trits and quints packed as in the decoder (ASTC specification C.2.12)
+
+    void decode_trits(int* t, int T)
+    {
+        int C;
+
+        if (((T >> 2) & 7) == 7)
+        {
+            C = (((T >> 5) & 7) << 2) | (T & 3);
+            t[4] = 2;
+            t[3] = 2;
+        }
+        else
+        {
+            C = T & 0x1f;
+            if (((T >> 5) & 3) == 3)
+            {
+                t[4] = 2;
+                t[3] = (T >> 7) & 1;
+            }
+            else
+            {
+                t[4] = (T >> 7) & 1;
+                t[3] = (T >> 5) & 3;
+            }
+        }
+
+        if ((C & 3) == 3)
+        {
+            t[2] = 2;
+            t[1] = (C >> 4) & 1;
+            t[0] = (((C >> 3) & 1) << 1) | (((C >> 2) & 1) & ~((C >> 3) & 1));
+        }
+        else if (((C >> 2) & 3) == 3)
+        {
+            t[2] = 2;
+            t[1] = 2;
+            t[0] = C & 3;
+        }
+        else
+        {
+            t[2] = (C >> 4) & 1;
+            t[1] = (C >> 2) & 3;
+            t[0] = (((C >> 1) & 1) << 1) | ((C & 1) & ~((C >> 1) & 1));
+        }
+    }
+
+    void decode_quints(int* q, int Q)
+    {
+        if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0)
+        {
+            const int q0 = Q & 1;
+            q[2] = (q0 << 2) | ((((Q >> 4) & 1) & ~q0) << 1) | (((Q >> 3) & 1) & ~q0);
+            q[1] = 4;
+            q[0] = 4;
+        }
+        else
+        {
+            int C;
+
+            if (((Q >> 1) & 3) == 3)
+            {
+                q[2] = 4;
+                C = (((Q >> 3) & 3) << 3) | ((~(Q >> 5) & 3) << 1) | (Q & 1);
+            }
+            else
+            {
+                q[2] = (Q >> 5) & 3;
+                C = Q & 0x1f;
+            }
+
+            if ((C & 7) == 5)
+            {
+                q[1] = 4;
+                q[0] = (C >> 3) & 3;
+            }
+            else
+            {
+                q[1] = (C >> 3) & 3;
+                q[0] = C & 7;
+            }
+        }
+    }
+
+    struct QuantTables
+    {
+        u8 endpoint_value[NUM_QUANT_LEVELS][256]; // quantized -> [0, 255]
+        u8 endpoint_quant[NUM_QUANT_LEVELS][256]; // [0, 255] -> nearest quantized
+        u8 weight_value[NUM_WEIGHT_LEVELS][32]; // quantized -> [0, 64]
+        u8 weight_quant[NUM_WEIGHT_LEVELS][65]; // [0, 64] -> nearest quantized
+        u8 trit_encode[243];
+        u8 quint_encode[125];
+
+        QuantTables()
+        {
+            for (int level = 4; level < NUM_QUANT_LEVELS; ++level)
+            {
+                const int levels = g_quant_level[level].levels;
+
+                for (int i = 0; i < levels; ++i)
+                {
+                    endpoint_value[level][i] = u8(unquantize_endpoint(level, i));
+                }
+
+                for (int x = 0; x < 256; ++x)
+                {
+                    int best = 0;
+                    for (int i = 1; i < levels; ++i)
+                    {
+                        if (std::abs(endpoint_value[level][i] - x) < std::abs(endpoint_value[level][best] - x))
+                            best = i;
+                    }
+                    endpoint_quant[level][x] = u8(best);
+                }
+            }
+
+            for (int level = 0; level < NUM_WEIGHT_LEVELS; ++level)
+            {
+                const int levels = g_quant_level[level].levels;
+
+                for (int i = 0; i < levels; ++i)
+                {
+                    weight_value[level][i] = u8(unquantize_weight(level, i));
+                }
+
+                for (int x = 0; x < 65; ++x)
+                {
+                    int best = 0;
+                    for (int i = 1; i < levels; ++i)
+                    {
+                        if (std::abs(weight_value[level][i] - x) < std::abs(weight_value[level][best] - x))
+                            best = i;
+                    }
+                    weight_quant[level][x] = u8(best);
+                }
+            }
+
+            // the smallest code is used for every value so that the unused trailing values
+            // in a partial block have zero bits
+            for (int T = 255; T >= 0; --T)
+            {
+                int t[5];
+                decode_trits(t, T);
+                trit_encode[t[0] + t[1] * 3 + t[2] * 9 + t[3] * 27 + t[4] * 81] = u8(T);
+            }
+
+            for (int Q = 127; Q >= 0; --Q)
+            {
+                int q[3];
+                decode_quints(q, Q);
+                quint_encode[q[0] + q[1] * 5 + q[2] * 25] = u8(Q);
+            }
+        }
+    };
+
+    const QuantTables& getQuantTables()
+    {
+        static const QuantTables tables;
+        return tables;
+    }
+
+    struct BitWriter128
+    {
+        u64 data[2] = { 0, 0 };
+        int offset = 0;
+
+        void write(u32 value, int bits)
+        {
+            if (!bits)
+                return;
+
+            const u64 v = u64(value) & ((u64(1) << bits) - 1);
+            const int index = offset >> 6;
+            const int shift = offset & 63;
+
+            if (index < 2)
+            {
+                data[index] |= v << shift;
+                if (index == 0 && shift + bits > 64)
+                {
+                    data[1] |= v >> (64 - shift);
+                }
+            }
+
+            offset += bits;
+        }
+
+        // clear the bits at and above length
+        void truncate(int length)
+        {
+            if (length < 64)
+            {
+                data[0] &= (u64(1) << length) - 1;
+                data[1] = 0;
+            }
+            else if (length < 128)
+            {
+                data[1] &= (u64(1) << (length - 64)) - 1;
+            }
+        }
+    };
+
+    void encode_ise(BitWriter128& writer, const u8* values, int count, int level)
+    {
+        const QuantTables& tables = getQuantTables();
+        const QuantLevel& q = g_quant_level[level];
+        const int mask = (1 << q.bits) - 1;
+
+        if (q.trits)
+        {
+            for (int i = 0; i < count; i += 5)
+            {
+                int m[5] = { 0, 0, 0, 0, 0 };
+                int t[5] = { 0, 0, 0, 0, 0 };
+
+                for (int j = 0; j < 5 && i + j < count; ++j)
+                {
+                    m[j] = values[i + j] & mask;
+                    t[j] = values[i + j] >> q.bits;
+                }
+
+                const int T = tables.trit_encode[t[0] + t[1] * 3 + t[2] * 9 + t[3] * 27 + t[4] * 81];
+
+                writer.write(m[0], q.bits);
+                writer.write(T >> 0, 2);
+                writer.write(m[1], q.bits);
+                writer.write(T >> 2, 2);
+                writer.write(m[2], q.bits);
+                writer.write(T >> 4, 1);
+                writer.write(m[3], q.bits);
+                writer.write(T >> 5, 2);
+                writer.write(m[4], q.bits);
+                writer.write(T >> 7, 1);
+            }
+        }
+        else if (q.quints)
+        {
+            for (int i = 0; i < count; i += 3)
+            {
+                int m[3] = { 0, 0, 0 };
+                int t[3] = { 0, 0, 0 };
+
+                for (int j = 0; j < 3 && i + j < count; ++j)
+                {
+                    m[j] = values[i + j] & mask;
+                    t[j] = values[i + j] >> q.bits;
+                }
+
+                const int Q = tables.quint_encode[t[0] + t[1] * 5 + t[2] * 25];
+
+                writer.write(m[0], q.bits);
+                writer.write(Q >> 0, 3);
+                writer.write(m[1], q.bits);
+                writer.write(Q >> 3, 2);
+                writer.write(m[2], q.bits);
+                writer.write(Q >> 5, 2);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                writer.write(values[i], q.bits);
+            }
+        }
+
+        writer.truncate(ise_bits(level, count));
+    }
+
+    // ----------------------------------------------------------------------------
+    // block configuration
+    // ----------------------------------------------------------------------------
+
+    // The encoder uses a single partition and a single weight plane; the color endpoint mode
+    // is 8 (RGB direct) for opaque blocks and 12 (RGBA direct) for blocks with alpha.
+    // Every block size has a short list of weight grid and quantization configurations
+    // ranked by an error estimate; the quality presets try more of them.
+
+    constexpr int MAX_TEXELS = 144;
+    constexpr int MAX_WEIGHTS = 64;
+    constexpr int MAX_CONFIGS = 8;
+
+    // block mode for a single plane weight grid; -1 when the grid cannot be encoded
+    int encode_block_mode(int width, int height, int level)
+    {
+        const int h = level >= 6;
+        const int r = level % 6 + 2;
+        const int r0 = r & 1;
+        const int r1 = (r >> 1) & 1;
+        const int r2 = (r >> 2) & 1;
+
+        const int a = (r1 << 0) | (r2 << 1) | (r0 << 4) | (h << 9);
+
+        if (width >= 4 && width <= 7 && height >= 2 && height <= 5)
+            return a | (0 << 2) | ((width - 4) << 7) | ((height - 2) << 5);
+        if (width >= 8 && width <= 11 && height >= 2 && height <= 5)
+            return a | (1 << 2) | ((width - 8) << 7) | ((height - 2) << 5);
+        if (height >= 8 && height <= 11 && width >= 2 && width <= 5)
+            return a | (2 << 2) | ((height - 8) << 7) | ((width - 2) << 5);
+        if (height >= 6 && height <= 7 && width >= 2 && width <= 5)
+            return a | (3 << 2) | ((height - 6) << 7) | ((width - 2) << 5);
+        if (width >= 2 && width <= 3 && height >= 2 && height <= 5)
+            return a | (3 << 2) | (1 << 8) | ((width - 2) << 7) | ((height - 2) << 5);
+
+        const int b = (r1 << 2) | (r2 << 3) | (r0 << 4) | (h << 9);
+
+        if (width == 12 && height >= 2 && height <= 5)
+            return b | (0 << 7) | ((height - 2) << 5);
+        if (height == 12 && width >= 2 && width <= 5)
+            return b | (1 << 7) | ((width - 2) << 5);
+        if (width == 6 && height == 10)
+            return b | (3 << 7);
+        if (width == 10 && height == 6)
+            return b | (3 << 7) | (1 << 5);
+
+        // this layout has no room for the high precision bit
+        if (!h && width >= 6 && width <= 9 && height >= 6 && height <= 9)
+            return b | (2 << 7) | ((width - 6) << 5) | ((height - 6) << 9);
+
+        return -1;
+    }
+
+    struct Config
+    {
+        int mode;
+        int width;
+        int height;
+        int weightLevel;
+        int weightBits;
+        int endpointLevel[2]; // RGB, RGBA
+        float score;
+
+        // weight grid infill: four grid points and weights (sum 16) for every texel
+        u8 index[MAX_TEXELS][4];
+        u8 weight[MAX_TEXELS][4];
+        float inverse[MAX_WEIGHTS]; // 1 / sum of the infill weights of each grid point
+    };
+
+    struct ConfigList
+    {
+        int width;
+        int height;
+        std::vector<Config> configs;
+
+        ConfigList(int width, int height)
+            : width(width)
+            , height(height)
+        {
+            const int texels = width * height;
+
+            for (int gh = 2; gh <= height; ++gh)
+            {
+                for (int gw = 2; gw <= width; ++gw)
+                {
+                    const int count = gw * gh;
+                    if (count > MAX_WEIGHTS)
+                        continue;
+
+                    for (int level = 0; level < NUM_WEIGHT_LEVELS; ++level)
+                    {
+                        const int bits = ise_bits(level, count);
+                        if (bits < 24 || bits > 96)
+                            continue;
+
+                        const int mode = encode_block_mode(gw, gh, level);
+                        if (mode < 0)
+                            continue;
+
+                        // 17 bits of configuration; the RGBA endpoints require 21 bits at least
+                        const int available = 128 - 17 - bits;
+                        if (available < 21)
+                            continue;
+
+                        Config config;
+
+                        config.mode = mode;
+                        config.width = gw;
+                        config.height = gh;
+                        config.weightLevel = level;
+                        config.weightBits = bits;
+                        config.endpointLevel[0] = endpoint_level(available, 6);
+                        config.endpointLevel[1] = endpoint_level(available, 8);
+
+                        // Estimated error for a typical block: weight and endpoint quantization
+                        // noise and the error from the weight grid decimation.
+                        const float wstep = 1.0f / float(g_quant_level[level].levels - 1);
+                        const float estep = 255.0f / float(g_quant_level[config.endpointLevel[0]].levels - 1);
+                        const float decimation = 1.0f - float(count) / float(texels);
+                        config.score = 600.0f * wstep * wstep + estep * estep * 0.01f + 200.0f * decimation;
+
+                        configs.push_back(config);
+                    }
+                }
+            }
+
+            std::sort(configs.begin(), configs.end(), [] (const Config& a, const Config& b)
+            {
+                return a.score < b.score;
+            });
+
+            if (configs.size() > MAX_CONFIGS)
+            {
+                configs.resize(MAX_CONFIGS);
+            }
+
+            for (Config& config : configs)
+            {
+                computeInfill(config);
+            }
+        }
+
+        // the weight grid is bilinearly interpolated to the texels exactly as in the decoder
+        void computeInfill(Config& config) const
+        {
+            const int scalex = (1024 + width / 2) / (width - 1);
+            const int scaley = (1024 + height / 2) / (height - 1);
+
+            float sum[MAX_WEIGHTS] = { 0 };
+
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    const int gx = (scalex * x * (config.width - 1) + 32) >> 6;
+                    const int gy = (scaley * y * (config.height - 1) + 32) >> 6;
+                    const int jx = gx >> 4;
+                    const int jy = gy >> 4;
+                    const int fx = gx & 0xf;
+                    const int fy = gy & 0xf;
+                    const int w11 = (fx * fy + 8) >> 4;
+                    const int w10 = fy - w11;
+                    const int w01 = fx - w11;
+                    const int w00 = 16 - fx - fy + w11;
+                    const int v0 = jy * config.width + jx;
+
+                    const int i = y * width + x;
+
+                    // the weights outside of the grid are always zero; they are clamped to a valid index
+                    const int last = config.width * config.height - 1;
+
+                    config.index[i][0] = u8(v0);
+                    config.index[i][1] = u8(std::min(v0 + 1, last));
+                    config.index[i][2] = u8(std::min(v0 + config.width, last));
+                    config.index[i][3] = u8(std::min(v0 + config.width + 1, last));
+                    config.weight[i][0] = u8(w00);
+                    config.weight[i][1] = u8(w01);
+                    config.weight[i][2] = u8(w10);
+                    config.weight[i][3] = u8(w11);
+
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        sum[config.index[i][k]] += config.weight[i][k];
+                    }
+                }
+            }
+
+            for (int j = 0; j < config.width * config.height; ++j)
+            {
+                config.inverse[j] = sum[j] > 0.0f ? 1.0f / sum[j] : 0.0f;
+            }
+        }
+    };
+
+    const ConfigList& getConfigList(int width, int height)
+    {
+        static const ConfigList lists[] =
+        {
+            ConfigList(4, 4),
+            ConfigList(5, 4),
+            ConfigList(5, 5),
+            ConfigList(6, 5),
+            ConfigList(6, 6),
+            ConfigList(8, 5),
+            ConfigList(8, 6),
+            ConfigList(8, 8),
+            ConfigList(10, 5),
+            ConfigList(10, 6),
+            ConfigList(10, 8),
+            ConfigList(10, 10),
+            ConfigList(12, 10),
+            ConfigList(12, 12),
+        };
+
+        for (const ConfigList& list : lists)
+        {
+            if (list.width == width && list.height == height)
+                return list;
+        }
+
+        return lists[0];
+    }
+
+    // ----------------------------------------------------------------------------
+    // BlockBatch
+    // ----------------------------------------------------------------------------
+
+    // Eight blocks are encoded at a time, one block in each SIMD lane; see block_bc.cpp.
+    // The configuration search is vectorized and the quantization uses table lookups per lane.
+
+    constexpr int BATCH = 8;
+
+    struct LaneStorage
+    {
+        alignas(32) float data[BATCH];
+
+        LaneStorage(float32x8 v)
+        {
+            simd::f32x8_ustore(data, v);
+        }
+
+        int operator [] (int lane) const
+        {
+            return int(data[lane]);
+        }
+    };
+
+    struct BlockBatch
+    {
+        int width;
+        int height;
+        int texels;
+        float32x8 channel[4][MAX_TEXELS];
+
+        BlockBatch(const u8* input, int stride, int count, int width, int height)
+            : width(width)
+            , height(height)
+            , texels(width * height)
+        {
+            alignas(32) float temp[4][MAX_TEXELS][BATCH];
+
+            for (int lane = 0; lane < BATCH; ++lane)
+            {
+                // the unused lanes replicate the last block
+                const u8* block = input + std::min(lane, count - 1) * width * 4;
+
+                for (int y = 0; y < height; ++y)
+                {
+                    const u8* scan = block + y * stride;
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        const int i = y * width + x;
+                        temp[0][i][lane] = scan[x * 4 + 0];
+                        temp[1][i][lane] = scan[x * 4 + 1];
+                        temp[2][i][lane] = scan[x * 4 + 2];
+                        temp[3][i][lane] = scan[x * 4 + 3];
+                    }
+                }
+            }
+
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int i = 0; i < texels; ++i)
+                {
+                    channel[c][i] = simd::f32x8_uload(temp[c][i]);
+                }
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // encoder
+    // ----------------------------------------------------------------------------
+
+    struct BlockResult
+    {
+        float error;
+        const Config* config;
+        int cem;
+        u8 endpoint[8];
+        u8 weight[MAX_WEIGHTS];
+    };
+
+    struct Endpoints
+    {
+        float32x8 e0[4];
+        float32x8 e1[4];
+    };
+
+    // principal axis of the block colors; the endpoints are the extents along the axis
+    void fit_principal_axis(Endpoints& endpoints, const BlockBatch& batch)
+    {
+        const int texels = batch.texels;
+        const float scale = 1.0f / float(texels);
+
+        float32x8 mean[4];
+
+        for (int c = 0; c < 4; ++c)
+        {
+            float32x8 sum(0.0f);
+            for (int i = 0; i < texels; ++i)
+            {
+                sum += batch.channel[c][i];
+            }
+            mean[c] = sum * scale;
+        }
+
+        float32x8 cov[4][4];
+
+        for (int c0 = 0; c0 < 4; ++c0)
+        {
+            for (int c1 = c0; c1 < 4; ++c1)
+            {
+                float32x8 sum(0.0f);
+                for (int i = 0; i < texels; ++i)
+                {
+                    sum = madd(sum, batch.channel[c0][i] - mean[c0], batch.channel[c1][i] - mean[c1]);
+                }
+                cov[c0][c1] = sum;
+                cov[c1][c0] = sum;
+            }
+        }
+
+        float32x8 axis[4] = { float32x8(1.0f), float32x8(1.0f), float32x8(1.0f), float32x8(1.0f) };
+
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float32x8 v[4];
+            for (int c = 0; c < 4; ++c)
+            {
+                v[c] = cov[c][0] * axis[0] + cov[c][1] * axis[1] + cov[c][2] * axis[2] + cov[c][3] * axis[3];
+            }
+
+            const float32x8 length = max(max(abs(v[0]), abs(v[1])), max(abs(v[2]), abs(v[3])));
+            const mask32x8 valid = length > 1e-8f;
+            const float32x8 s = select(valid, float32x8(1.0f) / length, float32x8(0.0f));
+
+            for (int c = 0; c < 4; ++c)
+            {
+                axis[c] = v[c] * s;
+            }
+        }
+
+        const float32x8 length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+        const float32x8 s = select(length2 > 1e-8f, float32x8(1.0f) / length2, float32x8(0.0f));
+
+        float32x8 lo(std::numeric_limits<float>::max());
+        float32x8 hi(-std::numeric_limits<float>::max());
+
+        for (int i = 0; i < texels; ++i)
+        {
+            float32x8 t(0.0f);
+            for (int c = 0; c < 4; ++c)
+            {
+                t = madd(t, batch.channel[c][i] - mean[c], axis[c]);
+            }
+            lo = min(lo, t);
+            hi = max(hi, t);
+        }
+
+        for (int c = 0; c < 4; ++c)
+        {
+            const float32x8 zero(0.0f);
+            const float32x8 one(255.0f);
+            const float32x8 a = axis[c] * s * length2;
+            endpoints.e0[c] = clamp(madd(mean[c], a, lo), zero, one);
+            endpoints.e1[c] = clamp(madd(mean[c], a, hi), zero, one);
+        }
+    }
+
+    // Quantize the endpoints, fit the weights and compute the error; the lanes which improve
+    // are stored in the results. The texel weights are returned for the endpoint refinement.
+    void fit_config(BlockResult* result, float32x8* texelWeight, const Endpoints& endpoints,
+                    const BlockBatch& batch, const Config& config, const int* cem)
+    {
+        const QuantTables& tables = getQuantTables();
+        const int texels = batch.texels;
+        const int weights = config.width * config.height;
+
+        // quantize the endpoints
+
+        alignas(32) float e[2][4][BATCH];
+
+        for (int c = 0; c < 4; ++c)
+        {
+            simd::f32x8_ustore(e[0][c], endpoints.e0[c]);
+            simd::f32x8_ustore(e[1][c], endpoints.e1[c]);
+        }
+
+        u8 code[BATCH][8];
+
+        for (int lane = 0; lane < BATCH; ++lane)
+        {
+            const int level = config.endpointLevel[cem[lane]];
+            const u8* quant = tables.endpoint_quant[level];
+            const u8* value = tables.endpoint_value[level];
+
+            int q[2][4];
+
+            for (int i = 0; i < 2; ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    q[i][c] = quant[int(e[i][c][lane] + 0.5f)];
+                }
+            }
+
+            // the decoder applies blue contraction when the second endpoint is darker
+            const int sum0 = value[q[0][0]] + value[q[0][1]] + value[q[0][2]];
+            const int sum1 = value[q[1][0]] + value[q[1][1]] + value[q[1][2]];
+            const int first = sum1 < sum0 ? 1 : 0;
+
+            for (int c = 0; c < 4; ++c)
+            {
+                const int c0 = q[first][c];
+                const int c1 = q[first ^ 1][c];
+                code[lane][c * 2 + 0] = u8(c0);
+                code[lane][c * 2 + 1] = u8(c1);
+                e[0][c][lane] = value[c0];
+                e[1][c][lane] = value[c1];
+            }
+
+            if (!cem[lane])
+            {
+                e[0][3][lane] = 255.0f;
+                e[1][3][lane] = 255.0f;
+            }
+        }
+
+        float32x8 q0[4];
+        float32x8 q1[4];
+        float32x8 axis[4];
+
+        for (int c = 0; c < 4; ++c)
+        {
+            q0[c] = simd::f32x8_uload(e[0][c]);
+            q1[c] = simd::f32x8_uload(e[1][c]);
+            axis[c] = q1[c] - q0[c];
+        }
+
+        // ideal texel weights in the [0, 64] range
+
+        const float32x8 length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+        const float32x8 scale = select(length2 > 0.0f, float32x8(64.0f) / length2, float32x8(0.0f));
+
+        float32x8 ideal[MAX_TEXELS];
+
+        for (int i = 0; i < texels; ++i)
+        {
+            float32x8 t(0.0f);
+            for (int c = 0; c < 4; ++c)
+            {
+                t = madd(t, batch.channel[c][i] - q0[c], axis[c]);
+            }
+            ideal[i] = clamp(t * scale, float32x8(0.0f), float32x8(64.0f));
+        }
+
+        // decimate to the weight grid
+
+        float32x8 grid[MAX_WEIGHTS];
+
+        for (int j = 0; j < weights; ++j)
+        {
+            grid[j] = float32x8(0.0f);
+        }
+
+        for (int i = 0; i < texels; ++i)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                const int j = config.index[i][k];
+                grid[j] = madd(grid[j], ideal[i], float32x8(float(config.weight[i][k])));
+            }
+        }
+
+        // quantize the grid weights
+
+        alignas(32) float w[MAX_WEIGHTS][BATCH];
+
+        for (int j = 0; j < weights; ++j)
+        {
+            simd::f32x8_ustore(w[j], grid[j] * config.inverse[j]);
+        }
+
+        u8 weight[BATCH][MAX_WEIGHTS];
+
+        const u8* quant = tables.weight_quant[config.weightLevel];
+        const u8* value = tables.weight_value[config.weightLevel];
+
+        for (int j = 0; j < weights; ++j)
+        {
+            for (int lane = 0; lane < BATCH; ++lane)
+            {
+                const int q = quant[int(w[j][lane] + 0.5f)];
+                weight[lane][j] = u8(q);
+                w[j][lane] = value[q];
+            }
+
+            grid[j] = simd::f32x8_uload(w[j]);
+        }
+
+        // interpolate the texel weights and compute the error
+
+        float32x8 error(0.0f);
+
+        for (int i = 0; i < texels; ++i)
+        {
+            float32x8 t(8.0f);
+            for (int k = 0; k < 4; ++k)
+            {
+                t = madd(t, grid[config.index[i][k]], float32x8(float(config.weight[i][k])));
+            }
+
+            t = floor(t * (1.0f / 16.0f));
+            texelWeight[i] = t;
+
+            const float32x8 alpha = t * (1.0f / 64.0f);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                const float32x8 d = batch.channel[c][i] - madd(q0[c], axis[c], alpha);
+                error = madd(error, d, d);
+            }
+        }
+
+        alignas(32) float errors[BATCH];
+        simd::f32x8_ustore(errors, error);
+
+        for (int lane = 0; lane < BATCH; ++lane)
+        {
+            if (errors[lane] < result[lane].error)
+            {
+                result[lane].error = errors[lane];
+                result[lane].config = &config;
+                result[lane].cem = cem[lane];
+                std::copy(code[lane], code[lane] + 8, result[lane].endpoint);
+                std::copy(weight[lane], weight[lane] + weights, result[lane].weight);
+            }
+        }
+    }
+
+    // least squares fit of the endpoints to the texel weights
+    void refine_endpoints(Endpoints& endpoints, const float32x8* texelWeight, const BlockBatch& batch)
+    {
+        float32x8 aa(0.0f);
+        float32x8 bb(0.0f);
+        float32x8 ab(0.0f);
+        float32x8 ax[4] = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+        float32x8 bx[4] = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+
+        for (int i = 0; i < batch.texels; ++i)
+        {
+            const float32x8 alpha = texelWeight[i] * (1.0f / 64.0f);
+            const float32x8 beta = float32x8(1.0f) - alpha;
+
+            aa = madd(aa, alpha, alpha);
+            bb = madd(bb, beta, beta);
+            ab = madd(ab, alpha, beta);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                ax[c] = madd(ax[c], alpha, batch.channel[c][i]);
+                bx[c] = madd(bx[c], beta, batch.channel[c][i]);
+            }
+        }
+
+        const float32x8 det = aa * bb - ab * ab;
+        const mask32x8 valid = abs(det) > 1e-4f;
+        const float32x8 s = select(valid, float32x8(1.0f) / det, float32x8(0.0f));
+
+        const float32x8 zero(0.0f);
+        const float32x8 one(255.0f);
+
+        for (int c = 0; c < 4; ++c)
+        {
+            endpoints.e1[c] = select(valid, clamp((bb * ax[c] - ab * bx[c]) * s, zero, one), endpoints.e1[c]);
+            endpoints.e0[c] = select(valid, clamp((aa * bx[c] - ab * ax[c]) * s, zero, one), endpoints.e0[c]);
+        }
+    }
+
+    void write_block(u8* output, const BlockResult& result)
+    {
+        const Config& config = *result.config;
+        const int cem = result.cem ? 12 : 8;
+        const int count = result.cem ? 8 : 6;
+
+        BitWriter128 endpoints;
+        encode_ise(endpoints, result.endpoint, count, config.endpointLevel[result.cem]);
+
+        BitWriter128 weights;
+        encode_ise(weights, result.weight, config.width * config.height, config.weightLevel);
+
+        // the weights are stored in reverse bit order from the top of the block
+        u64 lo = u64(config.mode) | (u64(cem) << 13);
+        u64 hi = 0;
+
+        lo |= endpoints.data[0] << 17;
+        hi |= (endpoints.data[1] << 17) | (endpoints.data[0] >> 47);
+        lo |= u64_reverse_bits(weights.data[1]);
+        hi |= u64_reverse_bits(weights.data[0]);
+
+        ustore64le(output + 0, lo);
+        ustore64le(output + 8, hi);
+    }
+
+    // constant color block
+    void write_void_extent(u8* output, const u16* color)
+    {
+        // block mode 0x1fc, LDR, all extent coordinates set to one
+        const u64 lo = 0xfffffffffffffdfcull;
+        const u64 hi = u64(color[0]) | (u64(color[1]) << 16) | (u64(color[2]) << 32) | (u64(color[3]) << 48);
+
+        ustore64le(output + 0, lo);
+        ustore64le(output + 8, hi);
+    }
+
+    void encode_astc(u8* output, const BlockBatch& batch, int count, TextureCompressionQuality quality)
+    {
+        const ConfigList& list = getConfigList(batch.width, batch.height);
+
+        const int candidates = std::min(int(list.configs.size()),
+            quality == TextureCompressionQuality::FAST ? 1 :
+            quality == TextureCompressionQuality::NORMAL ? 3 : MAX_CONFIGS);
+        const int refinements = quality == TextureCompressionQuality::FAST ? 1 :
+                                quality == TextureCompressionQuality::NORMAL ? 1 : 2;
+
+        // block extents; the blocks with alpha use the RGBA endpoints
+        float32x8 lo[4];
+        float32x8 hi[4];
+
+        for (int c = 0; c < 4; ++c)
+        {
+            lo[c] = batch.channel[c][0];
+            hi[c] = batch.channel[c][0];
+
+            for (int i = 1; i < batch.texels; ++i)
+            {
+                lo[c] = min(lo[c], batch.channel[c][i]);
+                hi[c] = max(hi[c], batch.channel[c][i]);
+            }
+        }
+
+        const LaneStorage translucent(select(lo[3] < 255.0f, float32x8(1.0f), float32x8(0.0f)));
+        const mask32x8 constant = (lo[0] == hi[0]) & (lo[1] == hi[1]) & (lo[2] == hi[2]) & (lo[3] == hi[3]);
+        const LaneStorage solid(select(constant, float32x8(1.0f), float32x8(0.0f)));
+
+        int cem[BATCH];
+        BlockResult result[BATCH];
+
+        for (int lane = 0; lane < BATCH; ++lane)
+        {
+            cem[lane] = translucent[lane];
+            result[lane].error = std::numeric_limits<float>::max();
+            result[lane].config = nullptr;
+        }
+
+        Endpoints initial;
+        fit_principal_axis(initial, batch);
+
+        float32x8 texelWeight[MAX_TEXELS];
+
+        for (int i = 0; i < candidates; ++i)
+        {
+            const Config& config = list.configs[i];
+
+            Endpoints endpoints = initial;
+            fit_config(result, texelWeight, endpoints, batch, config, cem);
+
+            for (int iteration = 0; iteration < refinements; ++iteration)
+            {
+                refine_endpoints(endpoints, texelWeight, batch);
+                fit_config(result, texelWeight, endpoints, batch, config, cem);
+            }
+        }
+
+        const LaneStorage r(lo[0]);
+        const LaneStorage g(lo[1]);
+        const LaneStorage b(lo[2]);
+        const LaneStorage a(lo[3]);
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            if (solid[lane])
+            {
+                const u16 color[] = { u16(r[lane] * 257), u16(g[lane] * 257), u16(b[lane] * 257), u16(a[lane] * 257) };
+                write_void_extent(output, color);
+            }
+            else
+            {
+                write_block(output, result[lane]);
+            }
+
+            output += 16;
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // batch encoders
+    // ----------------------------------------------------------------------------
+
+    // The input is a row of blocks in R8G8B8A8 format; count blocks are encoded.
+
+    void encode_blocks_astc(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count, info.width, info.height);
+            encode_astc(output, batch, std::min(count, BATCH), quality);
+            input += BATCH * info.width * 4;
+            output += BATCH * 16;
+        }
+    }
+
+} // namespace mango
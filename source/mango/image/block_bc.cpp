@@ -0,0 +1,2105 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <mango/core/endian.hpp>
+#include <mango/core/bits.hpp>
+#include <mango/core/half.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/compression.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // BlockBatch
+    // ----------------------------------------------------------------------------
+
+    // Eight 4x4 blocks are encoded at a time; each SIMD lane processes one block so the
+    // endpoint selection and index fitting run in parallel without any horizontal operations.
+    // The pixels are stored as structure-of-arrays: channel[c][i] holds pixel i from every block.
+
+    constexpr int BATCH = 8;
+
+    struct BlockBatch
+    {
+        float32x8 channel[4][16];
+
+        BlockBatch(const u8* input, int stride, int count)
+        {
+            alignas(32) float temp[4][16][BATCH];
+
+            for (int lane = 0; lane < BATCH; ++lane)
+            {
+                // the unused lanes replicate the last block
+                const u8* block = input + std::min(lane, count - 1) * 16;
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    const u8* scan = block + y * stride;
+
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const int i = y * 4 + x;
+                        temp[0][i][lane] = scan[x * 4 + 0];
+                        temp[1][i][lane] = scan[x * 4 + 1];
+                        temp[2][i][lane] = scan[x * 4 + 2];
+                        temp[3][i][lane] = scan[x * 4 + 3];
+                    }
+                }
+            }
+
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    channel[c][i] = simd::f32x8_uload(temp[c][i]);
+                }
+            }
+        }
+    };
+
+    struct LaneStorage
+    {
+        alignas(32) float data[BATCH];
+
+        LaneStorage(float32x8 v)
+        {
+            simd::f32x8_ustore(data, v);
+        }
+
+        int operator [] (int lane) const
+        {
+            return int(data[lane]);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // color block
+    // ----------------------------------------------------------------------------
+
+    // The palette index is stored as a weight k: color = c1 + (c0 - c1) * k / 3.
+    // The weights are mapped to the BC1 index order only when the block is written.
+
+    struct Color
+    {
+        float32x8 r;
+        float32x8 g;
+        float32x8 b;
+    };
+
+    struct ColorEncoding
+    {
+        Color c0;
+        Color c1;
+        float32x8 code0;
+        float32x8 code1;
+        float32x8 weight[16];
+        float32x8 error;
+    };
+
+    float32x8 dot(const Color& a, const Color& b)
+    {
+        return a.r * b.r + a.g * b.g + a.b * b.b;
+    }
+
+    Color sub(const Color& a, const Color& b)
+    {
+        return { a.r - b.r, a.g - b.g, a.b - b.b };
+    }
+
+    // quantize to 5:6:5 and expand back to 8 bits with the same bit replication as the decoder
+    void quantize565(Color& color, float32x8& code)
+    {
+        const float32x8 zero(0.0f);
+        const float32x8 one(255.0f);
+
+        const float32x8 r = round(clamp(color.r, zero, one) * (31.0f / 255.0f));
+        const float32x8 g = round(clamp(color.g, zero, one) * (63.0f / 255.0f));
+        const float32x8 b = round(clamp(color.b, zero, one) * (31.0f / 255.0f));
+
+        code = r * 2048.0f + g * 32.0f + b;
+
+        color.r = round(r * (255.0f / 31.0f));
+        color.g = round(g * (255.0f / 63.0f));
+        color.b = round(b * (255.0f / 31.0f));
+    }
+
+    // select the weights by projecting the pixels on the line between the endpoints
+    void project_weights(ColorEncoding& encoding, const BlockBatch& batch)
+    {
+        const Color axis = sub(encoding.c0, encoding.c1);
+        const float32x8 length = dot(axis, axis);
+        const float32x8 scale = select(length > 0.0f, float32x8(3.0f) / length, float32x8(0.0f));
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const Color p = { batch.channel[0][i], batch.channel[1][i], batch.channel[2][i] };
+            const float32x8 t = dot(sub(p, encoding.c1), axis) * scale;
+            encoding.weight[i] = clamp(round(t), float32x8(0.0f), float32x8(3.0f));
+        }
+
+        encoding.error = float32x8(0.0f);
+    }
+
+    // select the weights by searching the nearest palette color and accumulate the error
+    void search_weights(ColorEncoding& encoding, const BlockBatch& batch)
+    {
+        Color palette[4];
+
+        palette[0] = encoding.c1;
+        palette[3] = encoding.c0;
+        palette[1].r = (encoding.c1.r * 2.0f + encoding.c0.r) * (1.0f / 3.0f);
+        palette[1].g = (encoding.c1.g * 2.0f + encoding.c0.g) * (1.0f / 3.0f);
+        palette[1].b = (encoding.c1.b * 2.0f + encoding.c0.b) * (1.0f / 3.0f);
+        palette[2].r = (encoding.c0.r * 2.0f + encoding.c1.r) * (1.0f / 3.0f);
+        palette[2].g = (encoding.c0.g * 2.0f + encoding.c1.g) * (1.0f / 3.0f);
+        palette[2].b = (encoding.c0.b * 2.0f + encoding.c1.b) * (1.0f / 3.0f);
+
+        float32x8 error(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const Color p = { batch.channel[0][i], batch.channel[1][i], batch.channel[2][i] };
+
+            Color d = sub(p, palette[0]);
+            float32x8 best = dot(d, d);
+            float32x8 weight(0.0f);
+
+            for (int k = 1; k < 4; ++k)
+            {
+                d = sub(p, palette[k]);
+                const float32x8 e = dot(d, d);
+                const mask32x8 mask = e < best;
+                best = select(mask, e, best);
+                weight = select(mask, float32x8(float(k)), weight);
+            }
+
+            encoding.weight[i] = weight;
+            error += best;
+        }
+
+        encoding.error = error;
+    }
+
+    // least squares fit of the endpoints to the current weights
+    void refine_endpoints(ColorEncoding& encoding, const BlockBatch& batch)
+    {
+        float32x8 aa(0.0f);
+        float32x8 bb(0.0f);
+        float32x8 ab(0.0f);
+        Color ax = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+        Color bx = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float32x8 alpha = encoding.weight[i] * (1.0f / 3.0f);
+            const float32x8 beta = float32x8(1.0f) - alpha;
+
+            aa = madd(aa, alpha, alpha);
+            bb = madd(bb, beta, beta);
+            ab = madd(ab, alpha, beta);
+
+            ax.r = madd(ax.r, alpha, batch.channel[0][i]);
+            ax.g = madd(ax.g, alpha, batch.channel[1][i]);
+            ax.b = madd(ax.b, alpha, batch.channel[2][i]);
+            bx.r = madd(bx.r, beta, batch.channel[0][i]);
+            bx.g = madd(bx.g, beta, batch.channel[1][i]);
+            bx.b = madd(bx.b, beta, batch.channel[2][i]);
+        }
+
+        const float32x8 det = aa * bb - ab * ab;
+        const mask32x8 valid = abs(det) > 1e-4f;
+        const float32x8 s = select(valid, float32x8(1.0f) / det, float32x8(0.0f));
+
+        encoding.c0.r = select(valid, (bb * ax.r - ab * bx.r) * s, encoding.c0.r);
+        encoding.c0.g = select(valid, (bb * ax.g - ab * bx.g) * s, encoding.c0.g);
+        encoding.c0.b = select(valid, (bb * ax.b - ab * bx.b) * s, encoding.c0.b);
+        encoding.c1.r = select(valid, (aa * bx.r - ab * ax.r) * s, encoding.c1.r);
+        encoding.c1.g = select(valid, (aa * bx.g - ab * ax.g) * s, encoding.c1.g);
+        encoding.c1.b = select(valid, (aa * bx.b - ab * ax.b) * s, encoding.c1.b);
+    }
+
+    void encode_color(u8* output, int pitch, const BlockBatch& batch, int count, TextureCompressionQuality quality)
+    {
+        const float32x8* r = batch.channel[0];
+        const float32x8* g = batch.channel[1];
+        const float32x8* b = batch.channel[2];
+
+        // mean
+
+        Color mean = { r[0], g[0], b[0] };
+
+        for (int i = 1; i < 16; ++i)
+        {
+            mean.r += r[i];
+            mean.g += g[i];
+            mean.b += b[i];
+        }
+
+        mean.r *= (1.0f / 16.0f);
+        mean.g *= (1.0f / 16.0f);
+        mean.b *= (1.0f / 16.0f);
+
+        // covariance
+
+        float32x8 crr(0.0f);
+        float32x8 cgg(0.0f);
+        float32x8 cbb(0.0f);
+        float32x8 crg(0.0f);
+        float32x8 crb(0.0f);
+        float32x8 cgb(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float32x8 dr = r[i] - mean.r;
+            const float32x8 dg = g[i] - mean.g;
+            const float32x8 db = b[i] - mean.b;
+
+            crr = madd(crr, dr, dr);
+            cgg = madd(cgg, dg, dg);
+            cbb = madd(cbb, db, db);
+            crg = madd(crg, dr, dg);
+            crb = madd(crb, dr, db);
+            cgb = madd(cgb, dg, db);
+        }
+
+        // principal axis with power iteration; start from the covariance row with largest variance
+
+        const mask32x8 rmax = (crr >= cgg) & (crr >= cbb);
+        const mask32x8 gmax = cgg >= cbb;
+
+        Color axis;
+        axis.r = select(rmax, crr, select(gmax, crg, crb));
+        axis.g = select(rmax, crg, select(gmax, cgg, cgb));
+        axis.b = select(rmax, crb, select(gmax, cgb, cbb));
+
+        const int iterations = quality == TextureCompressionQuality::FAST ? 1 :
+                               quality == TextureCompressionQuality::NORMAL ? 4 : 8;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            const float32x8 x = axis.r * crr + axis.g * crg + axis.b * crb;
+            const float32x8 y = axis.r * crg + axis.g * cgg + axis.b * cgb;
+            const float32x8 z = axis.r * crb + axis.g * cgb + axis.b * cbb;
+
+            // keep the vector in range; the length is normalized after the iteration
+            const float32x8 m = max(max(abs(x), abs(y)), max(abs(z), float32x8(1e-10f)));
+            const float32x8 s = float32x8(1.0f) / m;
+
+            axis.r = x * s;
+            axis.g = y * s;
+            axis.b = z * s;
+        }
+
+        const float32x8 length = dot(axis, axis);
+        const float32x8 s = select(length > 0.0f, rsqrt(length), float32x8(0.0f));
+
+        axis.r *= s;
+        axis.g *= s;
+        axis.b *= s;
+
+        // endpoints from the extent of the pixels along the axis
+
+        float32x8 tmin(0.0f);
+        float32x8 tmax(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const Color p = { r[i], g[i], b[i] };
+            const float32x8 t = dot(sub(p, mean), axis);
+            tmin = min(tmin, t);
+            tmax = max(tmax, t);
+        }
+
+        // inset the endpoints; the extreme pixels are rarely worth the precision in the middle
+        const float32x8 inset = (tmax - tmin) * (1.0f / 16.0f);
+        tmin += inset;
+        tmax -= inset;
+
+        ColorEncoding encoding;
+
+        encoding.c0.r = madd(mean.r, axis.r, tmax);
+        encoding.c0.g = madd(mean.g, axis.g, tmax);
+        encoding.c0.b = madd(mean.b, axis.b, tmax);
+        encoding.c1.r = madd(mean.r, axis.r, tmin);
+        encoding.c1.g = madd(mean.g, axis.g, tmin);
+        encoding.c1.b = madd(mean.b, axis.b, tmin);
+
+        quantize565(encoding.c0, encoding.code0);
+        quantize565(encoding.c1, encoding.code1);
+
+        if (quality == TextureCompressionQuality::FAST)
+        {
+            project_weights(encoding, batch);
+        }
+        else
+        {
+            search_weights(encoding, batch);
+        }
+
+        const int refinements = quality == TextureCompressionQuality::FAST ? 0 :
+                                quality == TextureCompressionQuality::NORMAL ? 1 : 3;
+
+        for (int iteration = 0; iteration < refinements; ++iteration)
+        {
+            ColorEncoding refined = encoding;
+
+            refine_endpoints(refined, batch);
+            quantize565(refined.c0, refined.code0);
+            quantize565(refined.c1, refined.code1);
+            search_weights(refined, batch);
+
+            const mask32x8 better = refined.error < encoding.error;
+
+            encoding.code0 = select(better, refined.code0, encoding.code0);
+            encoding.code1 = select(better, refined.code1, encoding.code1);
+            encoding.c0.r = select(better, refined.c0.r, encoding.c0.r);
+            encoding.c0.g = select(better, refined.c0.g, encoding.c0.g);
+            encoding.c0.b = select(better, refined.c0.b, encoding.c0.b);
+            encoding.c1.r = select(better, refined.c1.r, encoding.c1.r);
+            encoding.c1.g = select(better, refined.c1.g, encoding.c1.g);
+            encoding.c1.b = select(better, refined.c1.b, encoding.c1.b);
+            encoding.error = select(better, refined.error, encoding.error);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                encoding.weight[i] = select(better, refined.weight[i], encoding.weight[i]);
+            }
+        }
+
+        // write the blocks
+
+        const LaneStorage code0(encoding.code0);
+        const LaneStorage code1(encoding.code1);
+
+        alignas(32) float weights[16][BATCH];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            simd::f32x8_ustore(weights[i], encoding.weight[i]);
+        }
+
+        // weight to index in four color mode (color0 > color1)
+        static const u32 table[] = { 1, 3, 2, 0 };
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            u32 color0 = code0[lane];
+            u32 color1 = code1[lane];
+
+            // swapping the endpoints reverses the weights
+            const u32 reverse = color0 < color1 ? 3 : 0;
+
+            if (reverse)
+            {
+                std::swap(color0, color1);
+            }
+
+            u32 indices = 0;
+
+            if (color0 != color1)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    const u32 k = u32(weights[i][lane]) ^ reverse;
+                    indices |= table[k] << (i * 2);
+                }
+            }
+
+            ustore16le(output + 0, u16(color0));
+            ustore16le(output + 2, u16(color1));
+            ustore32le(output + 4, indices);
+            output += pitch;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // explicit alpha block
+    // ----------------------------------------------------------------------------
+
+    // BC2 alpha block: 4 bits for each pixel, stored in pixel order starting from the lowest bits.
+    // The decoder expands the value with a * 17 so the nearest value is (a + 8) / 17.
+
+    void encode_explicit_alpha(u8* output, int pitch, const u8* input, int stride, int count)
+    {
+        for (int lane = 0; lane < count; ++lane)
+        {
+            u64 data = 0;
+
+            for (int y = 0; y < 4; ++y)
+            {
+                const u8* scan = input + y * stride;
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    const u64 alpha = (scan[x * 4 + 3] + 8) / 17;
+                    data |= alpha << ((y * 4 + x) * 4);
+                }
+            }
+
+            ustore64le(output, data);
+            input += 16;
+            output += pitch;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // alpha block
+    // ----------------------------------------------------------------------------
+
+    // BC4 block (also the BC3 alpha and the BC5 red and green blocks). The eight value mode
+    // is used with the block extents as endpoints; the high quality mode also tries the six
+    // value mode which has exact 0 and 255 in the palette for blocks with saturated values.
+
+    float32x8 fit_alpha(float32x8* weight, const float32x8* value, float32x8 lo, float32x8 hi)
+    {
+        const float32x8 zero(0.0f);
+        const float32x8 range = hi - lo;
+        const float32x8 scale = select(range > 0.0f, float32x8(7.0f) / range, zero);
+        const float32x8 step = range * (1.0f / 7.0f);
+
+        float32x8 error(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float32x8 k = clamp(round((value[i] - lo) * scale), zero, float32x8(7.0f));
+            const float32x8 d = value[i] - madd(lo, k, step);
+            weight[i] = k;
+            error = madd(error, d, d);
+        }
+
+        return error;
+    }
+
+    // least squares fit of the endpoints to the current weights
+    void refine_alpha(float32x8& lo, float32x8& hi, const float32x8* weight, const float32x8* value)
+    {
+        float32x8 aa(0.0f);
+        float32x8 bb(0.0f);
+        float32x8 ab(0.0f);
+        float32x8 ax(0.0f);
+        float32x8 bx(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float32x8 alpha = weight[i] * (1.0f / 7.0f);
+            const float32x8 beta = float32x8(1.0f) - alpha;
+
+            aa = madd(aa, alpha, alpha);
+            bb = madd(bb, beta, beta);
+            ab = madd(ab, alpha, beta);
+            ax = madd(ax, alpha, value[i]);
+            bx = madd(bx, beta, value[i]);
+        }
+
+        const float32x8 det = aa * bb - ab * ab;
+        const mask32x8 valid = abs(det) > 1e-4f;
+        const float32x8 s = select(valid, float32x8(1.0f) / det, float32x8(0.0f));
+
+        const float32x8 zero(0.0f);
+        const float32x8 one(255.0f);
+
+        hi = select(valid, clamp(round((bb * ax - ab * bx) * s), zero, one), hi);
+        lo = select(valid, clamp(round((aa * bx - ab * ax) * s), zero, one), lo);
+    }
+
+    void encode_alpha(u8* output, int pitch, const float32x8* value, int count, TextureCompressionQuality quality)
+    {
+        const float32x8 zero(0.0f);
+        const float32x8 one(255.0f);
+
+        // eight value mode: value = a1 + (a0 - a1) * k / 7
+
+        float32x8 lo = value[0];
+        float32x8 hi = value[0];
+
+        for (int i = 1; i < 16; ++i)
+        {
+            lo = min(lo, value[i]);
+            hi = max(hi, value[i]);
+        }
+
+        float32x8 weight8[16];
+        float32x8 error8 = fit_alpha(weight8, value, lo, hi);
+
+        const int iterations = quality == TextureCompressionQuality::FAST ? 0 :
+                               quality == TextureCompressionQuality::NORMAL ? 1 : 3;
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            float32x8 lo2 = lo;
+            float32x8 hi2 = hi;
+            refine_alpha(lo2, hi2, weight8, value);
+
+            float32x8 weight[16];
+            const float32x8 error = fit_alpha(weight, value, lo2, hi2);
+
+            // the eight value mode requires a0 > a1
+            const mask32x8 better = (error < error8) & (hi2 > lo2);
+
+            lo = select(better, lo2, lo);
+            hi = select(better, hi2, hi);
+            error8 = select(better, error, error8);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                weight8[i] = select(better, weight[i], weight8[i]);
+            }
+        }
+
+        // six value mode: value = a0 + (a1 - a0) * k / 5, with k = 6 for 0 and k = 7 for 255
+
+        float32x8 lo6 = one;
+        float32x8 hi6 = zero;
+        float32x8 weight6[16];
+        float32x8 error6(0.0f);
+
+        const bool six = quality == TextureCompressionQuality::HIGH;
+
+        if (six)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                const mask32x8 inner = (value[i] > zero) & (value[i] < one);
+                lo6 = select(inner, min(lo6, value[i]), lo6);
+                hi6 = select(inner, max(hi6, value[i]), hi6);
+            }
+
+            // blocks with only 0 and 255 get an empty interpolated range
+            lo6 = min(lo6, hi6);
+
+            const float32x8 range6 = hi6 - lo6;
+            const float32x8 scale6 = select(range6 > 0.0f, float32x8(5.0f) / range6, zero);
+            const float32x8 step6 = range6 * (1.0f / 5.0f);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float32x8 k = clamp(round((value[i] - lo6) * scale6), zero, float32x8(5.0f));
+                const float32x8 d = value[i] - madd(lo6, k, step6);
+
+                float32x8 best = d * d;
+                float32x8 weight = k;
+
+                const float32x8 e0 = value[i] * value[i];
+                const float32x8 e1 = (one - value[i]) * (one - value[i]);
+
+                mask32x8 mask = e0 < best;
+                best = select(mask, e0, best);
+                weight = select(mask, float32x8(6.0f), weight);
+
+                mask = e1 < best;
+                best = select(mask, e1, best);
+                weight = select(mask, float32x8(7.0f), weight);
+
+                weight6[i] = weight;
+                error6 += best;
+            }
+        }
+
+        // write the blocks
+
+        const LaneStorage a8lo(lo);
+        const LaneStorage a8hi(hi);
+        const LaneStorage a6lo(lo6);
+        const LaneStorage a6hi(hi6);
+
+        alignas(32) float w8[16][BATCH];
+        alignas(32) float w6[16][BATCH];
+        alignas(32) float mode6[BATCH];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            simd::f32x8_ustore(w8[i], weight8[i]);
+            if (six)
+            {
+                simd::f32x8_ustore(w6[i], weight6[i]);
+            }
+        }
+
+        simd::f32x8_ustore(mode6, select(error6 < error8, float32x8(1.0f), zero));
+
+        // weight to index
+        static const u64 table8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        static const u64 table6[] = { 0, 2, 3, 4, 5, 1, 6, 7 };
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            u64 indices = 0;
+
+            if (six && mode6[lane])
+            {
+                output[0] = u8(a6lo[lane]);
+                output[1] = u8(a6hi[lane]);
+
+                for (int i = 0; i < 16; ++i)
+                {
+                    indices |= table6[int(w6[i][lane])] << (i * 3);
+                }
+            }
+            else
+            {
+                output[0] = u8(a8hi[lane]);
+                output[1] = u8(a8lo[lane]);
+
+                for (int i = 0; i < 16; ++i)
+                {
+                    indices |= table8[int(w8[i][lane])] << (i * 3);
+                }
+            }
+
+            ustore16le(output + 2, u16(indices));
+            ustore32le(output + 4, u32(indices >> 16));
+            output += pitch;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // endpoint fitting
+    // ----------------------------------------------------------------------------
+
+    // The BC7 and BC6H modes share the same subset fitting: endpoints from the extent of the
+    // pixels along the principal axis, indices by projection with an exact check of the
+    // neighbouring indices and least squares refinement. The modes supply the endpoint
+    // quantization. The mask selects the pixels in the subset (1.0 or 0.0) or all pixels
+    // when it is null.
+
+    template <int C>
+    struct SubsetFit
+    {
+        float32x8 value0[C]; // reconstructed endpoints
+        float32x8 value1[C];
+        float32x8 code0[C]; // quantized endpoints
+        float32x8 code1[C];
+        float32x8 pbit0;
+        float32x8 pbit1;
+        float32x8 index[16];
+        float32x8 error;
+    };
+
+    template <int C>
+    void select_fit(SubsetFit<C>& dest, mask32x8 mask, const SubsetFit<C>& source)
+    {
+        for (int c = 0; c < C; ++c)
+        {
+            dest.value0[c] = select(mask, source.value0[c], dest.value0[c]);
+            dest.value1[c] = select(mask, source.value1[c], dest.value1[c]);
+            dest.code0[c] = select(mask, source.code0[c], dest.code0[c]);
+            dest.code1[c] = select(mask, source.code1[c], dest.code1[c]);
+        }
+
+        dest.pbit0 = select(mask, source.pbit0, dest.pbit0);
+        dest.pbit1 = select(mask, source.pbit1, dest.pbit1);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            dest.index[i] = select(mask, source.index[i], dest.index[i]);
+        }
+
+        dest.error = select(mask, source.error, dest.error);
+    }
+
+    template <int C>
+    void fit_indices(SubsetFit<C>& fit, const float32x8 (*value)[16], const float32x8* mask, int bits)
+    {
+        const float levels = float((1 << bits) - 1);
+
+        float32x8 axis[C];
+        float32x8 length(0.0f);
+
+        for (int c = 0; c < C; ++c)
+        {
+            axis[c] = fit.value1[c] - fit.value0[c];
+            length = madd(length, axis[c], axis[c]);
+        }
+
+        const float32x8 zero(0.0f);
+        const float32x8 scale = select(length > 0.0f, float32x8(levels) / length, zero);
+
+        float32x8 error(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float32x8 t(0.0f);
+
+            for (int c = 0; c < C; ++c)
+            {
+                t = madd(t, value[c][i] - fit.value0[c], axis[c]);
+            }
+
+            const float32x8 k = clamp(round(t * scale), zero, float32x8(levels));
+
+            float32x8 best(1e30f);
+            float32x8 index = k;
+
+            // the weights are not evenly spaced; check the neighbours with the exact decoding
+            for (int delta = -1; delta <= 1; ++delta)
+            {
+                const float32x8 candidate = clamp(k + float(delta), zero, float32x8(levels));
+                const float32x8 w = round(candidate * (64.0f / levels));
+                const float32x8 w0 = float32x8(64.0f) - w;
+
+                float32x8 e(0.0f);
+
+                for (int c = 0; c < C; ++c)
+                {
+                    const float32x8 decoded = floor((w0 * fit.value0[c] + w * fit.value1[c] + 32.0f) * (1.0f / 64.0f));
+                    const float32x8 d = decoded - value[c][i];
+                    e = madd(e, d, d);
+                }
+
+                const mask32x8 better = e < best;
+                best = select(better, e, best);
+                index = select(better, candidate, index);
+            }
+
+            fit.index[i] = index;
+            error = mask ? madd(error, best, mask[i]) : error + best;
+        }
+
+        fit.error = error;
+    }
+
+    template <int C, typename Quantizer>
+    void fit_subset(SubsetFit<C>& fit, const float32x8 (*value)[16], const float32x8* mask, int bits,
+                    int refinements, const Quantizer& quantize)
+    {
+        const float32x8 zero(0.0f);
+
+        // mean
+
+        float32x8 count(16.0f);
+
+        if (mask)
+        {
+            count = mask[0];
+            for (int i = 1; i < 16; ++i)
+            {
+                count += mask[i];
+            }
+        }
+
+        const float32x8 rcp = float32x8(1.0f) / max(count, float32x8(1.0f));
+
+        float32x8 mean[C];
+
+        for (int c = 0; c < C; ++c)
+        {
+            float32x8 sum(0.0f);
+            for (int i = 0; i < 16; ++i)
+            {
+                sum = mask ? madd(sum, value[c][i], mask[i]) : sum + value[c][i];
+            }
+            mean[c] = sum * rcp;
+        }
+
+        // covariance
+
+        float32x8 cov[C][C];
+
+        for (int a = 0; a < C; ++a)
+        {
+            for (int b = 0; b < C; ++b)
+            {
+                cov[a][b] = zero;
+            }
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float32x8 d[C];
+
+            for (int c = 0; c < C; ++c)
+            {
+                d[c] = value[c][i] - mean[c];
+                if (mask)
+                {
+                    d[c] *= mask[i];
+                }
+            }
+
+            for (int a = 0; a < C; ++a)
+            {
+                for (int b = a; b < C; ++b)
+                {
+                    cov[a][b] = madd(cov[a][b], d[a], d[b]);
+                }
+            }
+        }
+
+        for (int a = 0; a < C; ++a)
+        {
+            for (int b = 0; b < a; ++b)
+            {
+                cov[a][b] = cov[b][a];
+            }
+        }
+
+        // principal axis with power iteration; start from the covariance row with largest variance
+
+        float32x8 axis[C];
+        float32x8 largest = cov[0][0];
+
+        for (int c = 0; c < C; ++c)
+        {
+            axis[c] = cov[0][c];
+        }
+
+        for (int row = 1; row < C; ++row)
+        {
+            const mask32x8 m = cov[row][row] > largest;
+            largest = select(m, cov[row][row], largest);
+
+            for (int c = 0; c < C; ++c)
+            {
+                axis[c] = select(m, cov[row][c], axis[c]);
+            }
+        }
+
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float32x8 temp[C];
+            float32x8 m(1e-10f);
+
+            for (int a = 0; a < C; ++a)
+            {
+                temp[a] = zero;
+                for (int b = 0; b < C; ++b)
+                {
+                    temp[a] = madd(temp[a], cov[a][b], axis[b]);
+                }
+                m = max(m, abs(temp[a]));
+            }
+
+            const float32x8 s = float32x8(1.0f) / m;
+
+            for (int c = 0; c < C; ++c)
+            {
+                axis[c] = temp[c] * s;
+            }
+        }
+
+        float32x8 length(0.0f);
+
+        for (int c = 0; c < C; ++c)
+        {
+            length = madd(length, axis[c], axis[c]);
+        }
+
+        const float32x8 s = select(length > 0.0f, rsqrt(length), zero);
+
+        for (int c = 0; c < C; ++c)
+        {
+            axis[c] *= s;
+        }
+
+        // endpoints from the extent of the subset along the axis; the excluded pixels project to zero
+
+        float32x8 tmin(0.0f);
+        float32x8 tmax(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float32x8 t(0.0f);
+
+            for (int c = 0; c < C; ++c)
+            {
+                t = madd(t, value[c][i] - mean[c], axis[c]);
+            }
+
+            if (mask)
+            {
+                t *= mask[i];
+            }
+
+            tmin = min(tmin, t);
+            tmax = max(tmax, t);
+        }
+
+        float32x8 e0[C];
+        float32x8 e1[C];
+
+        for (int c = 0; c < C; ++c)
+        {
+            e0[c] = madd(mean[c], axis[c], tmin);
+            e1[c] = madd(mean[c], axis[c], tmax);
+        }
+
+        quantize(fit, e0, e1);
+        fit_indices(fit, value, mask, bits);
+
+        // least squares fit of the endpoints to the current indices
+
+        const float levels = float((1 << bits) - 1);
+
+        for (int iteration = 0; iteration < refinements; ++iteration)
+        {
+            float32x8 aa(0.0f);
+            float32x8 bb(0.0f);
+            float32x8 ab(0.0f);
+            float32x8 ax[C];
+            float32x8 bx[C];
+
+            for (int c = 0; c < C; ++c)
+            {
+                ax[c] = zero;
+                bx[c] = zero;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                float32x8 alpha = round(fit.index[i] * (64.0f / levels)) * (1.0f / 64.0f);
+                float32x8 beta = float32x8(1.0f) - alpha;
+
+                if (mask)
+                {
+                    alpha *= mask[i];
+                    beta *= mask[i];
+                }
+
+                aa = madd(aa, alpha, alpha);
+                bb = madd(bb, beta, beta);
+                ab = madd(ab, alpha, beta);
+
+                for (int c = 0; c < C; ++c)
+                {
+                    ax[c] = madd(ax[c], alpha, value[c][i]);
+                    bx[c] = madd(bx[c], beta, value[c][i]);
+                }
+            }
+
+            const float32x8 det = aa * bb - ab * ab;
+            const mask32x8 valid = abs(det) > 1e-4f;
+            const float32x8 rdet = select(valid, float32x8(1.0f) / det, zero);
+
+            for (int c = 0; c < C; ++c)
+            {
+                e0[c] = select(valid, (aa * bx[c] - ab * ax[c]) * rdet, fit.value0[c]);
+                e1[c] = select(valid, (bb * ax[c] - ab * bx[c]) * rdet, fit.value1[c]);
+            }
+
+            SubsetFit<C> refined;
+            quantize(refined, e0, e1);
+            fit_indices(refined, value, mask, bits);
+            select_fit(fit, refined.error < fit.error, refined);
+        }
+    }
+
+    struct BlockWriter
+    {
+        u64 data[2] = { 0, 0 };
+        int offset = 0;
+
+        void write(u32 value, int bits)
+        {
+            const int i = offset >> 6;
+            const int s = offset & 63;
+
+            data[i] |= u64(value) << s;
+
+            if (s + bits > 64)
+            {
+                data[i + 1] |= u64(value) >> (64 - s);
+            }
+
+            offset += bits;
+        }
+
+        void store(u8* output) const
+        {
+            ustore64le(output + 0, data[0]);
+            ustore64le(output + 8, data[1]);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // BC7
+    // ----------------------------------------------------------------------------
+
+    // Mode 6 (one subset, RGBA 7.7.7.7 with unique p-bits and 4 bit indices) handles every block.
+    // The opaque blocks also try mode 1 (two subsets, RGB 6.6.6 with shared p-bits and 3 bit indices)
+    // and the translucent blocks mode 5 (RGB 7.7.7 and A8 with separate 2 bit indices) and mode 7
+    // (two subsets, RGBA 5.5.5.5 with unique p-bits and 2 bit indices). Only the best partitions
+    // ranked by the principal axis fitting error are tried.
+
+    // two subset partitions: bit n is set when pixel n is in the second subset
+    const u16 g_bc7_partition2[] =
+    {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+        0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+        0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+        0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+        0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+    };
+
+    // anchor index of the second subset
+    const u8 g_bc7_anchor2[] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    struct QuantizeMode6
+    {
+        // 7 bit endpoint with unique p-bit: value = code * 2 + p
+        void endpoint(float32x8* value, float32x8* code, float32x8& pbit, const float32x8* e) const
+        {
+            float32x8 q[2][4];
+            float32x8 error[2];
+
+            for (int p = 0; p < 2; ++p)
+            {
+                error[p] = float32x8(0.0f);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    q[p][c] = clamp(round((e[c] - float(p)) * 0.5f), float32x8(0.0f), float32x8(127.0f));
+                    const float32x8 d = madd(float32x8(float(p)), q[p][c], float32x8(2.0f)) - e[c];
+                    error[p] = madd(error[p], d, d);
+                }
+            }
+
+            const mask32x8 mask = error[1] < error[0];
+            pbit = select(mask, float32x8(1.0f), float32x8(0.0f));
+
+            for (int c = 0; c < 4; ++c)
+            {
+                code[c] = select(mask, q[1][c], q[0][c]);
+                value[c] = madd(pbit, code[c], float32x8(2.0f));
+            }
+        }
+
+        void operator () (SubsetFit<4>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            endpoint(fit.value0, fit.code0, fit.pbit0, e0);
+            endpoint(fit.value1, fit.code1, fit.pbit1, e1);
+        }
+    };
+
+    struct QuantizeMode1
+    {
+        // 6 bit endpoints with shared p-bit: the 7 bit value code * 2 + p is expanded to 8 bits
+        void operator () (SubsetFit<3>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            float32x8 q[2][2][3];
+            float32x8 v[2][2][3];
+            float32x8 error[2];
+
+            for (int p = 0; p < 2; ++p)
+            {
+                error[p] = float32x8(0.0f);
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int n = 0; n < 2; ++n)
+                    {
+                        const float32x8 e = n ? e1[c] : e0[c];
+                        q[p][n][c] = clamp(round((e * (127.0f / 255.0f) - float(p)) * 0.5f), float32x8(0.0f), float32x8(63.0f));
+                        const float32x8 q7 = madd(float32x8(float(p)), q[p][n][c], float32x8(2.0f));
+                        v[p][n][c] = madd(floor(q7 * (1.0f / 64.0f)), q7, float32x8(2.0f));
+                        const float32x8 d = v[p][n][c] - e;
+                        error[p] = madd(error[p], d, d);
+                    }
+                }
+            }
+
+            const mask32x8 mask = error[1] < error[0];
+            fit.pbit0 = select(mask, float32x8(1.0f), float32x8(0.0f));
+            fit.pbit1 = fit.pbit0;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                fit.code0[c] = select(mask, q[1][0][c], q[0][0][c]);
+                fit.code1[c] = select(mask, q[1][1][c], q[0][1][c]);
+                fit.value0[c] = select(mask, v[1][0][c], v[0][0][c]);
+                fit.value1[c] = select(mask, v[1][1][c], v[0][1][c]);
+            }
+        }
+    };
+
+    struct QuantizeMode7
+    {
+        // 5 bit endpoints with unique p-bit: the 6 bit value code * 2 + p is expanded to 8 bits
+        void endpoint(float32x8* value, float32x8* code, float32x8& pbit, const float32x8* e) const
+        {
+            float32x8 q[2][4];
+            float32x8 v[2][4];
+            float32x8 error[2];
+
+            for (int p = 0; p < 2; ++p)
+            {
+                error[p] = float32x8(0.0f);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    q[p][c] = clamp(round((e[c] * (63.0f / 255.0f) - float(p)) * 0.5f), float32x8(0.0f), float32x8(31.0f));
+                    const float32x8 q6 = madd(float32x8(float(p)), q[p][c], float32x8(2.0f));
+                    v[p][c] = madd(floor(q6 * (1.0f / 16.0f)), q6, float32x8(4.0f));
+                    const float32x8 d = v[p][c] - e[c];
+                    error[p] = madd(error[p], d, d);
+                }
+            }
+
+            const mask32x8 mask = error[1] < error[0];
+            pbit = select(mask, float32x8(1.0f), float32x8(0.0f));
+
+            for (int c = 0; c < 4; ++c)
+            {
+                code[c] = select(mask, q[1][c], q[0][c]);
+                value[c] = select(mask, v[1][c], v[0][c]);
+            }
+        }
+
+        void operator () (SubsetFit<4>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            endpoint(fit.value0, fit.code0, fit.pbit0, e0);
+            endpoint(fit.value1, fit.code1, fit.pbit1, e1);
+        }
+    };
+
+    struct QuantizeMode5Color
+    {
+        // 7 bit endpoints expanded to 8 bits
+        void operator () (SubsetFit<3>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                fit.code0[c] = clamp(round(e0[c] * (127.0f / 255.0f)), float32x8(0.0f), float32x8(127.0f));
+                fit.code1[c] = clamp(round(e1[c] * (127.0f / 255.0f)), float32x8(0.0f), float32x8(127.0f));
+                fit.value0[c] = madd(floor(fit.code0[c] * (1.0f / 64.0f)), fit.code0[c], float32x8(2.0f));
+                fit.value1[c] = madd(floor(fit.code1[c] * (1.0f / 64.0f)), fit.code1[c], float32x8(2.0f));
+            }
+
+            fit.pbit0 = float32x8(0.0f);
+            fit.pbit1 = float32x8(0.0f);
+        }
+    };
+
+    struct QuantizeMode5Alpha
+    {
+        // 8 bit endpoints
+        void operator () (SubsetFit<1>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            fit.code0[0] = clamp(round(e0[0]), float32x8(0.0f), float32x8(255.0f));
+            fit.code1[0] = clamp(round(e1[0]), float32x8(0.0f), float32x8(255.0f));
+            fit.value0[0] = fit.code0[0];
+            fit.value1[0] = fit.code1[0];
+            fit.pbit0 = float32x8(0.0f);
+            fit.pbit1 = float32x8(0.0f);
+        }
+    };
+
+    // rank the two subset partitions by the error of fitting a line to both subsets
+    void rank_partitions(float32x8* ranked, int candidates, int partitions, const float32x8 (*value)[16])
+    {
+        const float32x8* r = value[0];
+        const float32x8* g = value[1];
+        const float32x8* b = value[2];
+
+        // per pixel moments: r, g, b, rr, gg, bb, rg, rb, gb
+        float32x8 moment[16][9];
+        float32x8 total[9];
+
+        for (int j = 0; j < 9; ++j)
+        {
+            total[j] = float32x8(0.0f);
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            moment[i][0] = r[i];
+            moment[i][1] = g[i];
+            moment[i][2] = b[i];
+            moment[i][3] = r[i] * r[i];
+            moment[i][4] = g[i] * g[i];
+            moment[i][5] = b[i] * b[i];
+            moment[i][6] = r[i] * g[i];
+            moment[i][7] = r[i] * b[i];
+            moment[i][8] = g[i] * b[i];
+
+            for (int j = 0; j < 9; ++j)
+            {
+                total[j] += moment[i][j];
+            }
+        }
+
+        float32x8 best[4];
+
+        for (int i = 0; i < candidates; ++i)
+        {
+            best[i] = float32x8(1e30f);
+            ranked[i] = float32x8(0.0f);
+        }
+
+        for (int partition = 0; partition < partitions; ++partition)
+        {
+            const u32 mask = g_bc7_partition2[partition];
+
+            float32x8 sum[2][9];
+
+            for (int j = 0; j < 9; ++j)
+            {
+                sum[1][j] = float32x8(0.0f);
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                if (mask & (1 << i))
+                {
+                    for (int j = 0; j < 9; ++j)
+                    {
+                        sum[1][j] += moment[i][j];
+                    }
+                }
+            }
+
+            for (int j = 0; j < 9; ++j)
+            {
+                sum[0][j] = total[j] - sum[1][j];
+            }
+
+            const int count1 = u32_count_bits(mask);
+            const int counts[] = { 16 - count1, count1 };
+
+            float32x8 error(0.0f);
+
+            for (int subset = 0; subset < 2; ++subset)
+            {
+                const float32x8* s = sum[subset];
+                const float n = 1.0f / float(counts[subset]);
+
+                const float32x8 crr = s[3] - s[0] * s[0] * n;
+                const float32x8 cgg = s[4] - s[1] * s[1] * n;
+                const float32x8 cbb = s[5] - s[2] * s[2] * n;
+                const float32x8 crg = s[6] - s[0] * s[1] * n;
+                const float32x8 crb = s[7] - s[0] * s[2] * n;
+                const float32x8 cgb = s[8] - s[1] * s[2] * n;
+
+                // largest eigenvalue with power iteration
+                float32x8 x = crr + crg + crb;
+                float32x8 y = crg + cgg + cgb;
+                float32x8 z = crb + cgb + cbb;
+
+                for (int iteration = 0; iteration < 2; ++iteration)
+                {
+                    const float32x8 x2 = crr * x + crg * y + crb * z;
+                    const float32x8 y2 = crg * x + cgg * y + cgb * z;
+                    const float32x8 z2 = crb * x + cgb * y + cbb * z;
+                    const float32x8 m = float32x8(1.0f) / max(max(abs(x2), abs(y2)), max(abs(z2), float32x8(1e-10f)));
+                    x = x2 * m;
+                    y = y2 * m;
+                    z = z2 * m;
+                }
+
+                const float32x8 vv = x * x + y * y + z * z;
+                const float32x8 vcv = x * (crr * x + crg * y + crb * z) +
+                                      y * (crg * x + cgg * y + cgb * z) +
+                                      z * (crb * x + cgb * y + cbb * z);
+                const float32x8 lambda = select(vv > 0.0f, vcv / vv, float32x8(0.0f));
+
+                error += crr + cgg + cbb - lambda;
+            }
+
+            // insert into the sorted candidate list
+            float32x8 e = error;
+            float32x8 id = float32x8(float(partition));
+
+            for (int i = 0; i < candidates; ++i)
+            {
+                const mask32x8 m = e < best[i];
+                const float32x8 e2 = select(m, best[i], e);
+                const float32x8 id2 = select(m, ranked[i], id);
+                best[i] = select(m, e, best[i]);
+                ranked[i] = select(m, id, ranked[i]);
+                e = e2;
+                id = id2;
+            }
+        }
+    }
+
+    // per pixel subset weights (0.0 or 1.0) for the partition selected in each lane
+    void partition_masks(float32x8 (*mask)[16], float32x8 partition)
+    {
+        const LaneStorage id(partition);
+
+        alignas(32) float weight[2][16][BATCH];
+
+        for (int lane = 0; lane < BATCH; ++lane)
+        {
+            const u32 bits = g_bc7_partition2[id[lane]];
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float s = float((bits >> i) & 1);
+                weight[0][i][lane] = 1.0f - s;
+                weight[1][i][lane] = s;
+            }
+        }
+
+        for (int s = 0; s < 2; ++s)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                mask[s][i] = simd::f32x8_uload(weight[s][i]);
+            }
+        }
+    }
+
+    void write_bc7_mode6(u8* output, const SubsetFit<4>& fit, int lane)
+    {
+        const LaneStorage index0(fit.index[0]);
+        const bool swap = index0[lane] >= 8;
+
+        const SubsetFit<4>* f = &fit;
+        BlockWriter writer;
+
+        writer.write(1 << 6, 7);
+
+        for (int c = 0; c < 4; ++c)
+        {
+            const int a = LaneStorage(f->code0[c])[lane];
+            const int b = LaneStorage(f->code1[c])[lane];
+            writer.write(swap ? b : a, 7);
+            writer.write(swap ? a : b, 7);
+        }
+
+        const int p0 = LaneStorage(f->pbit0)[lane];
+        const int p1 = LaneStorage(f->pbit1)[lane];
+        writer.write(swap ? p1 : p0, 1);
+        writer.write(swap ? p0 : p1, 1);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int index = LaneStorage(f->index[i])[lane];
+            if (swap)
+            {
+                index = 15 - index;
+            }
+            writer.write(index, i ? 4 : 3);
+        }
+
+        writer.store(output);
+    }
+
+    struct TwoSubsetMode
+    {
+        u32 mode;
+        int modeBits;
+        int codeBits;
+        int indexBits;
+        bool uniquePbits;
+    };
+
+    const TwoSubsetMode g_bc7_mode1 = { 0x02, 2, 6, 3, false };
+    const TwoSubsetMode g_bc7_mode7 = { 0x80, 8, 5, 2, true };
+
+    template <int C>
+    void write_bc7_two_subsets(u8* output, const SubsetFit<C>* subset, const TwoSubsetMode& mode, int partition, int lane)
+    {
+        const u32 mask = g_bc7_partition2[partition];
+        const int anchor[] = { 0, g_bc7_anchor2[partition] };
+        const int half = 1 << (mode.indexBits - 1);
+
+        bool swap[2];
+
+        for (int s = 0; s < 2; ++s)
+        {
+            swap[s] = LaneStorage(subset[s].index[anchor[s]])[lane] >= half;
+        }
+
+        BlockWriter writer;
+
+        writer.write(mode.mode, mode.modeBits);
+        writer.write(partition, 6);
+
+        for (int c = 0; c < C; ++c)
+        {
+            for (int s = 0; s < 2; ++s)
+            {
+                const int a = LaneStorage(subset[s].code0[c])[lane];
+                const int b = LaneStorage(subset[s].code1[c])[lane];
+                writer.write(swap[s] ? b : a, mode.codeBits);
+                writer.write(swap[s] ? a : b, mode.codeBits);
+            }
+        }
+
+        for (int s = 0; s < 2; ++s)
+        {
+            const int p0 = LaneStorage(subset[s].pbit0)[lane];
+            const int p1 = LaneStorage(subset[s].pbit1)[lane];
+
+            if (mode.uniquePbits)
+            {
+                writer.write(swap[s] ? p1 : p0, 1);
+                writer.write(swap[s] ? p0 : p1, 1);
+            }
+            else
+            {
+                writer.write(p0, 1);
+            }
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int s = (mask >> i) & 1;
+            int index = LaneStorage(subset[s].index[i])[lane];
+            if (swap[s])
+            {
+                index = half * 2 - 1 - index;
+            }
+            writer.write(index, i == anchor[s] ? mode.indexBits - 1 : mode.indexBits);
+        }
+
+        writer.store(output);
+    }
+
+    void write_bc7_mode5(u8* output, const SubsetFit<3>& color, const SubsetFit<1>& alpha, int lane)
+    {
+        const bool swapColor = LaneStorage(color.index[0])[lane] >= 2;
+        const bool swapAlpha = LaneStorage(alpha.index[0])[lane] >= 2;
+
+        BlockWriter writer;
+
+        writer.write(1 << 5, 6);
+        writer.write(0, 2); // no channel rotation
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const int a = LaneStorage(color.code0[c])[lane];
+            const int b = LaneStorage(color.code1[c])[lane];
+            writer.write(swapColor ? b : a, 7);
+            writer.write(swapColor ? a : b, 7);
+        }
+
+        const int a = LaneStorage(alpha.code0[0])[lane];
+        const int b = LaneStorage(alpha.code1[0])[lane];
+        writer.write(swapAlpha ? b : a, 8);
+        writer.write(swapAlpha ? a : b, 8);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int index = LaneStorage(color.index[i])[lane];
+            writer.write(swapColor ? 3 - index : index, i ? 2 : 1);
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int index = LaneStorage(alpha.index[i])[lane];
+            writer.write(swapAlpha ? 3 - index : index, i ? 2 : 1);
+        }
+
+        writer.store(output);
+    }
+
+    void encode_bc7(u8* output, const BlockBatch& batch, int count, TextureCompressionQuality quality)
+    {
+        const int refinements = quality == TextureCompressionQuality::FAST ? 0 :
+                                quality == TextureCompressionQuality::NORMAL ? 1 : 2;
+
+        SubsetFit<4> mode6;
+        fit_subset(mode6, batch.channel, nullptr, 4, refinements, QuantizeMode6());
+
+        float32x8 opaque(1.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            opaque = select(batch.channel[3][i] < 255.0f, float32x8(0.0f), opaque);
+        }
+
+        const LaneStorage opaqueLane(opaque);
+
+        bool anyOpaque = false;
+        bool anyAlpha = false;
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            anyOpaque |= opaqueLane[lane] != 0;
+            anyAlpha |= opaqueLane[lane] == 0;
+        }
+
+        const int candidates = quality == TextureCompressionQuality::FAST ? 0 :
+                               quality == TextureCompressionQuality::NORMAL ? 1 : 3;
+
+        float32x8 mode(6.0f);
+        float32x8 error = mode6.error;
+
+        // mode 1 for the opaque blocks
+        SubsetFit<3> mode1[2];
+        float32x8 partition(0.0f);
+
+        if (anyOpaque && candidates > 0)
+        {
+            float32x8 ranked[4];
+            rank_partitions(ranked, candidates, 64, batch.channel);
+
+            float32x8 error1(1e30f);
+
+            for (int candidate = 0; candidate < candidates; ++candidate)
+            {
+                float32x8 mask[2][16];
+                partition_masks(mask, ranked[candidate]);
+
+                SubsetFit<3> subset[2];
+                fit_subset(subset[0], batch.channel, mask[0], 3, refinements, QuantizeMode1());
+                fit_subset(subset[1], batch.channel, mask[1], 3, refinements, QuantizeMode1());
+
+                const float32x8 e = subset[0].error + subset[1].error;
+                const mask32x8 better = e < error1;
+
+                select_fit(mode1[0], better, subset[0]);
+                select_fit(mode1[1], better, subset[1]);
+                partition = select(better, ranked[candidate], partition);
+                error1 = select(better, e, error1);
+            }
+
+            const mask32x8 better = (opaque > 0.0f) & (error1 < error);
+            mode = select(better, float32x8(1.0f), mode);
+            error = select(better, error1, error);
+        }
+
+        // mode 5 for the translucent blocks; the alpha has its own indices
+        SubsetFit<3> mode5color;
+        SubsetFit<1> mode5alpha;
+
+        if (anyAlpha)
+        {
+            fit_subset(mode5color, batch.channel, nullptr, 2, refinements, QuantizeMode5Color());
+            fit_subset(mode5alpha, batch.channel + 3, nullptr, 2, refinements, QuantizeMode5Alpha());
+
+            const float32x8 error5 = mode5color.error + mode5alpha.error;
+            const mask32x8 better = (opaque == 0.0f) & (error5 < error);
+            mode = select(better, float32x8(5.0f), mode);
+            error = select(better, error5, error);
+        }
+
+        // mode 7 for the translucent blocks
+        SubsetFit<4> mode7[2];
+        float32x8 partition7(0.0f);
+
+        if (anyAlpha && candidates > 0)
+        {
+            float32x8 ranked[4];
+            rank_partitions(ranked, candidates, 64, batch.channel);
+
+            float32x8 error7(1e30f);
+
+            for (int candidate = 0; candidate < candidates; ++candidate)
+            {
+                float32x8 mask[2][16];
+                partition_masks(mask, ranked[candidate]);
+
+                SubsetFit<4> subset[2];
+                fit_subset(subset[0], batch.channel, mask[0], 2, refinements, QuantizeMode7());
+                fit_subset(subset[1], batch.channel, mask[1], 2, refinements, QuantizeMode7());
+
+                const float32x8 e = subset[0].error + subset[1].error;
+                const mask32x8 better = e < error7;
+
+                select_fit(mode7[0], better, subset[0]);
+                select_fit(mode7[1], better, subset[1]);
+                partition7 = select(better, ranked[candidate], partition7);
+                error7 = select(better, e, error7);
+            }
+
+            const mask32x8 better = (opaque == 0.0f) & (error7 < error);
+            mode = select(better, float32x8(7.0f), mode);
+            error = select(better, error7, error);
+        }
+
+        const LaneStorage modeLane(mode);
+        const LaneStorage partitionLane(partition);
+        const LaneStorage partition7Lane(partition7);
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            switch (modeLane[lane])
+            {
+                case 1:
+                    write_bc7_two_subsets(output, mode1, g_bc7_mode1, partitionLane[lane], lane);
+                    break;
+                case 5:
+                    write_bc7_mode5(output, mode5color, mode5alpha, lane);
+                    break;
+                case 7:
+                    write_bc7_two_subsets(output, mode7, g_bc7_mode7, partition7Lane[lane], lane);
+                    break;
+                default:
+                    write_bc7_mode6(output, mode6, lane);
+                    break;
+            }
+
+            output += 16;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // BC6H
+    // ----------------------------------------------------------------------------
+
+    // The one region modes (10 bit endpoints and the 11.9, 12.8 and 16.4 bit base + delta
+    // endpoints with 4 bit indices) and the two region modes with 6 bit endpoints and 7.6 bit
+    // base + delta endpoints (3 bit indices, 32 shapes). The fitting is done in the unquantized
+    // domain where the half float bit pattern h is represented as h * 64 / 31; the interpolation
+    // is linear in this domain and close to logarithmic in the color.
+
+    // Header bits following the mode bits: field << 4 | bit, where the fields 0..11 are the
+    // endpoint channels (rw, gw, bw, rx, gx, bx, ry, gy, by, rz, gz, bz) and 12 is the shape.
+
+    const u8 g_bc6h_layout_01[] =
+    {
+        117, 164, 165,   0,   1,   2,   3,   4,   5,   6, 176, 177, 132,  16,  17,  18,
+         19,  20,  21,  22, 133, 178, 116,  32,  33,  34,  35,  36,  37,  38, 179, 181,
+        180,  48,  49,  50,  51,  52,  53, 112, 113, 114, 115,  64,  65,  66,  67,  68,
+         69, 160, 161, 162, 163,  80,  81,  82,  83,  84,  85, 128, 129, 130, 131,  96,
+         97,  98,  99, 100, 101, 144, 145, 146, 147, 148, 149, 192, 193, 194, 195, 196
+    };
+
+    const u8 g_bc6h_layout_1e[] =
+    {
+          0,   1,   2,   3,   4,   5, 164, 176, 177, 132,  16,  17,  18,  19,  20,  21,
+        117, 133, 178, 116,  32,  33,  34,  35,  36,  37, 165, 179, 181, 180,  48,  49,
+         50,  51,  52,  53, 112, 113, 114, 115,  64,  65,  66,  67,  68,  69, 160, 161,
+        162, 163,  80,  81,  82,  83,  84,  85, 128, 129, 130, 131,  96,  97,  98,  99,
+        100, 101, 144, 145, 146, 147, 148, 149, 192, 193, 194, 195, 196
+    };
+
+    const u8 g_bc6h_layout_03[] =
+    {
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  16,  17,  18,  19,  20,  21,
+         22,  23,  24,  25,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  48,  49,
+         50,  51,  52,  53,  54,  55,  56,  57,  64,  65,  66,  67,  68,  69,  70,  71,
+         72,  73,  80,  81,  82,  83,  84,  85,  86,  87,  88,  89
+    };
+
+    const u8 g_bc6h_layout_07[] =
+    {
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  16,  17,  18,  19,  20,  21,
+         22,  23,  24,  25,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  48,  49,
+         50,  51,  52,  53,  54,  55,  56,  10,  64,  65,  66,  67,  68,  69,  70,  71,
+         72,  26,  80,  81,  82,  83,  84,  85,  86,  87,  88,  42
+    };
+
+    const u8 g_bc6h_layout_0b[] =
+    {
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  16,  17,  18,  19,  20,  21,
+         22,  23,  24,  25,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  48,  49,
+         50,  51,  52,  53,  54,  55,  11,  10,  64,  65,  66,  67,  68,  69,  70,  71,
+         27,  26,  80,  81,  82,  83,  84,  85,  86,  87,  43,  42
+    };
+
+    const u8 g_bc6h_layout_0f[] =
+    {
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  16,  17,  18,  19,  20,  21,
+         22,  23,  24,  25,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  48,  49,
+         50,  51,  15,  14,  13,  12,  11,  10,  64,  65,  66,  67,  31,  30,  29,  28,
+         27,  26,  80,  81,  82,  83,  47,  46,  45,  44,  43,  42
+    };
+
+    struct ModeBC6H
+    {
+        u32 mode;
+        int modeBits;
+        int regions;
+        int bits; // endpoint precision
+        int delta; // precision of the endpoints stored as delta from the first endpoint; equal to bits when the mode is not transformed
+        const u8* layout;
+        int size;
+    };
+
+    const ModeBC6H g_bc6h_modes[] =
+    {
+        { 0x03, 5, 1, 10, 10, g_bc6h_layout_03, 60 },
+        { 0x0f, 5, 1, 16,  4, g_bc6h_layout_0f, 60 },
+        { 0x07, 5, 1, 11,  9, g_bc6h_layout_07, 60 },
+        { 0x0b, 5, 1, 12,  8, g_bc6h_layout_0b, 60 },
+        { 0x1e, 5, 2,  6,  6, g_bc6h_layout_1e, 77 },
+        { 0x01, 2, 2,  7,  6, g_bc6h_layout_01, 80 },
+    };
+
+    struct QuantizeBC6H
+    {
+        int bits;
+        int delta;
+
+        QuantizeBC6H(int bits, int delta)
+            : bits(bits)
+            , delta(delta)
+        {
+        }
+
+        float32x8 quantize(float32x8 e) const
+        {
+            if (bits >= 15)
+            {
+                return clamp(round(e), float32x8(0.0f), float32x8(65535.0f));
+            }
+
+            const float scale = float(1 << (16 - bits));
+            const float maximum = float((1 << bits) - 1);
+            return clamp(round(e * (1.0f / scale) - 0.5f), float32x8(0.0f), float32x8(maximum));
+        }
+
+        float32x8 unquantize(float32x8 q) const
+        {
+            if (bits >= 15)
+            {
+                return q;
+            }
+
+            const float scale = float(1 << (16 - bits));
+            const float maximum = float((1 << bits) - 1);
+            const float32x8 v = madd(float32x8(scale * 0.5f), q, float32x8(scale));
+            return select(q == 0.0f, float32x8(0.0f), select(q == maximum, float32x8(65535.0f), v));
+        }
+
+        void operator () (SubsetFit<3>& fit, const float32x8* e0, const float32x8* e1) const
+        {
+            // symmetric delta range so that the endpoints can be swapped
+            const float limit = float((1 << (delta - 1)) - 1);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const float32x8 q0 = quantize(e0[c]);
+                float32x8 q1 = quantize(e1[c]);
+
+                if (delta < bits)
+                {
+                    q1 = q0 + clamp(q1 - q0, float32x8(-limit), float32x8(limit));
+                }
+
+                fit.code0[c] = q0;
+                fit.code1[c] = q1;
+                fit.value0[c] = unquantize(q0);
+                fit.value1[c] = unquantize(q1);
+            }
+
+            fit.pbit0 = float32x8(0.0f);
+            fit.pbit1 = float32x8(0.0f);
+        }
+    };
+
+    // The transformed two region mode stores three endpoints as deltas from the first endpoint
+    // of the first region. The first region is oriented so that its anchor index is in the lower
+    // half before the deltas are clamped; swapping it when writing would change the base.
+    void transform_regions(SubsetFit<3>* subset, const float32x8 (*value)[16], const float32x8 (*mask)[16],
+                           const ModeBC6H& mode)
+    {
+        const QuantizeBC6H quantize(mode.bits, mode.bits);
+
+        SubsetFit<3>& region = subset[0];
+        const mask32x8 swap = region.index[0] >= 4.0f;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float32x8 code0 = region.code0[c];
+            region.code0[c] = select(swap, region.code1[c], code0);
+            region.code1[c] = select(swap, code0, region.code1[c]);
+        }
+
+        const float lo = -float(1 << (mode.delta - 1));
+        const float hi = float((1 << (mode.delta - 1)) - 1);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float32x8 base = subset[0].code0[c];
+
+            subset[0].code1[c] = base + clamp(subset[0].code1[c] - base, float32x8(lo), float32x8(hi));
+            subset[1].code0[c] = base + clamp(subset[1].code0[c] - base, float32x8(lo), float32x8(hi));
+            subset[1].code1[c] = base + clamp(subset[1].code1[c] - base, float32x8(lo), float32x8(hi));
+
+            for (int s = 0; s < 2; ++s)
+            {
+                subset[s].value0[c] = quantize.unquantize(subset[s].code0[c]);
+                subset[s].value1[c] = quantize.unquantize(subset[s].code1[c]);
+            }
+        }
+
+        fit_indices(subset[0], value, mask[0], 3);
+        fit_indices(subset[1], value, mask[1], 3);
+
+        // the clamping can move the anchor to the upper half; these lanes cannot use the mode
+        subset[0].error = select(subset[0].index[0] >= 4.0f, float32x8(1e30f), subset[0].error);
+    }
+
+    void write_bc6h(u8* output, const SubsetFit<3>* subset, const ModeBC6H& mode, int shape, int lane)
+    {
+        const u32 partition = mode.regions > 1 ? g_bc7_partition2[shape] : 0;
+        const int anchor[] = { 0, g_bc7_anchor2[shape] };
+        const int bits = mode.regions > 1 ? 3 : 4;
+        const int half = 1 << (bits - 1);
+
+        bool swap[2];
+        int endpoint[4][3];
+
+        for (int s = 0; s < mode.regions; ++s)
+        {
+            swap[s] = LaneStorage(subset[s].index[anchor[s]])[lane] >= half;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const int a = LaneStorage(subset[s].code0[c])[lane];
+                const int b = LaneStorage(subset[s].code1[c])[lane];
+                endpoint[s * 2 + 0][c] = swap[s] ? b : a;
+                endpoint[s * 2 + 1][c] = swap[s] ? a : b;
+            }
+        }
+
+        if (mode.delta < mode.bits)
+        {
+            const int mask = (1 << mode.delta) - 1;
+
+            for (int e = 1; e < mode.regions * 2; ++e)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    endpoint[e][c] = (endpoint[e][c] - endpoint[0][c]) & mask;
+                }
+            }
+        }
+
+        BlockWriter writer;
+
+        writer.write(mode.mode, mode.modeBits);
+
+        for (int i = 0; i < mode.size; ++i)
+        {
+            const int field = mode.layout[i] >> 4;
+            const int bit = mode.layout[i] & 15;
+            const int value = field == 12 ? shape : endpoint[field / 3][field % 3];
+            writer.write((value >> bit) & 1, 1);
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int s = (partition >> i) & 1;
+            int index = LaneStorage(subset[s].index[i])[lane];
+            if (swap[s])
+            {
+                index = half * 2 - 1 - index;
+            }
+            writer.write(index, i == anchor[s] ? bits - 1 : bits);
+        }
+
+        writer.store(output);
+    }
+
+    void encode_bc6h(u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        alignas(32) float temp[3][16][BATCH];
+
+        for (int lane = 0; lane < BATCH; ++lane)
+        {
+            // the unused lanes replicate the last block
+            const u8* block = input + std::min(lane, count - 1) * 64;
+
+            for (int y = 0; y < 4; ++y)
+            {
+                const float* scan = reinterpret_cast<const float*>(block + y * stride);
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        // unsigned format: negative values are clamped to zero and infinity to max half
+                        const float s = clamp(scan[x * 4 + c], 0.0f, 65504.0f);
+                        const u16 h = Half(s).u;
+                        temp[c][y * 4 + x][lane] = float(h) * (64.0f / 31.0f);
+                    }
+                }
+            }
+        }
+
+        float32x8 value[3][16];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                value[c][i] = simd::f32x8_uload(temp[c][i]);
+            }
+        }
+
+        const int refinements = quality == TextureCompressionQuality::FAST ? 0 :
+                                quality == TextureCompressionQuality::NORMAL ? 1 : 3;
+        const int modes = quality == TextureCompressionQuality::FAST ? 2 : 4;
+        const int candidates = quality == TextureCompressionQuality::HIGH ? 3 : 1;
+
+        // one region
+
+        SubsetFit<3> best[2];
+        float32x8 error(1e30f);
+        float32x8 selected(0.0f);
+        float32x8 shape(0.0f);
+
+        for (int i = 0; i < modes; ++i)
+        {
+            const ModeBC6H& mode = g_bc6h_modes[i];
+
+            SubsetFit<3> fit;
+            fit_subset(fit, value, nullptr, 4, refinements, QuantizeBC6H(mode.bits, mode.delta));
+
+            const mask32x8 better = fit.error < error;
+            select_fit(best[0], better, fit);
+            selected = select(better, float32x8(float(i)), selected);
+            error = select(better, fit.error, error);
+        }
+
+        // two regions
+
+        float32x8 ranked[4];
+        rank_partitions(ranked, candidates, 32, value);
+
+        for (int candidate = 0; candidate < candidates; ++candidate)
+        {
+            float32x8 mask[2][16];
+            partition_masks(mask, ranked[candidate]);
+
+            for (int i = 4; i < 6; ++i)
+            {
+                const ModeBC6H& mode = g_bc6h_modes[i];
+                const QuantizeBC6H quantize(mode.bits, mode.bits);
+
+                SubsetFit<3> subset[2];
+                fit_subset(subset[0], value, mask[0], 3, refinements, quantize);
+                fit_subset(subset[1], value, mask[1], 3, refinements, quantize);
+
+                if (mode.delta < mode.bits)
+                {
+                    transform_regions(subset, value, mask, mode);
+                }
+
+                const float32x8 e = subset[0].error + subset[1].error;
+                const mask32x8 better = e < error;
+
+                select_fit(best[0], better, subset[0]);
+                select_fit(best[1], better, subset[1]);
+                selected = select(better, float32x8(float(i)), selected);
+                shape = select(better, ranked[candidate], shape);
+                error = select(better, e, error);
+            }
+        }
+
+        const LaneStorage modeLane(selected);
+        const LaneStorage shapeLane(shape);
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            write_bc6h(output, best, g_bc6h_modes[modeLane[lane]], shapeLane[lane], lane);
+            output += 16;
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // batch encoders
+    // ----------------------------------------------------------------------------
+
+    // The input is a row of blocks in R8G8B8A8 format; count blocks are encoded.
+
+    void encode_blocks_bc1(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_color(output, 8, batch, std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 8;
+        }
+    }
+
+    void encode_blocks_bc2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_explicit_alpha(output + 0, 16, input, stride, std::min(count, BATCH));
+            encode_color(output + 8, 16, batch, std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 16;
+        }
+    }
+
+    void encode_blocks_bc3(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_alpha(output + 0, 16, batch.channel[3], std::min(count, BATCH), quality);
+            encode_color(output + 8, 16, batch, std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 16;
+        }
+    }
+
+    void encode_blocks_bc4(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_alpha(output, 8, batch.channel[0], std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 8;
+        }
+    }
+
+    void encode_blocks_bc5(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_alpha(output + 0, 16, batch.channel[0], std::min(count, BATCH), quality);
+            encode_alpha(output + 8, 16, batch.channel[1], std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 16;
+        }
+    }
+
+    void encode_blocks_bc7(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_bc7(output, batch, std::min(count, BATCH), quality);
+            input += BATCH * 16;
+            output += BATCH * 16;
+        }
+    }
+
+    // The input is a row of blocks in RGBA32F format.
+
+    void encode_blocks_bc6h(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            encode_bc6h(output, input, stride, std::min(count, BATCH), quality);
+            input += BATCH * 64;
+            output += BATCH * 16;
+        }
+    }
+
+} // namespace mango
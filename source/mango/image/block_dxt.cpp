@@ -2,6 +2,7 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <cstring>
 #include <mango/core/endian.hpp>
 #include <mango/image/compression.hpp>
 
@@ -294,6 +295,247 @@ namespace
         }
     }
 
+    // ------------------------------------------------------------
+    // row decoders
+    // ------------------------------------------------------------
+
+    // A row of blocks is decoded per call. The palettes are expanded with byte shuffles:
+    // the control for each scanline is looked up with the four 2-bit color indices and
+    // gathers the 32 bit colors from the palette register in one instruction.
+
+#if defined(MANGO_ENABLE_SSSE3)
+
+    using Vector = __m128i;
+
+    inline Vector vector_load(const void* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    inline void vector_store(void* p, Vector v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+    }
+
+    // the control bytes with the high bit set select zero
+    inline Vector vector_lookup(Vector table, Vector control)
+    {
+        return _mm_shuffle_epi8(table, control);
+    }
+
+    inline Vector vector_or(Vector a, Vector b)
+    {
+        return _mm_or_si128(a, b);
+    }
+
+    inline Vector vector_unpacklo(Vector a, Vector b)
+    {
+        return _mm_unpacklo_epi8(a, b);
+    }
+
+    inline Vector vector_unpackhi(Vector a, Vector b)
+    {
+        return _mm_unpackhi_epi8(a, b);
+    }
+
+#elif defined(MANGO_ENABLE_NEON) && defined(__aarch64__)
+
+    using Vector = uint8x16_t;
+
+    inline Vector vector_load(const void* p)
+    {
+        return vld1q_u8(reinterpret_cast<const u8*>(p));
+    }
+
+    inline void vector_store(void* p, Vector v)
+    {
+        vst1q_u8(reinterpret_cast<u8*>(p), v);
+    }
+
+    // the out of range control bytes select zero
+    inline Vector vector_lookup(Vector table, Vector control)
+    {
+        return vqtbl1q_u8(table, control);
+    }
+
+    inline Vector vector_or(Vector a, Vector b)
+    {
+        return vorrq_u8(a, b);
+    }
+
+    inline Vector vector_unpacklo(Vector a, Vector b)
+    {
+        return vzip1q_u8(a, b);
+    }
+
+    inline Vector vector_unpackhi(Vector a, Vector b)
+    {
+        return vzip2q_u8(a, b);
+    }
+
+#else
+
+    struct Vector
+    {
+        u8 data[16];
+    };
+
+    inline Vector vector_load(const void* p)
+    {
+        Vector v;
+        std::memcpy(v.data, p, 16);
+        return v;
+    }
+
+    inline void vector_store(void* p, Vector v)
+    {
+        std::memcpy(p, v.data, 16);
+    }
+
+    inline Vector vector_lookup(Vector table, Vector control)
+    {
+        Vector v;
+        for (int i = 0; i < 16; ++i)
+        {
+            const u8 c = control.data[i];
+            v.data[i] = c & 0x80 ? 0 : table.data[c & 15];
+        }
+        return v;
+    }
+
+    inline Vector vector_or(Vector a, Vector b)
+    {
+        Vector v;
+        for (int i = 0; i < 16; ++i)
+        {
+            v.data[i] = a.data[i] | b.data[i];
+        }
+        return v;
+    }
+
+    inline Vector vector_unpacklo(Vector a, Vector b)
+    {
+        Vector v;
+        for (int i = 0; i < 8; ++i)
+        {
+            v.data[i * 2 + 0] = a.data[i];
+            v.data[i * 2 + 1] = b.data[i];
+        }
+        return v;
+    }
+
+    inline Vector vector_unpackhi(Vector a, Vector b)
+    {
+        Vector v;
+        for (int i = 0; i < 8; ++i)
+        {
+            v.data[i * 2 + 0] = a.data[i + 8];
+            v.data[i * 2 + 1] = b.data[i + 8];
+        }
+        return v;
+    }
+
+#endif
+
+    struct ShuffleTable
+    {
+        // scanline of four 2-bit color indices -> gather 32 bit colors
+        alignas(16) u8 color[256][16];
+
+        // alpha of scanline y -> the alpha bytes of 32 bit pixels
+        alignas(16) u8 alpha[4][16];
+
+        ShuffleTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int index = (i >> (x * 2)) & 3;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        color[i][x * 4 + c] = u8(index * 4 + c);
+                    }
+                }
+            }
+
+            for (int y = 0; y < 4; ++y)
+            {
+                for (int x = 0; x < 4; ++x)
+                {
+                    alpha[y][x * 4 + 0] = 0x80;
+                    alpha[y][x * 4 + 1] = 0x80;
+                    alpha[y][x * 4 + 2] = 0x80;
+                    alpha[y][x * 4 + 3] = u8(y * 4 + x);
+                }
+            }
+        }
+    };
+
+    const ShuffleTable& getShuffleTable()
+    {
+        static const ShuffleTable table;
+        return table;
+    }
+
+    // The alpha values of the block in scanline order
+    Vector DecodeAlphaExplicitVector(const DXTAlphaBlockExplicit* alphaBlock)
+    {
+        const u64 data = uload64le(&alphaBlock->data[0]);
+
+        alignas(16) u8 alpha[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            alpha[i] = ExtendAlpha((data >> (i * 4)) & 0xf);
+        }
+
+        return vector_load(alpha);
+    }
+
+    Vector Decode3BitLinearVector(const DXTAlphaBlock3BitLinear* block)
+    {
+        alignas(16) u8 table[16] = { 0 };
+        DecodeAlphaTable(table, block);
+
+        const u64 data = uload64le(block) >> 16;
+
+        alignas(16) u8 index[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            index[i] = (data >> (i * 3)) & 7;
+        }
+
+        return vector_lookup(vector_load(table), vector_load(index));
+    }
+
+    void DecodeColorRow(u8* dest, int stride, const DXTColBlock* colorBlock, u8 alpha, const Vector* alphaVector)
+    {
+        const ShuffleTable& shuffle = getShuffleTable();
+
+        alignas(16) u32 color[4];
+        GetColorBlockColors(color, colorBlock, alpha);
+
+        const Vector palette = vector_load(color);
+
+        u32 data = uload32le(&colorBlock->data);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            Vector v = vector_lookup(palette, vector_load(shuffle.color[data & 0xff]));
+
+            if (alphaVector)
+            {
+                v = vector_or(v, vector_lookup(*alphaVector, vector_load(shuffle.alpha[y])));
+            }
+
+            vector_store(dest, v);
+            data >>= 8;
+            dest += stride;
+        }
+    }
+
 } // namespace
 
 namespace mango
@@ -340,6 +582,96 @@ namespace mango
         Decode3BitLinear(out + 1, 2, stride, greenBlock);
     }
 
+    void decode_blocks_dxt1(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 0);
+            DecodeColorRow(out, stride, colorBlock, 0xff, nullptr);
+            out += 16;
+            in += 8;
+        }
+    }
+
+    void decode_blocks_dxt3(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const DXTAlphaBlockExplicit* alphaBlock = reinterpret_cast<const DXTAlphaBlockExplicit *>(in + 0);
+            const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+            const Vector alpha = DecodeAlphaExplicitVector(alphaBlock);
+            DecodeColorRow(out, stride, colorBlock, 0, &alpha);
+            out += 16;
+            in += 16;
+        }
+    }
+
+    void decode_blocks_dxt5(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const DXTAlphaBlock3BitLinear* alphaBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear *>(in + 0);
+            const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+            const Vector alpha = Decode3BitLinearVector(alphaBlock);
+            DecodeColorRow(out, stride, colorBlock, 0, &alpha);
+            out += 16;
+            in += 16;
+        }
+    }
+
+    void decode_blocks_3dc_x(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+
+            alignas(16) u8 red[16];
+            vector_store(red, Decode3BitLinearVector(redBlock));
+
+            for (int y = 0; y < 4; ++y)
+            {
+                std::memcpy(out + y * stride, red + y * 4, 4);
+            }
+
+            out += 4;
+            in += 8;
+        }
+    }
+
+    void decode_blocks_3dc_xy(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+            const DXTAlphaBlock3BitLinear* greenBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 8);
+
+            const Vector red = Decode3BitLinearVector(redBlock);
+            const Vector green = Decode3BitLinearVector(greenBlock);
+
+            alignas(16) u8 rg[32];
+            vector_store(rg + 0, vector_unpacklo(red, green));
+            vector_store(rg + 16, vector_unpackhi(red, green));
+
+            for (int y = 0; y < 4; ++y)
+            {
+                std::memcpy(out + y * stride, rg + y * 8, 8);
+            }
+
+            out += 8;
+            in += 16;
+        }
+    }
+
     void decode_block_atc(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
     {
         MANGO_UNREFERENCED(info);
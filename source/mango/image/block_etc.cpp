@@ -0,0 +1,1138 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mango/core/endian.hpp>
+#include <mango/core/bits.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/compression.hpp>
+#include "../../external/google/etc.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // BlockBatch
+    // ----------------------------------------------------------------------------
+
+    // Eight 4x4 blocks are encoded at a time, one block in each SIMD lane; see block_bc.cpp.
+    // The pixels are stored as structure-of-arrays: channel[c][i] holds pixel i from every block.
+
+    constexpr int BATCH = 8;
+
+    struct BlockBatch
+    {
+        float32x8 channel[4][16];
+
+        // R8G8B8A8 blocks; the values are in the [0, 255] range
+        BlockBatch(const u8* input, int stride, int count)
+        {
+            alignas(32) float temp[4][16][BATCH];
+
+            for (int lane = 0; lane < BATCH; ++lane)
+            {
+                // the unused lanes replicate the last block
+                const u8* block = input + std::min(lane, count - 1) * 16;
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    const u8* scan = block + y * stride;
+
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const int i = y * 4 + x;
+                        temp[0][i][lane] = scan[x * 4 + 0];
+                        temp[1][i][lane] = scan[x * 4 + 1];
+                        temp[2][i][lane] = scan[x * 4 + 2];
+                        temp[3][i][lane] = scan[x * 4 + 3];
+                    }
+                }
+            }
+
+            load(temp);
+        }
+
+        // RGBA32F blocks; the values are clamped to [0, 1] and multiplied by scale
+        BlockBatch(const u8* input, int stride, int count, float scale)
+        {
+            alignas(32) float temp[4][16][BATCH];
+
+            for (int lane = 0; lane < BATCH; ++lane)
+            {
+                const u8* block = input + std::min(lane, count - 1) * 64;
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    const float* scan = reinterpret_cast<const float*>(block + y * stride);
+
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const int i = y * 4 + x;
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            temp[c][i][lane] = std::round(clamp(scan[x * 4 + c], 0.0f, 1.0f) * scale);
+                        }
+                    }
+                }
+            }
+
+            load(temp);
+        }
+
+        void load(const float (*temp)[16][BATCH])
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    channel[c][i] = simd::f32x8_uload(temp[c][i]);
+                }
+            }
+        }
+    };
+
+    struct LaneStorage
+    {
+        alignas(32) float data[BATCH];
+
+        LaneStorage(float32x8 v)
+        {
+            simd::f32x8_ustore(data, v);
+        }
+
+        int operator [] (int lane) const
+        {
+            return int(data[lane]);
+        }
+    };
+
+    float32x8 square(float32x8 v)
+    {
+        return v * v;
+    }
+
+    // ----------------------------------------------------------------------------
+    // EAC
+    // ----------------------------------------------------------------------------
+
+    // The EAC block stores a base value, a multiplier and one of the 16 modifier tables:
+    // value = base * scale + offset + multiplier * scale * modifier. The 8 bit alpha uses scale 1
+    // and offset 0; the 11 bit channels use scale 8 and offset 4 in the 11 bit domain.
+    // The tables are fitted to the block extents and the best table is selected per block.
+
+    const int g_eac_modifier[16][8] =
+    {
+        { -3,  -6,  -9, -15,  2,  5,  8, 14 },
+        { -3,  -7, -10, -13,  2,  6,  9, 12 },
+        { -2,  -5,  -8, -13,  1,  4,  7, 12 },
+        { -2,  -4,  -6, -13,  1,  3,  5, 12 },
+        { -3,  -6,  -8, -12,  2,  5,  7, 11 },
+        { -3,  -7,  -9, -11,  2,  6,  8, 10 },
+        { -4,  -7,  -8, -11,  3,  6,  7, 10 },
+        { -3,  -5,  -8, -11,  2,  4,  7, 10 },
+        { -2,  -6,  -8, -10,  1,  5,  7,  9 },
+        { -2,  -5,  -8, -10,  1,  4,  7,  9 },
+        { -2,  -4,  -8, -10,  1,  3,  7,  9 },
+        { -2,  -5,  -7, -10,  1,  4,  6,  9 },
+        { -3,  -4,  -7, -10,  2,  3,  6,  9 },
+        { -1,  -2,  -3, -10,  0,  1,  2,  9 },
+        { -4,  -6,  -8,  -9,  3,  5,  7,  8 },
+        { -3,  -5,  -7,  -9,  2,  4,  6,  8 }
+    };
+
+    struct EACFit
+    {
+        float32x8 error;
+        float32x8 base;
+        float32x8 multiplier;
+        float32x8 table;
+        float32x8 index[16];
+    };
+
+    void fit_eac(EACFit& fit, const float32x8* value, int table, float32x8 base, float32x8 multiplier,
+                 float scale, float offset, float maximum)
+    {
+        const float32x8 zero(0.0f);
+        const float32x8 top(maximum);
+        const float32x8 center = madd(float32x8(offset), base, float32x8(scale));
+        const float32x8 step = multiplier * scale;
+
+        float32x8 palette[8];
+
+        for (int k = 0; k < 8; ++k)
+        {
+            palette[k] = clamp(madd(center, step, float32x8(float(g_eac_modifier[table][k]))), zero, top);
+        }
+
+        float32x8 error(0.0f);
+        float32x8 index[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float32x8 best = square(value[i] - palette[0]);
+            float32x8 k0(0.0f);
+
+            for (int k = 1; k < 8; ++k)
+            {
+                const float32x8 e = square(value[i] - palette[k]);
+                const mask32x8 mask = e < best;
+                best = select(mask, e, best);
+                k0 = select(mask, float32x8(float(k)), k0);
+            }
+
+            index[i] = k0;
+            error += best;
+        }
+
+        const mask32x8 better = error < fit.error;
+
+        fit.error = select(better, error, fit.error);
+        fit.base = select(better, base, fit.base);
+        fit.multiplier = select(better, multiplier, fit.multiplier);
+        fit.table = select(better, float32x8(float(table)), fit.table);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            fit.index[i] = select(better, index[i], fit.index[i]);
+        }
+    }
+
+    void encode_eac(u8* output, int pitch, const float32x8* value, int count, TextureCompressionQuality quality,
+                    float scale, float offset, float maximum)
+    {
+        float32x8 lo = value[0];
+        float32x8 hi = value[0];
+
+        for (int i = 1; i < 16; ++i)
+        {
+            lo = min(lo, value[i]);
+            hi = max(hi, value[i]);
+        }
+
+        // the tables with the most distinct shapes are tried first
+        static const int tables[] = { 13, 11, 2, 7, 0, 1, 3, 4, 5, 6, 8, 9, 10, 12, 14, 15 };
+
+        const int numTables = quality == TextureCompressionQuality::FAST ? 4 : 16;
+        const int spread = quality == TextureCompressionQuality::HIGH ? 1 : 0;
+
+        EACFit fit;
+        fit.error = float32x8(std::numeric_limits<float>::max());
+
+        const float32x8 middle = (lo + hi) * 0.5f;
+
+        for (int j = 0; j < numTables; ++j)
+        {
+            const int table = tables[j];
+            const float low = float(g_eac_modifier[table][3]);
+            const float high = float(g_eac_modifier[table][7]);
+
+            // the multiplier zero has a special meaning in the 11 bit mode; it is never used
+            const float32x8 multiplier = round((hi - lo) * (1.0f / (scale * (high - low))));
+
+            for (int d = -spread; d <= spread; ++d)
+            {
+                const float32x8 m = clamp(multiplier + float(d), float32x8(1.0f), float32x8(15.0f));
+                const float32x8 center = middle - offset - m * (scale * (low + high) * 0.5f);
+                const float32x8 base = clamp(round(center * (1.0f / scale)), float32x8(0.0f), float32x8(255.0f));
+                fit_eac(fit, value, table, base, m, scale, offset, maximum);
+            }
+        }
+
+        const LaneStorage base(fit.base);
+        const LaneStorage multiplier(fit.multiplier);
+        const LaneStorage table(fit.table);
+
+        alignas(32) float index[16][BATCH];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            simd::f32x8_ustore(index[i], fit.index[i]);
+        }
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            u64 data = u64(base[lane]) << 56;
+            data |= u64(multiplier[lane]) << 52;
+            data |= u64(table[lane]) << 48;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                // the pixels are stored in column-major order
+                const int x = i & 3;
+                const int y = i >> 2;
+                data |= u64(index[i][lane]) << (45 - 3 * (x * 4 + y));
+            }
+
+            ustore64be(output, data);
+            output += pitch;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // ETC2 color block
+    // ----------------------------------------------------------------------------
+
+    // The individual and differential modes split the block into two 2x4 or 4x2 sub-blocks
+    // with a base color and a modifier table each. The base color is the sub-block average
+    // and the best of the eight tables is searched. The planar mode is a least squares fit of
+    // a color gradient to the block. The T and H modes are not used by the encoder.
+    //
+    // With punch-through alpha the differential bit is the opaque bit and the individual mode is
+    // not available. When the opaque bit is clear the selector 2 is a transparent pixel, the
+    // selector 0 is the base color without a modifier and the planar mode cannot be used.
+
+    const int g_etc_modifier[8][4] =
+    {
+        {  2,   8,  -2,   -8 },
+        {  5,  17,  -5,  -17 },
+        {  9,  29,  -9,  -29 },
+        { 13,  42, -13,  -42 },
+        { 18,  60, -18,  -60 },
+        { 24,  80, -24,  -80 },
+        { 33, 106, -33, -106 },
+        { 47, 183, -47, -183 }
+    };
+
+    // pixels in the sub-blocks: [flip][subblock][pixel]
+    const int g_etc_subblock[2][2][8] =
+    {
+        {
+            { 0, 1, 4, 5, 8, 9, 12, 13 },
+            { 2, 3, 6, 7, 10, 11, 14, 15 },
+        },
+        {
+            { 0, 1, 2, 3, 4, 5, 6, 7 },
+            { 8, 9, 10, 11, 12, 13, 14, 15 },
+        },
+    };
+
+    struct PunchThrough
+    {
+        mask32x8 transparent; // blocks with transparent pixels
+        mask32x8 opaque; // blocks without transparent pixels
+        mask32x8 pixel[16]; // transparent pixels
+
+        PunchThrough(const BlockBatch& batch)
+        {
+            float32x8 minimum = batch.channel[3][0];
+
+            for (int i = 0; i < 16; ++i)
+            {
+                pixel[i] = batch.channel[3][i] < 128.0f;
+                minimum = min(minimum, batch.channel[3][i]);
+            }
+
+            transparent = minimum < 128.0f;
+            opaque = minimum >= 128.0f;
+        }
+    };
+
+    struct SubblockFit
+    {
+        float32x8 error;
+        float32x8 table;
+        float32x8 selector[8];
+    };
+
+    void fit_subblock(SubblockFit& fit, const BlockBatch& batch, const int* pixels, const float32x8* base, const PunchThrough* punch)
+    {
+        const float32x8 zero(0.0f);
+        const float32x8 one(255.0f);
+
+        fit.error = float32x8(std::numeric_limits<float>::max());
+
+        for (int table = 0; table < 8; ++table)
+        {
+            float32x8 palette[4][3];
+
+            for (int k = 0; k < 4; ++k)
+            {
+                float32x8 m(float(g_etc_modifier[table][k]));
+
+                if (punch && !(k & 1))
+                {
+                    // the selector 2 is the same color as 0 and is never selected as it is not better
+                    m = select(punch->transparent, zero, m);
+                }
+
+                palette[k][0] = clamp(base[0] + m, zero, one);
+                palette[k][1] = clamp(base[1] + m, zero, one);
+                palette[k][2] = clamp(base[2] + m, zero, one);
+            }
+
+            float32x8 error(0.0f);
+            float32x8 selector[8];
+
+            for (int j = 0; j < 8; ++j)
+            {
+                const int i = pixels[j];
+                const float32x8 r = batch.channel[0][i];
+                const float32x8 g = batch.channel[1][i];
+                const float32x8 b = batch.channel[2][i];
+
+                float32x8 best = square(r - palette[0][0]) + square(g - palette[0][1]) + square(b - palette[0][2]);
+                float32x8 k0(0.0f);
+
+                for (int k = 1; k < 4; ++k)
+                {
+                    const float32x8 e = square(r - palette[k][0]) + square(g - palette[k][1]) + square(b - palette[k][2]);
+                    const mask32x8 mask = e < best;
+                    best = select(mask, e, best);
+                    k0 = select(mask, float32x8(float(k)), k0);
+                }
+
+                if (punch)
+                {
+                    best = select(punch->pixel[i], zero, best);
+                    k0 = select(punch->pixel[i], float32x8(2.0f), k0);
+                }
+
+                selector[j] = k0;
+                error += best;
+            }
+
+            const mask32x8 better = error < fit.error;
+
+            fit.error = select(better, error, fit.error);
+            fit.table = select(better, float32x8(float(table)), fit.table);
+
+            for (int j = 0; j < 8; ++j)
+            {
+                fit.selector[j] = select(better, selector[j], fit.selector[j]);
+            }
+        }
+    }
+
+    // least squares base color for the selected modifiers (ignoring the clamping)
+    void refine_base(float32x8* color, const SubblockFit& fit, const BlockBatch& batch, const int* pixels)
+    {
+        float32x8 sum[3] = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+        float32x8 modifier(0.0f);
+
+        for (int j = 0; j < 8; ++j)
+        {
+            const int i = pixels[j];
+
+            float32x8 m(0.0f);
+
+            for (int table = 0; table < 8; ++table)
+            {
+                for (int k = 0; k < 4; ++k)
+                {
+                    const mask32x8 mask = (fit.table == float(table)) & (fit.selector[j] == float(k));
+                    m = select(mask, float32x8(float(g_etc_modifier[table][k])), m);
+                }
+            }
+
+            sum[0] += batch.channel[0][i];
+            sum[1] += batch.channel[1][i];
+            sum[2] += batch.channel[2][i];
+            modifier += m;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            color[c] = (sum[c] - modifier) * (1.0f / 8.0f);
+        }
+    }
+
+    struct ColorFit
+    {
+        float32x8 error;
+        float32x8 mode; // 0: individual, 1: differential, 2: planar
+        float32x8 flip;
+        float32x8 code[2][3];
+        float32x8 table[2];
+        float32x8 selector[16];
+    };
+
+    void select_fit(ColorFit& fit, mask32x8 mask, float32x8 mode, float32x8 flip, const float32x8 (*code)[3],
+                    const SubblockFit* subblock, const int (*pixels)[8])
+    {
+        fit.error = select(mask, subblock[0].error + subblock[1].error, fit.error);
+        fit.mode = select(mask, mode, fit.mode);
+        fit.flip = select(mask, flip, fit.flip);
+
+        for (int s = 0; s < 2; ++s)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                fit.code[s][c] = select(mask, code[s][c], fit.code[s][c]);
+            }
+
+            fit.table[s] = select(mask, subblock[s].table, fit.table[s]);
+
+            for (int j = 0; j < 8; ++j)
+            {
+                const int i = pixels[s][j];
+                fit.selector[i] = select(mask, subblock[s].selector[j], fit.selector[i]);
+            }
+        }
+    }
+
+    // 5 bit code expanded to 8 bits with bit replication
+    float32x8 expand5(float32x8 code)
+    {
+        return code * 8.0f + floor(code * 0.25f);
+    }
+
+    void fit_differential(float32x8 (*code)[3], float32x8 (*base)[3], const float32x8 (*color)[3])
+    {
+        const float32x8 zero(0.0f);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float32x8 code0 = clamp(round(color[0][c] * (31.0f / 255.0f)), zero, float32x8(31.0f));
+            const float32x8 code1 = clamp(round(color[1][c] * (31.0f / 255.0f)), zero, float32x8(31.0f));
+
+            // the second base color is stored as a 3 bit signed delta
+            code[0][c] = code0;
+            code[1][c] = code0 + clamp(code1 - code0, float32x8(-4.0f), float32x8(3.0f));
+            base[0][c] = expand5(code[0][c]);
+            base[1][c] = expand5(code[1][c]);
+        }
+    }
+
+    void fit_individual(float32x8 (*code)[3], float32x8 (*base)[3], const float32x8 (*color)[3])
+    {
+        const float32x8 zero(0.0f);
+
+        for (int s = 0; s < 2; ++s)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                code[s][c] = clamp(round(color[s][c] * (15.0f / 255.0f)), zero, float32x8(15.0f));
+                base[s][c] = code[s][c] * 17.0f;
+            }
+        }
+    }
+
+    // planar mode: color(x, y) = (x * (H - O) + y * (V - O) + 4 * O + 2) >> 2
+
+    struct PlanarFit
+    {
+        float32x8 error;
+        float32x8 code[3][3]; // [channel][O, H, V]
+    };
+
+    float32x8 expand_planar(float32x8 code, int bits)
+    {
+        // 6 and 7 bit codes are expanded to 8 bits with bit replication
+        const float s = float(1 << (8 - bits));
+        const float t = 1.0f / float(1 << (2 * bits - 8));
+        return madd(floor(code * t), code, float32x8(s));
+    }
+
+    float32x8 planar_error(const float32x8* value, float32x8 o, float32x8 h, float32x8 v)
+    {
+        const float32x8 dh = h - o;
+        const float32x8 dv = v - o;
+        const float32x8 center = madd(float32x8(2.0f), o, float32x8(4.0f));
+
+        float32x8 error(0.0f);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float x = float(i & 3);
+            const float y = float(i >> 2);
+            const float32x8 c = floor(madd(madd(center, dh, float32x8(x)), dv, float32x8(y)) * 0.25f);
+            error += square(value[i] - clamp(c, float32x8(0.0f), float32x8(255.0f)));
+        }
+
+        return error;
+    }
+
+    void fit_planar(PlanarFit& fit, const BlockBatch& batch, TextureCompressionQuality quality)
+    {
+        static const int bits[] = { 6, 7, 6 };
+
+        fit.error = float32x8(0.0f);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float32x8* value = batch.channel[c];
+
+            float32x8 mean(0.0f);
+            float32x8 dx(0.0f);
+            float32x8 dy(0.0f);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float x = float(i & 3) - 1.5f;
+                const float y = float(i >> 2) - 1.5f;
+                mean += value[i];
+                dx = madd(dx, value[i], float32x8(x));
+                dy = madd(dy, value[i], float32x8(y));
+            }
+
+            // sum of (x - 1.5)^2 over the block is 20
+            mean = mean * (1.0f / 16.0f);
+            dx = dx * (1.0f / 20.0f);
+            dy = dy * (1.0f / 20.0f);
+
+            const float32x8 o = mean - (dx + dy) * 1.5f;
+            const float32x8 ideal[] = { o, madd(o, dx, float32x8(4.0f)), madd(o, dy, float32x8(4.0f)) };
+
+            const float maximum = float((1 << bits[c]) - 1);
+
+            float32x8 code[3];
+            float32x8 color[3];
+
+            for (int j = 0; j < 3; ++j)
+            {
+                code[j] = clamp(round(ideal[j] * (maximum / 255.0f)), float32x8(0.0f), float32x8(maximum));
+                color[j] = expand_planar(code[j], bits[c]);
+            }
+
+            float32x8 error = planar_error(value, color[0], color[1], color[2]);
+
+            if (quality == TextureCompressionQuality::HIGH)
+            {
+                // coordinate descent over the neighbouring codes
+                for (int j = 0; j < 3; ++j)
+                {
+                    for (int d = -1; d <= 1; d += 2)
+                    {
+                        float32x8 test[3] = { color[0], color[1], color[2] };
+                        const float32x8 tcode = clamp(code[j] + float(d), float32x8(0.0f), float32x8(maximum));
+                        test[j] = expand_planar(tcode, bits[c]);
+
+                        const float32x8 e = planar_error(value, test[0], test[1], test[2]);
+                        const mask32x8 better = e < error;
+
+                        error = select(better, e, error);
+                        code[j] = select(better, tcode, code[j]);
+                        color[j] = select(better, test[j], color[j]);
+                    }
+                }
+            }
+
+            for (int j = 0; j < 3; ++j)
+            {
+                fit.code[c][j] = code[j];
+            }
+
+            fit.error += error;
+        }
+    }
+
+    u64 write_planar(const PlanarFit& fit, int lane)
+    {
+        int code[3][3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                code[c][j] = LaneStorage(fit.code[c][j])[lane];
+            }
+        }
+
+        const u64 ro = code[0][0];
+        const u64 go = code[1][0];
+        const u64 bo = code[2][0];
+
+        u64 data = 0;
+
+        data |= ro << 57;
+        data |= (go >> 6) << 56;
+        data |= (go & 0x3f) << 49;
+        data |= (bo >> 5) << 48;
+        data |= ((bo >> 3) & 3) << 43;
+        data |= (bo & 7) << 39;
+        data |= u64(code[0][1] >> 1) << 34;
+        data |= u64(code[0][1] & 1) << 32;
+        data |= u64(code[1][1]) << 25;
+        data |= u64(code[2][1]) << 19;
+        data |= u64(code[0][2]) << 13;
+        data |= u64(code[1][2]) << 6;
+        data |= u64(code[2][2]) << 0;
+        data |= u64(1) << 33;
+
+        // The planar mode is signaled with the differential bit and an overflowing blue
+        // base + delta; red and green must not overflow. The unused bits are set to get this.
+
+        const int r = int((data >> 59) & 0x1f);
+        const int dr = int((data >> 56) & 7) - (data & (u64(1) << 58) ? 8 : 0);
+        if (r + dr < 0)
+        {
+            data |= u64(1) << 63;
+        }
+
+        const int g = int((data >> 51) & 0x1f);
+        const int dg = int((data >> 48) & 7) - (data & (u64(1) << 50) ? 8 : 0);
+        if (g + dg < 0)
+        {
+            data |= u64(1) << 55;
+        }
+
+        const int b = int((data >> 43) & 3);
+        const int db = int((data >> 40) & 3);
+        if (b + db > 3)
+        {
+            // base 28..31 with a positive delta
+            data |= u64(7) << 45;
+        }
+        else
+        {
+            // base 0..3 with a negative delta
+            data |= u64(1) << 42;
+        }
+
+        return data;
+    }
+
+    void encode_etc2(u8* output, int pitch, const BlockBatch& batch, int count, TextureCompressionQuality quality, const PunchThrough* punch)
+    {
+        ColorFit fit;
+        fit.error = float32x8(std::numeric_limits<float>::max());
+
+        for (int flip = 0; flip < 2; ++flip)
+        {
+            const int (*pixels)[8] = g_etc_subblock[flip];
+
+            // sub-block average colors
+            float32x8 color[2][3];
+
+            for (int s = 0; s < 2; ++s)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    float32x8 sum(0.0f);
+
+                    for (int j = 0; j < 8; ++j)
+                    {
+                        sum += batch.channel[c][pixels[s][j]];
+                    }
+
+                    color[s][c] = sum * (1.0f / 8.0f);
+                }
+
+                if (punch)
+                {
+                    // the transparent pixels do not contribute to the average
+                    float32x8 sum[3] = { float32x8(0.0f), float32x8(0.0f), float32x8(0.0f) };
+                    float32x8 weight(0.0f);
+
+                    for (int j = 0; j < 8; ++j)
+                    {
+                        const int i = pixels[s][j];
+                        const float32x8 w = select(punch->pixel[i], float32x8(0.0f), float32x8(1.0f));
+
+                        sum[0] = madd(sum[0], batch.channel[0][i], w);
+                        sum[1] = madd(sum[1], batch.channel[1][i], w);
+                        sum[2] = madd(sum[2], batch.channel[2][i], w);
+                        weight += w;
+                    }
+
+                    const float32x8 scale = float32x8(1.0f) / max(weight, float32x8(1.0f));
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        color[s][c] = select(punch->transparent, sum[c] * scale, color[s][c]);
+                    }
+                }
+            }
+
+            float32x8 code[2][3];
+            float32x8 base[2][3];
+            SubblockFit subblock[2];
+
+            // differential mode
+            fit_differential(code, base, color);
+            fit_subblock(subblock[0], batch, pixels[0], base[0], punch);
+            fit_subblock(subblock[1], batch, pixels[1], base[1], punch);
+
+            mask32x8 better = (subblock[0].error + subblock[1].error) < fit.error;
+            select_fit(fit, better, float32x8(1.0f), float32x8(float(flip)), code, subblock, pixels);
+
+            if (quality == TextureCompressionQuality::HIGH)
+            {
+                // refit with the base colors which are optimal for the selected modifiers
+                float32x8 refined[2][3];
+                refine_base(refined[0], subblock[0], batch, pixels[0]);
+                refine_base(refined[1], subblock[1], batch, pixels[1]);
+
+                fit_differential(code, base, refined);
+                fit_subblock(subblock[0], batch, pixels[0], base[0], punch);
+                fit_subblock(subblock[1], batch, pixels[1], base[1], punch);
+
+                better = (subblock[0].error + subblock[1].error) < fit.error;
+                select_fit(fit, better, float32x8(1.0f), float32x8(float(flip)), code, subblock, pixels);
+            }
+
+            // individual mode; it is better when the sub-block colors are too far apart for the delta
+            if (punch)
+                continue;
+
+            if (quality == TextureCompressionQuality::FAST)
+            {
+                // only the blocks where the delta was clamped are tried
+                mask32x8 clamped = fit.error < 0.0f;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    const float32x8 delta = round(color[1][c] * (31.0f / 255.0f)) - round(color[0][c] * (31.0f / 255.0f));
+                    clamped = clamped | (delta < -4.0f) | (delta > 3.0f);
+                }
+
+                if (none_of(clamped))
+                    continue;
+            }
+
+            fit_individual(code, base, color);
+            fit_subblock(subblock[0], batch, pixels[0], base[0], punch);
+            fit_subblock(subblock[1], batch, pixels[1], base[1], punch);
+
+            better = (subblock[0].error + subblock[1].error) < fit.error;
+            select_fit(fit, better, float32x8(0.0f), float32x8(float(flip)), code, subblock, pixels);
+        }
+
+        PlanarFit planar;
+        fit_planar(planar, batch, quality);
+
+        mask32x8 planarBetter = planar.error < fit.error;
+
+        if (punch)
+        {
+            planarBetter = planarBetter & punch->opaque;
+        }
+
+        fit.mode = select(planarBetter, float32x8(2.0f), fit.mode);
+        const LaneStorage transparent(punch ? select(punch->transparent, float32x8(1.0f), float32x8(0.0f)) : float32x8(0.0f));
+
+        // write the blocks
+
+        const LaneStorage mode(fit.mode);
+        const LaneStorage flip(fit.flip);
+        const LaneStorage table0(fit.table[0]);
+        const LaneStorage table1(fit.table[1]);
+
+        alignas(32) float code[2][3][BATCH];
+        alignas(32) float selector[16][BATCH];
+
+        for (int s = 0; s < 2; ++s)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                simd::f32x8_ustore(code[s][c], fit.code[s][c]);
+            }
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            simd::f32x8_ustore(selector[i], fit.selector[i]);
+        }
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            u64 data = 0;
+
+            if (mode[lane] == 2)
+            {
+                data = write_planar(planar, lane);
+            }
+            else
+            {
+                const int r0 = int(code[0][0][lane]);
+                const int g0 = int(code[0][1][lane]);
+                const int b0 = int(code[0][2][lane]);
+                const int r1 = int(code[1][0][lane]);
+                const int g1 = int(code[1][1][lane]);
+                const int b1 = int(code[1][2][lane]);
+
+                if (mode[lane] == 1)
+                {
+                    data |= u64(r0) << 59;
+                    data |= u64((r1 - r0) & 7) << 56;
+                    data |= u64(g0) << 51;
+                    data |= u64((g1 - g0) & 7) << 48;
+                    data |= u64(b0) << 43;
+                    data |= u64((b1 - b0) & 7) << 40;
+                    data |= u64(!transparent[lane]) << 33;
+                }
+                else
+                {
+                    data |= u64(r0) << 60;
+                    data |= u64(r1) << 56;
+                    data |= u64(g0) << 52;
+                    data |= u64(g1) << 48;
+                    data |= u64(b0) << 44;
+                    data |= u64(b1) << 40;
+                }
+
+                data |= u64(table0[lane]) << 37;
+                data |= u64(table1[lane]) << 34;
+                data |= u64(flip[lane]) << 32;
+
+                for (int i = 0; i < 16; ++i)
+                {
+                    // the pixels are stored in column-major order
+                    const int p = (i & 3) * 4 + (i >> 2);
+                    const u64 k = u64(selector[i][lane]);
+                    data |= (k & 1) << p;
+                    data |= (k >> 1) << (p + 16);
+                }
+            }
+
+            ustore64be(output, data);
+            output += pitch;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // decoding
+    // ----------------------------------------------------------------------------
+
+    // The row decoder expands the palettes of the two sub-blocks once per block and the
+    // pixels are plain 32 bit palette lookups. The ETC2 T, H and planar modes are rare in
+    // practice; those blocks are passed to the block decoder.
+
+    inline u8 clamp_byte(int value)
+    {
+        return u8(std::max(0, std::min(255, value)));
+    }
+
+    // palette[subblock * 4 + index]; returns false for the ETC2 T, H and planar modes
+    bool decode_etc_palette(u8 (*palette)[4], u64 data, bool etc2)
+    {
+        int base[2][3];
+
+        if (!(data & (1ull << 33)))
+        {
+            // individual mode
+            for (int c = 0; c < 3; ++c)
+            {
+                base[0][c] = u32_extend((data >> (60 - c * 8)) & 0xf, 4, 8);
+                base[1][c] = u32_extend((data >> (56 - c * 8)) & 0xf, 4, 8);
+            }
+        }
+        else
+        {
+            // differential mode
+            for (int c = 0; c < 3; ++c)
+            {
+                const int color = (data >> (59 - c * 8)) & 0x1f;
+                const int delta = s32_extend((data >> (56 - c * 8)) & 0x7, 3);
+
+                if (etc2 && (color + delta < 0 || color + delta > 31))
+                    return false;
+
+                base[0][c] = u32_extend(color, 5, 8);
+                base[1][c] = u8(u32_extend(color + delta, 5, 8));
+            }
+        }
+
+        const int table[2] = { int(data >> 37) & 7, int(data >> 34) & 7 };
+
+        for (int subblock = 0; subblock < 2; ++subblock)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                const int modifier = g_etc_modifier[table[subblock]][k];
+                u8* color = palette[subblock * 4 + k];
+                color[0] = clamp_byte(base[subblock][0] + modifier);
+                color[1] = clamp_byte(base[subblock][1] + modifier);
+                color[2] = clamp_byte(base[subblock][2] + modifier);
+                color[3] = 0xff;
+            }
+        }
+
+        return true;
+    }
+
+    void decode_etc_color(u8* output, int stride, const u8 (*palette)[4], u64 data)
+    {
+        const int flip = (data >> 32) & 1;
+
+        for (int y = 0; y < 4; ++y)
+        {
+            u8* dest = output + y * stride;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const int p = x * 4 + y;
+                const int subblock = (flip ? y : x) >> 1;
+                const int index = ((data >> p) & 1) | (((data >> (p + 16)) & 1) << 1);
+                std::memcpy(dest + x * 4, palette[subblock * 4 + index], 4);
+            }
+        }
+    }
+
+    void decode_eac_alpha(u8* output, int stride, u64 data)
+    {
+        const int base = int(data >> 56);
+        const int multiplier = (data >> 52) & 0xf;
+        const int* modifier = g_eac_modifier[(data >> 48) & 0xf];
+
+        u8 palette[8];
+
+        for (int k = 0; k < 8; ++k)
+        {
+            palette[k] = clamp_byte(base + multiplier * modifier[k]);
+        }
+
+        for (int y = 0; y < 4; ++y)
+        {
+            u8* dest = output + y * stride + 3;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const int p = x * 4 + y;
+                dest[x * 4] = palette[(data >> (45 - p * 3)) & 7];
+            }
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // batch encoders
+    // ----------------------------------------------------------------------------
+
+    // The input is a row of blocks in R8G8B8A8 format; count blocks are encoded.
+
+    void encode_blocks_etc2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        const bool alphaMode = info.compression == TextureCompression::ETC2_RGB_ALPHA1 ||
+                               info.compression == TextureCompression::ETC2_SRGB_ALPHA1;
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+
+            if (alphaMode)
+            {
+                const PunchThrough punch(batch);
+                encode_etc2(output, 8, batch, std::min(count, BATCH), quality, &punch);
+            }
+            else
+            {
+                encode_etc2(output, 8, batch, std::min(count, BATCH), quality, nullptr);
+            }
+
+            input += BATCH * 16;
+            output += BATCH * 8;
+        }
+    }
+
+    void encode_blocks_etc2_eac(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count);
+            encode_eac(output + 0, 16, batch.channel[3], std::min(count, BATCH), quality, 1.0f, 0.0f, 255.0f);
+            encode_etc2(output + 8, 16, batch, std::min(count, BATCH), quality, nullptr);
+            input += BATCH * 16;
+            output += BATCH * 16;
+        }
+    }
+
+    // The input is a row of blocks in RGBA32F format; the channels are encoded with 11 bits.
+
+    void encode_blocks_eac_r11(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count, 2047.0f);
+            encode_eac(output, 8, batch.channel[0], std::min(count, BATCH), quality, 8.0f, 4.0f, 2047.0f);
+            input += BATCH * 64;
+            output += BATCH * 8;
+        }
+    }
+
+    void encode_blocks_eac_rg11(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count, TextureCompressionQuality quality)
+    {
+        MANGO_UNREFERENCED(info);
+
+        for ( ; count > 0; count -= BATCH)
+        {
+            BlockBatch batch(input, stride, count, 2047.0f);
+            encode_eac(output + 0, 16, batch.channel[0], std::min(count, BATCH), quality, 8.0f, 4.0f, 2047.0f);
+            encode_eac(output + 8, 16, batch.channel[1], std::min(count, BATCH), quality, 8.0f, 4.0f, 2047.0f);
+            input += BATCH * 64;
+            output += BATCH * 16;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // row decoders
+    // ----------------------------------------------------------------------------
+
+    void decode_blocks_etc1(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        MANGO_UNREFERENCED(info);
+
+        u8 palette[8][4];
+
+        for (int i = 0; i < count; ++i)
+        {
+            const u64 data = uload64be(input);
+            decode_etc_palette(palette, data, false);
+            decode_etc_color(output, stride, palette, data);
+            output += 16;
+            input += 8;
+        }
+    }
+
+#ifdef MANGO_ENABLE_LICENSE_APACHE
+
+    void decode_blocks_etc2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        u8 palette[8][4];
+
+        for (int i = 0; i < count; ++i)
+        {
+            const u64 data = uload64be(input);
+
+            if (decode_etc_palette(palette, data, true))
+            {
+                decode_etc_color(output, stride, palette, data);
+            }
+            else
+            {
+                decode_block_etc2(info, output, input, stride);
+            }
+
+            output += 16;
+            input += 8;
+        }
+    }
+
+    void decode_blocks_etc2_eac(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        u8 palette[8][4];
+
+        for (int i = 0; i < count; ++i)
+        {
+            const u64 data = uload64be(input + 8);
+
+            if (decode_etc_palette(palette, data, true))
+            {
+                decode_etc_color(output, stride, palette, data);
+            }
+            else
+            {
+                decode_block_etc2(info, output, input + 8, stride);
+            }
+
+            decode_eac_alpha(output, stride, uload64be(input));
+            output += 16;
+            input += 16;
+        }
+    }
+
+#endif // MANGO_ENABLE_LICENSE_APACHE
+
+} // namespace mango
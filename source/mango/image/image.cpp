@@ -2,7 +2,10 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <algorithm>
+#include <cstring>
 #include <map>
+#include <unordered_map>
 #include <mango/core/string.hpp>
 #include <mango/core/timer.hpp>
 #include <mango/image/image.hpp>
@@ -75,8 +78,34 @@ namespace mango
     class ImageServer
     {
     protected:
-        std::map<std::string, ImageDecoder::CreateDecoderFunc> m_decoders;
+        struct Signature
+        {
+            std::string magic;
+            u32 offset;
+            std::string extension;
+            ImageDecoder::CreateDecoderFunc func;
+
+            bool match(ConstMemory memory) const
+            {
+                const size_t size = magic.length();
+                return memory.size >= offset + size && !std::memcmp(memory.address + offset, magic.data(), size);
+            }
+        };
+
+        // Signatures shorter than this can occur by chance in the formats which do not
+        // have one; those are confirmed with the extension.
+        static constexpr size_t STRONG_SIGNATURE = 4;
+
+        std::unordered_map<std::string, ImageDecoder::CreateDecoderFunc> m_decoders;
+        std::vector<Signature> m_signatures;
+
+        // signatures at offset zero indexed with the first byte; the others are always tested
+        std::vector<u16> m_signature_table[256];
+        std::vector<u16> m_signature_offset;
+
         std::map<std::string, ImageEncoder::EncodeFunc> m_encoders;
+        std::map<std::string, ImageEncoder::EncodeCompressedFunc> m_compressed_encoders;
+        std::map<std::string, AnimationEncoder::CreateEncoderFunc> m_animation_encoders;
 
     public:
         ImageServer()
@@ -156,11 +185,42 @@ namespace mango
             m_decoders[toLower(extension)] = func;
         }
 
+        void registerImageSignature(const std::string& extension, const std::string& magic, u32 offset)
+        {
+            auto i = m_decoders.find(toLower(extension));
+            if (i == m_decoders.end() || magic.empty())
+            {
+                return;
+            }
+
+            u16 index = u16(m_signatures.size());
+            m_signatures.push_back({ magic, offset, i->first, i->second });
+
+            if (offset)
+            {
+                m_signature_offset.push_back(index);
+            }
+            else
+            {
+                m_signature_table[u8(magic[0])].push_back(index);
+            }
+        }
+
         void registerImageEncoder(ImageEncoder::EncodeFunc func, const std::string& extension)
         {
             m_encoders[toLower(extension)] = func;
         }
 
+        void registerImageEncoder(ImageEncoder::EncodeCompressedFunc func, const std::string& extension)
+        {
+            m_compressed_encoders[toLower(extension)] = func;
+        }
+
+        void registerAnimationEncoder(AnimationEncoder::CreateEncoderFunc func, const std::string& extension)
+        {
+            m_animation_encoders[toLower(extension)] = func;
+        }
+
         ImageDecoder::CreateDecoderFunc getImageDecoder(const std::string& extension) const
         {
             auto i = m_decoders.find(getLowerCaseExtension(extension));
@@ -172,6 +232,79 @@ namespace mango
             return nullptr;
         }
 
+        const Signature* findSignature(ConstMemory memory) const
+        {
+            const Signature* best = nullptr;
+
+            auto test = [&] (u16 index)
+            {
+                const Signature& signature = m_signatures[index];
+                if (signature.match(memory) && (!best || signature.magic.length() > best->magic.length()))
+                {
+                    best = &signature;
+                }
+            };
+
+            if (memory.size > 0)
+            {
+                for (u16 index : m_signature_table[memory.address[0]])
+                {
+                    test(index);
+                }
+            }
+
+            for (u16 index : m_signature_offset)
+            {
+                test(index);
+            }
+
+            return best;
+        }
+
+        bool hasSignature(ImageDecoder::CreateDecoderFunc func) const
+        {
+            for (auto& signature : m_signatures)
+            {
+                if (signature.func == func)
+                    return true;
+            }
+
+            return false;
+        }
+
+        // The decoder is selected from the content; the extension decides only when
+        // the content does not have a strong signature.
+        ImageDecoder::CreateDecoderFunc getImageDecoder(ConstMemory memory, const std::string& filename, std::string* extension) const
+        {
+            const Signature* signature = findSignature(memory);
+
+            if (signature && signature->magic.length() >= STRONG_SIGNATURE)
+            {
+                if (extension)
+                    *extension = signature->extension;
+                return signature->func;
+            }
+
+            std::string lower = getLowerCaseExtension(filename);
+
+            auto i = m_decoders.find(lower);
+            if (i != m_decoders.end() && (!signature || !hasSignature(i->second)))
+            {
+                if (extension)
+                    *extension = lower;
+                return i->second;
+            }
+
+            if (signature)
+            {
+                if (extension)
+                    *extension = signature->extension;
+                return signature->func;
+            }
+
+            return nullptr;
+        }
+
         ImageEncoder::EncodeFunc getImageEncoder(const std::string& extension) const
         {
             auto i = m_encoders.find(getLowerCaseExtension(extension));
@@ -182,6 +315,28 @@ namespace mango
 
             return nullptr;
         }
+
+        ImageEncoder::EncodeCompressedFunc getCompressedImageEncoder(const std::string& extension) const
+        {
+            auto i = m_compressed_encoders.find(getLowerCaseExtension(extension));
+            if (i != m_compressed_encoders.end())
+            {
+                return i->second;
+            }
+
+            return nullptr;
+        }
+
+        AnimationEncoder::CreateEncoderFunc getAnimationEncoder(const std::string& extension) const
+        {
+            auto i = m_animation_encoders.find(getLowerCaseExtension(extension));
+            if (i != m_animation_encoders.end())
+            {
+                return i->second;
+            }
+
+            return nullptr;
+        }
     } g_imageServer;
 
     void registerImageDecoder(ImageDecoder::CreateDecoderFunc func, const std::string& extension)
@@ -189,23 +344,64 @@ namespace mango
         g_imageServer.registerImageDecoder(func, extension);
     }
 
+    void registerImageSignature(const std::string& extension, const std::string& magic, u32 offset)
+    {
+        g_imageServer.registerImageSignature(extension, magic, offset);
+    }
+
     void registerImageEncoder(ImageEncoder::EncodeFunc func, const std::string& extension)
     {
         g_imageServer.registerImageEncoder(func, extension);
     }
 
+    void registerImageEncoder(ImageEncoder::EncodeCompressedFunc func, const std::string& extension)
+    {
+        g_imageServer.registerImageEncoder(func, extension);
+    }
+
+    void registerAnimationEncoder(AnimationEncoder::CreateEncoderFunc func, const std::string& extension)
+    {
+        g_imageServer.registerAnimationEncoder(func, extension);
+    }
+
     bool isImageDecoder(const std::string& extension)
     {
         auto func = g_imageServer.getImageDecoder(extension);
         return func != nullptr;
     }
 
+    std::string detectImageFormat(ConstMemory memory)
+    {
+        std::string extension;
+        g_imageServer.getImageDecoder(memory, std::string(), &extension);
+        return extension;
+    }
+
+    std::string detectImageFormat(ConstMemory memory, const std::string& filename)
+    {
+        std::string extension;
+        g_imageServer.getImageDecoder(memory, filename, &extension);
+        return extension;
+    }
+
     bool isImageEncoder(const std::string& extension)
     {
         auto func = g_imageServer.getImageEncoder(extension);
         return func != nullptr;
     }
 
+    bool isCompressedImageEncoder(const std::string& extension)
+    {
+        auto func = g_imageServer.getCompressedImageEncoder(extension);
+        return func != nullptr;
+    }
+
+    bool isAnimationEncoder(const std::string& extension)
+    {
+        auto func = g_imageServer.getAnimationEncoder(extension);
+        return func != nullptr;
+    }
+
     // ----------------------------------------------------------------------------
     // ImageDecoderInterface
     // ----------------------------------------------------------------------------
@@ -228,13 +424,23 @@ namespace mango
         return ConstMemory();
     }
 
+    bool ImageDecoderInterface::crop()
+    {
+        return false;
+    }
+
+    bool ImageDecoderInterface::orientation()
+    {
+        return false;
+    }
+
     // ----------------------------------------------------------------------------
     // ImageDecoder
     // ----------------------------------------------------------------------------
 
     ImageDecoder::ImageDecoder(ConstMemory memory, const std::string& filename)
     {
-        ImageDecoder::CreateDecoderFunc create_decoder_func = g_imageServer.getImageDecoder(filename);
+        ImageDecoder::CreateDecoderFunc create_decoder_func = g_imageServer.getImageDecoder(memory, filename, nullptr);
         if (create_decoder_func)
         {
             ImageDecoderInterface* x = create_decoder_func(memory);
@@ -267,17 +473,77 @@ namespace mango
         return header;
     }
 
+    static int getOrientation(ConstMemory exif_memory)
+    {
+        if (exif_memory.address)
+        {
+            image::Exif exif(exif_memory);
+            if (exif.Orientation >= 1 && exif.Orientation <= 8)
+            {
+                return exif.Orientation;
+            }
+        }
+
+        return 1;
+    }
+
     ImageDecodeStatus ImageDecoder::decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face)
     {
         ImageDecodeStatus status;
 
+        int orientation = 1;
+
+        if (m_interface && options.orientation && !m_interface->orientation())
+        {
+            orientation = getOrientation(m_interface->exif());
+        }
+
         if (!m_interface)
         {
             status.setError("[WARNING] ImageDecoder::decode() is not supported for this extension.");
         }
+        else if (orientation != 1)
+        {
+            // fallback: decode in the stored orientation and copy with the orientation applied
+            ImageHeader header = m_interface->header();
+
+            ImageDecodeOptions temp_options = options;
+            temp_options.orientation = false;
+
+            int width = header.width;
+            int height = header.height;
+
+            if (options.isCropped())
+            {
+                width = std::max(0, std::min(header.width, options.crop_x + options.crop_width) - std::max(0, options.crop_x));
+                height = std::max(0, std::min(header.height, options.crop_y + options.crop_height) - std::max(0, options.crop_y));
+            }
+
+            Bitmap temp(width, height, dest.format);
+            status = decode(temp, temp_options, level, depth, face);
+
+            dest.orient(temp, orientation);
+            status.direct = false;
+        }
+        else if (options.isCropped() && !m_interface->crop())
+        {
+            // fallback: decode the whole image and copy the crop rectangle
+            ImageHeader header = m_interface->header();
+
+            ImageDecodeOptions temp_options = options;
+            temp_options.crop_width = 0;
+            temp_options.crop_height = 0;
+
+            Bitmap temp(header.width, header.height, dest.format);
+            status = m_interface->decode(temp, temp_options, level, depth, face);
+
+            Surface rect(temp, options.crop_x, options.crop_y, options.crop_width, options.crop_height);
+            dest.blit(0, 0, rect);
+            status.direct = false;
+        }
         else
         {
-            status = m_interface->decode(dest, options.palette, level, depth, face);
+            status = m_interface->decode(dest, options, level, depth, face);
         }
 
         return status;
@@ -319,6 +585,41 @@ namespace mango
         return memory;
     }
 
+    // ----------------------------------------------------------------------------
+    // CompressedImage
+    // ----------------------------------------------------------------------------
+
+    CompressedImage::CompressedImage(ImageDecoder& decoder)
+    {
+        ImageHeader header = decoder.header();
+        if (header.success && header.compression != TextureCompression::NONE)
+        {
+            width = header.width;
+            height = header.height;
+            levels = std::max(1, header.levels);
+            faces = std::max(1, header.faces);
+            compression = header.compression;
+
+            memory = [&decoder] (int level, int face)
+            {
+                return decoder.memory(level, 0, face);
+            };
+        }
+    }
+
+    size_t CompressedImage::getLevelSize(int level) const
+    {
+        TextureCompressionInfo info(compression);
+        if (!info.width || !info.height)
+            return 0;
+
+        const int xsize = std::max(1, width >> level);
+        const int ysize = std::max(1, height >> level);
+        const int xblocks = ceil_div(xsize, info.width);
+        const int yblocks = ceil_div(ysize, info.height);
+        return size_t(xblocks) * yblocks * info.bytes;
+    }
+
     // ----------------------------------------------------------------------------
     // ImageEncoder
     // ----------------------------------------------------------------------------
@@ -326,6 +627,7 @@ namespace mango
     ImageEncoder::ImageEncoder(const std::string& extension)
     {
         m_encode_func = g_imageServer.getImageEncoder(extension);
+        m_encode_compressed_func = g_imageServer.getCompressedImageEncoder(extension);
     }
 
     ImageEncoder::~ImageEncoder()
@@ -353,4 +655,39 @@ namespace mango
         return status;
     }
 
+    bool ImageEncoder::isCompressedEncoder() const
+    {
+        return m_encode_compressed_func != nullptr;
+    }
+
+    ImageEncodeStatus ImageEncoder::encode(Stream& output, const CompressedImage& source)
+    {
+        ImageEncodeStatus status;
+
+        if (!m_encode_compressed_func)
+        {
+            status.setError("[WARNING] ImageEncoder::encode() does not support compressed images for this extension.");
+        }
+        else if (source.compression == TextureCompression::NONE || !source.memory)
+        {
+            status.setError("[WARNING] ImageEncoder::encode() requires compressed image data.");
+        }
+        else
+        {
+            status = m_encode_compressed_func(output, source);
+        }
+
+        return status;
+    }
+
+    // ----------------------------------------------------------------------------
+    // AnimationEncoder
+    // ----------------------------------------------------------------------------
+
+    AnimationEncoder::AnimationEncoder(Stream& output, const std::string& extension, int width, int height,
+                                       const ImageEncodeOptions& options)
+        : AnimationEncoder(output, g_imageServer.getAnimationEncoder(extension), width, height, options)
+    {
+    }
+
 } // namespace mango
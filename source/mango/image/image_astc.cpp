@@ -132,9 +132,9 @@ namespace
             return m_data;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -176,6 +176,7 @@ namespace mango
     void registerImageDecoderASTC()
     {
         registerImageDecoder(createInterface, ".astc");
+        registerImageSignature(".astc", "\x13\xab\xa1\x5c");
     }
 
 } // namespace mango
@@ -5,6 +5,7 @@
 //#define MANGO_ENABLE_DEBUG_PRINT
 
 #include <mango/core/pointer.hpp>
+#include <mango/core/buffer.hpp>
 #include <mango/core/system.hpp>
 #include <mango/image/image.hpp>
 
@@ -474,238 +475,252 @@ namespace
     // .bmp decoder
     // ------------------------------------------------------------
 
-    void readRLE4(Surface& surface, const BitmapHeader& header, int stride, const u8* data)
+    // Run-length decoded scanlines are written straight into the destination when it
+    // has the decoded format; otherwise one scanline is staged and converted.
+    struct ScanlineWriter
     {
-        MANGO_UNREFERENCED(stride);
-
-        int x = 0;
+        const Surface& surface;
+        const Blitter* blitter = nullptr;
+        Buffer buffer;
+        const u8* background;
+        int bytes;
+        int width;
+        int height;
+        int xsize;
         int y = 0;
-        int offset = 0;
+        u8* scan = nullptr;
+
+        ScanlineWriter(const Surface& surface, const Format& format, int width, int height, const u8* background)
+            : surface(surface)
+            , background(background)
+            , bytes(format.bytes())
+            , width(width)
+            , height(std::min(height, surface.height))
+            , xsize(std::min(width, surface.width))
+        {
+            if (surface.format != format || surface.width < width)
+            {
+                blitter = &getBlitter(surface.format, format);
+                buffer.resize(width * bytes);
+            }
 
-        while (y < header.height)
+            begin();
+        }
+
+        bool done() const
         {
-            u8* image = surface.address<u8>(0, y);
+            return y >= height;
+        }
 
-            if (x >= header.width)
+        void begin()
+        {
+            if (!done())
             {
-                x = 0;
+                scan = blitter ? buffer.data() : surface.address(0, y);
+                fillPixels(scan, background, bytes, width);
             }
+        }
 
-            u8 n = data[offset + 0];
-            u8 c = data[offset + 1];
-            offset += 2;
-
-            if (n > 0)
+        void next()
+        {
+            if (!done())
             {
-                // RLE run
-                int ad = 4;
-                while (n--)
+                if (blitter)
                 {
-                    image[x++] = (c >> ad) & 0xf;
-                    ad = 4 - ad;
+                    blitter->convert(surface.address(0, y), scan, xsize);
                 }
+
+                ++y;
+                begin();
             }
-            else
-            {
-                switch (c)
-                {
-                    case 0:
-                        // end of scanline
-                        x = 0;
-                        ++y;
-                        break;
+        }
 
-                    case 1:
-                        // end of image
-                        y = header.height;
-                        break;
+        u8* address(int x) const
+        {
+            return scan + x * bytes;
+        }
+    };
 
-                    case 2:
-                    {
-                        // position delta
-                        int dx = data[offset + 0];
-                        int dy = data[offset + 1];
-                        offset += 2;
-                        x += dx;
-                        y += dy;
-                        break;
-                    }
+    // Decode RLE4, RLE8 and the OS/2 RLE24 compression. The palette indices are
+    // expanded while decoding unless the caller wants them; the pixels skipped with
+    // the delta and end codes are left in the first palette color (index 0).
+    void readRLE(const Surface& surface, const BitmapHeader& header, const u8* data, const u8* end, const Palette* palette)
+    {
+        const int bits = header.bitsPerPixel;
+        const int width = header.width;
 
-                    default:
-                    {
-                        // linear imagedata
-                        int offset0 = offset;
-                        int count = c >> 1;
+        Format format = FORMAT_B8G8R8;
+        const u8* background = nullptr;
 
-                        while (count-- > 0)
-                        {
-                            u8 s = data[offset++];
-                            image[x++] = s >> 4;
-                            image[x++] = s & 0xf;
-                        }
+        const u8 zero[4] = { 0, 0, 0, 0 };
+        u8 color[3];
 
-                        if (c & 1)
-                        {
-                            u8 s = data[offset++];
-                            image[x++] = s >> 4;
-                        }
-
-                        int padding = (offset - offset0) & 1;
-                        offset += padding;
-                        break;
-                    }
-                }
-            }
+        if (bits == 24)
+        {
+            background = zero;
+        }
+        else if (palette)
+        {
+            format = FORMAT_B8G8R8A8;
+            background = palette->color[0].component;
+        }
+        else
+        {
+            format = FORMAT_L8;
+            background = zero;
         }
-    }
 
-    void readRLE8(Surface& surface, const BitmapHeader& header, int stride, const u8* data)
-    {
-        MANGO_UNREFERENCED(stride);
+        ScanlineWriter writer(surface, format, width, header.height, background);
 
         int x = 0;
-        int y = 0;
 
-        while (y < header.height)
+        while (!writer.done() && end - data >= 2)
         {
-            u8* image = surface.address<u8>(0, y);
+            int n = data[0];
 
-            if (x >= header.width)
+            if (n)
             {
-                x = 0;
-            }
-
-            u8 n = data[0];
-            u8 c = data[1];
-            data += 2;
+                // run
+                const int count = std::min(n, width - x);
 
-            if (n > 0)
-            {
-                // RLE run
-                while (n--)
-                {
-                    image[x++] = c;
-                }
-            }
-            else
-            {
-                switch (c)
+                if (bits == 24)
                 {
-                    case 0:
-                        // end of scanline
-                        x = 0;
-                        ++y;
+                    if (end - data < 4)
                         break;
 
-                    case 1:
-                        // end of image
-                        y = header.height;
-                        break;
+                    color[0] = data[3];
+                    color[1] = data[2];
+                    color[2] = data[1];
+                    data += 4;
 
-                    case 2:
+                    fillPixels(writer.address(x), color, 3, count);
+                }
+                else
+                {
+                    const u8 c = data[1];
+                    data += 2;
+
+                    if (bits == 8 || (c >> 4) == (c & 0xf))
                     {
-                        // position delta
-                        int dx = data[0];
-                        int dy = data[1];
-                        data += 2;
-                        x += dx;
-                        y += dy;
-                        break;
+                        u8 index = bits == 8 ? c : c & 0xf;
+                        if (palette)
+                        {
+                            fillPixels(writer.address(x), palette->color[index].component, 4, count);
+                        }
+                        else
+                        {
+                            std::memset(writer.address(x), index, count);
+                        }
                     }
-
-                    default:
+                    else
                     {
-                        // linear imagedata
-                        for (int i = 0; i < c; ++i)
+                        // alternating indices
+                        for (int i = 0; i < count; ++i)
                         {
-                            image[x++] = data[i];
+                            u8 index = (i & 1) ? c & 0xf : c >> 4;
+                            if (palette)
+                            {
+                                std::memcpy(writer.address(x + i), palette->color[index].component, 4);
+                            }
+                            else
+                            {
+                                *writer.address(x + i) = index;
+                            }
                         }
-                        data += c;
-                        data += (c & 1); // skip padding byte
-                        break;
                     }
                 }
-            }
-        }
-    }
-
-    void readRLE24(const Surface& surface, const BitmapHeader& header, const u8* data)
-    {
-        int x = 0;
-        int y = 0;
 
-        while (y < header.height)
-        {
-            u8* image = surface.address<u8>(0, y);
-
-            if (x >= header.width)
-            {
-                x = 0;
+                x += count;
+                continue;
             }
 
-            u8 n = data[0];
-            ++data;
+            const int c = data[1];
+            data += 2;
 
-            if (n)
+            switch (c)
             {
-                u8 r = data[0];
-                u8 g = data[1];
-                u8 b = data[2];
-                data += 3;
+                case 0:
+                    // end of scanline
+                    writer.next();
+                    x = 0;
+                    break;
 
-                // RLE run
-                while (n--)
-                {
-                    image[x * 3 + 0] = b;
-                    image[x * 3 + 1] = g;
-                    image[x * 3 + 2] = r;
-                    ++x;
-                }
-            }
-            else
-            {
-                n = data[0];
-                ++data;
+                case 1:
+                    // end of image
+                    while (!writer.done())
+                    {
+                        writer.next();
+                    }
+                    break;
 
-                switch (n)
+                case 2:
                 {
-                    case 0:
-                        // end of scanline
-                        x = 0;
-                        ++y;
+                    // position delta
+                    if (end - data < 2)
+                    {
+                        data = end;
                         break;
+                    }
 
-                    case 1:
-                        // end of image
-                        y = header.height;
-                        break;
+                    x = std::min(x + data[0], width);
+                    for (int dy = data[1]; dy > 0; --dy)
+                    {
+                        writer.next();
+                    }
 
-                    case 2:
+                    data += 2;
+                    break;
+                }
+
+                default:
+                {
+                    // literal pixels; padded to 16 bits
+                    const int bytes = bits == 24 ? c * 3 : bits == 8 ? c : (c + 1) / 2;
+                    if (end - data < bytes)
                     {
-                        // position delta
-                        x += data[0];
-                        y += data[1];
-                        data += 2;
+                        data = end;
                         break;
                     }
 
-                    default:
+                    const int count = std::min(c, width - x);
+                    u8* dest = writer.address(x);
+
+                    for (int i = 0; i < count; ++i)
                     {
-                        // linear imagedata
-                        for (int i = 0; i < n; ++i)
+                        if (bits == 24)
                         {
-                            image[x * 3 + 0] = data[2];
-                            image[x * 3 + 1] = data[1];
-                            image[x * 3 + 2] = data[0];
-                            data += 3;
-                            ++x;
+                            dest[0] = data[i * 3 + 2];
+                            dest[1] = data[i * 3 + 1];
+                            dest[2] = data[i * 3 + 0];
+                            dest += 3;
+                        }
+                        else
+                        {
+                            u8 index = bits == 8 ? data[i] : (data[i >> 1] >> ((~i & 1) * 4)) & 0xf;
+                            if (palette)
+                            {
+                                std::memcpy(dest, palette->color[index].component, 4);
+                                dest += 4;
+                            }
+                            else
+                            {
+                                *dest++ = index;
+                            }
                         }
-                        data += ((n * 3) & 1); // skip padding byte
-                        break;
                     }
+
+                    x += count;
+                    data += bytes + (bytes & 1);
+                    break;
                 }
             }
         }
+
+        // truncated data; the remaining scanlines are background
+        while (!writer.done())
+        {
+            writer.next();
+        }
     }
 
     void readIndexed(Surface& surface, const BitmapHeader& header, int stride, const u8* data)
@@ -797,6 +812,7 @@ namespace
 
         const int stride = ((header.bitsPerPixel * header.width + 31) / 32) * 4;
         const u8* data = memory.address + offset;
+        const u8* end = memory.address + memory.size;
 
         Surface mirror = surface;
 
@@ -816,7 +832,7 @@ namespace
 
             if (header.compression == BIC_JPEG)
             {
-                readRLE24(mirror, header, data);
+                readRLE(mirror, header, data, end, nullptr);
                 return std::move(header);
             }
         }
@@ -866,37 +882,16 @@ namespace
             }
 
             case BIC_RLE8:
-            {
-                if (ptr_palette)
-                {
-                    *ptr_palette = palette;
-                    std::memset(surface.image, 0, surface.width * surface.height);
-                    readRLE8(mirror, header, stride, data);
-                }
-                else
-                {
-                    Bitmap temp(header.width, header.height, FORMAT_L8);
-                    std::memset(temp.image, 0, temp.width * temp.height);
-                    readRLE8(temp, header, stride, data);
-                    blitPalette(mirror, temp, palette);
-                }
-                break;
-            }
-
             case BIC_RLE4:
             {
                 if (ptr_palette)
                 {
                     *ptr_palette = palette;
-                    std::memset(surface.image, 0, surface.width * surface.height);
-                    readRLE4(mirror, header, stride, data);
+                    readRLE(mirror, header, data, end, nullptr);
                 }
                 else
                 {
-                    Bitmap temp(header.width, header.height, FORMAT_L8);
-                    std::memset(temp.image, 0, temp.width * temp.height);
-                    readRLE4(temp, header, stride, data);
-                    blitPalette(mirror, temp, palette);
+                    readRLE(mirror, header, data, end, &palette);
                 }
                 break;
             }
@@ -1196,8 +1191,10 @@ namespace
             return m_image_header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -1333,6 +1330,8 @@ namespace mango
         registerImageDecoder(createInterface, ".bmp");
         registerImageDecoder(createInterface, ".ico");
         registerImageDecoder(createInterface, ".cur");
+        registerImageSignature(".bmp", "BM");
+        // ICO and CUR headers are valid TGA headers; they are selected by the extension
         registerImageEncoder(imageEncode, ".bmp");
     }
 
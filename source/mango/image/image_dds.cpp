@@ -939,6 +939,16 @@ namespace
                     return;
             }
 
+            // ASTC has no FourCC which the decoder understands; use the block format directly
+            const TextureCompressionInfo info = dxgi::getTextureCompression(header10.dxgiFormat);
+            if (info.getCompressionFormat() == TextureCompressionInfo::ASTC)
+            {
+                pixelFormat.format = FORMAT_R8G8B8A8;
+                pixelFormat.compression = info.compression;
+                pixelFormat.fourCC = 0;
+                return;
+            }
+
             const FormatDXGI& dxgi = g_dxgi_table[header10.dxgiFormat];
 
             if (dxgi.fourcc)
@@ -1088,9 +1098,9 @@ namespace
             return m_header.getMemory(level, depth, face);
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
 
             ImageDecodeStatus status;
 
@@ -1143,6 +1153,136 @@ namespace
         return x;
     }
 
+    // ------------------------------------------------------------
+    // ImageEncoder
+    // ------------------------------------------------------------
+
+    // The legacy formats are stored with FourCC so that older readers can load them;
+    // everything else goes through the DX10 extension header.
+    u32 compression_to_fourcc(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_ALPHA1:
+                return FOURCC_DXT1;
+            case TextureCompression::DXT3:
+                return FOURCC_DXT3;
+            case TextureCompression::DXT5:
+                return FOURCC_DXT5;
+            case TextureCompression::RGTC1_RED:
+                return FOURCC_BC4U;
+            case TextureCompression::RGTC1_SIGNED_RED:
+                return FOURCC_BC4S;
+            case TextureCompression::RGTC2_RG:
+                return FOURCC_ATI2;
+            case TextureCompression::RGTC2_SIGNED_RG:
+                return FOURCC_BC5S;
+            default:
+                return 0;
+        }
+    }
+
+    ImageEncodeStatus imageEncodeCompressed(Stream& stream, const CompressedImage& image)
+    {
+        ImageEncodeStatus status;
+
+        const TextureCompressionInfo info(image.compression);
+        const u32 fourcc = compression_to_fourcc(image.compression);
+
+        if (!fourcc && !info.dxgi)
+        {
+            status.setError("[ImageEncoder.DDS] Compression format is not supported.");
+            return status;
+        }
+
+        if (image.faces != 1 && image.faces != 6)
+        {
+            status.setError("[ImageEncoder.DDS] Incorrect number of faces.");
+            return status;
+        }
+
+        const bool cubemap = image.faces == 6;
+        const bool mipmap = image.levels > 1;
+
+        u32 flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+        u32 caps = DDSCAPS_TEXTURE;
+        u32 caps2 = 0;
+
+        if (mipmap)
+        {
+            flags |= DDSD_MIPMAPCOUNT;
+            caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+        }
+
+        if (cubemap)
+        {
+            caps |= DDSCAPS_COMPLEX;
+            caps2 |= DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+        }
+
+        LittleEndianStream s(stream);
+
+        s.write32(FOURCC_DDS);
+        s.write32(124);
+        s.write32(flags);
+        s.write32(image.height);
+        s.write32(image.width);
+        s.write32(u32(image.getLevelSize(0)));
+        s.write32(0); // depth
+        s.write32(image.levels);
+
+        for (int i = 0; i < 11; ++i)
+        {
+            s.write32(0); // reserved
+        }
+
+        // pixel format
+        s.write32(32);
+        s.write32(DDPF_FOURCC | (image.compression == TextureCompression::DXT1_ALPHA1 ? DDPF_ALPHAPIXELS : 0));
+        s.write32(fourcc ? fourcc : u32(FOURCC_DX10));
+        s.write32(0); // rgbBitCount
+        s.write32(0); // rBitMask
+        s.write32(0); // gBitMask
+        s.write32(0); // bBitMask
+        s.write32(0); // aBitMask
+
+        s.write32(caps);
+        s.write32(caps2);
+        s.write32(0); // caps3
+        s.write32(0); // caps4
+        s.write32(0); // reserved
+
+        if (!fourcc)
+        {
+            s.write32(info.dxgi);
+            s.write32(3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+            s.write32(cubemap ? 0x4 : 0); // D3D10_RESOURCE_MISC_TEXTURECUBE
+            s.write32(1); // arraySize
+            s.write32(0); // reserved
+        }
+
+        // the level data is stored face by face
+        for (int face = 0; face < image.faces; ++face)
+        {
+            for (int level = 0; level < image.levels; ++level)
+            {
+                const size_t bytes = image.getLevelSize(level);
+                ConstMemory memory = image.memory(level, face);
+
+                if (memory.size < bytes)
+                {
+                    status.setError("[ImageEncoder.DDS] Not enough level data (level: %d, face: %d).", level, face);
+                    return status;
+                }
+
+                s.write(memory.address, bytes);
+            }
+        }
+
+        return status;
+    }
+
 } // namespace
 
 namespace mango
@@ -1151,6 +1291,8 @@ namespace mango
     void registerImageDecoderDDS()
     {
         registerImageDecoder(createInterface, ".dds");
+        registerImageSignature(".dds", "DDS ");
+        registerImageEncoder(imageEncodeCompressed, ".dds");
     }
 
 } // namespace mango
@@ -4,13 +4,15 @@
 */
 /*
 	The lzw_decode() function is based on Jean-Marc Lienher / STB decoder.
-	The symbol resolver is iterative instead of recursive as in the original.
+	The code table stores the location and length of each string in the decoded output
+	so that symbols are resolved with a single forward copy instead of a prefix walk.
 */
 //#define MANGO_ENABLE_DEBUG_PRINT
 
 #include <algorithm>
 #include <mango/core/pointer.hpp>
 #include <mango/core/system.hpp>
+#include <mango/core/thread.hpp>
 #include <mango/image/image.hpp>
 
 #ifdef MANGO_ENABLE_IMAGE_GIF
@@ -127,18 +129,21 @@ namespace
 
 	const u8* lzw_decode(u8* dest, u8* dest_end, const u8* src, const u8* src_end)
 	{
-		constexpr int MAX_STACK_SIZE = 8192;
+		constexpr int MAX_CODES = 4096;
 		constexpr int MAX_AVAILABLE = 0xfff;
 
+		// Every dictionary string is a previously decoded string extended by one symbol,
+		// so the table only stores where the string was last written and its length.
+		// Resolving a code is a single forward copy out of the already decoded output
+		// instead of a walk through the prefix chain.
 		struct lzw
 		{
-			s16 prefix;
-			u8 first;
-			u8 suffix;
-		} codes[MAX_STACK_SIZE];
+			u32 offset;
+			u32 length;
+		} codes[MAX_CODES];
 
 		const u8 minimum_codesize = *src++;
-		if (minimum_codesize > 12)
+		if (minimum_codesize > 11)
 		{
 			return nullptr;
 		}
@@ -146,13 +151,8 @@ namespace
 		const s32 code_clear = 1 << minimum_codesize;
 		const s32 code_eoi = code_clear + 1;
 
-		for (int i = 0; i < code_clear; ++i)
-		{
-			const u8 initcode = i;
-			codes[i].prefix = -1;
-			codes[i].first = initcode;
-			codes[i].suffix = initcode;
-		}
+		u8* const base = dest;
+		const size_t capacity = dest_end - dest;
 
 		s32 codesize = minimum_codesize + 1;
 		s32 codemask = (1 << codesize) - 1;
@@ -160,7 +160,12 @@ namespace
 		s32 available = code_clear + 2;
 		s32 oldcode = -1;
 
-		s32 data = 0;
+		// position and length of the previous string in the decoded output
+		size_t position = 0;
+		size_t old_position = 0;
+		u32 old_length = 0;
+
+		u32 data = 0;
 		s32 data_bits = 0;
 		s32 length = 0;
 
@@ -186,90 +191,123 @@ namespace
 				}
 
 				// fill register
-				--length;
-				data |= s32(*src++) << data_bits;
-				data_bits += 8;
+				while (length && data_bits <= 24)
+				{
+					--length;
+					data |= u32(*src++) << data_bits;
+					data_bits += 8;
+				}
+
+				continue;
 			}
-			else
+
+			// consume register
+			s32 code = data & codemask;
+			data >>= codesize;
+			data_bits -= codesize;
+
+			if (code == code_clear)
 			{
-				// consume register
-				s32 code = data & codemask;
-				data >>= codesize;
-				data_bits -= codesize;
+				// clear code
+				codesize = minimum_codesize + 1;
+				codemask = (1 << codesize) - 1;
+				available = code_clear + 2;
+				oldcode = -1;
+				continue;
+			}
 
-				if (code == code_clear)
+			if (code == code_eoi)
+			{
+				// end of information
+				src += length;
+				while ((length = *src++) > 0)
 				{
-					// clear code
-					codesize = minimum_codesize + 1;
-					codemask = (1 << codesize) - 1;
-					available = code_clear + 2;
-					oldcode = -1;
+					src += length;
 				}
-				else if (code == code_eoi)
+				return src;
+			}
+
+			if (code > available || (code == available && oldcode < 0))
+			{
+				// illegal code
+				return nullptr;
+			}
+
+			if (oldcode >= 0 && available < MAX_CODES)
+			{
+				// the new string is the previous one extended with the first symbol of the current one,
+				// which is where the current string is going to be written
+				codes[available].offset = u32(old_position);
+				codes[available].length = old_length + 1;
+				++available;
+			}
+
+			oldcode = code;
+			old_position = position;
+
+			if (code < code_clear)
+			{
+				// literal
+				if (position < capacity)
 				{
-					// end of information
-					src += length;
-					while ((length = *src++) > 0)
-					{
-						src += length;
-					}
-					return src;
+					base[position] = u8(code);
 				}
-				else if (code <= available)
+
+				old_length = 1;
+				position += 1;
+			}
+			else
+			{
+				const size_t offset = codes[code].offset;
+				const u32 count = codes[code].length;
+
+				if (position < capacity)
 				{
-					if (oldcode >= 0)
+					u8* d = base + position;
+					const u8* s = base + offset;
+
+					// the string is never longer than the distance to its source, except when the
+					// code was defined by itself (KwKwK) where the last symbol is the first one
+					const size_t distance = position - offset;
+					const size_t n = std::min(size_t(count), distance);
+
+					if (position + n + 16 <= capacity)
 					{
-						lzw* p = &codes[available++];
-						if (available >= MAX_STACK_SIZE)
+						// wide copy; the overshoot is overwritten by the following strings and
+						// the source is always behind the destination so no unread data is clobbered
+						for (size_t i = 0; i < n; i += 16)
 						{
-							// too many codes
-							return nullptr;
+							u8 temp[16];
+							std::memcpy(temp, s + i, 16);
+							std::memcpy(d + i, temp, 16);
 						}
 
-						p->prefix = (s16) oldcode;
-						p->first = codes[oldcode].first;
-						p->suffix = (code == available) ? p->first : codes[code].first;
+						if (n < count)
+						{
+							d[n] = s[0];
+						}
 					}
-					else if (code == available)
+					else
 					{
-						// illegal code
-						return nullptr;
-					}
-
-					oldcode = code;
+						// clip to the end of the buffer
+						const size_t left = capacity - position;
+						std::memcpy(d, s, std::min(n, left));
 
-					// remember current address
-					u8* start = dest;
-
-					// resolve symbols
-					for (;;)
-					{
-						u8 sample = codes[code].suffix;
-						if (dest < dest_end)
+						if (n < count && n < left)
 						{
-							*dest++ = sample;
+							d[n] = s[0];
 						}
-
-						if (codes[code].prefix < 0)
-							break;
-
-						code = codes[code].prefix;
 					}
+				}
 
-					// reverse symbols
-					std::reverse(start, dest);
+				old_length = count;
+				position += count;
+			}
 
-					if (available > codemask && available < MAX_AVAILABLE)
-					{
-						++codesize;
-						codemask |= (codemask + 1);
-					}
-				}
-				else
-				{
-					// illegal code
-					return nullptr;
-				}
+			if (available > codemask && available < MAX_AVAILABLE)
+			{
+				++codesize;
+				codemask |= (codemask + 1);
 			}
 		}
 
@@ -592,8 +630,10 @@ namespace
             return m_header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -652,9 +692,48 @@ namespace
 	// encoder
 	// ------------------------------------------------------------
 
+	// Pixels per independently encoded LZW strip. Every strip starts with a clear code
+	// (written when the strips are joined) so the strips can be compressed concurrently and concatenated at bit granularity
+	// into a single code stream. The encoder resets the dictionary every ~4K codes
+	// anyway so the extra clear codes cost practically nothing in compression.
+	constexpr int LZW_STRIP_PIXELS = 1 << 20;
+
+	struct BitWriter
+	{
+		std::vector<u8> buffer;
+		u64 data = 0;
+		int index = 0;
+
+		void writeBits(u32 code, int numbits)
+		{
+			data |= u64(code) << index;
+			index += numbits;
+
+			if (index >= 32)
+			{
+				size_t offset = buffer.size();
+				buffer.resize(offset + 4);
+				ustore32le(buffer.data() + offset, u32(data));
+				data >>= 32;
+				index -= 32;
+			}
+		}
+
+		void flush()
+		{
+			// leave less than a byte in the register
+			while (index >= 8)
+			{
+				buffer.push_back(u8(data));
+				data >>= 8;
+				index -= 8;
+			}
+		}
+	};
+
 	struct EncoderState
 	{
-		u8 data = 0;
+		u32 data = 0;
 		int index = 0;
 
 		int chunkIndex = 0;
@@ -662,33 +741,55 @@ namespace
 
 		void writeBits(LittleEndianStream& s, u32 code, int numbits)
 		{
-			while (numbits > 0)
+			data |= code << index;
+			index += numbits;
+
+			while (index >= 8)
 			{
-				// how many bits still fit into the register
-				int size = std::min(numbits, 8 - index);
+				writeByte(s, u8(data));
+				data >>= 8;
+				index -= 8;
+			}
+		}
 
-				// insert the bits into the register
-				u32 mask = (1 << size) - 1;
-				data |= ((code & mask) << index);
+		void writeBytes(LittleEndianStream& s, const u8* bytes, size_t size)
+		{
+			if (index)
+			{
+				// unaligned; shift every byte into place
+				for (size_t i = 0; i < size; ++i)
+				{
+					u32 value = data | (u32(bytes[i]) << index);
+					writeByte(s, u8(value));
+					data = value >> 8;
+				}
+				return;
+			}
 
-				code >>= size;
-				index += size;
-				numbits -= size;
+			while (size > 0)
+			{
+				size_t n = std::min(size, size_t(255 - chunkIndex));
+				std::memcpy(chunk + chunkIndex, bytes, n);
+				chunkIndex += int(n);
+				bytes += n;
+				size -= n;
 
-				if (index > 7)
+				if (chunkIndex == 255)
 				{
-					chunk[chunkIndex++] = data;
-					if (chunkIndex == 255)
-					{
-						flushChunk(s);
-					}
-
-					data = 0;
-					index = 0;
+					flushChunk(s);
 				}
 			}
 		}
 
+		void writeByte(LittleEndianStream& s, u8 value)
+		{
+			chunk[chunkIndex++] = value;
+			if (chunkIndex == 255)
+			{
+				flushChunk(s);
+			}
+		}
+
 		void flushChunk(LittleEndianStream& s)
 		{
 			s.write8(chunkIndex);
@@ -700,7 +801,9 @@ namespace
 		{
 			if (index)
 			{
-				chunk[chunkIndex++] = data;
+				writeByte(s, u8(data));
+				data = 0;
+				index = 0;
 			}
 
 			if (chunkIndex > 0)
@@ -710,26 +813,33 @@ namespace
 		}
 	};
 
-	void gif_encode_image_block(LittleEndianStream& s, int depth, int width, int height, int stride, u8* image)
+	struct LZWStrip
 	{
-		const int minCodeSize = depth;
-		const u32 clearCode = 1 << depth;
+		BitWriter writer;
+		u32 codeSize = 0; // code size the decoder is at when the strip ends
+	};
 
-		s.write8(minCodeSize);
+	void lzw_encode_strip(LZWStrip& strip, int depth, int width, int height, int stride, const u8* image)
+	{
+		const u32 minCodeSize = u32(depth + 1);
+		const u32 clearCode = 1 << depth;
 
 		std::vector<u16> codetree(4096 * 256, 0);
 
+		// nodes inserted into the tree; clearing only these is much cheaper than resetting the whole tree
+		std::vector<u32> nodes;
+		nodes.reserve(4096);
+
 		s32 curCode = -1;
-		u32 codeSize = u32(minCodeSize + 1);
+		u32 codeSize = minCodeSize;
 		u32 maxCode = clearCode + 1;
 
-		EncoderState state;
-
-		state.writeBits(s, clearCode, codeSize); // start with a fresh LZW dictionary
+		BitWriter& writer = strip.writer;
+		writer.buffer.reserve(width * height);
 
 		for (int y = 0; y < height; ++y)
 		{
-			u8* scan = image + y * stride;
+			const u8* scan = image + y * stride;
 
 			for (int x = 0; x < width; ++x)
 			{
@@ -739,33 +849,44 @@ namespace
 				{
 					// first value in a new run
 					curCode = nextValue;
+					continue;
 				}
-				else if (codetree[curCode * 256 + nextValue])
+
+				const u32 node = curCode * 256 + nextValue;
+
+				if (codetree[node])
 				{
 					// current run already in the dictionary
-					curCode = codetree[curCode * 256 + nextValue];
+					curCode = codetree[node];
 				}
 				else
 				{
 					// finish the current run, write a code
-					state.writeBits(s, curCode, codeSize);
+					writer.writeBits(curCode, codeSize);
 
 					// insert the new run into the dictionary
-					codetree[curCode * 256 + nextValue] = u16(++maxCode);
+					codetree[node] = u16(++maxCode);
+					nodes.push_back(node);
 
-					if (maxCode >= (1ul << codeSize))
+					if (maxCode >= (1u << codeSize))
 					{
 						// dictionary entry count has broken a size barrier,
 						// we need more bits for codes
 						codeSize++;
 					}
+
 					if (maxCode == 4095)
 					{
 						// the dictionary is full, clear it out and begin anew
-						state.writeBits(s, clearCode, codeSize); // clear tree
-						
-						std::memset(codetree.data(), 0, 4096 * 256 * sizeof(u16));
-						codeSize = u32(minCodeSize + 1);
+						writer.writeBits(clearCode, codeSize);
+
+						for (u32 index : nodes)
+						{
+							codetree[index] = 0;
+						}
+
+						nodes.clear();
+						codeSize = minCodeSize;
 						maxCode = clearCode + 1;
 					}
 
@@ -774,10 +895,85 @@ namespace
 			}
 		}
 
+		// finish the last run
+		writer.writeBits(curCode, codeSize);
+
+		// the decoder defines one more dictionary entry when it receives the last code;
+		// the code that follows (clear code of the next strip or end of information)
+		// must be written with the code size the decoder has at that point
+		if (++maxCode >= (1u << codeSize) && codeSize < 12)
+		{
+			codeSize++;
+		}
+
+		writer.flush();
+		strip.codeSize = codeSize;
+	}
+
+	void gif_encode_image_block(LittleEndianStream& s, int depth, int width, int height, int stride, const u8* image)
+	{
+		const int minCodeSize = depth;
+		const u32 clearCode = 1 << depth;
+
+		s.write8(minCodeSize);
+
+		const int strip_height = std::max(1, LZW_STRIP_PIXELS / std::max(1, width));
+		const int count = (height + strip_height - 1) / strip_height;
+
+		std::vector<LZWStrip> strips(count);
+
+		auto encode = [&strips, depth, width, height, stride, image, strip_height] (int i)
+		{
+			const int y0 = i * strip_height;
+			const int y1 = std::min(height, y0 + strip_height);
+			lzw_encode_strip(strips[i], depth, width, y1 - y0, stride, image + y0 * stride);
+		};
+
+		// the strip layout does not depend on the machine so the output is identical
+		// regardless of how the strips are scheduled
+		if (count > 1 && ThreadPool::getHardwareConcurrency() > 1)
+		{
+			ConcurrentQueue queue("gif.lzw", Priority::HIGH);
+
+			for (int i = 0; i < count; ++i)
+			{
+				queue.enqueue([&encode, i]
+				{
+					encode(i);
+				});
+			}
+
+			queue.wait();
+		}
+		else
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				encode(i);
+			}
+		}
+
+		// concatenate the strips into one code stream
+		EncoderState state;
+		u32 codeSize = u32(minCodeSize + 1);
+
+		for (LZWStrip& strip : strips)
+		{
+			// start with a fresh LZW dictionary; the clear code is written with the
+			// code size the decoder has at the end of the previous strip
+			state.writeBits(s, clearCode, codeSize);
+			codeSize = strip.codeSize;
+
+			BitWriter& writer = strip.writer;
+			state.writeBytes(s, writer.buffer.data(), writer.buffer.size());
+			state.writeBits(s, u32(writer.data), writer.index);
+
+			// release memory as soon as possible
+			std::vector<u8>().swap(writer.buffer);
+		}
+
 		// compression footer
-		state.writeBits(s, curCode, codeSize);
-		state.writeBits(s, clearCode, codeSize);
-		state.writeBits(s, clearCode + 1, minCodeSize + 1);
+		state.writeBits(s, clearCode + 1, codeSize);
 		state.terminate(s);
 
 		s.write8(0); // image block terminator
@@ -852,7 +1048,7 @@ namespace
 				return status;
 			}
 
-			if (surface.format.isIndexed() || surface.format.bits != 8)
+			if (!surface.format.isIndexed() || surface.format.bits != 8)
 			{
 				status.setError("[ImageEncoder.GIF] Incorrect format - must be 8 bit INDEXED (bits: %d).", surface.format.bits);
 				return status;
@@ -873,6 +1069,198 @@ namespace
         return status;
     }
 
+	// ------------------------------------------------------------
+	// AnimationEncoder
+	// ------------------------------------------------------------
+
+	struct AnimationInterface : AnimationEncoderInterface
+	{
+		float m_quality;
+		bool m_dithering;
+
+		AnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+			: m_quality(options.quality)
+			, m_dithering(options.dithering)
+		{
+			LittleEndianStream s = stream;
+
+			// identifier
+			s.write("GIF89a", 6);
+
+			// screen descriptor; every frame has a local palette
+			s.write16(width);
+			s.write16(height);
+			s.write8(0x7 << 4); // color resolution: 8 bits, no global color table
+			s.write8(0); // background color
+			s.write8(0); // aspect ratio
+
+			// NETSCAPE2.0 application extension: loop forever
+			s.write8(GIF_EXTENSION);
+			s.write8(APPLICATION_EXTENSION);
+			s.write8(11);
+			s.write("NETSCAPE2.0", 11);
+			s.write8(3);
+			s.write8(1);
+			s.write16(0); // loop count
+			s.write8(0);
+		}
+
+		ImageEncodeStatus compress(Stream& stream, const AnimationFrame& frame) override
+		{
+			ImageEncodeStatus status;
+
+			const Surface& source = frame.image;
+			const int width = source.width;
+			const int height = source.height;
+
+			// The transparent pixels take the color of the preceding opaque pixel
+			// so that they don't bias the palette towards black.
+			Bitmap opaque(source, FORMAT_R8G8B8A8);
+			u32 color = 0;
+
+			for (int y = 0; y < height && !color; ++y)
+			{
+				const u32* scan = opaque.address<u32>(0, y);
+				for (int x = 0; x < width; ++x)
+				{
+					if (scan[x])
+					{
+						color = scan[x];
+						break;
+					}
+				}
+			}
+
+			for (int y = 0; y < height; ++y)
+			{
+				u32* scan = opaque.address<u32>(0, y);
+				for (int x = 0; x < width; ++x)
+				{
+					if (scan[x] & 0xff000000)
+						color = scan[x];
+					else
+						scan[x] = color;
+				}
+			}
+
+			Bitmap temp(width, height, IndexedFormat(8));
+
+			image::ColorQuantizer quantizer(opaque, m_quality);
+			quantizer.quantize(temp, opaque, m_dithering);
+			Palette palette = quantizer.getPalette();
+
+			u8 transparent = 0;
+
+			if (frame.blend)
+			{
+				// The least used palette entry becomes the transparent color;
+				// its pixels are moved to the closest remaining entry.
+				u32 histogram[256] = { 0 };
+
+				for (int y = 0; y < height; ++y)
+				{
+					const u32* scan = source.address<u32>(0, y);
+					const u8* index = temp.address<u8>(0, y);
+					for (int x = 0; x < width; ++x)
+					{
+						histogram[index[x]] += (scan[x] != 0);
+					}
+				}
+
+				transparent = u8(std::min_element(histogram, histogram + 256) - histogram);
+
+				u8 replacement = transparent;
+
+				if (histogram[transparent])
+				{
+					const ColorBGRA c = palette[transparent];
+					int best = 0x7fffffff;
+
+					for (int i = 0; i < 256; ++i)
+					{
+						const ColorBGRA p = palette[i];
+						int dr = p.r - c.r;
+						int dg = p.g - c.g;
+						int db = p.b - c.b;
+						int distance = dr * dr + dg * dg + db * db;
+						if (i != transparent && distance < best)
+						{
+							best = distance;
+							replacement = u8(i);
+						}
+					}
+				}
+
+				for (int y = 0; y < height; ++y)
+				{
+					const u32* scan = source.address<u32>(0, y);
+					u8* index = temp.address<u8>(0, y);
+					for (int x = 0; x < width; ++x)
+					{
+						if (!scan[x])
+							index[x] = transparent;
+						else if (index[x] == transparent)
+							index[x] = replacement;
+					}
+				}
+			}
+
+			LittleEndianStream s = stream;
+
+			// graphics control extension
+			u32 delay = u32((u64(frame.delay_numerator) * 100 + frame.delay_denominator / 2) / frame.delay_denominator);
+
+			u8 packed = 1 << 2; // disposal: do not dispose
+			packed |= frame.blend ? 1 : 0; // transparent color
+
+			s.write8(GIF_EXTENSION);
+			s.write8(GRAPHICS_CONTROL_EXTENSION);
+			s.write8(4);
+			s.write8(packed);
+			s.write16(u16(std::min(delay, 0xffffu)));
+			s.write8(transparent);
+			s.write8(0);
+
+			// image descriptor
+			s.write8(GIF_IMAGE);
+			s.write16(frame.x);
+			s.write16(frame.y);
+			s.write16(width);
+			s.write16(height);
+			s.write8(0x80 | 0x7); // local color table, 256 colors
+
+			// local palette
+			for (int i = 0; i < 256; ++i)
+			{
+				s.write8(palette[i].r);
+				s.write8(palette[i].g);
+				s.write8(palette[i].b);
+			}
+
+			gif_encode_image_block(s, 8, width, height, temp.stride, temp.image);
+
+			return status;
+		}
+
+		void write(Stream& stream, const AnimationFrame& frame, ConstMemory data) override
+		{
+			MANGO_UNREFERENCED(frame);
+			stream.write(data);
+		}
+
+		void finish(Stream& stream) override
+		{
+			LittleEndianStream s = stream;
+			s.write8(GIF_TERMINATE);
+		}
+	};
+
+	AnimationEncoderInterface* createAnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+	{
+		AnimationEncoderInterface* x = new AnimationInterface(stream, width, height, options);
+		return x;
+	}
+
 } // namespace
 
 namespace mango
@@ -881,7 +1269,10 @@ namespace mango
     void registerImageDecoderGIF()
     {
         registerImageDecoder(createInterface, ".gif");
+        registerImageSignature(".gif", "GIF87a");
+        registerImageSignature(".gif", "GIF89a");
         registerImageEncoder(imageEncode, ".gif");
+        registerAnimationEncoder(createAnimationInterface, ".gif");
     }
 
 } // namespace mango
@@ -6,7 +6,9 @@
 #include <mango/core/pointer.hpp>
 #include <mango/core/buffer.hpp>
 #include <mango/core/system.hpp>
+#include <mango/core/thread.hpp>
 #include <mango/image/image.hpp>
+#include <mango/math/math.hpp>
 
 #ifdef MANGO_ENABLE_IMAGE_HDR
 
@@ -22,22 +24,27 @@ namespace
     {
         const u8* p = data;
 
-        int endsize = 1;
+        int endsize = 0;
 
         // scan for endline
-        for ( ; data < end; )
+        for ( ; p < end; )
         {
             u8 v = *p++;
 
             // Unix ("\n")
             if (v == '\n')
+            {
+                endsize = 1;
                 break;
+            }
 
             // MacOS ("\r")
             if (v == '\r')
             {
+                endsize = 1;
+
                 // Windows ("\r\n")
-                if (*p == '\n')
+                if (p < end && *p == '\n')
                 {
                     ++endsize;
                     ++p;
@@ -112,58 +119,324 @@ namespace
     }
 
     // ------------------------------------------------------------
-    // encoder
+    // rgbe conversion
     // ------------------------------------------------------------
 
-    struct rgbe
+    // Scanlines are processed in bands of this size; every scanline is
+    // self-contained so the bands can be coded concurrently.
+    constexpr int HDR_BAND_HEIGHT = 32;
+
+    // Expand four pixels from planar (r, g, b, e) bytes. The scale 2^(e - 136) is
+    // constructed directly into the float exponent; exponents below 10 would
+    // be denormals and are flushed to zero like the zero exponent.
+    inline float4x4 rgbe_to_float(const u8* r, const u8* g, const u8* b, const u8* e)
     {
-        u8 r, g, b, e;
-    };
+        int32x4 exponent(e[0], e[1], e[2], e[3]);
+        float32x4 scale = reinterpret<float32x4>((exponent - 9) << 23);
+        scale = select(exponent > 9, scale, float32x4(0.0f));
+
+        float32x4 red   = convert<float32x4>(int32x4(r[0], r[1], r[2], r[3])) * scale;
+        float32x4 green = convert<float32x4>(int32x4(g[0], g[1], g[2], g[3])) * scale;
+        float32x4 blue  = convert<float32x4>(int32x4(b[0], b[1], b[2], b[3])) * scale;
 
-    /*
-    rgbe create_rgbe(float r, float g, float b)
+        return transpose(red, green, blue, float32x4(1.0f));
+    }
+
+    inline float32x4 rgbe_to_float(u8 r, u8 g, u8 b, u8 e)
+    {
+        float scale = e > 9 ? std::ldexp(1.0f, e - 136) : 0.0f;
+        return float32x4(r * scale, g * scale, b * scale, 1.0f);
+    }
+
+    void rgbe_to_rgba32f(u8* dest, const u8* planar, int width)
     {
-        float maxf = r > g ? r : g;
-        maxf = maxf > b ? maxf : b;
-    
-        rgbe color;
+        float* image = reinterpret_cast<float*>(dest);
+
+        const u8* r = planar + width * 0;
+        const u8* g = planar + width * 1;
+        const u8* b = planar + width * 2;
+        const u8* e = planar + width * 3;
 
-        if (maxf <= 1e-32f)
+        int x = 0;
+
+        for ( ; x <= width - 4; x += 4)
         {
-            color.r = 0;
-            color.g = 0;
-            color.b = 0;
-            color.e = 0;
+            float4x4 m = rgbe_to_float(r + x, g + x, b + x, e + x);
+            simd::f32x4_ustore(image +  0, m[0]);
+            simd::f32x4_ustore(image +  4, m[1]);
+            simd::f32x4_ustore(image +  8, m[2]);
+            simd::f32x4_ustore(image + 12, m[3]);
+            image += 16;
         }
-        else
+
+        for ( ; x < width; ++x)
+        {
+            simd::f32x4_ustore(image, rgbe_to_float(r[x], g[x], b[x], e[x]));
+            image += 4;
+        }
+    }
+
+    void rgbe_to_rgba16f(u8* dest, const u8* planar, int width)
+    {
+        float16x4* image = reinterpret_cast<float16x4*>(dest);
+
+        const u8* r = planar + width * 0;
+        const u8* g = planar + width * 1;
+        const u8* b = planar + width * 2;
+        const u8* e = planar + width * 3;
+
+        int x = 0;
+
+        for ( ; x <= width - 4; x += 4)
+        {
+            float4x4 m = rgbe_to_float(r + x, g + x, b + x, e + x);
+            image[0] = float16x4(m[0]);
+            image[1] = float16x4(m[1]);
+            image[2] = float16x4(m[2]);
+            image[3] = float16x4(m[3]);
+            image += 4;
+        }
+
+        for ( ; x < width; ++x)
         {
-            int exponent;
-            std::frexpf(maxf, &exponent);
-            float scale = std::ldexpf(1.0f, 8 - exponent);
-
-            color.r = u8(r * scale);
-            color.g = u8(g * scale);
-            color.b = u8(b * scale);
-            color.e = u8(exponent + 128);
+            *image++ = float16x4(rgbe_to_float(r[x], g[x], b[x], e[x]));
         }
+    }
 
-        return color;
+    // Compress four RGBA float pixels into planar (r, g, b, e). This is the frexp()
+    // based reference conversion with the exponent read from the float bits.
+    inline void float_to_rgbe(u8* r, u8* g, u8* b, u8* e, const float* image)
+    {
+        float4x4 m = transpose(float32x4(simd::f32x4_uload(image +  0)),
+                               float32x4(simd::f32x4_uload(image +  4)),
+                               float32x4(simd::f32x4_uload(image +  8)),
+                               float32x4(simd::f32x4_uload(image + 12)));
+
+        // negative and NaN components are stored as zero
+        const float32x4 zero(0.0f);
+        const float32x4 limit(1e38f);
+        float32x4 red   = min(max(m[0], zero), limit);
+        float32x4 green = min(max(m[1], zero), limit);
+        float32x4 blue  = min(max(m[2], zero), limit);
+        float32x4 maxf  = max(max(red, green), blue);
+
+        // maxf = mantissa * 2^(biased - 126), where mantissa is in [0.5, 1.0)
+        int32x4 biased = (reinterpret<int32x4>(maxf) >> 23) & 0xff;
+        float32x4 scale = reinterpret<float32x4>((261 - biased) << 23);
+
+        mask32x4 nonzero = maxf > 1e-32f;
+
+        int32x4 ir = select(nonzero, truncate<int32x4>(red * scale), int32x4(0));
+        int32x4 ig = select(nonzero, truncate<int32x4>(green * scale), int32x4(0));
+        int32x4 ib = select(nonzero, truncate<int32x4>(blue * scale), int32x4(0));
+        int32x4 ie = select(nonzero, biased + 2, int32x4(0));
+
+        for (int i = 0; i < 4; ++i)
+        {
+            r[i] = u8(ir[i]);
+            g[i] = u8(ig[i]);
+            b[i] = u8(ib[i]);
+            e[i] = u8(ie[i]);
+        }
+    }
+
+    void rgba32f_to_rgbe(u8* planar, const float* image, int width)
+    {
+        u8* r = planar + width * 0;
+        u8* g = planar + width * 1;
+        u8* b = planar + width * 2;
+        u8* e = planar + width * 3;
+
+        int x = 0;
+
+        for ( ; x <= width - 4; x += 4)
+        {
+            float_to_rgbe(r + x, g + x, b + x, e + x, image);
+            image += 16;
+        }
+
+        if (x < width)
+        {
+            float temp[16] = { 0 };
+            std::memcpy(temp, image, (width - x) * 16);
+
+            u8 tr[4], tg[4], tb[4], te[4];
+            float_to_rgbe(tr, tg, tb, te, temp);
+
+            for (int i = 0; x < width; ++x, ++i)
+            {
+                r[x] = tr[i];
+                g[x] = tg[i];
+                b[x] = tb[i];
+                e[x] = te[i];
+            }
+        }
     }
-    */
 
     // ------------------------------------------------------------
-    // decoder
+    // encoder
     // ------------------------------------------------------------
 
-    void write_rgbe(float* buffer, rgbe color)
+    // Adaptive run-length encoding of one channel: runs of at least four
+    // bytes are stored as runs and everything between them as literals.
+    void rle_encode_channel(Buffer& output, const u8* data, int width)
     {
-        float scale = color.e ? std::ldexp(1.0f, color.e - 136) : 0;
-        buffer[0] = color.r * scale;
-        buffer[1] = color.g * scale;
-        buffer[2] = color.b * scale;
-        buffer[3] = 1.0f;
+        constexpr int MIN_RUN = 4;
+
+        int current = 0;
+
+        while (current < width)
+        {
+            int begin = current;
+            int run = 0;
+            int previous_run = 0;
+
+            // find the next run long enough to be worth storing
+            while (run < MIN_RUN && begin < width)
+            {
+                begin += run;
+                previous_run = run;
+                run = 1;
+
+                while (begin + run < width && run < 127 && data[begin] == data[begin + run])
+                {
+                    ++run;
+                }
+            }
+
+            // a short run right before the long one is cheaper as a run
+            if (previous_run > 1 && previous_run == begin - current)
+            {
+                u8 code[] = { u8(128 + previous_run), data[current] };
+                output.append(code, 2);
+                current = begin;
+            }
+
+            while (current < begin)
+            {
+                int count = std::min(128, begin - current);
+                u8 code = u8(count);
+                output.append(&code, 1);
+                output.append(data + current, count);
+                current += count;
+            }
+
+            if (run >= MIN_RUN)
+            {
+                u8 code[] = { u8(128 + run), data[begin] };
+                output.append(code, 2);
+                current += run;
+            }
+        }
     }
 
+    void hdr_encode_band(Buffer& output, const Surface& surface, int y0, int y1)
+    {
+        const int width = surface.width;
+
+        // new-style RLE can only describe these widths; others are stored flat
+        const bool rle = width >= 8 && width <= 0x7fff;
+
+        Bitmap temp(width, 1, FORMAT_RGBA32F);
+        Buffer planar(width * 4);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            const float* image;
+
+            if (surface.format == FORMAT_RGBA32F)
+            {
+                image = surface.address<float>(0, y);
+            }
+            else
+            {
+                temp.blit(0, 0, Surface(surface, 0, y, width, 1));
+                image = temp.address<float>(0, 0);
+            }
+
+            rgba32f_to_rgbe(planar, image, width);
+
+            if (rle)
+            {
+                u8 scan[] = { 2, 2, u8(width >> 8), u8(width) };
+                output.append(scan, 4);
+
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    rle_encode_channel(output, planar + width * channel, width);
+                }
+            }
+            else
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    u8 color[] = { planar[x], planar[x + width], planar[x + width * 2], planar[x + width * 3] };
+                    output.append(color, 4);
+                }
+            }
+        }
+    }
+
+    ImageEncodeStatus imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        MANGO_UNREFERENCED(options);
+
+        ImageEncodeStatus status;
+
+        if (surface.width < 1 || surface.height < 1)
+        {
+            status.setError("[ImageEncoder.HDR] Incorrect dimensions (%d x %d).", surface.width, surface.height);
+            return status;
+        }
+
+        std::string header = makeString("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n",
+            surface.height, surface.width);
+        stream.write(header.c_str(), header.length());
+
+        const int count = ceil_div(surface.height, HDR_BAND_HEIGHT);
+        std::vector<Buffer> bands(count);
+
+        auto encode = [&] (int i)
+        {
+            const int y0 = i * HDR_BAND_HEIGHT;
+            const int y1 = std::min(y0 + HDR_BAND_HEIGHT, surface.height);
+            hdr_encode_band(bands[i], surface, y0, y1);
+        };
+
+        if (count > 1 && ThreadPool::getHardwareConcurrency() > 1)
+        {
+            ConcurrentQueue queue("hdr.encode", Priority::HIGH);
+
+            for (int i = 0; i < count; ++i)
+            {
+                queue.enqueue([&encode, i]
+                {
+                    encode(i);
+                });
+            }
+
+            queue.wait();
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                encode(i);
+            }
+        }
+
+        for (const Buffer& band : bands)
+        {
+            stream.write(band.data(), band.size());
+        }
+
+        return status;
+    }
+
+    // ------------------------------------------------------------
+    // decoder
+    // ------------------------------------------------------------
+
     struct HeaderRAD
     {
         enum rad_format
@@ -199,6 +472,8 @@ namespace
                     break;
 
                 std::vector<std::string> tokens = tokenize(ln);
+                if (tokens.empty())
+                    continue;
 
                 if (tokens[0] == "FORMAT")
                 {
@@ -211,7 +486,7 @@ namespace
                     if (tokens[1] == "32-bit_rle_rgbe")
                         format = rad_rle_rgbe;
                 }
-                else if (tokens[1] == "EXPOSURE")
+                else if (tokens[0] == "EXPOSURE")
                 {
                     if (tokens.size() != 2)
                     {
@@ -287,75 +562,177 @@ namespace
         }
     };
 
-    void hdr_decode(ImageDecodeStatus& status, Surface& surface, const u8* data)
+    bool is_rle_scanline(const u8* data, const u8* end)
+    {
+        return end - data >= 4 && data[0] == 2 && data[1] == 2 && !(data[2] & 0x80);
+    }
+
+    // Locate the start of every scanline and validate the stream. This only
+    // walks the rle codes so it is fast compared to the decoding; with the
+    // start addresses known the scanlines can be decoded in any order.
+    const char* hdr_scan(std::vector<const u8*>& scans, const u8* data, const u8* end, int width, int height)
     {
-        Buffer buffer(surface.width * 4);
+        scans.resize(height);
 
-        for (int y = 0; y < surface.height; ++y)
+        for (int y = 0; y < height; ++y)
         {
-            if (data[0] != 2 || data[1] != 2 || data[2] & 0x80)
+            scans[y] = data;
+
+            if (is_rle_scanline(data, end))
             {
-                status.setError("[ImageDecoder.HDR] Incorrect rle_rgbe stream (wrong header).");
-                return;
-            }
+                if (((data[2] << 8) | data[3]) != width)
+                {
+                    return "[ImageDecoder.HDR] Incorrect rle_rgbe stream (wrong scan).";
+                }
+
+                data += 4;
+
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    int x = 0;
+
+                    while (x < width)
+                    {
+                        if (data >= end)
+                        {
+                            return "[ImageDecoder.HDR] Incorrect rle_rgbe stream (out of data).";
+                        }
+
+                        int count = *data++;
+                        int bytes = count;
+
+                        if (count > 128)
+                        {
+                            count -= 128;
+                            bytes = 1;
+                        }
+
+                        if (!count || x + count > width)
+                        {
+                            return "[ImageDecoder.HDR] Incorrect rle_rgbe stream (rle count).";
+                        }
+
+                        if (end - data < bytes)
+                        {
+                            return "[ImageDecoder.HDR] Incorrect rle_rgbe stream (out of data).";
+                        }
 
-            if (((data[2] << 8) | data[3]) != surface.width)
+                        data += bytes;
+                        x += count;
+                    }
+                }
+            }
+            else
             {
-                status.setError("[ImageDecoder.HDR] Incorrect rle_rgbe stream (wrong scan).");
-                return;
+                // flat scanline
+                if (end - data < width * 4)
+                {
+                    return "[ImageDecoder.HDR] Incorrect rle_rgbe stream (out of data).";
+                }
+
+                data += width * 4;
             }
+        }
+
+        return nullptr;
+    }
 
+    // Decode a scanline validated by hdr_scan() into planar (r, g, b, e) bytes
+    void hdr_decode_scanline(u8* planar, const u8* data, const u8* end, int width)
+    {
+        if (is_rle_scanline(data, end))
+        {
             data += 4;
 
             for (int channel = 0; channel < 4; ++channel)
             {
-                u8* dest = buffer + surface.width * channel;
-                u8* end = dest + surface.width;
+                u8* dest = planar + width * channel;
+                u8* last = dest + width;
 
-                while (dest < end)
+                while (dest < last)
                 {
                     int count = *data++;
 
                     if (count > 128)
                     {
                         count -= 128;
-                        if (!count || dest + count > end)
-                        {
-                            status.setError("[ImageDecoder.HDR] Incorrect rle_rgbe stream (rle count).");
-                            return;
-                        }
-
-                        u8 value = *data++;
-                        std::memset(dest, value, count);
-                        dest += count;
+                        std::memset(dest, *data++, count);
                     }
                     else
                     {
-                        if (!count || dest + count > end)
-                        {
-                            status.setError("[ImageDecoder.HDR] Incorrect rle_rgbe stream (rle count).");
-                            return;
-                        }
-
                         std::memcpy(dest, data, count);
-                        dest += count;
                         data += count;
                     }
+
+                    dest += count;
                 }
             }
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                planar[x + width * 0] = data[0];
+                planar[x + width * 1] = data[1];
+                planar[x + width * 2] = data[2];
+                planar[x + width * 3] = data[3];
+                data += 4;
+            }
+        }
+    }
+
+    // The surface must be FORMAT_RGBA32F or FORMAT_RGBA16F
+    void hdr_decode(ImageDecodeStatus& status, Surface& surface, const u8* data, const u8* end)
+    {
+        const int width = surface.width;
+        const int height = surface.height;
+
+        std::vector<const u8*> scans;
+
+        const char* error = hdr_scan(scans, data, end, width, height);
+        if (error)
+        {
+            status.setError(error);
+            return;
+        }
+
+        auto convert = surface.format == FORMAT_RGBA16F ? rgbe_to_rgba16f : rgbe_to_rgba32f;
+
+        auto decode = [&] (int i)
+        {
+            const int y0 = i * HDR_BAND_HEIGHT;
+            const int y1 = std::min(y0 + HDR_BAND_HEIGHT, height);
+
+            Buffer planar(width * 4);
 
-            float* image = surface.address<float>(0, y);
+            for (int y = y0; y < y1; ++y)
+            {
+                hdr_decode_scanline(planar, scans[y], end, width);
+                convert(surface.address(0, y), planar, width);
+            }
+        };
+
+        const int count = ceil_div(height, HDR_BAND_HEIGHT);
+
+        if (count > 1 && ThreadPool::getHardwareConcurrency() > 1)
+        {
+            ConcurrentQueue queue("hdr.decode", Priority::HIGH);
+
+            for (int i = 0; i < count; ++i)
+            {
+                queue.enqueue([&decode, i]
+                {
+                    decode(i);
+                });
+            }
 
-            for (int x = 0; x < surface.width; ++x)
+            queue.wait();
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
             {
-                rgbe color;
-                color.r = buffer[x + surface.width * 0];
-                color.g = buffer[x + surface.width * 1];
-                color.b = buffer[x + surface.width * 2];
-                color.e = buffer[x + surface.width * 3];
-
-                write_rgbe(image, color);
-                image += 4;
+                decode(i);
             }
         }
     }
@@ -368,10 +745,12 @@ namespace
     {
         HeaderRAD m_rad_header;
         const u8* m_data;
+        const u8* m_end;
 
         Interface(ConstMemory memory)
         {
             m_data = m_rad_header.parse(memory);
+            m_end = memory.address + memory.size;
         }
 
         ~Interface()
@@ -383,9 +762,9 @@ namespace
             return m_rad_header.header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -399,18 +778,18 @@ namespace
                 return status;
             }
 
-            status.direct = dest.format == header.format &&
+            status.direct = (dest.format == FORMAT_RGBA32F || dest.format == FORMAT_RGBA16F) &&
                             dest.width == header.width &&
                             dest.height == header.height;
 
             if (status.direct)
             {
-                hdr_decode(status, dest, m_data);
+                hdr_decode(status, dest, m_data, m_end);
             }
             else
             {
                 Bitmap temp(header.width, header.height, header.format);
-                hdr_decode(status, temp, m_data);
+                hdr_decode(status, temp, m_data, m_end);
                 if (status)
                 {
                     dest.blit(0, 0, temp);
@@ -435,6 +814,9 @@ namespace mango
     void registerImageDecoderHDR()
     {
         registerImageDecoder(createInterface, ".hdr");
+        registerImageSignature(".hdr", "#?RADIANCE");
+        registerImageSignature(".hdr", "#?RGBE");
+        registerImageEncoder(imageEncode, ".hdr");
     }
 
 } // namespace mango
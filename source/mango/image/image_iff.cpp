@@ -3,6 +3,7 @@
     Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <mango/core/pointer.hpp>
+#include <mango/core/buffer.hpp>
 #include <mango/core/system.hpp>
 #include <mango/image/image.hpp>
 
@@ -16,67 +17,107 @@ namespace
     // iff
     // ------------------------------------------------------------
 
-    void unpackBits(u8* buffer, const u8* input, int scansize, int insize)
+    // ByteRun1 decoder; the runs can continue on the next scanline so the decoder
+    // keeps the state of the current run between the scanlines.
+    struct DecoderRLE
     {
-        u8* buffer_end = buffer + scansize;
-        const u8* input_end = input + insize;
-
-        for (; buffer < buffer_end && input < input_end;)
+        const u8* p;
+        const u8* end;
+        int count = 0;
+        bool literal = false;
+        u8 value = 0;
+
+        DecoderRLE(const u8* data, const u8* end)
+            : p(data)
+            , end(end)
         {
-            u8 v = *input++;
+        }
 
-            if (v > 128)
-            {
-                const int n = 257 - v;
-                std::memset(buffer, *input++, n);
-                buffer += n;
-            }
-            else if (v < 128)
+        void decode(u8* dest, int bytes)
+        {
+            while (bytes > 0)
             {
-                const int n = v + 1;
-                std::memcpy(buffer, input, n);
-                input += n;
-                buffer += n;
+                if (count)
+                {
+                    const int n = std::min(count, bytes);
+
+                    if (literal)
+                    {
+                        if (end - p < n)
+                            break;
+
+                        std::memcpy(dest, p, n);
+                        p += n;
+                    }
+                    else
+                    {
+                        std::memset(dest, value, n);
+                    }
+
+                    dest += n;
+                    bytes -= n;
+                    count -= n;
+                    continue;
+                }
+
+                if (p >= end)
+                    break;
+
+                u8 v = *p++;
+
+                if (v > 128)
+                {
+                    if (p >= end)
+                        break;
+
+                    count = 257 - v;
+                    literal = false;
+                    value = *p++;
+                }
+                else if (v < 128)
+                {
+                    count = v + 1;
+                    literal = true;
+                }
+                else
+                {
+                    // 0x80
+                    end = p;
+                    break;
+                }
             }
-            else
+
+            if (bytes > 0)
             {
-                // 0x80
-                break;
+                // truncated data
+                std::memset(dest, 0, bytes);
             }
         }
-    }
+    };
 
-    void p2c_raw(u8* image, const u8* temp, int xsize, int ysize, int nplanes, int mask)
+    void p2c_raw(u8* image, const u8* temp, int xsize, int nplanes)
     {
         const int bpp = (nplanes + 7) >> 3;
-        const int scansize = xsize * bpp;
         const int planesize = ((xsize + 15) & ~15) / 8;
-        const int mplanes = nplanes + (mask == 1);
 
-        for (int y = 0; y < ysize; ++y)
-        {
-            std::memset(image, 0, scansize);
+        std::memset(image, 0, xsize * bpp);
 
-            for (int x = 0; x < xsize; ++x)
-            {
-                const int shift = ((x ^ 7) & 7);
+        for (int x = 0; x < xsize; ++x)
+        {
+            const int shift = ((x ^ 7) & 7);
 
-                const u8* src = temp + x / 8;
-                u8* dest = image + x * bpp;
+            const u8* src = temp + x / 8;
+            u8* dest = image + x * bpp;
 
-                for (int n = 0; n < nplanes; ++n)
-                {
-                    int v = src[n * planesize] >> shift;
-                    dest[n / 8] |= (v & 1) << (n & 7);
-                }
+            for (int n = 0; n < nplanes; ++n)
+            {
+                int v = src[n * planesize] >> shift;
+                dest[n / 8] |= (v & 1) << (n & 7);
             }
-
-            image += scansize;
-            temp += planesize * mplanes;
         }
     }
 
-    void p2c_ham(u8* dest, const u8* workptr, int width, int height, int nplanes, const Palette& palette)
+    void p2c_ham(u8* dest, const u8* workptr, int width, int nplanes, const Palette& palette)
     {
         bool hamcode2b = (nplanes == 6 || nplanes == 8);
         int ham_shift = 8 - (nplanes - (hamcode2b ? 2 : 1));
@@ -84,96 +125,90 @@ namespace
 
         int lineskip = ((width + 15) >> 4) << 1;
 
-        for (int y = 0; y < height; ++y)
-        {
-            u32 r = palette[0].r;
-            u32 g = palette[0].g;
-            u32 b = palette[0].b;
+        u32 r = palette[0].r;
+        u32 g = palette[0].g;
+        u32 b = palette[0].b;
 
-            u32 bitmask = 0x80;
-            const u8* workptr2 = workptr;
+        u32 bitmask = 0x80;
+        const u8* workptr2 = workptr;
 
-            for (int x = 0; x < width; ++x)
-            {
-                const u8* workptr3 = workptr2;
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* workptr3 = workptr2;
 
-                // read value
-                u32 v = 0;
-                u32 colorbit = 1;
+            // read value
+            u32 v = 0;
+            u32 colorbit = 1;
 
-                for (int plane = 2; plane < nplanes; ++plane)
+            for (int plane = 2; plane < nplanes; ++plane)
+            {
+                if (*workptr3 & bitmask)
                 {
-                    if (*workptr3 & bitmask)
-                    {
-                        v |= colorbit;
-                    }
-                    workptr3 += lineskip;
-                    colorbit += colorbit;
+                    v |= colorbit;
                 }
+                workptr3 += lineskip;
+                colorbit += colorbit;
+            }
 
-                // read hamcode
-                u32 hamcode = 0;
+            // read hamcode
+            u32 hamcode = 0;
 
+            if (*workptr3 & bitmask)
+            {
+                hamcode = 1;
+            }
+            workptr3 += lineskip;
+
+            if (hamcode2b)
+            {
                 if (*workptr3 & bitmask)
                 {
-                    hamcode = 1;
+                    hamcode |= 2;
                 }
                 workptr3 += lineskip;
+            }
 
-                if (hamcode2b)
-                {
-                    if (*workptr3 & bitmask)
-                    {
-                        hamcode |= 2;
-                    }
-                    workptr3 += lineskip;
-                }
-
-                // hold-and-modify
-                switch (hamcode)
-                {
-                    case 0:
-                        r = palette[v].r;
-                        g = palette[v].g;
-                        b = palette[v].b;
-                        break;
+            // hold-and-modify
+            switch (hamcode)
+            {
+                case 0:
+                    r = palette[v].r;
+                    g = palette[v].g;
+                    b = palette[v].b;
+                    break;
 
-                    case 1:
-                        b = v << ham_shift;
-                        break;
+                case 1:
+                    b = v << ham_shift;
+                    break;
 
-                    case 2:
-                        r = v << ham_shift;
-                        break;
+                case 2:
+                    r = v << ham_shift;
+                    break;
 
-                    case 3:
-                        g = v << ham_shift;
-                        break;
-                }
+                case 3:
+                    g = v << ham_shift;
+                    break;
+            }
 
-                dest[0] = u8(b);
-                dest[1] = u8(g);
-                dest[2] = u8(r);
-                dest[3] = 0xff;
-                dest += 4;
+            dest[0] = u8(b);
+            dest[1] = u8(g);
+            dest[2] = u8(r);
+            dest[3] = 0xff;
+            dest += 4;
 
-                bitmask >>= 1;
+            bitmask >>= 1;
 
-                if (!bitmask)
-                {
-                    bitmask = 0x80;
-                    ++workptr2;
-                }
+            if (!bitmask)
+            {
+                bitmask = 0x80;
+                ++workptr2;
             }
-
-            workptr += lineskip * nplanes;
         }
     }
 
-    void expand_palette(u8* dest, const u8* src, int xsize, int ysize, const Palette& palette)
+    void expand_palette(u8* dest, const u8* src, int count, const Palette& palette)
     {
         ColorBGRA* image = reinterpret_cast<ColorBGRA*>(dest);
-        int count = xsize * ysize;
 
         for (int i = 0; i < count; ++i)
         {
@@ -322,8 +357,10 @@ namespace
             return m_header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -344,8 +381,8 @@ namespace
 
             Palette palette;
 
-            std::unique_ptr<u8[]> allocation;
-            const u8* buffer = nullptr;
+            const u8* body = nullptr;
+            u32 body_size = 0;
 
             bool ham = false;
             bool ehb = false;
@@ -424,21 +461,8 @@ namespace
 
                     case u32_mask_rev('B','O','D','Y'):
                     {
-                        if (compression)
-                        {
-                            int scansize = ((xsize + 15) & ~15) / 8 * (nplanes + (mask == 1));
-                            int bytes = scansize * ysize;
-                            allocation.reset(new u8[bytes]);
-                            u8* allocated = allocation.get();
-
-                            unpackBits(allocated, p, bytes, size);
-                            buffer = allocated;
-                        }
-                        else
-                        {
-                            buffer = p;
-                        }
-
+                        body = p;
+                        body_size = size;
                         break;
                     }
 
@@ -468,67 +492,109 @@ namespace
                 }
             }
 
-            if (palette.size > 0 && !ham && ptr_palette)
+            if (!body)
+            {
+                status.setError("[ImageDecoder.IFF] No image data.");
+                return status;
+            }
+
+            const bool indices = palette.size > 0 && !ham && ptr_palette;
+            if (indices)
             {
                 // client requests for palette and the image has one
                 *ptr_palette = palette;
+            }
+
+            // choose pixelformat
+            const Format format = indices ? FORMAT_L8 : select_format(nplanes, ham);
+            const int bpp = (nplanes + 7) >> 3;
+
+            // bytes of one scanline in the BODY
+            const int scansize = is_pbm ? xsize * bpp : ((xsize + 15) & ~15) / 8 * (nplanes + (mask == 1));
+
+            // Scanlines are decoded straight into the destination; a scanline is
+            // staged only when it must be converted into the destination format.
+            const bool direct = dest.format == format && dest.width >= xsize;
+
+            const Blitter* blitter = direct ? nullptr : &getBlitter(dest.format, format);
+            Buffer temp(direct ? 0 : xsize * format.bytes());
+
+            Buffer scanline(compression ? scansize : 0);
+            Buffer chunky(!is_pbm && nplanes <= 8 && !ham ? xsize : 0);
+
+            const u8* memory_end = m_memory.address + m_memory.size;
+            const size_t available = body < memory_end ? memory_end - body : 0;
+            const u8* body_end = body + std::min(size_t(body_size), available);
 
-                if (is_pbm)
+            DecoderRLE decoder(body, body_end);
+
+            const int xcount = std::min(xsize, dest.width);
+            const int ycount = std::min(ysize, dest.height);
+
+            for (int y = 0; y < ycount; ++y)
+            {
+                const u8* src;
+
+                if (compression)
                 {
-                    // linear
-                    std::memcpy(dest.image, buffer, xsize * ysize);
+                    decoder.decode(scanline, scansize);
+                    src = scanline;
                 }
                 else
                 {
-                    // interlaced
-                    Bitmap raw(xsize, ysize, FORMAT_L8);
-                    p2c_raw(raw.image, buffer, xsize, ysize, nplanes, mask);
-                    std::memcpy(dest.image, raw.image, xsize * ysize);
+                    if (body_end - body < scansize)
+                    {
+                        status.setError("[ImageDecoder.IFF] Not enough data.");
+                        return status;
+                    }
+
+                    src = body;
+                    body += scansize;
                 }
-            }
-            else
-            {
-                // choose pixelformat
-                Format format = select_format(nplanes, ham);
-                Bitmap temp(xsize, ysize, format);
+
+                u8* scan = direct ? dest.address(0, y) : temp.data();
 
                 // planar-to-chunky conversion
                 if (ham)
                 {
-                    p2c_ham(temp.image, buffer, xsize, ysize, nplanes, palette);
+                    p2c_ham(scan, src, xsize, nplanes, palette);
+                }
+                else if (nplanes <= 8)
+                {
+                    if (!is_pbm)
+                    {
+                        // interlaced
+                        p2c_raw(chunky, src, xsize, nplanes);
+                        src = chunky;
+                    }
+
+                    if (indices)
+                    {
+                        std::memcpy(scan, src, xsize);
+                    }
+                    else
+                    {
+                        expand_palette(scan, src, xsize, palette);
+                    }
                 }
                 else
                 {
                     if (is_pbm)
                     {
                         // linear
-                        if (nplanes <= 8)
-                        {
-                            expand_palette(temp.image, buffer, xsize, ysize, palette);
-                        }
-                        else
-                        {
-                            std::memcpy(temp.image, buffer, temp.stride * ysize);
-                        }
+                        std::memcpy(scan, src, xsize * bpp);
                     }
                     else
                     {
                         // interlaced
-                        if (nplanes <= 8)
-                        {
-                            Bitmap raw(xsize, ysize, FORMAT_L8);
-                            p2c_raw(raw.image, buffer, xsize, ysize, nplanes, mask);
-                            expand_palette(temp.image, raw.image, xsize, ysize, palette);
-                        }
-                        else
-                        {
-                            p2c_raw(temp.image, buffer, xsize, ysize, nplanes, mask);
-                        }
+                        p2c_raw(scan, src, xsize, nplanes);
                     }
                 }
 
-                // NOTE: we could directly decode into dest if the formats match.
-                dest.blit(0, 0, temp);
+                if (blitter)
+                {
+                    blitter->convert(dest.address(0, y), scan, xcount);
+                }
             }
 
             return status;
@@ -554,6 +620,7 @@ namespace mango
         registerImageDecoder(createInterface, ".ham8");
         registerImageDecoder(createInterface, ".ilbm");
         registerImageDecoder(createInterface, ".ehb");
+        registerImageSignature(".iff", "FORM");
     }
 
 } // namespace mango
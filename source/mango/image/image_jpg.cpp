@@ -47,16 +47,25 @@ namespace
             return m_parser.exif_memory;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
 
-            ImageDecodeStatus status = m_parser.decode(dest);
+            ImageDecodeStatus status = m_parser.decode(dest, options);
             return status;
         }
+
+        bool crop() override
+        {
+            return true;
+        }
+
+        bool orientation() override
+        {
+            return true;
+        }
     };
 
     ImageDecoderInterface* createInterface(ConstMemory memory)
@@ -71,7 +80,7 @@ namespace
 
     ImageEncodeStatus imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        ImageEncodeStatus status = jpeg::encodeImage(stream, surface, options.quality);
+        ImageEncodeStatus status = jpeg::encodeImage(stream, surface, options);
         return status;
     }
 
@@ -86,6 +95,7 @@ namespace mango
         registerImageDecoder(createInterface, ".jpeg");
         registerImageDecoder(createInterface, ".jfif");
         registerImageDecoder(createInterface, ".mpo");
+        registerImageSignature(".jpg", "\xff\xd8\xff");
         registerImageEncoder(imageEncode, ".jpg");
         registerImageEncoder(imageEncode, ".jpeg");
     }
@@ -5,6 +5,7 @@
 //#define MANGO_ENABLE_DEBUG_PRINT
 
 #include <cstring>
+#include <vector>
 #include <mango/core/pointer.hpp>
 #include <mango/core/system.hpp>
 #include <mango/image/image.hpp>
@@ -667,9 +668,9 @@ namespace
             return data;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
 
             ImageDecodeStatus status;
 
@@ -720,6 +721,398 @@ namespace
         return x;
     }
 
+    // ------------------------------------------------------------
+    // ImageEncoder
+    // ------------------------------------------------------------
+
+    ImageEncodeStatus validate(const CompressedImage& image, u32 format, const char* name)
+    {
+        ImageEncodeStatus status;
+
+        if (!format)
+        {
+            status.setError("[ImageEncoder.%s] Compression format is not supported.", name);
+        }
+        else if (image.faces != 1 && image.faces != 6)
+        {
+            status.setError("[ImageEncoder.%s] Incorrect number of faces.", name);
+        }
+        else
+        {
+            for (int level = 0; level < image.levels && status; ++level)
+            {
+                for (int face = 0; face < image.faces; ++face)
+                {
+                    if (image.memory(level, face).size < image.getLevelSize(level))
+                    {
+                        status.setError("[ImageEncoder.%s] Not enough level data (level: %d, face: %d).", name, level, face);
+                        break;
+                    }
+                }
+            }
+        }
+
+        return status;
+    }
+
+    u32 get_base_internal_format(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::AMD_3DC_X:
+            case TextureCompression::RGTC1_RED:
+            case TextureCompression::RGTC1_SIGNED_RED:
+            case TextureCompression::EAC_R11:
+            case TextureCompression::EAC_SIGNED_R11:
+                return KTX_RED;
+            case TextureCompression::AMD_3DC_XY:
+            case TextureCompression::RGTC2_RG:
+            case TextureCompression::RGTC2_SIGNED_RG:
+            case TextureCompression::EAC_RG11:
+            case TextureCompression::EAC_SIGNED_RG11:
+                return KTX_RG;
+            default:
+                break;
+        }
+
+        const TextureCompressionInfo info(compression);
+        return info.getCompressionFlags() & TextureCompressionInfo::ALPHA ? KTX_RGBA : KTX_RGB;
+    }
+
+    ImageEncodeStatus imageEncodeCompressedKTX(Stream& stream, const CompressedImage& image)
+    {
+        const TextureCompressionInfo info(image.compression);
+
+        ImageEncodeStatus status = validate(image, info.gl, "KTX");
+        if (!status)
+            return status;
+
+        const u8 ktxIdentifier[] =
+        {
+            0xab, 0x4b, 0x54, 0x58, 0x20, 0x31,
+            0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+        };
+
+        LittleEndianStream s(stream);
+
+        s.write(ktxIdentifier, sizeof(ktxIdentifier));
+        s.write32(0x04030201);
+        s.write32(0); // glType
+        s.write32(1); // glTypeSize
+        s.write32(0); // glFormat
+        s.write32(info.gl);
+        s.write32(get_base_internal_format(image.compression));
+        s.write32(image.width);
+        s.write32(image.height);
+        s.write32(0); // pixelDepth
+        s.write32(0); // numberOfArrayElements
+        s.write32(image.faces);
+        s.write32(image.levels);
+        s.write32(0); // bytesOfKeyValueData
+
+        // the faces are stored level by level; the block sizes keep the data 4 byte aligned
+        for (int level = 0; level < image.levels; ++level)
+        {
+            const size_t bytes = image.getLevelSize(level);
+            s.write32(u32(bytes));
+
+            for (int face = 0; face < image.faces; ++face)
+            {
+                ConstMemory memory = image.memory(level, face);
+                s.write(memory.address, bytes);
+            }
+        }
+
+        return status;
+    }
+
+    // ------------------------------------------------------------
+    // KTX2
+    // ------------------------------------------------------------
+
+    // KTX 2.0 Specification:
+    // https://github.khronos.org/KTX-Specification/
+
+    // Khronos Data Format Specification (color models and channels):
+    // https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html
+
+    constexpr int KTX2_HEADER_SIZE = 80;
+    constexpr int KTX2_LEVEL_INDEX_SIZE = 24;
+
+    enum : u8
+    {
+        KDF_MODEL_BC1A   = 128,
+        KDF_MODEL_BC2    = 129,
+        KDF_MODEL_BC3    = 130,
+        KDF_MODEL_BC4    = 131,
+        KDF_MODEL_BC5    = 132,
+        KDF_MODEL_BC6H   = 133,
+        KDF_MODEL_BC7    = 134,
+        KDF_MODEL_ETC1   = 160,
+        KDF_MODEL_ETC2   = 161,
+        KDF_MODEL_ASTC   = 162,
+        KDF_MODEL_PVRTC  = 164,
+        KDF_MODEL_PVRTC2 = 165,
+    };
+
+    enum : u8
+    {
+        KDF_SAMPLE_SIGNED = 0x40,
+        KDF_SAMPLE_FLOAT  = 0x80,
+    };
+
+    struct SampleKTX2
+    {
+        u8 channel;
+        u8 offset; // in 64 bit units
+        u8 bits;
+    };
+
+    struct DescriptorKTX2
+    {
+        u8 model = 0;
+        int count = 0;
+        SampleKTX2 samples[2];
+
+        DescriptorKTX2(TextureCompression compression)
+        {
+            const u32 flags = u32(compression) & 0xffff0000;
+            const bool alpha = (flags & TextureCompressionInfo::ALPHA) != 0;
+
+            switch (compression)
+            {
+                case TextureCompression::DXT1:
+                case TextureCompression::DXT1_SRGB:
+                case TextureCompression::DXT1_ALPHA1:
+                case TextureCompression::DXT1_ALPHA1_SRGB:
+                    set(KDF_MODEL_BC1A, { alpha ? u8(1) : u8(0), 0, 64 });
+                    break;
+                case TextureCompression::DXT3:
+                case TextureCompression::DXT3_SRGB:
+                    set(KDF_MODEL_BC2, { 15, 0, 64 }, { 0, 1, 64 });
+                    break;
+                case TextureCompression::DXT5:
+                case TextureCompression::DXT5_SRGB:
+                    set(KDF_MODEL_BC3, { 15, 0, 64 }, { 0, 1, 64 });
+                    break;
+                case TextureCompression::AMD_3DC_X:
+                case TextureCompression::RGTC1_RED:
+                case TextureCompression::RGTC1_SIGNED_RED:
+                    set(KDF_MODEL_BC4, { 0, 0, 64 });
+                    break;
+                case TextureCompression::AMD_3DC_XY:
+                case TextureCompression::RGTC2_RG:
+                case TextureCompression::RGTC2_SIGNED_RG:
+                    set(KDF_MODEL_BC5, { 0, 0, 64 }, { 1, 1, 64 });
+                    break;
+                case TextureCompression::BPTC_RGB_UNSIGNED_FLOAT:
+                case TextureCompression::BPTC_RGB_SIGNED_FLOAT:
+                    set(KDF_MODEL_BC6H, { 0, 0, 128 });
+                    break;
+                case TextureCompression::BPTC_RGBA_UNORM:
+                case TextureCompression::BPTC_SRGB_ALPHA_UNORM:
+                    set(KDF_MODEL_BC7, { 0, 0, 128 });
+                    break;
+                case TextureCompression::ETC1_RGB:
+                    set(KDF_MODEL_ETC1, { 0, 0, 64 });
+                    break;
+                case TextureCompression::EAC_R11:
+                case TextureCompression::EAC_SIGNED_R11:
+                    set(KDF_MODEL_ETC2, { 0, 0, 64 });
+                    break;
+                case TextureCompression::EAC_RG11:
+                case TextureCompression::EAC_SIGNED_RG11:
+                    set(KDF_MODEL_ETC2, { 0, 0, 64 }, { 1, 1, 64 });
+                    break;
+                case TextureCompression::ETC2_RGB:
+                case TextureCompression::ETC2_SRGB:
+                case TextureCompression::ETC2_RGB_ALPHA1:
+                case TextureCompression::ETC2_SRGB_ALPHA1:
+                    set(KDF_MODEL_ETC2, { 2, 0, 64 });
+                    break;
+                case TextureCompression::ETC2_RGBA:
+                case TextureCompression::ETC2_SRGB_ALPHA8:
+                    set(KDF_MODEL_ETC2, { 15, 0, 64 }, { 2, 1, 64 });
+                    break;
+                default:
+                    break;
+            }
+
+            switch (TextureCompressionInfo(compression).getCompressionFormat())
+            {
+                case TextureCompressionInfo::ASTC:
+                case TextureCompressionInfo::ASTC_HDR:
+                    set(KDF_MODEL_ASTC, { 0, 0, 128 });
+                    break;
+                case TextureCompressionInfo::PVRTC1:
+                    set(KDF_MODEL_PVRTC, { 0, 0, 64 });
+                    break;
+                case TextureCompressionInfo::PVRTC2:
+                    set(KDF_MODEL_PVRTC2, { 0, 0, 64 });
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void set(u8 m, SampleKTX2 s0)
+        {
+            model = m;
+            count = 1;
+            samples[0] = s0;
+        }
+
+        void set(u8 m, SampleKTX2 s0, SampleKTX2 s1)
+        {
+            model = m;
+            count = 2;
+            samples[0] = s0;
+            samples[1] = s1;
+        }
+
+        u32 size() const
+        {
+            // dfdTotalSize + basic descriptor block
+            return 4 + 24 + count * 16;
+        }
+
+        void write(LittleEndianStream& s, const TextureCompressionInfo& info) const
+        {
+            const u32 flags = info.getCompressionFlags();
+
+            u8 qualifiers = 0;
+            u32 lower = 0;
+            u32 upper = 0xffffffff;
+
+            if (flags & TextureCompressionInfo::FLOAT)
+            {
+                qualifiers |= KDF_SAMPLE_FLOAT;
+                lower = 0xbf800000; // -1.0f
+                upper = 0x3f800000; // 1.0f
+            }
+
+            if (flags & TextureCompressionInfo::SIGNED)
+            {
+                qualifiers |= KDF_SAMPLE_SIGNED;
+                if (!(flags & TextureCompressionInfo::FLOAT))
+                {
+                    lower = 0x80000000;
+                    upper = 0x7fffffff;
+                }
+            }
+
+            s.write32(size());
+            s.write32(0); // vendorId: KHRONOS, descriptorType: BASICFORMAT
+            s.write32(2 | ((24 + count * 16) << 16)); // versionNumber, descriptorBlockSize
+            s.write8(model);
+            s.write8(1); // colorPrimaries: BT709
+            s.write8(flags & TextureCompressionInfo::SRGB ? 2 : 1); // transferFunction: SRGB or LINEAR
+            s.write8(0); // flags: straight alpha
+            s.write8(u8(info.width - 1));
+            s.write8(u8(info.height - 1));
+            s.write8(0);
+            s.write8(0);
+            s.write8(u8(info.bytes)); // bytesPlane0
+            for (int i = 1; i < 8; ++i)
+            {
+                s.write8(0);
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                const SampleKTX2& sample = samples[i];
+                s.write16(sample.offset * 64);
+                s.write8(sample.bits - 1);
+                s.write8(sample.channel | qualifiers);
+                s.write32(0); // samplePosition
+                s.write32(lower);
+                s.write32(upper);
+            }
+        }
+    };
+
+    ImageEncodeStatus imageEncodeCompressedKTX2(Stream& stream, const CompressedImage& image)
+    {
+        const TextureCompressionInfo info(image.compression);
+        const DescriptorKTX2 descriptor(image.compression);
+
+        ImageEncodeStatus status = validate(image, descriptor.model ? info.vk : 0, "KTX2");
+        if (!status)
+            return status;
+
+        const u8 ktx2Identifier[] =
+        {
+            0xab, 0x4b, 0x54, 0x58, 0x20, 0x32,
+            0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+        };
+
+        const u32 dfdOffset = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_SIZE * image.levels;
+        const u32 dfdSize = descriptor.size();
+
+        // the levels are stored smallest first; each level is aligned to the block size
+        const u64 alignment = info.bytes;
+
+        std::vector<u64> offsets(image.levels);
+        u64 offset = dfdOffset + dfdSize;
+
+        for (int level = image.levels - 1; level >= 0; --level)
+        {
+            offset = (offset + alignment - 1) / alignment * alignment;
+            offsets[level] = offset;
+            offset += image.getLevelSize(level) * image.faces;
+        }
+
+        LittleEndianStream s(stream);
+
+        s.write(ktx2Identifier, sizeof(ktx2Identifier));
+        s.write32(info.vk);
+        s.write32(1); // typeSize
+        s.write32(image.width);
+        s.write32(image.height);
+        s.write32(0); // pixelDepth
+        s.write32(0); // layerCount
+        s.write32(image.faces);
+        s.write32(image.levels);
+        s.write32(0); // supercompressionScheme
+
+        s.write32(dfdOffset);
+        s.write32(dfdSize);
+        s.write32(0); // kvdByteOffset
+        s.write32(0); // kvdByteLength
+        s.write64(0); // sgdByteOffset
+        s.write64(0); // sgdByteLength
+
+        for (int level = 0; level < image.levels; ++level)
+        {
+            const u64 bytes = image.getLevelSize(level) * image.faces;
+            s.write64(offsets[level]);
+            s.write64(bytes);
+            s.write64(bytes); // uncompressedByteLength
+        }
+
+        descriptor.write(s, info);
+
+        u64 position = dfdOffset + dfdSize;
+        const u8 zeros[16] = { 0 };
+
+        for (int level = image.levels - 1; level >= 0; --level)
+        {
+            s.write(zeros, size_t(offsets[level] - position));
+
+            const size_t bytes = image.getLevelSize(level);
+
+            for (int face = 0; face < image.faces; ++face)
+            {
+                ConstMemory memory = image.memory(level, face);
+                s.write(memory.address, bytes);
+            }
+
+            position = offsets[level] + bytes * image.faces;
+        }
+
+        return status;
+    }
+
 } // namespace
 
 namespace mango
@@ -728,6 +1121,9 @@ namespace mango
     void registerImageDecoderKTX()
     {
         registerImageDecoder(createInterface, ".ktx");
+        registerImageSignature(".ktx", "\xabKTX 11\xbb\r\n\x1a\n");
+        registerImageEncoder(imageEncodeCompressedKTX, ".ktx");
+        registerImageEncoder(imageEncodeCompressedKTX2, ".ktx2");
     }
 
 } // namespace mango
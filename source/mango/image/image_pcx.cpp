@@ -100,125 +100,139 @@ namespace
     // scanline decoders
     // ------------------------------------------------------------
 
-    void scanRLE(u8* dest, int bytes, const u8* p)
+    // The runs can continue on the next scanline so the decoder keeps the state of
+    // the current run between the scanlines.
+    struct DecoderRLE
     {
-        u8* end = dest + bytes;
+        const u8* p;
+        const u8* end;
+        int count = 0;
+        u8 value = 0;
+
+        DecoderRLE(const u8* data, const u8* end)
+            : p(data)
+            , end(end)
+        {
+        }
 
-        while (dest < end)
+        void decode(u8* dest, int bytes)
         {
-            u8 sample = *p++;
-            if (sample < 0xc0)
+            while (bytes > 0)
             {
-                *dest++ = sample;
+                if (count)
+                {
+                    const int n = std::min(count, bytes);
+                    std::memset(dest, value, n);
+                    dest += n;
+                    bytes -= n;
+                    count -= n;
+                    continue;
+                }
+
+                if (p >= end)
+                {
+                    // truncated file
+                    std::memset(dest, 0, bytes);
+                    break;
+                }
+
+                u8 sample = *p++;
+                if (sample < 0xc0)
+                {
+                    *dest++ = sample;
+                    --bytes;
+                }
+                else
+                {
+                    count = sample & 0x3f;
+                    value = p < end ? *p++ : 0;
+                }
             }
+        }
+    };
+
+    // Expand one decoded scanline; the palette is nullptr when the caller wants the
+    // indices instead of B8G8R8A8 colors.
+    using ScanFunc = void (*)(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette);
+
+    void scan_planar4(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette)
+    {
+        u32* d = reinterpret_cast<u32*>(dest);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* s = src + (x >> 3);
+            const u8 mask = 0x80 >> (x & 7);
+            int index = 0;
+            if (s[bytesPerLine * 0] & mask) index |= 1;
+            if (s[bytesPerLine * 1] & mask) index |= 2;
+            if (s[bytesPerLine * 2] & mask) index |= 4;
+            if (s[bytesPerLine * 3] & mask) index |= 8;
+
+            if (palette)
+                d[x] = (*palette)[index];
             else
-            {
-                int count = sample & 0x3f;
-                sample = *p++;
-                std::memset(dest, sample, count);
-                dest += count;
-            }
+                dest[x] = u8(index);
         }
     }
 
-    void decode4(const Surface& s, u8* buffer, int scansize)
+    void scan_indexed8(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette)
     {
-        const int width = s.width;
-        const int height = s.height;
-        const int stride = s.stride;
-        u8* image = s.image;
-
-        const int sn = scansize / 4;
+        MANGO_UNREFERENCED(bytesPerLine);
 
-        for (int y = 0; y < height; ++y)
+        if (palette)
         {
+            u32* d = reinterpret_cast<u32*>(dest);
             for (int x = 0; x < width; ++x)
             {
-                const u8* src = buffer + (x >> 3);
-                const u8 mask = 0x80 >> (x & 7);
-                int index = 0;
-                if (src[sn * 0] & mask) index |= 1;
-                if (src[sn * 1] & mask) index |= 2;
-                if (src[sn * 2] & mask) index |= 4;
-                if (src[sn * 3] & mask) index |= 8;
-                image[x] = index;
+                d[x] = (*palette)[src[x]];
             }
-
-            buffer += scansize;
-            image += stride;
+        }
+        else
+        {
+            std::memcpy(dest, src, width);
         }
     }
 
-    void decode8(const Surface& s, u8* buffer, int scansize)
+    void scan_gray8(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette)
     {
-        const int width = s.width;
-        const int height = s.height;
-        const int stride = s.stride;
-        u8* image = s.image;
+        MANGO_UNREFERENCED(bytesPerLine);
+        MANGO_UNREFERENCED(palette);
 
-        for (int y = 0; y < height; ++y)
+        u32* d = reinterpret_cast<u32*>(dest);
+        for (int x = 0; x < width; ++x)
         {
-            std::memcpy(image, buffer, width);
-            buffer += scansize;
-            image += stride;
+            d[x] = src[x] * 0x00010101 | 0xff000000;
         }
     }
 
-    void decode24(const Surface& s, u8* buffer, int scansize)
+    void scan_planar24(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette)
     {
-        const int width = s.width;
-        const int height = s.height;
-        const int stride = s.stride;
-        u8* image = s.image;
+        MANGO_UNREFERENCED(palette);
 
-        const int sn = scansize / 3;
-
-        for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
         {
-            const u8* src = buffer;
-            u8* dest = image;
-
-            for (int x = 0; x < width; ++x)
-            {
-                dest[0] = src[sn * 2];
-                dest[1] = src[sn * 1];
-                dest[2] = src[sn * 0];
-                dest[3] = 0xff;
-                dest += 4;
-                ++src;
-            }
-
-            buffer += scansize;
-            image += stride;
+            dest[0] = src[bytesPerLine * 2];
+            dest[1] = src[bytesPerLine * 1];
+            dest[2] = src[bytesPerLine * 0];
+            dest[3] = 0xff;
+            dest += 4;
+            ++src;
         }
     }
 
-    void decode32(const Surface& s, u8* buffer, int scansize)
+    void scan_planar32(u8* dest, const u8* src, int width, int bytesPerLine, const Palette* palette)
     {
-        const int width = s.width;
-        const int height = s.height;
-        const int stride = s.stride;
-        u8* image = s.image;
-
-        const int sn = scansize / 4;
+        MANGO_UNREFERENCED(palette);
 
-        for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
         {
-            const u8* src = buffer;
-            u8* dest = image;
-
-            for (int x = 0; x < width; ++x)
-            {
-                dest[0] = src[sn * 2];
-                dest[1] = src[sn * 1];
-                dest[2] = src[sn * 0];
-                dest[3] = src[sn * 3];
-                dest += 4;
-                ++src;
-            }
-
-            buffer += scansize;
-            image += stride;
+            dest[0] = src[bytesPerLine * 2];
+            dest[1] = src[bytesPerLine * 1];
+            dest[2] = src[bytesPerLine * 0];
+            dest[3] = src[bytesPerLine * 3];
+            dest += 4;
+            ++src;
         }
     }
 
@@ -246,8 +260,10 @@ namespace
             return m_header.header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -261,79 +277,37 @@ namespace
                 return status;
             }
 
-            int width = header.width;
-            int height = header.height;
-            Format format = header.format;
+            const int width = header.width;
+            const int height = header.height;
 
-            Bitmap temp(width, height, format);
-
-            // RLE scanline buffer
             int bytesPerLine = m_header.BytesPerLine;
             if (!bytesPerLine) bytesPerLine = width * ceil_div(m_header.BitsPerPixel, 8);
-            int scansize = m_header.NPlanes * bytesPerLine;
-
-            Buffer buffer(scansize * height);
+            const int scansize = m_header.NPlanes * bytesPerLine;
 
-            scanRLE(buffer, scansize * height, m_memory.address + 128);
+            ScanFunc func = nullptr;
+            Palette palette;
 
             switch (m_header.BitsPerPixel)
             {
                 case 1:
-                    switch (m_header.NPlanes)
+                    if (m_header.NPlanes == 4)
                     {
-                        case 4:
-                        {
-                            Palette palette;
-                            palette.size = 16;
-
-                            // read palette
-                            const u8* pal = m_header.ColorMap;
-                            for (u32 i = 0; i < palette.size; ++i)
-                            {
-                                palette[i] = ColorBGRA(pal[0], pal[1], pal[2], 0xff);
-                                pal += 3;
-                            }
+                        func = scan_planar4;
+                        palette.size = 16;
 
-                            if (ptr_palette)
-                            {
-                                *ptr_palette = palette;
-                                decode4(dest, buffer, scansize);
-                            }
-                            else
-                            {
-                                Bitmap indices(width, height, FORMAT_L8);
-                                decode4(indices, buffer, scansize);
-
-                                for (int y = 0; y < height; ++y)
-                                {
-                                    u32* d = temp.address<u32>(0, y);
-                                    u8* s = indices.address<u8>(0, y);
-                                    for (int x = 0; x < width; ++x)
-                                    {
-                                        d[x] = palette[s[x]];
-                                    }
-                                }
-                                dest.blit(0, 0, temp);
-                            }
-                            break;
+                        // read palette
+                        const u8* pal = m_header.ColorMap;
+                        for (u32 i = 0; i < palette.size; ++i)
+                        {
+                            palette[i] = ColorBGRA(pal[0], pal[1], pal[2], 0xff);
+                            pal += 3;
                         }
-                        default:
-                            break;
                     }
                     break;
 
                 case 4:
-                    switch (m_header.NPlanes)
-                    {
-                        case 1:
-                            // TODO: 16 color palette (need sample files for testing)
-                            break;
-                        case 4:
-                            // TODO: 4096 color ARGB4444 (need sample files for testing)
-                            break;
-                        default:
-                            break;
-                    }
+                    // TODO: 16 color palette (need sample files for testing)
+                    // TODO: 4096 color ARGB4444 (need sample files for testing)
                     break;
 
                 case 8:
@@ -342,7 +316,7 @@ namespace
                         case 1:
                             if (m_header.isPaletteMarker)
                             {
-                                Palette palette;
+                                func = scan_indexed8;
                                 palette.size = 256;
 
                                 // read palette
@@ -352,42 +326,17 @@ namespace
                                     palette[i] = ColorBGRA(pal[0], pal[1], pal[2], 0xff);
                                     pal += 3;
                                 }
-
-                                if (ptr_palette)
-                                {
-                                    *ptr_palette = palette;
-                                    decode8(dest, buffer, scansize);
-                                }
-                                else
-                                {
-                                    Bitmap indices(width, height, FORMAT_L8);
-                                    decode8(indices, buffer, scansize);
-
-                                    for (int y = 0; y < height; ++y)
-                                    {
-                                        u32* d = temp.address<u32>(0, y);
-                                        u8* s = indices.address<u8>(0, y);
-                                        for (int x = 0; x < width; ++x)
-                                        {
-                                            d[x] = palette[s[x]];
-                                        }
-                                    }
-                                    dest.blit(0, 0, temp);
-                                }
                             }
                             else
                             {
-                                decode8(temp, buffer, scansize);
-                                dest.blit(0, 0, temp);
+                                func = scan_gray8;
                             }
                             break;
                         case 3:
-                            decode24(temp, buffer, scansize);
-                            dest.blit(0, 0, temp);
+                            func = scan_planar24;
                             break;
                         case 4:
-                            decode32(temp, buffer, scansize);
-                            dest.blit(0, 0, temp);
+                            func = scan_planar32;
                             break;
                         default:
                             break;
@@ -398,6 +347,49 @@ namespace
                     break;
             }
 
+            if (!func)
+            {
+                return status;
+            }
+
+            const Palette* expand = &palette;
+
+            if (palette.size && ptr_palette)
+            {
+                // client requests for palette and the image has one
+                *ptr_palette = palette;
+                expand = nullptr;
+            }
+
+            // Scanlines are expanded straight into the destination; a scanline is
+            // staged only when it must be converted into the destination format.
+            const Format format = expand ? FORMAT_B8G8R8A8 : FORMAT_L8;
+            const bool direct = dest.format == format && dest.width >= width;
+
+            const Blitter* blitter = direct ? nullptr : &getBlitter(dest.format, format);
+            Buffer temp(direct ? 0 : width * format.bytes());
+
+            // the planes of a corrupted header can be narrower than the image
+            Buffer scanline(std::max(scansize, m_header.NPlanes * width), 0);
+
+            DecoderRLE decoder(m_memory.address + 128, m_memory.address + m_memory.size);
+
+            const int xsize = std::min(width, dest.width);
+            const int ysize = std::min(height, dest.height);
+
+            for (int y = 0; y < ysize; ++y)
+            {
+                decoder.decode(scanline, scansize);
+
+                u8* scan = direct ? dest.address(0, y) : temp.data();
+                func(scan, scanline, width, bytesPerLine, expand);
+
+                if (blitter)
+                {
+                    blitter->convert(dest.address(0, y), scan, xsize);
+                }
+            }
+
             return status;
         }
     };
@@ -416,6 +408,11 @@ namespace mango
     void registerImageDecoderPCX()
     {
         registerImageDecoder(createInterface, ".pcx");
+        registerImageSignature(".pcx", std::string("\x0a\x00\x01", 3));
+        registerImageSignature(".pcx", std::string("\x0a\x02\x01", 3));
+        registerImageSignature(".pcx", std::string("\x0a\x03\x01", 3));
+        registerImageSignature(".pcx", std::string("\x0a\x04\x01", 3));
+        registerImageSignature(".pcx", std::string("\x0a\x05\x01", 3));
     }
 
 } // namespace mango
@@ -147,9 +147,9 @@ namespace
             return m_data;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -237,6 +237,7 @@ namespace mango
     void registerImageDecoderPKM()
     {
         registerImageDecoder(createInterface, ".pkm");
+        registerImageSignature(".pkm", "PKM ");
         registerImageEncoder(imageEncode, ".pkm");
     }
 
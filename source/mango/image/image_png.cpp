@@ -2404,7 +2404,7 @@ namespace
         writeChunk(stream, u32_mask_rev('I', 'H', 'D', 'R'), buffer);
     }
 
-    void write_IDAT(Stream& stream, const Surface& surface, int level, bool filtering)
+    void compress_image(Buffer& compressed, const Surface& surface, int level, bool filtering)
     {
         // data to compress
         Buffer buffer;
@@ -2493,11 +2493,18 @@ namespace
 
         // compress
         size_t bound = zlib::bound(buffer.size());
-        Buffer compressed(bound);
+        compressed.resize(bound);
         size_t bytes_out = zlib::compress(compressed, buffer, level);
+        compressed.resize(bytes_out);
+    }
+
+    void write_IDAT(Stream& stream, const Surface& surface, int level, bool filtering)
+    {
+        Buffer compressed;
+        compress_image(compressed, surface, level, filtering);
 
         // write chunkdID + compressed data
-        writeChunk(stream, u32_mask_rev('I', 'D', 'A', 'T'), Memory(compressed, bytes_out));
+        writeChunk(stream, u32_mask_rev('I', 'D', 'A', 'T'), compressed);
     }
 
     void writePNG(Stream& stream, const Surface& surface, u8 color_bits, ColorType color_type, int level, bool filtering)
@@ -2538,8 +2545,10 @@ namespace
             return m_parser.getHeader();
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -2671,6 +2680,117 @@ namespace
         return status;
     }
 
+    // ------------------------------------------------------------
+    // AnimationEncoder
+    // ------------------------------------------------------------
+
+    // APNG; the frame count in the acTL chunk is patched when the animation is finished
+    struct AnimationInterface : AnimationEncoderInterface
+    {
+        int m_level;
+        bool m_filtering;
+        u64 m_actl_offset;
+        u32 m_sequence = 0;
+        u32 m_frames = 0;
+
+        AnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+            : m_level(options.compression)
+            , m_filtering(options.filtering)
+        {
+            BigEndianStream s(stream);
+
+            // write magic
+            s.write64(PNG_HEADER_MAGIC);
+
+            Surface canvas(width, height, FORMAT_R8G8B8A8, 0, nullptr);
+            write_IHDR(stream, canvas, 8, COLOR_TYPE_RGBA);
+
+            m_actl_offset = stream.offset();
+            write_acTL(stream);
+        }
+
+        void write_acTL(Stream& stream)
+        {
+            u8 buffer[8];
+            ustore32be(buffer + 0, m_frames);
+            ustore32be(buffer + 4, 0); // loop forever
+            writeChunk(stream, u32_mask_rev('a', 'c', 'T', 'L'), Memory(buffer, 8));
+        }
+
+        ImageEncodeStatus compress(Stream& stream, const AnimationFrame& frame) override
+        {
+            ImageEncodeStatus status;
+
+            Buffer compressed;
+            compress_image(compressed, frame.image, m_level, m_filtering);
+            stream.write(compressed);
+
+            return status;
+        }
+
+        void write(Stream& stream, const AnimationFrame& frame, ConstMemory data) override
+        {
+            // delay fraction is stored in 16 bits; fall back to milliseconds
+            u32 numerator = frame.delay_numerator;
+            u32 denominator = frame.delay_denominator;
+
+            if (numerator > 0xffff || denominator > 0xffff)
+            {
+                numerator = u32(std::min(u64(numerator) * 1000 / denominator, u64(0xffff)));
+                denominator = 1000;
+            }
+
+            u8 buffer[26];
+            ustore32be(buffer + 0, m_sequence++);
+            ustore32be(buffer + 4, frame.image.width);
+            ustore32be(buffer + 8, frame.image.height);
+            ustore32be(buffer + 12, frame.x);
+            ustore32be(buffer + 16, frame.y);
+            ustore16be(buffer + 20, u16(numerator));
+            ustore16be(buffer + 22, u16(denominator));
+            buffer[24] = 0; // dispose: none
+            buffer[25] = frame.blend ? 1 : 0; // blend: over / source
+            writeChunk(stream, u32_mask_rev('f', 'c', 'T', 'L'), Memory(buffer, 26));
+
+            if (!m_frames)
+            {
+                // the first frame is the default image
+                writeChunk(stream, u32_mask_rev('I', 'D', 'A', 'T'), Memory(const_cast<u8*>(data.address), data.size));
+            }
+            else
+            {
+                Buffer chunk(4 + data.size);
+                ustore32be(chunk, m_sequence++);
+                std::memcpy(chunk + 4, data.address, data.size);
+                writeChunk(stream, u32_mask_rev('f', 'd', 'A', 'T'), chunk);
+            }
+
+            ++m_frames;
+        }
+
+        void finish(Stream& stream) override
+        {
+            BigEndianStream s(stream);
+
+            // write IEND
+            s.write32(0);
+            s.write32(0x49454e44);
+            s.write32(0xae426082);
+
+            // patch the frame count
+            u64 end = stream.offset();
+            stream.seek(m_actl_offset, Stream::BEGIN);
+            write_acTL(stream);
+            stream.seek(end, Stream::BEGIN);
+        }
+    };
+
+    AnimationEncoderInterface* createAnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+    {
+        AnimationEncoderInterface* x = new AnimationInterface(stream, width, height, options);
+        return x;
+    }
+
 } // namespace
 
 namespace mango
@@ -2679,7 +2799,9 @@ namespace mango
     void registerImageDecoderPNG()
     {
         registerImageDecoder(createInterface, ".png");
+        registerImageSignature(".png", "\x89PNG\r\n\x1a\n");
         registerImageEncoder(imageEncode, ".png");
+        registerAnimationEncoder(createAnimationInterface, ".png");
     }
 
 } // namespace mango
@@ -500,9 +500,9 @@ namespace
             return true;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -553,6 +553,15 @@ namespace mango
         registerImageDecoder(createInterface, ".ppm");
         registerImageDecoder(createInterface, ".pam");
         registerImageDecoder(createInterface, ".pfm");
+        registerImageSignature(".pbm", "P1");
+        registerImageSignature(".pgm", "P2");
+        registerImageSignature(".ppm", "P3");
+        registerImageSignature(".pbm", "P4");
+        registerImageSignature(".pgm", "P5");
+        registerImageSignature(".ppm", "P6");
+        registerImageSignature(".pam", "P7");
+        registerImageSignature(".pfm", "Pf");
+        registerImageSignature(".pfm", "PF");
     }
 
 } // namespace mango
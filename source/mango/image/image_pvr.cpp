@@ -639,9 +639,9 @@ namespace
             return m_pvr_header.getMemory(m_memory, level, depth, face);
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
 
             ImageDecodeStatus status;
 
@@ -690,6 +690,9 @@ namespace mango
     void registerImageDecoderPVR()
     {
         registerImageDecoder(createInterface, ".pvr");
+        registerImageSignature(".pvr", "PVR\x03");
+        registerImageSignature(".pvr", "\x03RVP");
+        registerImageSignature(".pvr", "PVR!", 44);
     }
 
 } // namespace mango
@@ -90,6 +90,78 @@ namespace
         }
     };
 
+    // ------------------------------------------------------------
+    // scanline decoders
+    // ------------------------------------------------------------
+
+    // decode one channel of a scanline into every "channels" byte of dest
+    void decode_rle_scan(u8* dest, int width, int channels, const u8* src, const u8* end)
+    {
+        while (src < end && width > 0)
+        {
+            u8 pixel = *src++;
+            int count = pixel & 0x7f;
+            if (!count)
+                break;
+
+            count = std::min(count, width);
+            width -= count;
+
+            if (pixel & 0x80)
+            {
+                if (end - src < count)
+                {
+                    width += count;
+                    break;
+                }
+
+                while (count--)
+                {
+                    *dest = *src++;
+                    dest += channels;
+                }
+            }
+            else
+            {
+                if (src >= end)
+                {
+                    width += count;
+                    break;
+                }
+
+                u8 value = *src++;
+
+                while (count--)
+                {
+                    *dest = value;
+                    dest += channels;
+                }
+            }
+        }
+
+        // truncated scanline
+        for ( ; width > 0; --width)
+        {
+            *dest = 0;
+            dest += channels;
+        }
+    }
+
+    void copy_scan(u8* dest, int width, int channels, const u8* src)
+    {
+        if (channels == 1)
+        {
+            std::memcpy(dest, src, width);
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dest[x * channels] = src[x];
+            }
+        }
+    }
+
     // ------------------------------------------------------------
     // ImageDecoder
     // ------------------------------------------------------------
@@ -114,102 +186,88 @@ namespace
             return m_sgi_header.header;
         }
 
-        void decode_uncompressed(Surface& s)
+        // Decode straight into the destination when the formats match; otherwise the
+        // channels of each scanline are staged and converted into the destination format.
+        void decode_image(ImageDecodeStatus& status, const Surface& dest, const Format& format)
         {
-            int width = m_sgi_header.xsize;
-            int height = m_sgi_header.ysize;
-            int channels = m_sgi_header.zsize;
+            const int width = m_sgi_header.xsize;
+            const int height = m_sgi_header.ysize;
+            const int channels = m_sgi_header.zsize;
 
-            const u8* data = m_memory.address + 512;
-            
-            for (int channel = 0; channel < channels; ++channel)
-            {
-                for (int y = 0; y < height; ++y)
-                {
-                    int scanline = (height - 1) - y; // mirror y-axis
-                    u8* dest = s.address<u8>(0, scanline) + channel;
+            const u8* data = m_memory.address;
+            const u8* end = m_memory.address + m_memory.size;
 
-                    int offset = (y + channel * height) * width;
-                    const u8* src = data + offset;
+            const bool rle = m_sgi_header.encoding == 1;
+            const size_t num = size_t(height) * channels;
 
-                    for (int x = 0; x < width; ++x)
-                    {
-                        *dest = src[x];
-                        dest += channels;
-                    }
-                }
+            if (rle ? m_memory.size < 512 + num * 8 : m_memory.size < 512 + num * width)
+            {
+                status.setError("[ImageDecoder.SGI] Not enough data.");
+                return;
             }
-        }
 
-        void decode_rle(Surface& s)
-        {
-            int height = m_sgi_header.ysize;
-            int channels = m_sgi_header.zsize;
+            // decode scanline y of a channel into every "channels" byte of scan
+            auto decode_channel = [=] (u8* scan, int y, int channel)
+            {
+                size_t index = y + channel * size_t(height);
 
-            const u8* data = m_memory.address;
+                if (rle)
+                {
+                    // RLE offset table
+                    u32 offset = uload32be(data + 512 + index * 4);
+                    u32 size = uload32be(data + 512 + (num + index) * 4);
 
-            BigEndianConstPointer p = data + 512;
+                    const u8* src = data + std::min(size_t(offset), m_memory.size);
+                    const u8* last = src + std::min(size_t(size), size_t(end - src));
 
-            // read RLE offset table
-            int num = height * channels;
+                    decode_rle_scan(scan + channel, width, channels, src, last);
+                }
+                else
+                {
+                    copy_scan(scan + channel, width, channels, data + 512 + index * width);
+                }
+            };
 
-            std::vector<u32> offsets(num);
-            std::vector<s32> sizes(num);
+            const bool direct = dest.format == format && dest.width >= width && dest.height >= height;
 
-            for (int i = 0; i < num; ++i)
+            if (direct)
             {
-                offsets[i] = p.read32();
-            }
+                // decode the channels in the order they are stored in the file
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    for (int y = 0; y < height; ++y)
+                    {
+                        int scanline = (height - 1) - y; // mirror y-axis
+                        decode_channel(dest.address(0, scanline), y, channel);
+                    }
+                }
 
-            for (int i = 0; i < num; ++i)
-            {
-                sizes[i] = p.read32();
+                return;
             }
 
-            for (int channel = 0; channel < channels; ++channel)
-            {
-                for (int y = 0; y < height; ++y)
-                {
-                    int scanline = (height - 1) - y; // mirror y-axis
-                    u8* dest = s.address<u8>(0, scanline) + channel;
+            const Blitter& blitter = getBlitter(dest.format, format);
+            Buffer temp(width * channels);
 
-                    int index = y + channel * height;
-                    int offset = offsets[index];
-                    const u8* src = data + offset;
-                    const u8* end = src + sizes[index];
+            const int xsize = std::min(width, dest.width);
 
-                    for (; src < end;)
-                    {
-                        u8 pixel = *src++;
-                        int count = pixel & 0x7f;
-                        if (!count)
-                            break;
-
-                        if (pixel & 0x80)
-                        {
-                            while (count--)
-                            {
-                                *dest = *src++;
-                                dest += channels;
-                            }
-                        }
-                        else
-                        {
-                            pixel = *src++;
-                            while (count--)
-                            {
-                                *dest = pixel;
-                                dest += channels;
-                            }
-                        }
-                    }
+            for (int y = 0; y < height; ++y)
+            {
+                int scanline = (height - 1) - y; // mirror y-axis
+                if (scanline >= dest.height)
+                    continue;
+
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    decode_channel(temp.data(), y, channel);
                 }
+
+                blitter.convert(dest.address(0, scanline), temp.data(), xsize);
             }
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -227,32 +285,7 @@ namespace
                             dest.width >= m_sgi_header.xsize &&
                             dest.height >= m_sgi_header.ysize;
 
-            if (status.direct)
-            {
-                switch (m_sgi_header.encoding)
-                {
-                    case 0:
-                        decode_uncompressed(dest);
-                        break;
-                    case 1:
-                        decode_rle(dest);
-                        break;
-                }
-            }
-            else
-            {
-                Bitmap temp(m_sgi_header.xsize, m_sgi_header.ysize, header.format);
-                switch (m_sgi_header.encoding)
-                {
-                    case 0:
-                        decode_uncompressed(temp);
-                        break;
-                    case 1:
-                        decode_rle(temp);
-                        break;
-                }
-                dest.blit(0, 0, temp);
-            }
+            decode_image(status, dest, header.format);
 
             return status;
         }
@@ -275,6 +308,7 @@ namespace mango
         registerImageDecoder(createInterface, ".rgba");
         registerImageDecoder(createInterface, ".bw");
         registerImageDecoder(createInterface, ".sgi");
+        registerImageSignature(".sgi", "\x01\xda");
     }
 
 } // namespace mango
@@ -223,75 +223,113 @@ namespace
         }
     };
 
-    bool tga_decompress_RLE(u8* dest, const u8* p, const u8* end, int width, int height, int bpp)
+    // The packets can continue on the next scanline so the decoder keeps the state
+    // of the current packet between the scanlines.
+    struct DecoderRLE
     {
-        int x = 0;
-        int y = 0;
-        u8* scan = dest;
+        const u8* p;
+        const u8* end;
+        const u8* color = nullptr;
+        int bpp;
+        int count = 0;
+        bool run = false;
+
+        DecoderRLE(const u8* data, const u8* end, int bpp)
+            : p(data)
+            , end(end)
+            , bpp(bpp)
+        {
+        }
 
-        for ( ; y < height; )
+        bool next()
         {
             if (p >= end)
                 return false;
 
             u8 sample = *p++;
-            int count = (sample & 0x7f) + 1;
-            const u8* color = p;
+            count = (sample & 0x7f) + 1;
+            run = (sample & 0x80) != 0;
 
-            if (sample & 0x80)
+            if (run)
             {
+                if (end - p < bpp)
+                    return false;
+
+                color = p;
                 p += bpp;
             }
 
-            for ( ; count > 0; )
+            return true;
+        }
+
+        // decode width pixels of bpp bytes
+        bool decode(u8* dest, int width)
+        {
+            while (width > 0)
             {
-                // clip to right edge
-                const int size = std::min(count, width - x);
-                if (!size)
+                if (!count && !next())
                     return false;
 
-                if (sample & 0x80)
-                {
-                    if (color + size * bpp >= end)
-                        return false;
+                const int size = std::min(count, width);
 
-                    // repeat color
-                    for (int i = 0; i < size; ++i)
-                    {
-                        for (int j = 0; j < bpp; ++j)
-                        {
-                            scan[j] = color[j]; // <-- read
-                        }
-                        scan += bpp;
-                    }
+                if (run)
+                {
+                    dest = fillPixels(dest, color, bpp, size);
                 }
                 else
                 {
-                    int bytes = size * bpp;
-                    if (color + bytes >= end)
+                    const int bytes = size * bpp;
+                    if (end - p < bytes)
                         return false;
 
-                    std::memcpy(scan, color, bytes);
+                    std::memcpy(dest, p, bytes);
                     p += bytes;
-                    scan += bytes;
-                    color += bytes;
+                    dest += bytes;
                 }
 
                 count -= size;
-                x += size;
+                width -= size;
+            }
+
+            return true;
+        }
 
-                if (x >= width)
+        // decode width palette indices and expand them to 32 bit colors
+        bool decode(u8* dest, int width, const u32* colors)
+        {
+            while (width > 0)
+            {
+                if (!count && !next())
+                    return false;
+
+                const int size = std::min(count, width);
+
+                if (run)
                 {
-                    ++y;
-                    x = 0;
-                    dest += width * bpp;
-                    scan = dest;
+                    dest = fillPixels(dest, reinterpret_cast<const u8*>(colors + color[0]), 4, size);
+                }
+                else
+                {
+                    if (end - p < size)
+                        return false;
+
+                    u32* d = reinterpret_cast<u32*>(dest);
+                    for (int i = 0; i < size; ++i)
+                    {
+                        d[i] = colors[p[i]];
+                    }
+
+                    p += size;
+                    dest += size * 4;
                 }
+
+                count -= size;
+                width -= size;
             }
-        }
 
-        return true;
-    }
+            return true;
+        }
+    };
 
     // ------------------------------------------------------------
     // ImageDecoder
@@ -334,8 +372,10 @@ namespace
             return m_header;
         }
 
-        ImageDecodeStatus decode(Surface& surface, Palette* ptr_palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& surface, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
+            Palette* ptr_palette = options.palette;
+
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -439,57 +479,89 @@ namespace
                 dest.stride = -surface.stride;
             }
 
-		    std::unique_ptr<u8[]> temp;
             const u8* data = p;
             const u8* end = m_memory.address + m_memory.size;
 
-            if (m_targa_header.isRLE())
+            const bool is_palette = m_targa_header.isPalette();
+            const bool is_indices = is_palette && ptr_palette;
+
+            if (is_indices)
             {
-                temp.reset(new u8[width * height * bpp]);
-                if (!tga_decompress_RLE(temp.get(), p, end, width, height, bpp))
-                {
-                    status.setError("[ImageDecoder.TGA] RLE decoding error.");
-                    return status;
-                }
-                data = temp.get();
+                *ptr_palette = palette;
+                format = FORMAT_L8;
             }
 
-            switch (m_targa_header.image_type)
+            u32 colors[256];
+
+            if (is_palette && !is_indices)
             {
-                case IMAGETYPE_MONOCHROME:
-                case IMAGETYPE_RLE_MONOCHROME:
-                case IMAGETYPE_TRUECOLOR:
-                case IMAGETYPE_RLE_TRUECOLOR:
+                // the indices are expanded straight into the 32 bit destination formats
+                format = dest.format == FORMAT_R8G8B8A8 ? FORMAT_R8G8B8A8 : FORMAT_B8G8R8A8;
+
+                for (int i = 0; i < 256; ++i)
                 {
-                    dest.blit(0, 0, Surface(width, height, format, width * bpp, data));
-                    break;
+                    const ColorBGRA color = palette[i];
+                    colors[i] = format == FORMAT_R8G8B8A8 ? makeRGBA(color.r, color.g, color.b, color.a) : u32(color);
                 }
+            }
 
-                case IMAGETYPE_PALETTE:
-                case IMAGETYPE_RLE_PALETTE:
+            if (!m_targa_header.isRLE() && !is_palette)
+            {
+                // the image is stored in the file as it is
+                dest.blit(0, 0, Surface(width, height, format, width * bpp, data));
+            }
+            else
+            {
+                // Decode into the destination one scanline at a time; the scanline is
+                // staged only when it must be converted into the destination format.
+                const bool direct = dest.format == format && dest.width == width && dest.height == height;
+
+                const Blitter* blitter = direct ? nullptr : &getBlitter(dest.format, format);
+                Buffer buffer(direct ? 0 : width * format.bytes());
+
+                const int xsize = std::min(width, dest.width);
+                const int ysize = std::min(height, dest.height);
+
+                DecoderRLE decoder(data, end, bpp);
+
+                for (int y = 0; y < ysize; ++y)
                 {
-                    if (ptr_palette)
+                    u8* scan = direct ? dest.address(0, y) : buffer.data();
+
+                    if (m_targa_header.isRLE())
                     {
-                        *ptr_palette = palette;
-                        dest.blit(0, 0, Surface(width, height, FORMAT_L8, width, data));
+                        bool success = is_palette && !is_indices ?
+                            decoder.decode(scan, width, colors) :
+                            decoder.decode(scan, width);
+
+                        if (!success)
+                        {
+                            status.setError("[ImageDecoder.TGA] RLE decoding error.");
+                            return status;
+                        }
                     }
                     else
                     {
-                        Bitmap bitmap(width, height, FORMAT_B8G8R8A8);
+                        const u8* src = data + y * width;
 
-                        for (int y = 0; y < height; ++y)
+                        if (is_indices)
+                        {
+                            std::memcpy(scan, src, width);
+                        }
+                        else
                         {
-                            ColorBGRA* d = bitmap.address<ColorBGRA>(0, y);
-                            const u8* s = data + y * width;
+                            u32* d = reinterpret_cast<u32*>(scan);
                             for (int x = 0; x < width; ++x)
                             {
-                                d[x] = palette[s[x]];
+                                d[x] = colors[src[x]];
                             }
                         }
+                    }
 
-                        dest.blit(0, 0, bitmap);
+                    if (blitter)
+                    {
+                        blitter->convert(dest.address(0, y), scan, xsize);
                     }
-                    break;
                 }
             }
 
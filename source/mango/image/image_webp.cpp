@@ -115,9 +115,9 @@ namespace
             return m_header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -216,6 +216,135 @@ namespace
         return status;
     }
 
+    // ------------------------------------------------------------
+    // AnimationEncoder
+    // ------------------------------------------------------------
+
+    void write24(LittleEndianStream& s, u32 value)
+    {
+        s.write16(u16(value));
+        s.write8(u8(value >> 16));
+    }
+
+    // Extended file format with ANMF chunks; the RIFF size is patched when the animation is finished
+    struct AnimationInterface : AnimationEncoderInterface
+    {
+        float m_quality;
+        bool m_lossless;
+        u64 m_start;
+
+        AnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+            : m_quality(options.quality * 100.0f)
+            , m_lossless(options.lossless)
+        {
+            LittleEndianStream s = stream;
+
+            m_start = stream.offset();
+
+            s.write32(u32_mask('R', 'I', 'F', 'F'));
+            s.write32(0); // file size
+            s.write32(u32_mask('W', 'E', 'B', 'P'));
+
+            s.write32(u32_mask('V', 'P', '8', 'X'));
+            s.write32(10);
+            s.write8(0x10 | 0x02); // alpha, animation
+            write24(s, 0);
+            write24(s, width - 1);
+            write24(s, height - 1);
+
+            s.write32(u32_mask('A', 'N', 'I', 'M'));
+            s.write32(6);
+            s.write32(0); // background color
+            s.write16(0); // loop forever
+        }
+
+        int alignment() const override
+        {
+            // frame offsets are stored divided by two
+            return 2;
+        }
+
+        ImageEncodeStatus compress(Stream& stream, const AnimationFrame& frame) override
+        {
+            ImageEncodeStatus status;
+
+            WebPFormat wpformat = g_formats[0];
+
+            u8* output = nullptr;
+            size_t bytes = wpformat.encode(&output, frame.image, m_quality, m_lossless);
+
+            if (bytes > 12)
+            {
+                // Copy the chunks of the simple format file (ALPH, VP8, VP8L) into the
+                // frame and drop the RIFF header and an optional VP8X chunk.
+                LittleEndianConstPointer p = output + 12;
+                const u8* end = output + bytes;
+
+                while (p + 8 <= end)
+                {
+                    const u8* chunk = p;
+                    u32 id = p.read32();
+                    u32 size = p.read32();
+                    size = (size + 1) & ~1;
+
+                    if (p + size > end)
+                        break;
+
+                    if (id != u32_mask('V', 'P', '8', 'X'))
+                    {
+                        stream.write(chunk, size + 8);
+                    }
+
+                    p += size;
+                }
+            }
+            else
+            {
+                status.setError("[ImageEncoder.WEBP] Encoding failed.");
+            }
+
+            if (output)
+            {
+                WebPFree(output);
+            }
+
+            return status;
+        }
+
+        void write(Stream& stream, const AnimationFrame& frame, ConstMemory data) override
+        {
+            LittleEndianStream s = stream;
+
+            u64 duration = u64(frame.delay_numerator) * 1000 / frame.delay_denominator;
+
+            s.write32(u32_mask('A', 'N', 'M', 'F'));
+            s.write32(u32(16 + data.size));
+            write24(s, frame.x / 2);
+            write24(s, frame.y / 2);
+            write24(s, frame.image.width - 1);
+            write24(s, frame.image.height - 1);
+            write24(s, u32(std::min(duration, u64(0xffffff))));
+            s.write8(frame.blend ? 0x00 : 0x02); // blending: alpha-blend / do not blend, dispose: none
+            s.write(data);
+        }
+
+        void finish(Stream& stream) override
+        {
+            LittleEndianStream s = stream;
+
+            u64 end = stream.offset();
+            stream.seek(m_start + 4, Stream::BEGIN);
+            s.write32(u32(end - m_start - 8));
+            stream.seek(end, Stream::BEGIN);
+        }
+    };
+
+    AnimationEncoderInterface* createAnimationInterface(Stream& stream, int width, int height, const ImageEncodeOptions& options)
+    {
+        AnimationEncoderInterface* x = new AnimationInterface(stream, width, height, options);
+        return x;
+    }
+
 } // namespace
 
 namespace mango
@@ -224,7 +353,9 @@ namespace mango
     void registerImageDecoderWEBP()
     {
         registerImageDecoder(createInterface, ".webp");
+        registerImageSignature(".webp", "WEBP", 8);
         registerImageEncoder(imageEncode, ".webp");
+        registerAnimationEncoder(createAnimationInterface, ".webp");
     }
 
 } // namespace mango
@@ -97,9 +97,9 @@ namespace
             return m_header;
         }
 
-        ImageDecodeStatus decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        ImageDecodeStatus decode(Surface& dest, const ImageDecodeOptions& options, int level, int depth, int face) override
         {
-            MANGO_UNREFERENCED(palette);
+            MANGO_UNREFERENCED(options);
             MANGO_UNREFERENCED(level);
             MANGO_UNREFERENCED(depth);
             MANGO_UNREFERENCED(face);
@@ -193,6 +193,7 @@ namespace mango
     void registerImageDecoderZPNG()
     {
         registerImageDecoder(createInterface, ".zpng");
+        registerImageSignature(".zpng", "\xf8\xfb");
         registerImageEncoder(imageEncode, ".zpng");
     }
 
@@ -0,0 +1,476 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mango/core/buffer.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/filesystem/file.hpp>
+#include <mango/image/loader.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // batch
+    // ----------------------------------------------------------------------------
+
+    struct BatchImage
+    {
+        PooledBitmap bitmap;
+        ImageDecodeStatus status;
+        size_t bytes = 0;
+    };
+
+    // Native files are read with stdio; filesystem::File constructs a Path for every
+    // file and the Path lists the whole directory.
+    bool read_native_file(Buffer& buffer, const std::string& filename)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        bool success = false;
+
+        if (!std::fseek(file, 0, SEEK_END))
+        {
+            long size = std::ftell(file);
+            if (size >= 0 && !std::fseek(file, 0, SEEK_SET))
+            {
+                buffer.resize(size_t(size));
+                success = std::fread(buffer.data(), 1, size_t(size), file) == size_t(size);
+            }
+        }
+
+        std::fclose(file);
+        return success;
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // ImagePool
+    // ----------------------------------------------------------------------------
+
+    ImagePool::ImagePool(bool large_pages)
+        : m_large_pages(large_pages)
+    {
+    }
+
+    ImagePool::~ImagePool()
+    {
+        for (Memory memory : m_used)
+        {
+            page_free(memory);
+        }
+
+        for (Memory memory : m_free)
+        {
+            page_free(memory);
+        }
+    }
+
+    Memory ImagePool::allocate(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // smallest free buffer where the image fits
+        auto best = m_free.end();
+
+        for (auto i = m_free.begin(); i != m_free.end(); ++i)
+        {
+            if (i->size >= bytes && (best == m_free.end() || i->size < best->size))
+            {
+                best = i;
+            }
+        }
+
+        Memory memory;
+
+        if (best != m_free.end())
+        {
+            memory = *best;
+            m_free.erase(best);
+        }
+        else
+        {
+            memory = page_allocate(bytes, m_large_pages);
+            if (!memory.address)
+            {
+                return Memory();
+            }
+        }
+
+        m_used.push_back(memory);
+
+        return Memory(memory.address, bytes);
+    }
+
+    void ImagePool::release(Memory memory)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto i = std::find_if(m_used.begin(), m_used.end(), [&] (const Memory& used)
+        {
+            return used.address == memory.address;
+        });
+
+        if (i != m_used.end())
+        {
+            m_free.push_back(*i);
+            m_used.erase(i);
+        }
+    }
+
+    void ImagePool::trim()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (Memory memory : m_free)
+        {
+            page_free(memory);
+        }
+
+        m_free.clear();
+    }
+
+    // ----------------------------------------------------------------------------
+    // PooledBitmap
+    // ----------------------------------------------------------------------------
+
+    PooledBitmap::PooledBitmap()
+        : Surface(0, 0, Format(), 0, nullptr)
+        , m_allocator(nullptr)
+    {
+    }
+
+    PooledBitmap::PooledBitmap(PooledBitmap&& bitmap)
+        : Surface(bitmap)
+        , m_allocator(bitmap.m_allocator)
+        , m_memory(bitmap.m_memory)
+    {
+        // move storage ownership
+        bitmap.image = nullptr;
+        bitmap.m_allocator = nullptr;
+        bitmap.m_memory = Memory();
+    }
+
+    PooledBitmap::~PooledBitmap()
+    {
+        release();
+    }
+
+    PooledBitmap& PooledBitmap::operator = (PooledBitmap&& bitmap)
+    {
+        if (this != &bitmap)
+        {
+            release();
+
+            Surface::operator = (bitmap);
+            m_allocator = bitmap.m_allocator;
+            m_memory = bitmap.m_memory;
+
+            // move storage ownership
+            bitmap.image = nullptr;
+            bitmap.m_allocator = nullptr;
+            bitmap.m_memory = Memory();
+        }
+
+        return *this;
+    }
+
+    void PooledBitmap::release()
+    {
+        if (m_allocator)
+        {
+            m_allocator->release(m_memory);
+        }
+
+        m_allocator = nullptr;
+        m_memory = Memory();
+
+        image = nullptr;
+        width = 0;
+        height = 0;
+        stride = 0;
+    }
+
+    // ----------------------------------------------------------------------------
+    // ImageLoader
+    // ----------------------------------------------------------------------------
+
+    ImageLoader::ImageLoader(ImageAllocator& allocator)
+        : m_allocator(allocator)
+    {
+    }
+
+    ImageLoader::~ImageLoader()
+    {
+    }
+
+    ImageDecodeStatus ImageLoader::load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension, const Format* format)
+    {
+        bitmap.release();
+
+        ImageAllocator* allocator = &m_allocator;
+
+        ImageDecodeStatus status = load(memory, extension, [&] (const ImageHeader& header)
+        {
+            Format target = format ? *format : header.format;
+            int stride = header.width * target.bytes();
+
+            Memory storage = allocator->allocate(size_t(stride) * header.height);
+            if (!storage.address)
+            {
+                return Surface(0, 0, target, 0, nullptr);
+            }
+
+            Surface& surface = bitmap;
+            surface = Surface(header.width, header.height, target, stride, storage.address);
+
+            bitmap.m_allocator = allocator;
+            bitmap.m_memory = storage;
+
+            return surface;
+        });
+
+        return status;
+    }
+
+    ImageDecodeStatus ImageLoader::load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension)
+    {
+        return load(bitmap, memory, extension, nullptr);
+    }
+
+    ImageDecodeStatus ImageLoader::load(PooledBitmap& bitmap, ConstMemory memory, const std::string& extension, const Format& format)
+    {
+        return load(bitmap, memory, extension, &format);
+    }
+
+    ImageDecodeStatus ImageLoader::load(PooledBitmap& bitmap, const std::string& filename)
+    {
+        filesystem::File file(filename);
+        return load(bitmap, file, filesystem::getExtension(filename), nullptr);
+    }
+
+    ImageDecodeStatus ImageLoader::load(PooledBitmap& bitmap, const std::string& filename, const Format& format)
+    {
+        filesystem::File file(filename);
+        return load(bitmap, file, filesystem::getExtension(filename), &format);
+    }
+
+    ImageDecodeStatus ImageLoader::load(ConstMemory memory, const std::string& extension, const SurfaceCallback& callback)
+    {
+        ImageDecodeStatus status;
+
+        ImageDecoder decoder(memory, extension);
+        if (!decoder.isDecoder())
+        {
+            status.setError("[ImageLoader] Decoder not available (%s).", extension.c_str());
+            return status;
+        }
+
+        ImageHeader header = decoder.header();
+        if (!header.success)
+        {
+            status.setError(header.info);
+            return status;
+        }
+
+        Surface surface = callback(header);
+        if (!surface.image)
+        {
+            status.setError("[ImageLoader] Destination surface not available.");
+            return status;
+        }
+
+        return decoder.decode(surface);
+    }
+
+    ImageDecodeStatus ImageLoader::load(const std::string& filename, const SurfaceCallback& callback)
+    {
+        filesystem::File file(filename);
+        return load(file, filesystem::getExtension(filename), callback);
+    }
+
+    // ----------------------------------------------------------------------------
+    // ImageBatchLoader
+    // ----------------------------------------------------------------------------
+
+    ImageBatchLoader::ImageBatchLoader(ImageAllocator& allocator, const ImageBatchOptions& options)
+        : m_allocator(allocator)
+        , m_options(options)
+    {
+    }
+
+    ImageBatchLoader::~ImageBatchLoader()
+    {
+    }
+
+    void ImageBatchLoader::load(const filesystem::Path* path, const std::vector<std::string>& filenames, const Callback& callback)
+    {
+        // enough files in flight to keep every thread busy while the callback runs
+        const size_t max_files = std::max(4, ThreadPool::getHardwareConcurrency() * 4);
+
+        std::mutex pending_mutex;
+        std::condition_variable pending_condition;
+        size_t pending_files = 0;
+        size_t pending_bytes = 0;
+
+        auto reserve = [&] (size_t bytes, size_t released)
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            pending_bytes = pending_bytes + bytes - released;
+        };
+
+        auto process = [&] (size_t index)
+        {
+            auto image = std::make_shared<BatchImage>();
+
+            const std::string& name = filenames[index];
+            std::string filename = path ? path->pathname() + name : name;
+
+            try
+            {
+                Buffer buffer;
+                std::unique_ptr<filesystem::File> file;
+                ConstMemory memory;
+
+                if (read_native_file(buffer, filename))
+                {
+                    memory = buffer;
+                }
+                else
+                {
+                    // containers are mapped by the filesystem
+                    file.reset(path ? new filesystem::File(*path, name) : new filesystem::File(name));
+                    memory = *file;
+                }
+
+                reserve(memory.size, 0);
+
+                ImageLoader loader(m_allocator);
+                std::string extension = filesystem::getExtension(name);
+
+                if (m_options.format.bits)
+                {
+                    image->status = loader.load(image->bitmap, memory, extension, m_options.format);
+                }
+                else
+                {
+                    image->status = loader.load(image->bitmap, memory, extension);
+                }
+
+                image->bytes = size_t(image->bitmap.stride) * image->bitmap.height;
+                reserve(image->bytes, memory.size);
+            }
+            catch (const Exception& exception)
+            {
+                image->status.setError(exception.what());
+            }
+
+            return image;
+        };
+
+        auto deliver = [&] (size_t index, BatchImage& image)
+        {
+            callback(index, filenames[index], image.bitmap, image.status);
+            image.bitmap.release();
+
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            --pending_files;
+            pending_bytes -= image.bytes;
+            pending_condition.notify_one();
+        };
+
+        ConcurrentQueue queue("image.batch", Priority::HIGH);
+        TicketQueue tickets;
+        std::mutex callback_mutex;
+
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            {
+                // the first pending file is always scheduled so that a single image
+                // larger than max_memory still loads
+                std::unique_lock<std::mutex> lock(pending_mutex);
+                pending_condition.wait(lock, [&]
+                {
+                    return !pending_files || (pending_files < max_files && pending_bytes < m_options.max_memory);
+                });
+                ++pending_files;
+            }
+
+            if (m_options.ordered)
+            {
+                TicketQueue::Ticket ticket = tickets.acquire();
+
+                queue.enqueue([&process, &deliver, ticket, i]
+                {
+                    std::shared_ptr<BatchImage> image = process(i);
+                    ticket.consume([&deliver, image, i]
+                    {
+                        deliver(i, *image);
+                    });
+                });
+            }
+            else
+            {
+                queue.enqueue([&process, &deliver, &callback_mutex, i]
+                {
+                    std::shared_ptr<BatchImage> image = process(i);
+                    std::lock_guard<std::mutex> lock(callback_mutex);
+                    deliver(i, *image);
+                });
+            }
+        }
+
+        queue.wait();
+        tickets.wait();
+    }
+
+    void ImageBatchLoader::load(const std::vector<std::string>& filenames, const Callback& callback)
+    {
+        load(nullptr, filenames, callback);
+    }
+
+    void ImageBatchLoader::load(const filesystem::Path& path, const Callback& callback)
+    {
+        std::vector<std::string> filenames;
+
+        for (auto& node : path)
+        {
+            if (!node.isDirectory())
+            {
+                filenames.push_back(node.name);
+            }
+        }
+
+        load(&path, filenames, callback);
+    }
+
+    void ImageBatchLoader::load(const filesystem::Path& path, const filesystem::FileIndex& index, const Callback& callback)
+    {
+        std::vector<std::string> filenames;
+
+        for (auto& node : index)
+        {
+            if (!node.isDirectory())
+            {
+                filenames.push_back(node.name);
+            }
+        }
+
+        load(&path, filenames, callback);
+    }
+
+} // namespace mango
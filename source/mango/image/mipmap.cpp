@@ -0,0 +1,449 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <mango/core/thread.hpp>
+#include <mango/core/bits.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/blitter.hpp>
+#include <mango/image/mipmap.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // reduction filter
+    // ----------------------------------------------------------------------------
+
+    // Every level is half the size of the previous level (rounded down). Even dimensions are
+    // reduced with a 2-tap box filter and odd dimensions with a 3-tap filter which covers the
+    // exact footprint of the destination sample, so that no source sample is dropped.
+
+    int reduce_weights(int size, int i, int* index, float* weight)
+    {
+        if (size == 1)
+        {
+            index[0] = 0;
+            weight[0] = 1.0f;
+            return 1;
+        }
+
+        if (!(size & 1))
+        {
+            index[0] = i * 2 + 0;
+            index[1] = i * 2 + 1;
+            weight[0] = 0.5f;
+            weight[1] = 0.5f;
+            return 2;
+        }
+
+        const int m = size / 2;
+        const float s = 1.0f / float(size);
+
+        index[0] = i * 2 + 0;
+        index[1] = i * 2 + 1;
+        index[2] = i * 2 + 2;
+        weight[0] = float(m - i) * s;
+        weight[1] = float(m) * s;
+        weight[2] = float(i + 1) * s;
+        return 3;
+    }
+
+    void reduce_horizontal(float32x4* dest, const float32x4* src, int width, int sourceWidth)
+    {
+        if (!(sourceWidth & 1))
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dest[x] = (src[x * 2 + 0] + src[x * 2 + 1]) * 0.5f;
+            }
+            return;
+        }
+
+        int index[3];
+        float weight[3];
+
+        for (int x = 0; x < width; ++x)
+        {
+            const int count = reduce_weights(sourceWidth, x, index, weight);
+
+            float32x4 a(0.0f);
+
+            for (int i = 0; i < count; ++i)
+            {
+                a = madd(a, src[index[i]], weight[i]);
+            }
+
+            dest[x] = a;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // Level
+    // ----------------------------------------------------------------------------
+
+    // The levels are computed in linear RGBA32F from the previous level; the previous level
+    // is the smallest one computed so far so it is still in the cache.
+
+    struct Level
+    {
+        std::vector<float32x4> image;
+        int width;
+        int height;
+
+        Level(int width, int height)
+            : image(size_t(width) * height)
+            , width(width)
+            , height(height)
+        {
+        }
+
+        float32x4* row(int y)
+        {
+            return image.data() + size_t(y) * width;
+        }
+
+        const float32x4* row(int y) const
+        {
+            return image.data() + size_t(y) * width;
+        }
+    };
+
+    struct BaseDecoder
+    {
+        const Surface& surface;
+        const Blitter& blitter;
+        bool srgb;
+
+        BaseDecoder(const Surface& surface, bool srgb)
+            : surface(surface)
+            , blitter(getBlitter(FORMAT_RGBA32F, surface.format))
+            , srgb(srgb)
+        {
+        }
+
+        void decode(float32x4* dest, int y) const
+        {
+            BlitRect rect;
+
+            rect.src.address = surface.address(0, y);
+            rect.src.stride = surface.stride;
+            rect.dest.address = reinterpret_cast<u8*>(dest);
+            rect.dest.stride = surface.width * sizeof(float32x4);
+            rect.width = surface.width;
+            rect.height = 1;
+
+            blitter.convert(rect);
+
+            if (srgb)
+            {
+                for (int x = 0; x < surface.width; ++x)
+                {
+                    float32x4 v = dest[x];
+                    const float alpha = v.w;
+                    v = srgb_to_linear(v);
+                    v.w = alpha;
+                    dest[x] = v;
+                }
+            }
+        }
+    };
+
+    // Compute level from the previous level; the base level is decoded one scanline at a time.
+    void reduce(Level& dest, const Level* prev, const BaseDecoder& base)
+    {
+        const int sourceWidth = prev ? prev->width : base.surface.width;
+        const int sourceHeight = prev ? prev->height : base.surface.height;
+
+        const int slice = std::max(1, 65536 / dest.width);
+
+        ConcurrentQueue queue("mipmap", Priority::HIGH);
+
+        for (int y = 0; y < dest.height; y += slice)
+        {
+            queue.enqueue([=, &dest, &base]
+            {
+                const int y0 = y;
+                const int y1 = std::min(y + slice, dest.height);
+
+                std::vector<float32x4> scan(prev ? 0 : sourceWidth);
+                std::vector<float32x4> temp(dest.width);
+
+                for (int j = y0; j < y1; ++j)
+                {
+                    int index[3];
+                    float weight[3];
+                    const int count = reduce_weights(sourceHeight, j, index, weight);
+
+                    float32x4* d = dest.row(j);
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const float32x4* src;
+
+                        if (prev)
+                        {
+                            src = prev->row(index[i]);
+                        }
+                        else
+                        {
+                            base.decode(scan.data(), index[i]);
+                            src = scan.data();
+                        }
+
+                        reduce_horizontal(temp.data(), src, dest.width, sourceWidth);
+
+                        for (int x = 0; x < dest.width; ++x)
+                        {
+                            d[x] = i ? madd(d[x], temp[x], weight[i]) : temp[x] * weight[i];
+                        }
+                    }
+                }
+            });
+        }
+
+        queue.wait();
+    }
+
+    // ----------------------------------------------------------------------------
+    // alpha coverage
+    // ----------------------------------------------------------------------------
+
+    // Alpha tested geometry gets thinner in the smaller levels because the filtering averages
+    // the alpha towards the reference value. The alpha is scaled so that the fraction of samples
+    // which pass the test is the same as in the base level.
+
+    float compute_coverage(const float* alpha, size_t count, float scale, float reference)
+    {
+        size_t pass = 0;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            pass += alpha[i] * scale > reference;
+        }
+
+        return float(pass) / float(count);
+    }
+
+    float compute_alpha_scale(const Level& level, float coverage, float reference)
+    {
+        const size_t count = level.image.size();
+
+        std::vector<float> alpha(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            alpha[i] = level.image[i].w;
+        }
+
+        float low = 0.0f;
+        float high = 4.0f;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const float mid = (low + high) * 0.5f;
+            if (compute_coverage(alpha.data(), count, mid, reference) < coverage)
+                low = mid;
+            else
+                high = mid;
+        }
+
+        return (low + high) * 0.5f;
+    }
+
+    // ----------------------------------------------------------------------------
+    // encode
+    // ----------------------------------------------------------------------------
+
+    void encode(const Surface& dest, const Level& level, const MipmapOptions& options, float alphaScale)
+    {
+        const Blitter& blitter = getBlitter(dest.format, FORMAT_RGBA32F);
+
+        std::vector<float32x4> scan(level.width);
+
+        for (int y = 0; y < level.height; ++y)
+        {
+            const float32x4* src = level.row(y);
+
+            for (int x = 0; x < level.width; ++x)
+            {
+                float32x4 v = src[x];
+                const float alpha = std::min(1.0f, v.w * alphaScale);
+
+                if (options.normalmap)
+                {
+                    float32x3 n = float32x3(v.x, v.y, v.z) * 2.0f - 1.0f;
+                    const float s = dot(n, n);
+                    if (s > 0.0f)
+                    {
+                        n = n * (1.0f / std::sqrt(s));
+                    }
+                    n = n * 0.5f + 0.5f;
+                    v = float32x4(n, alpha);
+                }
+
+                if (options.srgb)
+                {
+                    v = linear_to_srgb(max(v, float32x4(0.0f)));
+                }
+
+                v.w = alpha;
+                scan[x] = v;
+            }
+
+            BlitRect rect;
+
+            rect.src.address = reinterpret_cast<u8*>(scan.data());
+            rect.src.stride = level.width * sizeof(float32x4);
+            rect.dest.address = dest.address(0, y);
+            rect.dest.stride = dest.stride;
+            rect.width = level.width;
+            rect.height = 1;
+
+            blitter.convert(rect);
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // MipmapChain
+    // ----------------------------------------------------------------------------
+
+    MipmapChain::MipmapChain(const Surface& base, const MipmapOptions& options)
+        : m_base(base)
+    {
+        if (base.width < 1 || base.height < 1)
+            return;
+
+        int levels = 1 + u32_log2(std::max(base.width, base.height));
+        if (options.levels > 0)
+        {
+            levels = std::min(levels, options.levels);
+        }
+
+        const BaseDecoder decoder(base, options.srgb);
+
+        const bool coverage = options.alphaCoverage > 0.0f && base.format.isAlpha();
+        float baseCoverage = 0.0f;
+
+        if (coverage)
+        {
+            std::vector<float32x4> scan(base.width);
+            size_t pass = 0;
+
+            for (int y = 0; y < base.height; ++y)
+            {
+                decoder.decode(scan.data(), y);
+                for (int x = 0; x < base.width; ++x)
+                {
+                    pass += scan[x].w > options.alphaCoverage;
+                }
+            }
+
+            baseCoverage = float(pass) / float(size_t(base.width) * base.height);
+        }
+
+        std::unique_ptr<Level> prev;
+
+        for (int i = 1; i < levels; ++i)
+        {
+            const int width = std::max(1, base.width >> i);
+            const int height = std::max(1, base.height >> i);
+
+            std::unique_ptr<Level> level(new Level(width, height));
+            reduce(*level, prev.get(), decoder);
+
+            const float alphaScale = coverage ? compute_alpha_scale(*level, baseCoverage, options.alphaCoverage) : 1.0f;
+
+            Bitmap* bitmap = new Bitmap(width, height, base.format);
+            m_levels.emplace_back(bitmap);
+
+            encode(*bitmap, *level, options, alphaScale);
+
+            prev = std::move(level);
+        }
+    }
+
+    MipmapChain::~MipmapChain()
+    {
+    }
+
+    int MipmapChain::getLevelCount() const
+    {
+        return m_base.width > 0 ? int(m_levels.size()) + 1 : 0;
+    }
+
+    const Surface& MipmapChain::getLevel(int level) const
+    {
+        if (level <= 0)
+            return m_base;
+        return *m_levels[std::min(level, int(m_levels.size())) - 1];
+    }
+
+    size_t MipmapChain::getCompressedSize(const TextureCompressionInfo& info) const
+    {
+        size_t bytes = 0;
+
+        for (int i = 0; i < getLevelCount(); ++i)
+        {
+            const Surface& level = getLevel(i);
+            const int xblocks = ceil_div(level.width, info.width);
+            const int yblocks = ceil_div(level.height, info.height);
+            bytes += size_t(xblocks) * yblocks * info.bytes;
+        }
+
+        return bytes;
+    }
+
+    TextureCompressionStatus MipmapChain::compress(Memory memory, const TextureCompressionInfo& info, TextureCompressionQuality quality) const
+    {
+        TextureCompressionStatus status;
+
+        if (memory.size < getCompressedSize(info))
+        {
+            status.setError("Not enough memory for the compressed levels.");
+            return status;
+        }
+
+        const int count = getLevelCount();
+        std::vector<TextureCompressionStatus> results(count);
+
+        ConcurrentQueue queue("mipmap.compress", Priority::HIGH);
+
+        u8* address = memory.address;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Surface& level = getLevel(i);
+            const int xblocks = ceil_div(level.width, info.width);
+            const int yblocks = ceil_div(level.height, info.height);
+            const size_t bytes = size_t(xblocks) * yblocks * info.bytes;
+
+            // the compressor enqueues the block rows into the same thread pool
+            queue.enqueue([&info, &level, &results, i, address, bytes, quality]
+            {
+                results[i] = info.compress(Memory(address, bytes), level, quality);
+            });
+
+            address += bytes;
+        }
+
+        queue.wait();
+
+        for (auto& result : results)
+        {
+            if (!result)
+                return result;
+        }
+
+        status.direct = results.empty() ? false : results[0].direct;
+        return status;
+    }
+
+} // namespace mango
@@ -0,0 +1,182 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <mango/core/buffer.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/filesystem/file.hpp>
+#include <mango/image/probe.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // probe
+    // ----------------------------------------------------------------------------
+
+    // The header of almost every file fits in here; EXIF in JPEG is at most 64 KB
+    constexpr size_t PROBE_SIZE = 64 * 1024;
+
+    // Marker and chunk lengths near the end of the window can point outside of it;
+    // the zero padding keeps the reads of the header parsers inside the buffer.
+    constexpr size_t PROBE_PADDING = 64 * 1024 + 16;
+
+    // files per ThreadPool task
+    constexpr size_t PROBE_BATCH = 32;
+
+    void probe_memory(ImageProbe& probe, ConstMemory memory)
+    {
+        ImageDecoder decoder(memory, probe.filename);
+        if (!decoder.isDecoder())
+        {
+            probe.header.setError("[ImageProbe] Unsupported format (%s).", probe.filename.c_str());
+            return;
+        }
+
+        probe.extension = detectImageFormat(memory, probe.filename);
+        probe.header = decoder.header();
+
+        if (probe.header.success)
+        {
+            ConstMemory exif_memory = decoder.exif();
+            if (exif_memory.address)
+            {
+                image::Exif exif(exif_memory);
+                if (exif.Orientation >= 1 && exif.Orientation <= 8)
+                {
+                    probe.orientation = exif.Orientation;
+                }
+            }
+        }
+    }
+
+    void probe_file(ImageProbe& probe, Buffer& buffer, const filesystem::Path& path)
+    {
+        std::string pathname = path.pathname() + probe.filename;
+
+        try
+        {
+            std::FILE* file = std::fopen(pathname.c_str(), "rb");
+            if (file)
+            {
+                // native file: read only the beginning
+                size_t bytes = std::fread(buffer.data(), 1, PROBE_SIZE, file);
+                std::fclose(file);
+
+                std::memset(buffer.data() + bytes, 0, PROBE_PADDING);
+                probe_memory(probe, ConstMemory(buffer.data(), bytes));
+
+                if (probe.header.success || bytes < PROBE_SIZE || probe.extension.empty())
+                {
+                    return;
+                }
+
+                // the header did not fit in the window; use the whole file
+                probe.header = ImageHeader();
+            }
+
+            // containers are mapped by the filesystem
+            filesystem::File mapped(path, probe.filename);
+            probe_memory(probe, mapped);
+        }
+        catch (const Exception& exception)
+        {
+            probe.header.setError(exception.what());
+        }
+    }
+
+    std::vector<ImageProbe> probe_files(const filesystem::Path& path, const std::vector<std::string>& filenames)
+    {
+        std::vector<ImageProbe> probes(filenames.size());
+
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            probes[i].filename = filenames[i];
+        }
+
+        auto probe_batch = [&probes, &path] (size_t first, size_t last)
+        {
+            Buffer buffer(PROBE_SIZE + PROBE_PADDING);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                probe_file(probes[i], buffer, path);
+            }
+        };
+
+        ConcurrentQueue queue("image.probe", Priority::HIGH);
+
+        for (size_t first = 0; first < probes.size(); first += PROBE_BATCH)
+        {
+            size_t last = std::min(first + PROBE_BATCH, probes.size());
+
+            queue.enqueue([&probe_batch, first, last]
+            {
+                probe_batch(first, last);
+            });
+        }
+
+        queue.wait();
+
+        return probes;
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    ImageProbe probeImage(ConstMemory memory, const std::string& filename)
+    {
+        ImageProbe probe;
+        probe.filename = filename;
+        probe_memory(probe, memory);
+        return probe;
+    }
+
+    ImageProbe probeImage(const filesystem::Path& path, const std::string& filename)
+    {
+        ImageProbe probe;
+        probe.filename = filename;
+
+        Buffer buffer(PROBE_SIZE + PROBE_PADDING);
+        probe_file(probe, buffer, path);
+
+        return probe;
+    }
+
+    std::vector<ImageProbe> probeImages(const filesystem::Path& path)
+    {
+        std::vector<std::string> filenames;
+
+        for (auto& node : path)
+        {
+            if (!node.isDirectory())
+            {
+                filenames.push_back(node.name);
+            }
+        }
+
+        return probe_files(path, filenames);
+    }
+
+    std::vector<ImageProbe> probeImages(const filesystem::Path& path, const filesystem::FileIndex& index)
+    {
+        std::vector<std::string> filenames;
+
+        for (auto& node : index)
+        {
+            if (!node.isDirectory())
+            {
+                filenames.push_back(node.name);
+            }
+        }
+
+        return probe_files(path, filenames);
+    }
+
+} // namespace mango
@@ -2,11 +2,12 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
-/*
-    Original NeuQuant implementation (C) 1994 Anthony Becker
-    Based on Self Organizing Map (SOM) neural network algorithm by Kohonen
-*/
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <mango/core/bits.hpp>
+#include <mango/core/thread.hpp>
 #include <mango/math/math.hpp>
 #include <mango/core/exception.hpp>
 #include <mango/image/quantize.hpp>
@@ -16,283 +17,488 @@ namespace
     using namespace mango;
 
     // ------------------------------------------------------------
-    // constants
+    // color cells
     // ------------------------------------------------------------
 
-    enum
+    // The color space is divided into 32x32x32 cells; the histogram and the inverse
+    // color map are both indexed with the cell.
+
+    constexpr int CELL_BITS = 5;
+    constexpr int CELL_SHIFT = 8 - CELL_BITS;
+    constexpr int CELL_COUNT = 1 << (CELL_BITS * 3);
+    constexpr int CELL_SIZE = 1 << CELL_SHIFT;
+
+    inline int cell_index(int r, int g, int b)
     {
-        NETSIZE = 256,
-        INITRAD = NETSIZE >> 3
-    };
+        return ((r >> CELL_SHIFT) << (CELL_BITS * 2)) | ((g >> CELL_SHIFT) << CELL_BITS) | (b >> CELL_SHIFT);
+    }
 
-    #define prime1		    499
-    #define prime2		    491
-    #define prime3		    487
-    #define prime4		    503
+    const Format& getQuantizeFormat()
+    {
+        static const Format format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8);
+        return format;
+    }
 
-    #define netbiasshift	4
-    #define ncycles			100
+    // ------------------------------------------------------------
+    // PaletteVectors
+    // ------------------------------------------------------------
 
-    #define intbiasshift    16
-    #define intbias			(((int) 1) << intbiasshift)
-    #define gammashift  	10
-    #define gamma   		(((int) 1) << gammashift)
-    #define betashift  		10
-    #define beta			(intbias >> betashift)
-    #define betagamma		(intbias << (gammashift - betashift))
+    // structure-of-arrays palette; the padding is far away so it is never nearest
 
-    #define radiusbiasshift	6
-    #define radiusbias		(((int) 1) << radiusbiasshift)
-    #define initradius		(INITRAD * radiusbias)
-    #define radiusdec		30
+    struct PaletteVectors
+    {
+        int size;
+        int padded;
+        std::vector<float> r;
+        std::vector<float> g;
+        std::vector<float> b;
+
+        PaletteVectors(const Palette& palette)
+            : size(std::max(1, int(palette.size)))
+            , padded((size + 3) & ~3)
+            , r(padded, 1e9f)
+            , g(padded, 1e9f)
+            , b(padded, 1e9f)
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                r[i] = palette[i].r;
+                g[i] = palette[i].g;
+                b[i] = palette[i].b;
+            }
+        }
 
-    #define alphabiasshift	10
-    #define initalpha		(((int) 1) << alphabiasshift)
+        int nearest(float red, float green, float blue) const
+        {
+            const float32x4 sr(red);
+            const float32x4 sg(green);
+            const float32x4 sb(blue);
+
+            float32x4 bestd(std::numeric_limits<float>::max());
+            float32x4 besti(0.0f);
+            float32x4 index(0.0f, 1.0f, 2.0f, 3.0f);
+
+            for (int i = 0; i < padded; i += 4)
+            {
+                const float32x4 dr = float32x4(simd::f32x4_uload(&r[i])) - sr;
+                const float32x4 dg = float32x4(simd::f32x4_uload(&g[i])) - sg;
+                const float32x4 db = float32x4(simd::f32x4_uload(&b[i])) - sb;
+                const float32x4 d = dr * dr + dg * dg + db * db;
+
+                const mask32x4 mask = d < bestd;
+                bestd = select(mask, d, bestd);
+                besti = select(mask, index, besti);
+                index = index + 4.0f;
+            }
+
+            float distance[4];
+            float position[4];
+            simd::f32x4_ustore(distance, bestd);
+            simd::f32x4_ustore(position, besti);
+
+            int lane = 0;
+            for (int i = 1; i < 4; ++i)
+            {
+                if (distance[i] < distance[lane] || (distance[i] == distance[lane] && position[i] < position[lane]))
+                {
+                    lane = i;
+                }
+            }
 
-    #define radbiasshift	8
-    #define alpharadbshift  (alphabiasshift + radbiasshift)
+            return int(position[lane]);
+        }
+    };
 
     // ------------------------------------------------------------
-    // NeuQuant
+    // inverse color map
     // ------------------------------------------------------------
 
-    struct NeuQuant
+    // Every cell stores the palette entries which can be nearest to some color inside the
+    // cell: an entry qualifies when its distance to the cell is not larger than the smallest
+    // distance to the far corner of the cell of any entry. The candidates are stored as
+    // (color, distance to the cell) pairs in increasing distance order so the search can
+    // stop at the first candidate which cannot be closer than the best one so far.
+
+    inline u32 pack_candidate(const Palette& palette, int index)
     {
-        u8* m_image;
-        int m_length_count;
-        int m_sample_factor; // 1..30
-
-        int network[NETSIZE][4];
-        int bias[NETSIZE];
-        int freq[NETSIZE];
-        int radpower[INITRAD];
-
-        NeuQuant(u8* image, int length, int sample_factor);
-        ~NeuQuant();
-
-        int contest(int r, int g, int b);
-        void alterSingle(int alpha, int i, int r, int g, int b);
-        void alterNeigh(int rad, int i, int r, int g, int b);
-        void learn();
-        void unbias();
-    };
+        const ColorBGRA color = palette[index];
+        return u32(color.r) | (u32(color.g) << 8) | (u32(color.b) << 16) | (u32(index) << 24);
+    }
 
-    NeuQuant::NeuQuant(u8* image, int length, int sample_factor)
+    void build_inverse_map(std::vector<u32>& offset, std::vector<u32>& candidate, const Palette& palette)
     {
-        m_image = image;
-        m_length_count = length;
-        m_sample_factor = sample_factor;
+        const PaletteVectors vectors(palette);
+        const int size = vectors.size;
+        const int padded = vectors.padded;
+
+        constexpr int slabs = 1 << CELL_BITS;
+        constexpr int slabCells = CELL_COUNT / slabs;
+
+        std::vector<std::vector<u32>> slab(slabs);
+        std::vector<u32> count(CELL_COUNT);
+
+        ConcurrentQueue queue("quantize.map", Priority::HIGH);
+
+        for (int cr = 0; cr < slabs; ++cr)
+        {
+            queue.enqueue([&, cr]
+            {
+                std::vector<float> mindist(padded);
+                std::vector<std::pair<u32, u32>> sorted;
+                std::vector<u32>& output = slab[cr];
+
+                const float32x4 zero(0.0f);
+                const float32x4 rlo(float(cr * CELL_SIZE));
+                const float32x4 rhi(float(cr * CELL_SIZE + CELL_SIZE - 1));
+
+                for (int cg = 0; cg < slabs; ++cg)
+                {
+                    const float32x4 glo(float(cg * CELL_SIZE));
+                    const float32x4 ghi(float(cg * CELL_SIZE + CELL_SIZE - 1));
+
+                    for (int cb = 0; cb < slabs; ++cb)
+                    {
+                        const float32x4 blo(float(cb * CELL_SIZE));
+                        const float32x4 bhi(float(cb * CELL_SIZE + CELL_SIZE - 1));
+
+                        float32x4 best(std::numeric_limits<float>::max());
+
+                        for (int i = 0; i < padded; i += 4)
+                        {
+                            const float32x4 r = simd::f32x4_uload(&vectors.r[i]);
+                            const float32x4 g = simd::f32x4_uload(&vectors.g[i]);
+                            const float32x4 b = simd::f32x4_uload(&vectors.b[i]);
+
+                            // distance to the cell
+                            const float32x4 dr = max(max(rlo - r, r - rhi), zero);
+                            const float32x4 dg = max(max(glo - g, g - ghi), zero);
+                            const float32x4 db = max(max(blo - b, b - bhi), zero);
+                            simd::f32x4_ustore(&mindist[i], dr * dr + dg * dg + db * db);
+
+                            // distance to the farthest corner of the cell
+                            const float32x4 fr = max(abs(r - rlo), abs(r - rhi));
+                            const float32x4 fg = max(abs(g - glo), abs(g - ghi));
+                            const float32x4 fb = max(abs(b - blo), abs(b - bhi));
+                            best = min(best, fr * fr + fg * fg + fb * fb);
+                        }
+
+                        const float limit = std::min(std::min(float(best.x), float(best.y)),
+                                                     std::min(float(best.z), float(best.w)));
+
+                        sorted.clear();
+
+                        for (int i = 0; i < size; ++i)
+                        {
+                            if (mindist[i] <= limit)
+                            {
+                                sorted.emplace_back(u32(mindist[i]), u32(i));
+                            }
+                        }
+
+                        std::sort(sorted.begin(), sorted.end());
+
+                        for (auto& c : sorted)
+                        {
+                            output.push_back(pack_candidate(palette, c.second));
+                            output.push_back(c.first);
+                        }
+
+                        count[cr * slabCells + cg * slabs + cb] = u32(sorted.size() * 2);
+                    }
+                }
+            });
+        }
+
+        queue.wait();
 
-        for (int i = 0; i < NETSIZE; ++i)
+        offset.resize(CELL_COUNT + 1);
+        offset[0] = 0;
+
+        for (int i = 0; i < CELL_COUNT; ++i)
         {
-            int* p = network[i];
-            p[0] = p[1] = p[2] = (i << (netbiasshift + 8)) / NETSIZE;
-            freq[i] = intbias / NETSIZE;
-            bias[i] = 0;
+            offset[i + 1] = offset[i] + count[i];
         }
 
-        learn();
-        unbias();
-    }
+        candidate.resize(offset[CELL_COUNT]);
 
-    NeuQuant::~NeuQuant()
-    {
+        for (int cr = 0; cr < slabs; ++cr)
+        {
+            std::copy(slab[cr].begin(), slab[cr].end(), candidate.begin() + offset[cr * slabCells]);
+        }
     }
 
-    int NeuQuant::contest(int r, int g, int b)
+    inline int find_nearest(const u32* offset, const u32* candidate, int r, int g, int b)
     {
-        int	bestd = ~(((int)1) << 31);
-        int	bestbiasd = bestd;
-        int	bestpos = -1;
-        int	bestbiaspos = bestpos;
-        int* p = bias;
-        int* f = freq;
-
-        for (int i = 0; i < NETSIZE; ++i)
-        {
-            const int* n = network[i];
-            int dist = std::abs(n[0] - b) +
-                       std::abs(n[1] - g) +
-                       std::abs(n[2] - r);
+        const int cell = cell_index(r, g, b);
+        const u32* c = candidate + offset[cell];
+        const u32* end = candidate + offset[cell + 1];
 
-            if (dist < bestd)
-            {
-                bestd = dist;
-                bestpos = i;
-            }
+        u32 best = c[0];
+        if (end - c == 2)
+            return best >> 24;
 
-            int biasdist = dist - ((*p) >> (intbiasshift - netbiasshift));
-            if (biasdist < bestbiasd)
+        int bestd = std::numeric_limits<int>::max();
+
+        for ( ; c < end && int(c[1]) < bestd; c += 2)
+        {
+            const u32 color = c[0];
+            const int dr = int(color & 0xff) - r;
+            const int dg = int((color >> 8) & 0xff) - g;
+            const int db = int((color >> 16) & 0xff) - b;
+            const int d = dr * dr + dg * dg + db * db;
+            if (d < bestd)
             {
-                bestbiasd = biasdist;
-                bestbiaspos = i;
+                bestd = d;
+                best = color;
             }
-
-            int betafreq = (*f >> betashift);
-            *f++ -= betafreq;
-            *p++ +=(betafreq << gammashift);
         }
 
-        freq[bestpos] += beta;
-        bias[bestpos] -= betagamma;
-
-        return bestbiaspos;
+        return best >> 24;
     }
 
-    void NeuQuant::alterSingle(int alpha, int i, int r, int g, int b)
+    // ------------------------------------------------------------
+    // histogram
+    // ------------------------------------------------------------
+
+    struct Bin
     {
-        int* n = network[i];
-        n[0] -= (alpha * (n[0] - b)) >> alphabiasshift;
-        n[1] -= (alpha * (n[1] - g)) >> alphabiasshift;
-        n[2] -= (alpha * (n[2] - r)) >> alphabiasshift;
-    }
+        float color[3]; // average color in the cell (r, g, b)
+        float weight;   // number of samples in the cell
+    };
+
+    struct CellSum
+    {
+        u64 r = 0;
+        u64 g = 0;
+        u64 b = 0;
+        u32 count = 0;
+    };
 
-    void NeuQuant::alterNeigh(int rad, int i, int r, int g, int b)
+    std::vector<Bin> compute_histogram(const Surface& surface, int step)
     {
-        const int lo = std::max(i - rad, -1);
-        const int hi = std::min(i + rad, int(NETSIZE));
-        int	j = i + 1;
-        int	k = i - 1;
+        const int width = surface.width;
+        const int height = surface.height;
+
+        const int bands = std::max(1, std::min(ThreadPool::getHardwareConcurrency(), height / 64));
+        std::vector<std::vector<CellSum>> histogram(bands);
+
+        ConcurrentQueue queue("quantize.histogram", Priority::HIGH);
+
+        for (int band = 0; band < bands; ++band)
+        {
+            queue.enqueue([&, band]
+            {
+                std::vector<CellSum>& cells = histogram[band];
+                cells.resize(CELL_COUNT);
 
-        const int* q = radpower;
-        while ((j < hi) || (k > lo))
+                const int y0 = height * band / bands;
+                const int y1 = height * (band + 1) / bands;
+
+                for (int y = y0; y < y1; y += step)
+                {
+                    const ColorBGRA* s = surface.address<ColorBGRA>(0, y);
+
+                    for (int x = 0; x < width; x += step)
+                    {
+                        const ColorBGRA color = s[x];
+                        CellSum& cell = cells[cell_index(color.r, color.g, color.b)];
+                        cell.r += color.r;
+                        cell.g += color.g;
+                        cell.b += color.b;
+                        ++cell.count;
+                    }
+                }
+            });
+        }
+
+        queue.wait();
+
+        std::vector<Bin> bins;
+
+        for (int i = 0; i < CELL_COUNT; ++i)
         {
-            int* p;
-            int	a = *(++q);
+            CellSum sum;
 
-            if (j < hi)
+            for (int band = 0; band < bands; ++band)
             {
-                p = network[j++];
-                p[0] -= (a * (p[0] - b)) >> alpharadbshift;
-                p[1] -= (a * (p[1] - g)) >> alpharadbshift;
-                p[2] -= (a * (p[2] - r)) >> alpharadbshift;
+                const CellSum& cell = histogram[band][i];
+                sum.r += cell.r;
+                sum.g += cell.g;
+                sum.b += cell.b;
+                sum.count += cell.count;
             }
-            if (k > lo)
+
+            if (sum.count)
             {
-                p = network[k--];
-                p[0] -= (a * (p[0] - b)) >> alpharadbshift;
-                p[1] -= (a * (p[1] - g)) >> alpharadbshift;
-                p[2] -= (a * (p[2] - r)) >> alpharadbshift;
+                const float scale = 1.0f / float(sum.count);
+
+                Bin bin;
+                bin.color[0] = float(sum.r) * scale;
+                bin.color[1] = float(sum.g) * scale;
+                bin.color[2] = float(sum.b) * scale;
+                bin.weight = float(sum.count);
+                bins.push_back(bin);
             }
         }
+
+        return bins;
     }
 
-    void NeuQuant::learn()
+    // ------------------------------------------------------------
+    // median cut
+    // ------------------------------------------------------------
+
+    struct ColorBox
     {
-        const int alphadec = 30 + ((m_sample_factor - 1) / 3);
+        int begin;
+        int end;
+        float mean[3];
+        float error; // weighted squared error
+        int axis;    // axis with the largest error
+    };
+
+    ColorBox compute_box(const Bin* bins, int begin, int end)
+    {
+        ColorBox box;
+        box.begin = begin;
+        box.end = end;
 
-        u8*	p = m_image;
-        u8*	lim = m_image + m_length_count;
-        int samplepixels = m_length_count / (4 * m_sample_factor);
-        int delta = samplepixels / ncycles;
-        int alpha = initalpha;
-        int radius = initradius;
+        double sum[3] = { 0, 0, 0 };
+        double sum2[3] = { 0, 0, 0 };
+        double weight = 0;
 
-        int rad = radius >> radiusbiasshift;
-        if (rad > 1)
+        for (int i = begin; i < end; ++i)
         {
-            int	radrad = rad * rad;
-            int	adder = 1;
-            int	bigalpha = (alpha << radbiasshift) / radrad;
-
-            for (int i = 0; i < rad; ++i)
+            const Bin& bin = bins[i];
+            for (int j = 0; j < 3; ++j)
             {
-                radpower[i] = bigalpha * radrad;
-                radrad -= adder;
-                adder += 2;
+                sum[j] += bin.color[j] * bin.weight;
+                sum2[j] += bin.color[j] * bin.color[j] * bin.weight;
             }
-        }
-        else
-        {
-            rad = 0;
+            weight += bin.weight;
         }
 
-        int	step;
-        if (m_length_count % prime1)
-        {
-            step = 4 * prime1;
-        }
-        else
+        box.error = 0.0f;
+        box.axis = 0;
+
+        float largest = -1.0f;
+
+        for (int j = 0; j < 3; ++j)
         {
-            if (m_length_count % prime2)
+            box.mean[j] = float(sum[j] / weight);
+            const float error = float(sum2[j] - sum[j] * sum[j] / weight);
+            box.error += std::max(0.0f, error);
+            if (error > largest)
             {
-                step = 4 * prime2;
-            }
-            else
-            {
-                if (m_length_count % prime3)
-                {
-                    step = 4 * prime3;
-                }
-                else
-                {
-                    step = 4 * prime4;
-                }
+                largest = error;
+                box.axis = j;
             }
         }
 
-        int j, b, g, r;
-        int i = 0;
-        int	phase = 0;
-        while (i++ < samplepixels)
+        // boxes with a single bin cannot be split
+        if (end - begin < 2)
         {
-            b = p[0] << netbiasshift;
-            g = p[1] << netbiasshift;
-            r = p[2] << netbiasshift;
-            j = contest(r, g, b);
+            box.error = 0.0f;
+        }
 
-            alterSingle(alpha, j, r, g, b);
-            if (rad)
-            {
-                alterNeigh(rad, j, r, g, b);
-            }
+        return box;
+    }
 
-            p += step;
-            while (p >= lim)
+    std::vector<ColorBox> median_cut(std::vector<Bin>& bins, int colors)
+    {
+        std::vector<ColorBox> boxes;
+        if (bins.empty())
+            return boxes;
+
+        boxes.push_back(compute_box(bins.data(), 0, int(bins.size())));
+
+        while (int(boxes.size()) < colors)
+        {
+            // split the box with the largest error
+            auto it = std::max_element(boxes.begin(), boxes.end(), [] (const ColorBox& a, const ColorBox& b)
             {
-                p -= m_length_count;
-            }
+                return a.error < b.error;
+            });
 
-            if (++phase == delta)
+            if (it->error <= 0.0f)
+                break;
+
+            const ColorBox box = *it;
+            const int axis = box.axis;
+
+            std::sort(bins.begin() + box.begin, bins.begin() + box.end, [axis] (const Bin& a, const Bin& b)
             {
-                phase = 0;
+                return a.color[axis] < b.color[axis];
+            });
 
-                alpha -= alpha / alphadec;
-                radius -= radius / radiusdec;
-                rad = radius >> radiusbiasshift;
+            float total = 0.0f;
+            for (int i = box.begin; i < box.end; ++i)
+            {
+                total += bins[i].weight;
+            }
 
-                if (rad > 1)
-                {
-                    int	radrad = rad * rad;
-                    int	adder = 1;
-                    int	bigalpha = (alpha << radbiasshift) / radrad;
+            // weighted median
+            int split = box.begin + 1;
+            float weight = bins[box.begin].weight;
 
-                    for (int k = 0; k < rad; ++k)
-                    {
-                        radpower[k] = bigalpha * radrad;
-                        radrad -= adder;
-                        adder += 2;
-                    }
-                }
-                else
-                {
-                    rad = 0;
-                }
+            while (split < box.end - 1 && weight + bins[split].weight <= total * 0.5f)
+            {
+                weight += bins[split].weight;
+                ++split;
             }
+
+            *it = compute_box(bins.data(), box.begin, split);
+            boxes.push_back(compute_box(bins.data(), split, box.end));
         }
+
+        return boxes;
     }
 
-    void NeuQuant::unbias()
+    // ------------------------------------------------------------
+    // k-means
+    // ------------------------------------------------------------
+
+    // Refine the median cut palette with k-means iterations over the histogram bins.
+
+    void refine_palette(Palette& palette, const std::vector<Bin>& bins, int iterations)
     {
-        for (int i = 0; i < NETSIZE; ++i)
+        std::vector<int> assignment(bins.size(), -1);
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
         {
-            for (int j = 0; j < 3; ++j)
+            const PaletteVectors vectors(palette);
+
+            double sum[256][4] = { };
+            bool changed = false;
+
+            for (size_t i = 0; i < bins.size(); ++i)
             {
-                constexpr int bias = 1 << (netbiasshift - 1);
-                network[i][j] = clamp((network[i][j] + bias) >> netbiasshift, 0, 255);
+                const Bin& bin = bins[i];
+                const int index = vectors.nearest(bin.color[0], bin.color[1], bin.color[2]);
+
+                changed |= assignment[i] != index;
+                assignment[i] = index;
+
+                sum[index][0] += bin.color[0] * bin.weight;
+                sum[index][1] += bin.color[1] * bin.weight;
+                sum[index][2] += bin.color[2] * bin.weight;
+                sum[index][3] += bin.weight;
             }
 
-            network[i][3] = i;
+            if (!changed)
+                break;
+
+            for (u32 i = 0; i < palette.size; ++i)
+            {
+                // empty clusters keep their color
+                if (sum[i][3] > 0.0)
+                {
+                    const double scale = 1.0 / sum[i][3];
+                    palette[i].r = u8(clamp(int(sum[i][0] * scale + 0.5), 0, 255));
+                    palette[i].g = u8(clamp(int(sum[i][1] * scale + 0.5), 0, 255));
+                    palette[i].b = u8(clamp(int(sum[i][2] * scale + 0.5), 0, 255));
+                }
+            }
         }
     }
 
@@ -304,41 +510,41 @@ namespace image {
     ColorQuantizer::ColorQuantizer(const Surface& source, float quality)
     {
         quality = clamp(quality, 0.0f, 1.0f);
-        int sample_factor = std::max(1, 30 - int(quality * 29.0f + 1.0f));
 
-        Bitmap temp(source, Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8));
-        NeuQuant nq(temp.image, temp.width * temp.height * 4, sample_factor);
+        // quality trades histogram sampling and k-means iterations for speed
+        const int step = quality < 0.5f ? 2 : 1;
+        const int iterations = 1 + int(quality * 7.0f);
+
+        Bitmap temp(source, getQuantizeFormat());
+        std::vector<Bin> bins = compute_histogram(temp, step);
 
-        m_palette.size = NETSIZE;
+        std::vector<ColorBox> boxes = median_cut(bins, 256);
 
-        for (int i = 0; i < NETSIZE; ++i)
+        m_palette.size = 256;
+
+        for (int i = 0; i < 256; ++i)
         {
-            m_palette.color[i].b = nq.network[i][0];
-            m_palette.color[i].g = nq.network[i][1];
-            m_palette.color[i].r = nq.network[i][2];
-            m_palette.color[i].a = 0xff;
-
-            m_network[i][0] = nq.network[i][0];
-            m_network[i][1] = nq.network[i][1];
-            m_network[i][2] = nq.network[i][2];
-            m_network[i][3] = nq.network[i][3];
+            ColorBGRA& color = m_palette.color[i];
+            color = ColorBGRA(0, 0, 0, 0xff);
+
+            if (!boxes.empty())
+            {
+                // unused entries repeat the last color
+                const ColorBox& box = boxes[std::min(i, int(boxes.size()) - 1)];
+                color.r = u8(clamp(int(box.mean[0] + 0.5f), 0, 255));
+                color.g = u8(clamp(int(box.mean[1] + 0.5f), 0, 255));
+                color.b = u8(clamp(int(box.mean[2] + 0.5f), 0, 255));
+            }
         }
 
+        refine_palette(m_palette, bins, iterations);
+
         buildIndex();
     }
 
     ColorQuantizer::ColorQuantizer(const Palette& palette)
     {
         m_palette = palette;
-
-        for (int i = 0; i < NETSIZE; ++i)
-        {
-            m_network[i][0] = palette[i].b;
-            m_network[i][1] = palette[i].g;
-            m_network[i][2] = palette[i].r;
-            m_network[i][3] = i;
-        }
-
         buildIndex();
     }
 
@@ -363,173 +569,147 @@ namespace image {
             MANGO_EXCEPTION("[ColorQuantizer] The destination and source dimensions must be identical.");
         }
 
-        Bitmap temp(source, Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8));
+        Bitmap temp(source, getQuantizeFormat());
 
-        int width = temp.width;
-        int height = temp.height;
+        const int width = temp.width;
+        const int height = temp.height;
 
-        for (int y = 0; y < height; ++y)
+        if (!dithering)
         {
-            ColorBGRA* s = temp.address<ColorBGRA>(0, y + 0);
-            ColorBGRA* n = temp.address<ColorBGRA>(0, y + 1);
-            u8* d = dest.address<u8>(0, y);
+            ConcurrentQueue queue("quantize", Priority::HIGH);
 
-            for (int x = 0; x < width; ++x)
+            for (int y0 = 0; y0 < height; y0 += 64)
             {
-                int r = s[x].r;
-                int g = s[x].g;
-                int b = s[x].b;
-                u8 index = getIndex(r, g, b);
-                d[x] = index;
-
-                if (dithering)
+                queue.enqueue([=, &temp, &dest]
                 {
-                    // quantization error
-                    r -= m_palette[index].r;
-                    g -= m_palette[index].g;
-                    b -= m_palette[index].b;
+                    const int y1 = std::min(y0 + 64, height);
 
-                    // distribute the error to neighbouring pixels with Floyd-Steinberg weights
-                    if (x < width - 1)
+                    for (int y = y0; y < y1; ++y)
                     {
-                        s[x + 1].r = clamp(s[x + 1].r + (r * 7 / 16), 0, 255);
-                        s[x + 1].g = clamp(s[x + 1].g + (g * 7 / 16), 0, 255);
-                        s[x + 1].b = clamp(s[x + 1].b + (b * 7 / 16), 0, 255);
+                        const ColorBGRA* s = temp.address<ColorBGRA>(0, y);
+                        u8* d = dest.address<u8>(0, y);
 
-                        if (y < height - 1)
+                        for (int x = 0; x < width; ++x)
                         {
-                            if (x > 0)
-                            {
-                                n[x - 1].r = clamp(n[x - 1].r + (r * 3 / 16), 0, 255);
-                                n[x - 1].g = clamp(n[x - 1].g + (g * 3 / 16), 0, 255);
-                                n[x - 1].b = clamp(n[x - 1].b + (b * 3 / 16), 0, 255);
-                            }
-
-                            n[x + 0].r = clamp(n[x + 0].r + (r * 5 / 16), 0, 255);
-                            n[x + 0].g = clamp(n[x + 0].g + (g * 5 / 16), 0, 255);
-                            n[x + 0].b = clamp(n[x + 0].b + (b * 5 / 16), 0, 255);
-
-                            n[x + 1].r = clamp(n[x + 1].r + (r * 1 / 16), 0, 255);
-                            n[x + 1].g = clamp(n[x + 1].g + (g * 1 / 16), 0, 255);
-                            n[x + 1].b = clamp(n[x + 1].b + (b * 1 / 16), 0, 255);
+                            d[x] = u8(getIndex(s[x].r, s[x].g, s[x].b));
                         }
                     }
-                }
+                });
             }
+
+            queue.wait();
+            return;
         }
-    }
 
-    void ColorQuantizer::buildIndex()
-    {
-        int previouscol = 0;
-        int startpos = 0;
+        // Floyd-Steinberg error diffusion as a wavefront: a scanline can be processed up to
+        // one pixel behind the previous scanline. The workers take the scanlines in order and
+        // publish their progress in chunks, so the oldest unfinished scanline never waits.
+        constexpr int chunk = 64;
 
-        for (int i = 0; i < NETSIZE; ++i)
+        std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[height]);
+        for (int y = 0; y < height; ++y)
         {
-            int* p = m_network[i];
-            int smallpos = i;
-            int smallval = p[1];
-
-            int* q;
-            for (int j = i + 1; j < NETSIZE; ++j)
-            {
-                q = m_network[j];
-                if (q[1] < smallval)
-                {
-                    smallpos = j;
-                    smallval = q[1];
-                }
-            }
-            q = m_network[smallpos];
-
-            if (i != smallpos)
-            {
-                std::swap(q[0], p[0]);
-                std::swap(q[1], p[1]);
-                std::swap(q[2], p[2]);
-                std::swap(q[3], p[3]);
-            }
-
-            if (smallval != previouscol)
-            {
-                m_netindex[previouscol] = (startpos + i) >> 1;
-                for (int j = previouscol + 1; j < smallval; ++j)
-                {
-                    m_netindex[j] = i;
-                }
-                previouscol = smallval;
-                startpos = i;
-            }
+            progress[y].store(0, std::memory_order_relaxed);
         }
 
-        m_netindex[previouscol] = (startpos + (NETSIZE - 1)) >> 1;
-        for (int j = previouscol + 1; j < 256; ++j)
-        {
-            m_netindex[j] = NETSIZE - 1;
-        }
-    }
+        std::atomic<int> next { 0 };
 
-    int ColorQuantizer::getIndex(int r, int g, int b) const
-    {
-        int	bestd = 1000;
-        int	best = -1;
-        int	i = m_netindex[g];
-        int	j = i - 1;
+        ConcurrentQueue queue("quantize.dither", Priority::HIGH);
 
-        while ((i < NETSIZE) || (j >= 0))
+        const int workers = std::max(1, std::min(height, ThreadPool::getHardwareConcurrency()));
+
+        for (int i = 0; i < workers; ++i)
         {
-            if (i < NETSIZE)
+            queue.enqueue([&]
             {
-                const int* p = m_network[i];
-                int dist = p[1] - g;
-                if (dist >= bestd)
-                {
-                    i = NETSIZE;
-                }
-                else
+                for (int y = next++; y < height; y = next++)
                 {
-                    ++i;
-                    if (dist < 0) dist = -dist;
-                    dist += std::abs(p[0] - b);
-                    if (dist < bestd)
+                    ColorBGRA* s = temp.address<ColorBGRA>(0, y);
+                    ColorBGRA* n = y < height - 1 ? temp.address<ColorBGRA>(0, y + 1) : nullptr;
+                    u8* d = dest.address<u8>(0, y);
+
+                    // error carried to the next pixel on the scanline
+                    int cr = 0;
+                    int cg = 0;
+                    int cb = 0;
+
+                    for (int x0 = 0; x0 < width; x0 += chunk)
                     {
-                        dist += std::abs(p[2] - r);
-                        if (dist < bestd)
+                        const int x1 = std::min(x0 + chunk, width);
+
+                        if (y > 0)
                         {
-                            bestd = dist;
-                            best = p[3];
+                            // the previous scanline must have distributed its error up to x1
+                            const int required = std::min(x1 + 1, width);
+                            while (progress[y - 1].load(std::memory_order_acquire) < required)
+                            {
+                                std::this_thread::yield();
+                            }
                         }
-                    }
-                }
-            }
 
-            if (j >= 0)
-            {
-                const int* p = m_network[j];
-                int dist = g - p[1];
-                if (dist >= bestd)
-                {
-                    j = -1;
-                }
-                else
-                {
-                    --j;
-                    if (dist < 0) dist = -dist;
-                    dist += std::abs(p[0] - b);
-                    if (dist < bestd)
-                    {
-                        dist += std::abs(p[2] - r);
-                        if (dist < bestd)
+                        for (int x = x0; x < x1; ++x)
                         {
-                            bestd = dist;
-                            best = p[3];
+                            int r = clamp(s[x].r + cr, 0, 255);
+                            int g = clamp(s[x].g + cg, 0, 255);
+                            int b = clamp(s[x].b + cb, 0, 255);
+
+                            const int index = getIndex(r, g, b);
+                            d[x] = u8(index);
+
+                            // quantization error
+                            r -= m_palette[index].r;
+                            g -= m_palette[index].g;
+                            b -= m_palette[index].b;
+
+                            // distribute the error to neighbouring pixels with Floyd-Steinberg weights
+                            cr = r * 7 / 16;
+                            cg = g * 7 / 16;
+                            cb = b * 7 / 16;
+
+                            if (n)
+                            {
+                                if (x > 0)
+                                {
+                                    n[x - 1].r = clamp(n[x - 1].r + (r * 3 / 16), 0, 255);
+                                    n[x - 1].g = clamp(n[x - 1].g + (g * 3 / 16), 0, 255);
+                                    n[x - 1].b = clamp(n[x - 1].b + (b * 3 / 16), 0, 255);
+                                }
+
+                                n[x + 0].r = clamp(n[x + 0].r + (r * 5 / 16), 0, 255);
+                                n[x + 0].g = clamp(n[x + 0].g + (g * 5 / 16), 0, 255);
+                                n[x + 0].b = clamp(n[x + 0].b + (b * 5 / 16), 0, 255);
+
+                                if (x < width - 1)
+                                {
+                                    n[x + 1].r = clamp(n[x + 1].r + (r * 1 / 16), 0, 255);
+                                    n[x + 1].g = clamp(n[x + 1].g + (g * 1 / 16), 0, 255);
+                                    n[x + 1].b = clamp(n[x + 1].b + (b * 1 / 16), 0, 255);
+                                }
+                            }
                         }
+
+                        progress[y].store(x1, std::memory_order_release);
                     }
                 }
-            }
+            });
+        }
+
+        queue.wait();
+    }
+
+    void ColorQuantizer::buildIndex()
+    {
+        if (!m_palette.size)
+        {
+            m_palette.size = 256;
         }
 
-        return best;
+        build_inverse_map(m_offset, m_candidate, m_palette);
+    }
+
+    int ColorQuantizer::getIndex(int r, int g, int b) const
+    {
+        return find_nearest(m_offset.data(), m_candidate.data(), r, g, b);
     }
 
 } // namespace image
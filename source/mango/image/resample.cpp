@@ -0,0 +1,374 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <mango/core/thread.hpp>
+#include <mango/core/memory.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/blitter.hpp>
+#include <mango/image/resample.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // filters
+    // ----------------------------------------------------------------------------
+
+    float sinc(float x)
+    {
+        x *= float(math::pi);
+        if (std::abs(x) < 1e-5f)
+            return 1.0f;
+        return std::sin(x) / x;
+    }
+
+    float cubic(float x, float B, float C)
+    {
+        // Mitchell-Netravali family of cubic filters
+        x = std::abs(x);
+        const float x2 = x * x;
+        const float x3 = x2 * x;
+
+        if (x < 1.0f)
+        {
+            return ((12.0f - 9.0f * B - 6.0f * C) * x3 +
+                    (-18.0f + 12.0f * B + 6.0f * C) * x2 +
+                    (6.0f - 2.0f * B)) * (1.0f / 6.0f);
+        }
+
+        if (x < 2.0f)
+        {
+            return ((-B - 6.0f * C) * x3 +
+                    (6.0f * B + 30.0f * C) * x2 +
+                    (-12.0f * B - 48.0f * C) * x +
+                    (8.0f * B + 24.0f * C)) * (1.0f / 6.0f);
+        }
+
+        return 0.0f;
+    }
+
+    float filter_box(float x)
+    {
+        return (x > -0.5f && x <= 0.5f) ? 1.0f : 0.0f;
+    }
+
+    float filter_triangle(float x)
+    {
+        x = std::abs(x);
+        return x < 1.0f ? 1.0f - x : 0.0f;
+    }
+
+    float filter_catmull_rom(float x)
+    {
+        return cubic(x, 0.0f, 0.5f);
+    }
+
+    float filter_mitchell(float x)
+    {
+        return cubic(x, 1.0f / 3.0f, 1.0f / 3.0f);
+    }
+
+    float filter_lanczos3(float x)
+    {
+        x = std::abs(x);
+        return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+    }
+
+    struct Filter
+    {
+        float (*func)(float x);
+        float support;
+    };
+
+    Filter getFilter(ResampleOptions::Filter filter)
+    {
+        switch (filter)
+        {
+            case ResampleOptions::BOX:         return { filter_box, 0.5f };
+            case ResampleOptions::TRIANGLE:    return { filter_triangle, 1.0f };
+            case ResampleOptions::CATMULL_ROM: return { filter_catmull_rom, 2.0f };
+            case ResampleOptions::MITCHELL:    return { filter_mitchell, 2.0f };
+            case ResampleOptions::LANCZOS3:    return { filter_lanczos3, 3.0f };
+        }
+        return { filter_mitchell, 2.0f };
+    }
+
+    // ----------------------------------------------------------------------------
+    // Contributors
+    // ----------------------------------------------------------------------------
+
+    // The filter weights are computed once for every destination sample (one phase per sample);
+    // the weights for samples outside the source are folded into the edge sample.
+
+    struct Contributors
+    {
+        std::vector<int> start;
+        std::vector<int> count;
+        std::vector<float> weights;
+        int taps;
+
+        Contributors(int destSize, int sourceSize, const Filter& filter)
+        {
+            const float scale = float(destSize) / float(sourceSize);
+            const float filterScale = std::max(1.0f, 1.0f / scale);
+            const float support = filter.support * filterScale;
+
+            taps = int(std::ceil(support * 2.0f)) + 2;
+
+            start.resize(destSize);
+            count.resize(destSize);
+            weights.resize(destSize * taps, 0.0f);
+
+            for (int i = 0; i < destSize; ++i)
+            {
+                const float center = (i + 0.5f) / scale;
+                const int left = int(std::floor(center - support));
+                const int right = int(std::ceil(center + support));
+
+                const int first = clamp(left, 0, sourceSize - 1);
+                const int last = clamp(right, 0, sourceSize - 1);
+
+                float* weight = &weights[i * taps];
+                float total = 0.0f;
+
+                for (int j = left; j <= right; ++j)
+                {
+                    const float w = filter.func((j + 0.5f - center) / filterScale);
+                    const int k = clamp(j, first, last) - first;
+                    if (k < taps)
+                    {
+                        weight[k] += w;
+                        total += w;
+                    }
+                }
+
+                int n = std::min(last - first + 1, taps);
+
+                // trim the zero weights at the end
+                while (n > 1 && weight[n - 1] == 0.0f)
+                {
+                    --n;
+                }
+
+                if (total != 0.0f)
+                {
+                    const float s = 1.0f / total;
+                    for (int k = 0; k < n; ++k)
+                    {
+                        weight[k] *= s;
+                    }
+                }
+
+                start[i] = first;
+                count[i] = n;
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // scanline processing
+    // ----------------------------------------------------------------------------
+
+    struct ResampleContext
+    {
+        bool srgb;
+        bool premultiply;
+
+        void decode(float32x4* scan, int count) const
+        {
+            for (int x = 0; x < count; ++x)
+            {
+                float32x4 v = scan[x];
+                const float alpha = v.w;
+
+                if (srgb)
+                {
+                    v = srgb_to_linear(v);
+                    v.w = alpha;
+                }
+
+                if (premultiply)
+                {
+                    v = v * float32x4(alpha, alpha, alpha, 1.0f);
+                }
+
+                scan[x] = v;
+            }
+        }
+
+        void encode(float32x4* scan, int count) const
+        {
+            for (int x = 0; x < count; ++x)
+            {
+                float32x4 v = scan[x];
+                const float alpha = clamp(float(v.w), 0.0f, 1.0f);
+
+                if (premultiply)
+                {
+                    const float s = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+                    v = v * float32x4(s, s, s, 1.0f);
+                }
+
+                if (srgb)
+                {
+                    v = linear_to_srgb(max(v, float32x4(0.0f)));
+                    v.w = alpha;
+                }
+
+                scan[x] = v;
+            }
+        }
+    };
+
+    void filter_horizontal(float32x4* dest, const float32x4* src, const Contributors& contrib, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float32x4* s = src + contrib.start[x];
+            const float* weight = &contrib.weights[x * contrib.taps];
+            const int count = contrib.count[x];
+
+            float32x4 a(0.0f);
+
+            for (int i = 0; i < count; ++i)
+            {
+                a = madd(a, s[i], weight[i]);
+            }
+
+            dest[x] = a;
+        }
+    }
+
+    void filter_vertical(float32x4* dest, const float32x4* src, int stride, const float* weight, int count, int width)
+    {
+        // the scanline is processed as a float array; eight floats (two pixels) at a time
+        float* d = reinterpret_cast<float*>(dest);
+        const float* s = reinterpret_cast<const float*>(src);
+        const int floats = width * 4;
+        const int xcount = floats & ~7;
+
+        for (int x = 0; x < xcount; x += 8)
+        {
+            float32x8 a(0.0f);
+
+            for (int i = 0; i < count; ++i)
+            {
+                float32x8 v = simd::f32x8_uload(s + i * stride * 4 + x);
+                a = madd(a, v, float32x8(weight[i]));
+            }
+
+            simd::f32x8_ustore(d + x, a);
+        }
+
+        for (int x = xcount; x < floats; x += 4)
+        {
+            float32x4 a(0.0f);
+
+            for (int i = 0; i < count; ++i)
+            {
+                float32x4 v = simd::f32x4_uload(s + i * stride * 4 + x);
+                a = madd(a, v, float32x4(weight[i]));
+            }
+
+            simd::f32x4_ustore(d + x, a);
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void resample(const Surface& dest, const Surface& source, const ResampleOptions& options)
+    {
+        if (dest.width < 1 || dest.height < 1 || source.width < 1 || source.height < 1)
+            return;
+
+        const Filter filter = getFilter(options.filter);
+        const Contributors xcontrib(dest.width, source.width, filter);
+        const Contributors ycontrib(dest.height, source.height, filter);
+
+        ResampleContext context;
+        context.srgb = options.srgb;
+        context.premultiply = !options.premultiplied && source.format.isAlpha();
+
+        const Blitter& decoder = getBlitter(FORMAT_RGBA32F, source.format);
+        const Blitter& encoder = getBlitter(dest.format, FORMAT_RGBA32F);
+
+        // horizontally filtered source scanlines
+        AlignedStorage<float32x4> temp(size_t(dest.width) * source.height);
+
+        const int slice = 32;
+
+        ConcurrentQueue queue("resample", Priority::HIGH);
+
+        for (int y = 0; y < source.height; y += slice)
+        {
+            queue.enqueue([=, &temp, &xcontrib, &context, &decoder, &source, &dest]
+            {
+                const int y0 = y;
+                const int y1 = std::min(y + slice, source.height);
+
+                std::vector<float32x4> scan(source.width);
+
+                for (int i = y0; i < y1; ++i)
+                {
+                    BlitRect rect;
+
+                    rect.src.address = source.address(0, i);
+                    rect.src.stride = source.stride;
+                    rect.dest.address = reinterpret_cast<u8*>(scan.data());
+                    rect.dest.stride = source.width * sizeof(float32x4);
+                    rect.width = source.width;
+                    rect.height = 1;
+
+                    decoder.convert(rect);
+                    context.decode(scan.data(), source.width);
+
+                    filter_horizontal(temp + size_t(i) * dest.width, scan.data(), xcontrib, dest.width);
+                }
+            });
+        }
+
+        queue.wait();
+
+        for (int y = 0; y < dest.height; y += slice)
+        {
+            queue.enqueue([=, &temp, &ycontrib, &context, &encoder, &dest]
+            {
+                const int y0 = y;
+                const int y1 = std::min(y + slice, dest.height);
+
+                std::vector<float32x4> scan(dest.width);
+
+                for (int i = y0; i < y1; ++i)
+                {
+                    const float32x4* src = temp + size_t(ycontrib.start[i]) * dest.width;
+                    const float* weight = &ycontrib.weights[i * ycontrib.taps];
+
+                    filter_vertical(scan.data(), src, dest.width, weight, ycontrib.count[i], dest.width);
+                    context.encode(scan.data(), dest.width);
+
+                    BlitRect rect;
+
+                    rect.src.address = reinterpret_cast<u8*>(scan.data());
+                    rect.src.stride = dest.width * sizeof(float32x4);
+                    rect.dest.address = dest.address(0, i);
+                    rect.dest.stride = dest.stride;
+                    rect.width = dest.width;
+                    rect.height = 1;
+
+                    encoder.convert(rect);
+                }
+            });
+        }
+
+        queue.wait();
+    }
+
+} // namespace mango
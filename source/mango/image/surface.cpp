@@ -103,6 +103,20 @@ namespace
     void clear_u24_scan(u8* dest, int count, u32 color)
     {
         u24 value24 = color;
+
+        if (count >= 32)
+        {
+            // 16 pixels are 48 bytes; the copy is three 128 bit stores
+            u8 pattern[48];
+            u8_fill(pattern, 16, value24);
+
+            for ( ; count >= 16; count -= 16)
+            {
+                std::memcpy(dest, pattern, 48);
+                dest += 48;
+            }
+        }
+
         u8_fill(dest, count, value24);
     }
 
@@ -173,6 +187,259 @@ namespace
         return size;
     }
 
+    // ----------------------------------------------------------------------------
+    // orient
+    // ----------------------------------------------------------------------------
+
+    template <int N>
+    struct Pixel
+    {
+        u8 data[N];
+    };
+
+    template <int N>
+    void orient_block(u8* dest, int xstep, int ystep, const u8* src, int stride, int width, int height)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            const Pixel<N>* s = reinterpret_cast<const Pixel<N>*>(src + y * stride);
+            u8* d = dest + y * ystep;
+
+            for (int x = 0; x < width; ++x)
+            {
+                *reinterpret_cast<Pixel<N>*>(d) = s[x];
+                d += xstep;
+            }
+        }
+    }
+
+    void orient_block_bytes(u8* dest, int xstep, int ystep, const u8* src, int stride, int width, int height, int bytes)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            const u8* s = src + y * stride;
+            u8* d = dest + y * ystep;
+
+            for (int x = 0; x < width; ++x)
+            {
+                std::memcpy(d, s, bytes);
+                s += bytes;
+                d += xstep;
+            }
+        }
+    }
+
+    // The source scanlines are columns in the destination (ystep is +4 or -4 bytes);
+    // 4x4 pixels are transposed in registers and stored as destination scanlines.
+    void orient_block_transpose32(u8* dest, int xstep, int ystep, const u8* src, int stride, int width, int height)
+    {
+        const int xblocks = width & ~3;
+        const int yblocks = height & ~3;
+
+        for (int y = 0; y < yblocks; y += 4)
+        {
+            const u8* s = src + y * stride;
+
+            // the reversed columns are stored from the last source scanline of the block
+            u8* d = dest + (ystep < 0 ? y + 3 : y) * ystep;
+
+            for (int x = 0; x < xblocks; x += 4)
+            {
+                simd::u32x4 r0 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + stride * 0));
+                simd::u32x4 r1 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + stride * 1));
+                simd::u32x4 r2 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + stride * 2));
+                simd::u32x4 r3 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + stride * 3));
+
+                simd::u64x2 t0 = simd::reinterpret<simd::u64x2>(simd::unpacklo(r0, r1));
+                simd::u64x2 t1 = simd::reinterpret<simd::u64x2>(simd::unpacklo(r2, r3));
+                simd::u64x2 t2 = simd::reinterpret<simd::u64x2>(simd::unpackhi(r0, r1));
+                simd::u64x2 t3 = simd::reinterpret<simd::u64x2>(simd::unpackhi(r2, r3));
+
+                simd::u32x4 c0 = simd::reinterpret<simd::u32x4>(simd::unpacklo(t0, t1));
+                simd::u32x4 c1 = simd::reinterpret<simd::u32x4>(simd::unpackhi(t0, t1));
+                simd::u32x4 c2 = simd::reinterpret<simd::u32x4>(simd::unpacklo(t2, t3));
+                simd::u32x4 c3 = simd::reinterpret<simd::u32x4>(simd::unpackhi(t2, t3));
+
+                if (ystep < 0)
+                {
+                    c0 = simd::shuffle<3, 2, 1, 0>(c0);
+                    c1 = simd::shuffle<3, 2, 1, 0>(c1);
+                    c2 = simd::shuffle<3, 2, 1, 0>(c2);
+                    c3 = simd::shuffle<3, 2, 1, 0>(c3);
+                }
+
+                simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 0), c0);
+                simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 1), c1);
+                simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 2), c2);
+                simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 3), c3);
+
+                s += 16;
+                d += xstep * 4;
+            }
+        }
+
+        // right and bottom edges
+        orient_block<4>(dest + xblocks * xstep, xstep, ystep, src + xblocks * 4, stride, width - xblocks, yblocks);
+        orient_block<4>(dest + yblocks * ystep, xstep, ystep, src + yblocks * stride, stride, width, height - yblocks);
+    }
+
+    // The source scanlines are reversed in the destination (xstep is -4 bytes).
+    void orient_block_reverse32(u8* dest, int ystep, const u8* src, int stride, int width, int height)
+    {
+        const int xblocks = width & ~3;
+
+        for (int y = 0; y < height; ++y)
+        {
+            const u8* s = src + y * stride;
+            u8* d = dest + y * ystep - 12;
+
+            for (int x = 0; x < xblocks; x += 4)
+            {
+                simd::u32x4 v = simd::u32x4_uload(reinterpret_cast<const u32*>(s));
+                simd::u32x4_ustore(reinterpret_cast<u32*>(d), simd::shuffle<3, 2, 1, 0>(v));
+                s += 16;
+                d -= 16;
+            }
+        }
+
+        orient_block<4>(dest - xblocks * 4, -4, ystep, src + xblocks * 4, stride, width - xblocks, height);
+    }
+
+    void orient_block(u8* dest, int xstep, int ystep, const u8* src, int stride, int width, int height, int bytes)
+    {
+        if (xstep == bytes)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                std::memcpy(dest + y * ystep, src + y * stride, width * bytes);
+            }
+            return;
+        }
+
+        switch (bytes)
+        {
+            case 1:
+                orient_block<1>(dest, xstep, ystep, src, stride, width, height);
+                break;
+            case 2:
+                orient_block<2>(dest, xstep, ystep, src, stride, width, height);
+                break;
+            case 3:
+                orient_block<3>(dest, xstep, ystep, src, stride, width, height);
+                break;
+            case 4:
+                if (xstep == -4)
+                    orient_block_reverse32(dest, ystep, src, stride, width, height);
+                else
+                    orient_block_transpose32(dest, xstep, ystep, src, stride, width, height);
+                break;
+            case 8:
+                orient_block<8>(dest, xstep, ystep, src, stride, width, height);
+                break;
+            case 16:
+                orient_block<16>(dest, xstep, ystep, src, stride, width, height);
+                break;
+            default:
+                orient_block_bytes(dest, xstep, ystep, src, stride, width, height, bytes);
+                break;
+        }
+    }
+
+    void orient_surface(const Surface& dest, const Surface& source, int orientation)
+    {
+        // the destination has the oriented size and the source format
+        const int bytes = source.format.bytes();
+        const int width = source.width;
+        const int height = source.height;
+
+        // destination of the source pixel (0, 0) and the bytes to the next source pixel and scanline
+        u8* origin;
+        int xstep;
+        int ystep;
+
+        switch (orientation)
+        {
+            default:
+                origin = dest.address(0, 0);
+                xstep = bytes;
+                ystep = dest.stride;
+                break;
+            case 2: // mirror horizontal
+                origin = dest.address(width - 1, 0);
+                xstep = -bytes;
+                ystep = dest.stride;
+                break;
+            case 3: // rotate 180
+                origin = dest.address(width - 1, height - 1);
+                xstep = -bytes;
+                ystep = -dest.stride;
+                break;
+            case 4: // mirror vertical
+                origin = dest.address(0, height - 1);
+                xstep = bytes;
+                ystep = -dest.stride;
+                break;
+            case 5: // transpose
+                origin = dest.address(0, 0);
+                xstep = dest.stride;
+                ystep = bytes;
+                break;
+            case 6: // rotate 90 clockwise
+                origin = dest.address(height - 1, 0);
+                xstep = dest.stride;
+                ystep = -bytes;
+                break;
+            case 7: // transverse
+                origin = dest.address(height - 1, width - 1);
+                xstep = -dest.stride;
+                ystep = -bytes;
+                break;
+            case 8: // rotate 270 clockwise
+                origin = dest.address(0, width - 1);
+                xstep = -dest.stride;
+                ystep = bytes;
+                break;
+        }
+
+        // Source columns are destination scanlines in orientations 5..8; the source is
+        // copied in tiles so that the destination scanlines stay in the cache between
+        // the source scanlines. The other orientations copy whole scanlines.
+        const int tile = orientation >= 5 ? 32 : width;
+        const int slice = 128;
+
+        auto copy = [=] (int y0, int y1)
+        {
+            for (int x = 0; x < width; x += tile)
+            {
+                const int w = std::min(tile, width - x);
+
+                for (int y = y0; y < y1; y += tile)
+                {
+                    const int h = std::min(tile, y1 - y);
+                    u8* d = origin + x * xstep + y * ystep;
+                    orient_block(d, xstep, ystep, source.address(x, y), source.stride, w, h, bytes);
+                }
+            }
+        };
+
+        if (ThreadPool::getHardwareConcurrency() > 2 && height >= slice * 2)
+        {
+            ConcurrentQueue queue("orient", Priority::HIGH);
+
+            for (int y = 0; y < height; y += slice)
+            {
+                queue.enqueue([=]
+                {
+                    copy(y, std::min(y + slice, height));
+                });
+            }
+        }
+        else
+        {
+            copy(0, height);
+        }
+    }
+
     // ----------------------------------------------------------------------------
     // load_surface()
     // ----------------------------------------------------------------------------
@@ -416,7 +683,7 @@ namespace mango
         rect.width = dest.width;
         rect.height = dest.height;
 
-        Blitter blitter(dest.format, source.format);
+        const Blitter& blitter = getBlitter(dest.format, source.format);
 
         const int slice = 96;
 
@@ -453,32 +720,37 @@ namespace mango
             return;
 
         const int bytes_per_pixel = format.bytes();
-        const int half_width = width / 2;
-
-        u8* left = image;
-        u8* right = image + (width - 1) * bytes_per_pixel;
 
         for (int y = 0; y < height; ++y)
         {
-            u8* a = left;
-            u8* b = right;
+            u8* scan = image + y * stride;
 
-            for (int x = 0; x < half_width; ++x)
+            switch (bytes_per_pixel)
             {
-                // swap pixels using the slowest possible method
-                for (int i = 0; i < bytes_per_pixel; ++i)
+                case 1:
+                    std::reverse(scan, scan + width);
+                    break;
+                case 2:
+                    std::reverse(reinterpret_cast<Pixel<2>*>(scan), reinterpret_cast<Pixel<2>*>(scan) + width);
+                    break;
+                case 3:
+                    std::reverse(reinterpret_cast<Pixel<3>*>(scan), reinterpret_cast<Pixel<3>*>(scan) + width);
+                    break;
+                case 4:
+                    std::reverse(reinterpret_cast<Pixel<4>*>(scan), reinterpret_cast<Pixel<4>*>(scan) + width);
+                    break;
+                default:
                 {
-                    std::swap(a[i], b[i]);
-                }
+                    u8* a = scan;
+                    u8* b = scan + (width - 1) * bytes_per_pixel;
 
-                // next pixel
-                a += bytes_per_pixel;
-                b -= bytes_per_pixel;
+                    for ( ; a < b; a += bytes_per_pixel, b -= bytes_per_pixel)
+                    {
+                        std::swap_ranges(a, a + bytes_per_pixel, b);
+                    }
+                    break;
+                }
             }
-
-            // next scanline
-            left += stride;
-            right += stride;
         }
     }
 
@@ -487,8 +759,7 @@ namespace mango
         if (!image || !stride)
             return;
 
-        const int bytes_per_pixel = format.bytes();
-        const int bytes_per_scan = width * bytes_per_pixel;
+        const int bytes_per_scan = width * format.bytes();
         const int half_height = height / 2;
 
         u8* top = image;
@@ -496,11 +767,7 @@ namespace mango
 
         for (int y = 0; y < half_height; ++y)
         {
-            // swap pixels using the slowest possible method
-            for (int i = 0; i < bytes_per_scan; ++i)
-            {
-                std::swap(top[i], bottom[i]);
-            }
+            std::swap_ranges(top, top + bytes_per_scan, bottom);
 
             // next scanline
             top += stride;
@@ -508,6 +775,47 @@ namespace mango
         }
     }
 
+    void Surface::orient(const Surface& source, int orientation) const
+    {
+        if (orientation < 2 || orientation > 8)
+        {
+            blit(0, 0, source);
+            return;
+        }
+
+        if (!source.image || !image)
+            return;
+
+        const bool swap = orientation >= 5;
+        const int w = swap ? source.height : source.width;
+        const int h = swap ? source.width : source.height;
+
+        if (format != source.format || width != w || height != h)
+        {
+            Bitmap temp(w, h, source.format);
+            orient_surface(temp, source, orientation);
+            blit(0, 0, temp);
+            return;
+        }
+
+        orient_surface(*this, source, orientation);
+    }
+
+    void Surface::transpose(const Surface& source) const
+    {
+        orient(source, 5);
+    }
+
+    void Surface::rotate90(const Surface& source) const
+    {
+        orient(source, 6);
+    }
+
+    void Surface::rotate270(const Surface& source) const
+    {
+        orient(source, 8);
+    }
+
     // ----------------------------------------------------------------------------
     // Bitmap
     // ----------------------------------------------------------------------------
@@ -588,4 +896,39 @@ namespace mango
         return *this;
     }
 
+    // ----------------------------------------------------------------------------
+    // fillPixels()
+    // ----------------------------------------------------------------------------
+
+    u8* fillPixels(u8* dest, const u8* pixel, int bytes, int count)
+    {
+        switch (bytes)
+        {
+            case 1:
+                clear_u8_scan(dest, count, pixel[0]);
+                break;
+
+            case 2:
+                clear_u16_scan(dest, count, uload16(pixel));
+                break;
+
+            case 3:
+                clear_u24_scan(dest, count, (pixel[2] << 16) | (pixel[1] << 8) | pixel[0]);
+                break;
+
+            case 4:
+                clear_u32_scan(dest, count, uload32(pixel));
+                break;
+
+            default:
+                for (int i = 0; i < count; ++i)
+                {
+                    std::memcpy(dest + i * bytes, pixel, bytes);
+                }
+                break;
+        }
+
+        return dest + count * bytes;
+    }
+
 } // namespace mango
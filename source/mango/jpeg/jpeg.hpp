@@ -29,6 +29,24 @@
         #define JPEG_ENABLE_AVX2
     #endif
 
+    // The multi-block decoding kernels are compiled with function target attributes so that
+    // configureCPU() can select them from the CPU flags when the library is built for SSE2.
+    #if defined(MANGO_ENABLE_SSE2) && (defined(MANGO_COMPILER_GCC) || defined(MANGO_COMPILER_CLANG))
+        #define JPEG_ENABLE_AVX2_KERNELS
+        #define JPEG_ENABLE_AVX512_KERNELS
+        #define JPEG_TARGET_AVX2    __attribute__((target("avx2")))
+        #define JPEG_TARGET_AVX512  __attribute__((target("avx2,avx512f,avx512bw")))
+    #else
+        #if defined(MANGO_ENABLE_AVX2)
+            #define JPEG_ENABLE_AVX2_KERNELS
+        #endif
+        #if defined(MANGO_ENABLE_AVX512) && defined(__AVX512BW__)
+            #define JPEG_ENABLE_AVX512_KERNELS
+        #endif
+        #define JPEG_TARGET_AVX2
+        #define JPEG_TARGET_AVX512
+    #endif
+
     #if defined(MANGO_ENABLE_NEON)
         #define JPEG_ENABLE_NEON
     #endif
@@ -53,6 +71,7 @@ namespace jpeg {
     using mango::u32;
     using mango::u64;
     using mango::s16;
+    using mango::s32;
     using mango::Format;
     using mango::Surface;
 	using mango::Stream;
@@ -86,6 +105,8 @@ namespace jpeg {
     constexpr int JPEG_AC_STAT_BINS       = 256; // ...
     constexpr int JPEG_HUFF_LOOKUP_BITS   = 8;   // Huffman look-ahead table log2 size
     constexpr int JPEG_HUFF_LOOKUP_SIZE   = (1 << JPEG_HUFF_LOOKUP_BITS);
+    constexpr int JPEG_HUFF_FAST_BITS     = 11;  // Combined symbol + coefficient table log2 size
+    constexpr int JPEG_HUFF_FAST_SIZE     = (1 << JPEG_HUFF_FAST_BITS);
 
     // supported external data formats (encode from, decode to)
     enum SampleType
@@ -169,6 +190,10 @@ namespace jpeg {
         u8 lookupSize[JPEG_HUFF_LOOKUP_SIZE];
         u8 lookupValue[JPEG_HUFF_LOOKUP_SIZE];
 
+        // combined lookup: coefficient (bits 16..31), symbol (bits 8..15), code + magnitude length (bits 0..7)
+        // a zero length means the code and magnitude bits do not fit into JPEG_HUFF_FAST_BITS
+        s32 lookupFast[JPEG_HUFF_FAST_SIZE];
+
         bool configure();
         int decode(BitBuffer& buffer) const;
     };
@@ -277,6 +302,12 @@ namespace jpeg {
         void (*process_ycbcr_8x16 ) (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
         void (*process_ycbcr_16x8 ) (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
         void (*process_ycbcr_16x16) (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+        // EXIF orientation: process is process_oriented(), which processes the MCU with
+        // process_block into a temporary buffer and stores the pixels xstep bytes apart
+        void (*process_block) (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+        int xstep;
+        int bytes_per_pixel;
     };
 
     // ----------------------------------------------------------------------------
@@ -300,6 +331,7 @@ namespace jpeg {
 
         int restartInterval;
         int restartCounter;
+        std::vector<const u8*> restartIndex; // start of each restart interval in the scan
 
         int m_hardware_concurrency;
 
@@ -310,6 +342,12 @@ namespace jpeg {
 
         Surface* m_surface;
 
+        // destination of the pixel (0, 0) and the bytes to the next pixel and scanline;
+        // these are not the pixel size and stride when EXIF orientation is applied
+        u8* m_image;
+        int m_xstep;
+        int m_ystep;
+
         int width;  // Image width, does include alignment
         int height; // Image height, does include alignment
         int xsize;  // Image width, does not include alignment
@@ -335,6 +373,13 @@ namespace jpeg {
         int ymcu;
         int mcus;
 
+        // region-of-interest in MCUs: [mcu_x0, mcu_x1) x [mcu_y0, mcu_y1)
+        bool is_cropped = false;
+        int mcu_x0;
+        int mcu_y0;
+        int mcu_x1;
+        int mcu_y1;
+
         bool isJPEG(ConstMemory memory) const;
 
         const u8* stepMarker(const u8* p, const u8* end) const;
@@ -367,14 +412,23 @@ namespace jpeg {
         void decodeSequential();
         void decodeSequentialST();
         void decodeSequentialMT(int N);
+        void decodeSequentialSpeculative(int N);
+        void decodeSequentialCrop();
+        void decodeSequentialCropRestart();
         void decodeMultiScan();
         void decodeProgressive();
         void finishProgressive();
         void finishProgressiveST();
         void finishProgressiveMT(int N);
+        void finishProgressiveCrop();
+
+        void buildRestartIndex();
+        bool isCropInterval(int n0, int n1) const;
 
         void process_range(int y0, int y1, const s16* data);
+        void process_crop_range(int y0, int y1, const s16* data, int mcu_stride);
         void process_and_clip(u8* dest, int stride, const s16* data, int width, int height);
+        void setSurface(Surface* surface, int orientation);
 
         int getTaskSize(int count) const;
         void configureCPU(SampleType sample);
@@ -389,7 +443,7 @@ namespace jpeg {
         Parser(ConstMemory memory);
         ~Parser();
 
-        ImageDecodeStatus decode(Surface& target);
+        ImageDecodeStatus decode(Surface& target, const ImageDecodeOptions& options);
     };
 
     // ----------------------------------------------------------------------------
@@ -419,6 +473,7 @@ namespace jpeg {
     void idct8                          (u8* dest, const s16* data, const s16* qt);
     void idct12                         (u8* dest, const s16* data, const s16* qt);
 
+    void process_oriented               (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
     void process_y_8bit                 (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
     void process_y_24bit                (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
     void process_y_32bit                (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
@@ -505,8 +560,34 @@ namespace jpeg {
 
 #endif // JPEG_ENABLE_SSE4
 
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+
+    JPEG_TARGET_AVX2   void idct2_avx2                     (u8* dest, const s16* data, const s16* qt0, const s16* qt1);
+
+    JPEG_TARGET_AVX2   void process_ycbcr_bgra_8x8_avx2    (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX2   void process_ycbcr_bgra_16x8_avx2   (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX2   void process_ycbcr_bgra_16x16_avx2  (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+    JPEG_TARGET_AVX2   void process_ycbcr_rgba_8x8_avx2    (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX2   void process_ycbcr_rgba_16x8_avx2   (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX2   void process_ycbcr_rgba_16x16_avx2  (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+#endif // JPEG_ENABLE_AVX2_KERNELS
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+
+    JPEG_TARGET_AVX512 void idct4_avx512                   (u8* dest, const s16* data, const s16* qt0, const s16* qt1, const s16* qt2, const s16* qt3);
+
+    JPEG_TARGET_AVX512 void process_ycbcr_bgra_16x8_avx512 (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX512 void process_ycbcr_bgra_16x16_avx512(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+    JPEG_TARGET_AVX512 void process_ycbcr_rgba_16x8_avx512 (u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+    JPEG_TARGET_AVX512 void process_ycbcr_rgba_16x16_avx512(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+#endif // JPEG_ENABLE_AVX512_KERNELS
+
     SampleFormat getSampleFormat(const Format& format);
-	ImageEncodeStatus encodeImage(Stream& stream, const Surface& surface, float quality);
+	ImageEncodeStatus encodeImage(Stream& stream, const Surface& surface, const ImageEncodeOptions& options);
 
 } // namespace jpeg
 } // namespace mango
@@ -195,6 +195,9 @@ namespace jpeg {
         }
 
         m_surface = nullptr;
+        m_image = nullptr;
+        m_xstep = 0;
+        m_ystep = 0;
 
         u64 flags = getCPUFlags();
         MANGO_UNREFERENCED(flags);
@@ -1524,6 +1527,51 @@ namespace jpeg {
         return false;
     }
 
+    void Parser::buildRestartIndex()
+    {
+        const u8* p = decodeState.buffer.ptr;
+
+        // the index is valid as long as the scan starts from the same address
+        if (!restartIndex.empty() && restartIndex[0] == p)
+        {
+            return;
+        }
+
+        restartIndex.clear();
+
+        for (int i = 0; i < mcus; i += restartInterval)
+        {
+            restartIndex.push_back(p);
+
+            // seek next restart marker
+            p = seekMarker(p, decodeState.buffer.end);
+            p += 2;
+        }
+
+        // end of the last interval
+        restartIndex.push_back(p);
+    }
+
+    bool Parser::isCropInterval(int n0, int n1) const
+    {
+        // check if MCUs [n0, n1) intersect with the crop rectangle
+        const int y0 = std::max(n0 / xmcu, mcu_y0);
+        const int y1 = std::min((n1 - 1) / xmcu, mcu_y1 - 1);
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            const int x0 = std::max(n0 - y * xmcu, 0);
+            const int x1 = std::min(n1 - y * xmcu, xmcu);
+
+            if (std::max(x0, mcu_x0) < std::min(x1, mcu_x1))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     void Parser::configureCPU(SampleType sample)
     {
         const char* simd = "";
@@ -1682,6 +1730,64 @@ namespace jpeg {
 
 #endif // JPEG_ENABLE_SSE4
 
+        // the multi-block kernels replace only some of the MCU configurations
+        const char* simd_8x8 = simd;
+        const char* simd_16x8 = simd;
+        const char* simd_16x16 = simd;
+
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+
+        // the multi-block idct kernels are 8 bit precision only
+        if ((flags & INTEL_AVX2) && precision == 8)
+        {
+            switch (sample)
+            {
+                case JPEG_U8_Y:
+                case JPEG_U8_BGR:
+                case JPEG_U8_RGB:
+                    break;
+                case JPEG_U8_BGRA:
+                    processState.process_ycbcr_8x8   = process_ycbcr_bgra_8x8_avx2;
+                    processState.process_ycbcr_16x8  = process_ycbcr_bgra_16x8_avx2;
+                    processState.process_ycbcr_16x16 = process_ycbcr_bgra_16x16_avx2;
+                    simd_8x8 = simd_16x8 = simd_16x16 = "AVX2";
+                    break;
+                case JPEG_U8_RGBA:
+                    processState.process_ycbcr_8x8   = process_ycbcr_rgba_8x8_avx2;
+                    processState.process_ycbcr_16x8  = process_ycbcr_rgba_16x8_avx2;
+                    processState.process_ycbcr_16x16 = process_ycbcr_rgba_16x16_avx2;
+                    simd_8x8 = simd_16x8 = simd_16x16 = "AVX2";
+                    break;
+            }
+        }
+
+#endif // JPEG_ENABLE_AVX2_KERNELS
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+
+        if ((flags & INTEL_AVX512BW) && precision == 8)
+        {
+            switch (sample)
+            {
+                case JPEG_U8_Y:
+                case JPEG_U8_BGR:
+                case JPEG_U8_RGB:
+                    break;
+                case JPEG_U8_BGRA:
+                    processState.process_ycbcr_16x8  = process_ycbcr_bgra_16x8_avx512;
+                    processState.process_ycbcr_16x16 = process_ycbcr_bgra_16x16_avx512;
+                    simd_16x8 = simd_16x16 = "AVX-512";
+                    break;
+                case JPEG_U8_RGBA:
+                    processState.process_ycbcr_16x8  = process_ycbcr_rgba_16x8_avx512;
+                    processState.process_ycbcr_16x16 = process_ycbcr_rgba_16x16_avx512;
+                    simd_16x8 = simd_16x16 = "AVX-512";
+                    break;
+            }
+        }
+
+#endif // JPEG_ENABLE_AVX512_KERNELS
+
         std::string id;
 
         // determine jpeg type -> select innerloops
@@ -1704,7 +1810,7 @@ namespace jpeg {
                         if (processState.process_ycbcr_8x8)
                         {
                             processState.process = processState.process_ycbcr_8x8;
-                            id = makeString("%s YCbCr 8x8", simd);
+                            id = makeString("%s YCbCr 8x8", simd_8x8);
                         }
                     }
 
@@ -1722,7 +1828,7 @@ namespace jpeg {
                         if (processState.process_ycbcr_16x8)
                         {
                             processState.process = processState.process_ycbcr_16x8;
-                            id = makeString("%s YCbCr 16x8", simd);
+                            id = makeString("%s YCbCr 16x8", simd_16x8);
                         }
                     }
 
@@ -1731,7 +1837,7 @@ namespace jpeg {
                         if (processState.process_ycbcr_16x16)
                         {
                             processState.process = processState.process_ycbcr_16x16;
-                            id = makeString("%s YCbCr 16x16", simd);
+                            id = makeString("%s YCbCr 16x16", simd_16x16);
                         }
                     }
                 }
@@ -1747,7 +1853,7 @@ namespace jpeg {
         debugPrint("  Decoder: %s\n", id.c_str());
     }
 
-    ImageDecodeStatus Parser::decode(Surface& target)
+    ImageDecodeStatus Parser::decode(Surface& target, const ImageDecodeOptions& options)
     {
         ImageDecodeStatus status;
 
@@ -1757,6 +1863,61 @@ namespace jpeg {
             return status;
         }
 
+        // region-of-interest
+        int crop_x0 = 0;
+        int crop_y0 = 0;
+        int crop_x1 = xsize;
+        int crop_y1 = ysize;
+
+        if (options.isCropped())
+        {
+            crop_x0 = std::max(0, options.crop_x);
+            crop_y0 = std::max(0, options.crop_y);
+            crop_x1 = std::min(xsize, options.crop_x + options.crop_width);
+            crop_y1 = std::min(ysize, options.crop_y + options.crop_height);
+
+            if (crop_x0 >= crop_x1 || crop_y0 >= crop_y1)
+            {
+                status.setError("Incorrect crop rectangle.");
+                return status;
+            }
+        }
+
+        const int crop_width = crop_x1 - crop_x0;
+        const int crop_height = crop_y1 - crop_y0;
+
+        // EXIF orientation
+        int orientation = 1;
+
+        if (options.orientation && exif_memory.address)
+        {
+            image::Exif exif(exif_memory);
+            if (exif.Orientation >= 1 && exif.Orientation <= 8)
+            {
+                orientation = exif.Orientation;
+            }
+        }
+
+        const bool swap = orientation >= 5;
+        const int oriented_width = swap ? crop_height : crop_width;
+        const int oriented_height = swap ? crop_width : crop_height;
+
+        // lossless decoder writes pixels directly; it decodes the whole image and the rectangle is copied
+        is_cropped = (crop_width != xsize || crop_height != ysize) && !is_lossless;
+
+        mcu_x0 = 0;
+        mcu_y0 = 0;
+        mcu_x1 = xmcu;
+        mcu_y1 = ymcu;
+
+        if (is_cropped)
+        {
+            mcu_x0 = crop_x0 / xblock;
+            mcu_y0 = crop_y0 / yblock;
+            mcu_x1 = ceil_div(crop_x1, xblock);
+            mcu_y1 = ceil_div(crop_y1, yblock);
+        }
+
         // determine if we need a full-surface temporary storage
         bool require_vector = is_progressive || is_multiscan;
         size_t vector_bytes = require_vector ? mcus * blocks_in_mcu * 64 : 0;
@@ -1795,7 +1956,13 @@ namespace jpeg {
         status.direct = true;
 
         // target surface size has to match (clipping isn't yet supported)
-        if (target.width != xsize || target.height != ysize)
+        if (target.width != oriented_width || target.height != oriented_height)
+        {
+            status.direct = false;
+        }
+
+        // lossless decoder writes the pixels without orientation
+        if (is_lossless && orientation != 1)
         {
             status.direct = false;
         }
@@ -1805,9 +1972,36 @@ namespace jpeg {
             status.direct = false;
         }
 
+        if (crop_width != xsize || crop_height != ysize)
+        {
+            status.direct = false;
+        }
+
         if (status.direct)
         {
-            m_surface = &target;
+            setSurface(&target, orientation);
+
+            parse(scan_memory, true);
+
+            if (!header)
+            {
+                status.setError(header.info);
+                return status;
+            }
+
+            if (is_progressive || is_multiscan)
+			{
+	            finishProgressive();
+			}
+        }
+        else if (is_cropped)
+        {
+            // MCU aligned temporary storage for the region-of-interest
+            const int x0 = mcu_x0 * xblock;
+            const int y0 = mcu_y0 * yblock;
+
+            Bitmap temp((mcu_x1 - mcu_x0) * xblock, (mcu_y1 - mcu_y0) * yblock, sf.format);
+            setSurface(&temp, 1);
 
             parse(scan_memory, true);
 
@@ -1821,11 +2015,13 @@ namespace jpeg {
 			{
 	            finishProgressive();
 			}
+
+            target.orient(Surface(temp, crop_x0 - x0, crop_y0 - y0, crop_width, crop_height), orientation);
         }
         else
         {
             Bitmap temp(width, height, sf.format);
-            m_surface = &temp;
+            setSurface(&temp, 1);
 
             parse(scan_memory, true);
 
@@ -1840,7 +2036,7 @@ namespace jpeg {
 	            finishProgressive();
 			}
 
-            target.blit(0, 0, temp);
+            target.orient(Surface(temp, crop_x0, crop_y0, crop_width, crop_height), orientation);
         }
 
         blockVector = nullptr;
@@ -2000,21 +2196,31 @@ namespace jpeg {
 
     void Parser::decodeSequential()
     {
+        if (is_cropped)
+        {
+            if (restartInterval)
+                decodeSequentialCropRestart();
+            else
+                decodeSequentialCrop();
+            return;
+        }
+
         int n = getTaskSize(ymcu);
         if (n == ymcu)
             decodeSequentialST();
+        else if (!restartInterval && !is_arithmetic)
+            decodeSequentialSpeculative(n);
         else
             decodeSequentialMT(n);
     }
 
     void Parser::decodeSequentialST()
     {
-        const int stride = m_surface->stride;
-        const int bytes_per_pixel = m_surface->format.bytes();
-        const int xstride = bytes_per_pixel * xblock;
-        const int ystride = stride * yblock;
+        const int stride = m_ystep;
+        const int xstride = m_xstep * xblock;
+        const int ystride = m_ystep * yblock;
 
-        u8* image = m_surface->image;
+        u8* image = m_image;
 
         ProcessFunc process = processState.process;
 
@@ -2097,11 +2303,10 @@ namespace jpeg {
         {
             const u8* p = decodeState.buffer.ptr;
 
-            const int stride = m_surface->stride;
-            const int bytes_per_pixel = m_surface->format.bytes();
-            const int xstride = bytes_per_pixel * xblock;
-            const int ystride = stride * yblock;
-            u8* image = m_surface->address<u8>(0, 0);
+            const int stride = m_ystep;
+            const int xstride = m_xstep * xblock;
+            const int ystride = m_ystep * yblock;
+            u8* image = m_image;
 
             for (int i = 0; i < mcus; i += restartInterval)
             {
@@ -2156,6 +2361,452 @@ namespace jpeg {
         }
     }
 
+    void Parser::decodeSequentialCrop()
+    {
+        // Huffman decoding is serial; only the MCUs inside the crop rectangle are stored
+        // and processed. Decoding terminates after the last MCU row in the rectangle.
+        const int mcu_data_size = blocks_in_mcu * 64;
+        const int mcu_stride = mcu_x1 - mcu_x0;
+
+        AlignedStorage<s16> scratch(JPEG_MAX_SAMPLES_IN_MCU);
+
+        // skip the MCU rows above the rectangle
+        for (int i = 0; i < mcu_y0 * xmcu; ++i)
+        {
+            decodeState.decode(scratch, &decodeState);
+        }
+
+        ConcurrentQueue queue("jpeg.crop", Priority::HIGH);
+
+        const int N = getTaskSize(mcu_y1 - mcu_y0);
+
+        for (int y = mcu_y0; y < mcu_y1; y += N)
+        {
+            const int y0 = y;
+            const int y1 = std::min(y + N, mcu_y1);
+            debugPrint("  Process: [%d, %d] --> ThreadPool.\n", y0, y1 - 1);
+
+            void* aligned_ptr = aligned_malloc((y1 - y0) * mcu_stride * mcu_data_size * sizeof(s16));
+            s16* data = reinterpret_cast<s16*>(aligned_ptr);
+            s16* dest = data;
+
+            for (int j = y0; j < y1; ++j)
+            {
+                for (int x = 0; x < xmcu; ++x)
+                {
+                    if (x >= mcu_x0 && x < mcu_x1)
+                    {
+                        decodeState.decode(dest, &decodeState);
+                        dest += mcu_data_size;
+                    }
+                    else
+                    {
+                        decodeState.decode(scratch, &decodeState);
+                    }
+                }
+            }
+
+            // enqueue task
+            queue.enqueue([=]
+            {
+                process_crop_range(y0, y1, data, mcu_stride);
+                aligned_free(data);
+            });
+        }
+    }
+
+    void Parser::decodeSequentialCropRestart()
+    {
+        // restart intervals can be decoded independently; intervals which do not
+        // intersect the crop rectangle are skipped without entropy decoding
+        buildRestartIndex();
+
+        ConcurrentQueue queue("jpeg.crop", Priority::HIGH);
+
+        const int stride = m_ystep;
+        const int xstride = m_xstep * xblock;
+        const int ystride = m_ystep * yblock;
+        u8* image = m_image;
+
+        for (int i = 0; i < mcus; i += restartInterval)
+        {
+            const int n0 = i;
+            const int n1 = std::min(i + restartInterval, mcus);
+
+            if (!isCropInterval(n0, n1))
+            {
+                continue;
+            }
+
+            const u8* p = restartIndex[i / restartInterval];
+
+            // enqueue task
+            queue.enqueue([=]
+            {
+                AlignedStorage<s16> data(JPEG_MAX_SAMPLES_IN_MCU);
+
+                DecodeState state = decodeState;
+                state.buffer.ptr = p;
+
+                ProcessFunc process = processState.process;
+
+                // the last MCU inside the rectangle terminates decoding
+                const int last = std::min(n1, mcu_y1 * xmcu);
+
+                for (int n = n0; n < last; ++n)
+                {
+                    state.decode(data, &state);
+
+                    int x = n % xmcu;
+                    int y = n / xmcu;
+
+                    if (x >= mcu_x0 && x < mcu_x1 && y >= mcu_y0)
+                    {
+                        u8* dest = image + (y - mcu_y0) * ystride + (x - mcu_x0) * xstride;
+                        process(dest, stride, data, &processState, xblock, yblock);
+                    }
+                }
+            });
+        }
+
+        decodeState.buffer.ptr = restartIndex.back();
+    }
+
+    // ----------------------------------------------------------------------------
+    // speculative decoding
+    // ----------------------------------------------------------------------------
+
+    /*
+        Huffman codes are self-synchronizing: a decoder started from an arbitrary bit
+        position in the entropy coded data will, after a few symbols, decode the same
+        symbols as a decoder which started from the beginning. The scan is split into
+        chunks which are decoded in parallel starting from the first byte in the chunk.
+        The decoder from the previous chunk continues decoding until it reaches
+        a MCU boundary recorded by the speculative decoder; from there on the results
+        are identical except for the DC predictors, which are corrected with a constant
+        delta for each component.
+    */
+
+    constexpr int JPEG_SPECULATIVE_CHUNK_SIZE = 64 * 1024;
+
+    struct SpeculativeChunk
+    {
+        const u8* start;
+        u64 stop; // bit position where the next chunk starts
+
+        DecodeState state; // decoder state after the last MCU
+        std::vector<u64> position; // bit position of each decoded MCU
+        std::vector<int> predictor; // DC predictors at the start of each decoded MCU
+        std::vector<s16> data;
+        int count = 0;
+    };
+
+    static inline
+    u64 getBitPosition(const BitBuffer& buffer, const u8* base)
+    {
+        // The buffer has prefetched bytes which are not consumed yet; walk the bytes
+        // backwards (skipping the stuffed zero bytes) to find the next unconsumed bit.
+        const u8* p = buffer.ptr;
+        int bits = buffer.remain;
+
+        while (bits > 0)
+        {
+            --p;
+            bool stuffing = p > base && p[0] == 0 && p[-1] == 0xff;
+            if (!stuffing)
+            {
+                bits -= 8;
+            }
+        }
+
+        return u64(p - base) * 8 + u64(-bits);
+    }
+
+    static
+    int decodeBlocks(DecodeState& state, int first, int last)
+    {
+        // Decode blocks [first, last) of a MCU without storing the coefficients.
+        // Returns the number of coding errors; a decoder which is not synchronized
+        // with the MCU block structure will see errors with overwhelming probability.
+        BitBuffer& buffer = state.buffer;
+        int errors = 0;
+
+        for (int j = first; j < last; ++j)
+        {
+            const DecodeBlock* block = state.block + j;
+
+            int s = block->table.dc->decode(buffer);
+            if (s > 16)
+            {
+                ++errors;
+            }
+            else if (s)
+            {
+                buffer.receive(s);
+            }
+
+            int i = 1;
+
+            while (i < 64)
+            {
+                int s = block->table.ac->decode(buffer);
+                int x = s & 15;
+
+                if (x)
+                {
+                    i += (s >> 4);
+                    buffer.receive(x);
+                    ++i;
+                }
+                else
+                {
+                    if (s < 16) break;
+                    i += 16;
+                }
+            }
+
+            errors += (i > 64);
+        }
+
+        return errors;
+    }
+
+    static
+    int probeBlockPhase(const DecodeState& state)
+    {
+        // The first byte in a chunk can be anywhere in a MCU; find the block index
+        // which gives the fewest coding errors after the decoder has synchronized.
+        const int warmup = 4;
+        const int count = 32;
+
+        int best_phase = 0;
+        int best_errors = count * state.blocks + 1;
+
+        for (int phase = 0; phase < state.blocks; ++phase)
+        {
+            DecodeState temp = state;
+            decodeBlocks(temp, phase, temp.blocks);
+
+            int errors = 0;
+
+            for (int i = 0; i < warmup + count; ++i)
+            {
+                int e = decodeBlocks(temp, 0, temp.blocks);
+                errors += i < warmup ? 0 : e;
+            }
+
+            if (errors < best_errors)
+            {
+                best_phase = phase;
+                best_errors = errors;
+            }
+        }
+
+        return best_phase;
+    }
+
+    void Parser::decodeSequentialSpeculative(int N)
+    {
+        const u8* start = decodeState.buffer.ptr;
+        const u8* end = seekMarker(start, decodeState.buffer.end);
+
+        const int chunks = std::min(m_hardware_concurrency, int((end - start) / JPEG_SPECULATIVE_CHUNK_SIZE));
+        if (chunks < 2)
+        {
+            decodeSequentialMT(N);
+            return;
+        }
+
+        const int mcu_data_size = blocks_in_mcu * 64;
+
+        // NOTE: the decoder writes up to 256 coefficients past the last block with corrupted data;
+        //       a speculative decoder will see corrupted data until it is synchronized.
+        const int padding = 256;
+
+        AlignedStorage<s16> storage(mcus * mcu_data_size + padding);
+        s16* output = storage.data();
+
+        std::vector<SpeculativeChunk> chunk(chunks);
+
+        for (int i = 0; i < chunks; ++i)
+        {
+            const u8* p = start + (end - start) * i / chunks;
+
+            // don't start from a stuffed zero byte
+            p += (i > 0 && p[-1] == 0xff && p[0] == 0);
+
+            chunk[i].start = p;
+        }
+
+        for (int i = 0; i < chunks; ++i)
+        {
+            const u8* next = i < chunks - 1 ? chunk[i + 1].start : end;
+            chunk[i].stop = u64(next - start) * 8;
+        }
+
+        // the first chunk is decoded with the correct decoder state
+        DecodeState& state0 = chunk[0].state;
+        state0 = decodeState;
+
+        {
+            ConcurrentQueue queue("jpeg.speculative", Priority::HIGH);
+
+            queue.enqueue([&]
+            {
+                SpeculativeChunk& current = chunk[0];
+                s16* data = output;
+
+                while (current.count < mcus && getBitPosition(current.state.buffer, start) < current.stop)
+                {
+                    current.state.decode(data, &current.state);
+                    data += mcu_data_size;
+                    ++current.count;
+                }
+            });
+
+            for (int i = 1; i < chunks; ++i)
+            {
+                queue.enqueue([&, i]
+                {
+                    SpeculativeChunk& current = chunk[i];
+
+                    DecodeState& state = current.state;
+                    state = decodeState;
+                    state.buffer.ptr = current.start;
+                    state.buffer.restart();
+                    state.huffman.restart();
+
+                    // skip to the first MCU boundary
+                    int phase = probeBlockPhase(state);
+                    decodeBlocks(state, phase, state.blocks);
+
+                    // rough estimate based on the compressed size
+                    size_t estimate = size_t(mcus) * (current.stop - getBitPosition(state.buffer, start)) / ((end - start) * 8) + 1;
+                    current.position.reserve(estimate);
+                    current.predictor.reserve(estimate * JPEG_MAX_COMPS_IN_SCAN);
+                    current.data.reserve(estimate * mcu_data_size + padding);
+
+                    while (current.count < mcus && state.buffer.ptr < end)
+                    {
+                        u64 position = getBitPosition(state.buffer, start);
+                        if (position >= current.stop)
+                            break;
+
+                        current.position.push_back(position);
+                        for (int j = 0; j < JPEG_MAX_COMPS_IN_SCAN; ++j)
+                        {
+                            current.predictor.push_back(state.huffman.last_dc_value[j]);
+                        }
+
+                        current.data.resize((current.count + 1) * mcu_data_size + padding);
+                        state.decode(current.data.data() + current.count * mcu_data_size, &state);
+                        ++current.count;
+                    }
+                });
+            }
+
+            queue.wait();
+        }
+
+        // stitch the chunks; the unsynchronized MCUs are decoded again with the correct state
+        DecodeState& state = state0;
+        int index = chunk[0].count;
+
+        for (int i = 1; i < chunks && index < mcus; ++i)
+        {
+            SpeculativeChunk& current = chunk[i];
+
+            int j = 0;
+
+            while (index < mcus)
+            {
+                if (state.buffer.ptr < end)
+                {
+                    u64 position = getBitPosition(state.buffer, start);
+
+                    while (j < current.count && current.position[j] < position)
+                    {
+                        ++j;
+                    }
+
+                    if (j == current.count)
+                    {
+                        // not synchronized; continue with the next chunk
+                        break;
+                    }
+
+                    if (current.position[j] == position)
+                    {
+                        // synchronized
+                        int delta[JPEG_MAX_COMPS_IN_SCAN];
+                        for (int c = 0; c < JPEG_MAX_COMPS_IN_SCAN; ++c)
+                        {
+                            delta[c] = state.huffman.last_dc_value[c] - current.predictor[j * JPEG_MAX_COMPS_IN_SCAN + c];
+                        }
+
+                        const int count = std::min(current.count - j, mcus - index);
+
+                        s16* dest = output + index * mcu_data_size;
+                        const s16* source = current.data.data() + j * mcu_data_size;
+                        std::memcpy(dest, source, count * mcu_data_size * sizeof(s16));
+
+                        for (int n = 0; n < count; ++n)
+                        {
+                            for (int b = 0; b < decodeState.blocks; ++b)
+                            {
+                                s16* block = dest + n * mcu_data_size + b * 64;
+                                block[0] = s16(block[0] + delta[decodeState.block[b].pred]);
+                            }
+                        }
+
+                        // continue from where the speculative decoder stopped
+                        state = current.state;
+
+                        for (int c = 0; c < JPEG_MAX_COMPS_IN_SCAN; ++c)
+                        {
+                            state.huffman.last_dc_value[c] += delta[c];
+                        }
+
+                        index += count;
+
+                        debugPrint("  Speculative chunk %d: synchronized after %d MCUs.\n", i, j);
+                        break;
+                    }
+                }
+
+                state.decode(output + index * mcu_data_size, &state);
+                ++index;
+            }
+        }
+
+        // decode the remaining MCUs
+        while (index < mcus)
+        {
+            state.decode(output + index * mcu_data_size, &state);
+            ++index;
+        }
+
+        decodeState.buffer = state.buffer;
+        decodeState.huffman = state.huffman;
+
+        // process
+        ConcurrentQueue queue("jpeg.sequential", Priority::HIGH);
+
+        for (int y = 0; y < ymcu; y += N)
+        {
+            const int y0 = y;
+            const int y1 = std::min(y + N, ymcu);
+            debugPrint("  Process: [%d, %d] --> ThreadPool.\n", y0, y1 - 1);
+
+            const s16* data = output + y0 * xmcu * mcu_data_size;
+
+            queue.enqueue([=]
+            {
+                process_range(y0, y1, data);
+            });
+        }
+    }
+
     void Parser::decodeMultiScan()
     {
         s16* data = blockVector;
@@ -2234,6 +2885,12 @@ namespace jpeg {
 
     void Parser::finishProgressive()
     {
+        if (is_cropped)
+        {
+            finishProgressiveCrop();
+            return;
+        }
+
         int n = getTaskSize(ymcu);
         if (n == ymcu)
             finishProgressiveST();
@@ -2243,12 +2900,11 @@ namespace jpeg {
 
     void Parser::finishProgressiveST()
     {
-        const int stride = m_surface->stride;
-        const int bytes_per_pixel = m_surface->format.bytes();
-        const int xstride = bytes_per_pixel * xblock;
-        const int ystride = stride * yblock;
+        const int stride = m_ystep;
+        const int xstride = m_xstep * xblock;
+        const int ystride = m_ystep * yblock;
 
-        u8* image = m_surface->address<u8>(0, 0);
+        u8* image = m_image;
 
         const int mcu_data_size = blocks_in_mcu * 64;
         s16* data = blockVector;
@@ -2311,6 +2967,28 @@ namespace jpeg {
         }
     }
 
+    void Parser::finishProgressiveCrop()
+    {
+        ConcurrentQueue queue("jpeg.progressive", Priority::HIGH);
+
+        const int N = getTaskSize(mcu_y1 - mcu_y0);
+
+        for (int y = mcu_y0; y < mcu_y1; y += N)
+        {
+            const int y0 = y;
+            const int y1 = std::min(y + N, mcu_y1);
+            debugPrint("  Process: [%d, %d] --> ThreadPool.\n", y0, y1 - 1);
+
+            s16* data = blockVector + (y0 * xmcu + mcu_x0) * (blocks_in_mcu * 64);
+
+            // enqueue task
+            queue.enqueue([=]
+            {
+                process_crop_range(y0, y1, data, xmcu);
+            });
+        }
+    }
+
     void Parser::process_range(int y0, int y1, const s16* data)
     {
         const int xmcu_last = xmcu - 1;
@@ -2318,12 +2996,11 @@ namespace jpeg {
         const int xblock_last = xclip ? xclip : xblock;
         const int yblock_last = yclip ? yclip : yblock;
 
-        const int stride = m_surface->stride;
-        const int bytes_per_pixel = m_surface->format.bytes();
-        const int xstride = bytes_per_pixel * xblock;
-        const int ystride = stride * yblock;
+        const int stride = m_ystep;
+        const int xstride = m_xstep * xblock;
+        const int ystride = m_ystep * yblock;
 
-        u8* image = m_surface->address<u8>(0, 0);
+        u8* image = m_image;
 
         const int mcu_data_size = blocks_in_mcu * 64;
 
@@ -2366,9 +3043,40 @@ namespace jpeg {
         }
     }
 
+    void Parser::process_crop_range(int y0, int y1, const s16* data, int mcu_stride)
+    {
+        // The surface is the MCU aligned region-of-interest, which starts from (mcu_x0, mcu_y0).
+        // The data contains the MCU rows from y0 to y1, which are mcu_stride MCUs apart.
+        const int stride = m_ystep;
+        const int xstride = m_xstep * xblock;
+        const int ystride = m_ystep * yblock;
+
+        const int mcu_data_size = blocks_in_mcu * 64;
+
+        ProcessFunc process = processState.process;
+
+        for (int y = y0; y < y1; ++y)
+        {
+            u8* dest = m_image + (y - mcu_y0) * ystride;
+            const s16* source = data + (y - y0) * mcu_stride * mcu_data_size;
+
+            for (int x = mcu_x0; x < mcu_x1; ++x)
+            {
+                process(dest, stride, source, &processState, xblock, yblock);
+                source += mcu_data_size;
+                dest += xstride;
+            }
+        }
+    }
+
     void Parser::process_and_clip(u8* dest, int stride, const s16* data, int width, int height)
     {
-        if (xblock != width || yblock != height)
+        if (processState.process == process_oriented)
+        {
+            // oriented MCU goes through a temporary buffer which is clipped when stored
+            processState.process(dest, stride, data, &processState, width, height);
+        }
+        else if (xblock != width || yblock != height)
         {
             u8 temp[JPEG_MAX_SAMPLES_IN_MCU * 4];
 
@@ -2393,5 +3101,67 @@ namespace jpeg {
         }
     }
 
+    void Parser::setSurface(Surface* surface, int orientation)
+    {
+        const int bytes = surface->format.bytes();
+        const int stride = surface->stride;
+
+        m_surface = surface;
+
+        // destination of the pixel (0, 0) and the bytes to the next pixel and scanline
+        switch (orientation)
+        {
+            default:
+                m_image = surface->address(0, 0);
+                m_xstep = bytes;
+                m_ystep = stride;
+                break;
+            case 2: // mirror horizontal
+                m_image = surface->address(xsize - 1, 0);
+                m_xstep = -bytes;
+                m_ystep = stride;
+                break;
+            case 3: // rotate 180
+                m_image = surface->address(xsize - 1, ysize - 1);
+                m_xstep = -bytes;
+                m_ystep = -stride;
+                break;
+            case 4: // mirror vertical
+                m_image = surface->address(0, ysize - 1);
+                m_xstep = bytes;
+                m_ystep = -stride;
+                break;
+            case 5: // transpose
+                m_image = surface->address(0, 0);
+                m_xstep = stride;
+                m_ystep = bytes;
+                break;
+            case 6: // rotate 90 clockwise
+                m_image = surface->address(ysize - 1, 0);
+                m_xstep = stride;
+                m_ystep = -bytes;
+                break;
+            case 7: // transverse
+                m_image = surface->address(ysize - 1, xsize - 1);
+                m_xstep = -stride;
+                m_ystep = -bytes;
+                break;
+            case 8: // rotate 270 clockwise
+                m_image = surface->address(0, xsize - 1);
+                m_xstep = -stride;
+                m_ystep = bytes;
+                break;
+        }
+
+        if (m_xstep != bytes)
+        {
+            // the pixels of a MCU scanline are not adjacent in the destination
+            processState.process_block = processState.process;
+            processState.process = process_oriented;
+            processState.xstep = m_xstep;
+            processState.bytes_per_pixel = bytes;
+        }
+    }
+
 } // namespace jpeg
 } // namespace mango
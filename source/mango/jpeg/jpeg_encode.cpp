@@ -284,6 +284,9 @@ namespace
         return output;
     }
 
+    struct HuffmanCodes;
+    struct JPEGScan;
+
     struct jpeg_chan
     {
         int     component;
@@ -292,6 +295,13 @@ namespace
 
     struct jpeg_encode
     {
+        int     width;
+        int     height;
+        int     bytes_per_pixel;
+
+        int     hsf; // luminance horizontal sampling factor
+        int     vsf; // luminance vertical sampling factor
+
         int     mcu_width;
         int     mcu_height;
         int     horizontal_mcus;
@@ -301,25 +311,34 @@ namespace
 
         int     mcu_width_size;
 
+        bool    progressive;
+        bool    optimize;
+        int     restart_interval;
+
         u8      Lqt [BLOCK_SIZE];
         u8      Cqt [BLOCK_SIZE];
         AlignedStorage<s16> ILqt;
         AlignedStorage<s16> ICqt;
 
         // MCU configuration
-        jpeg_chan   channel[3];
-        int         channel_count;
+        jpeg_chan   channel[JPEG_MAX_BLOCKS_IN_MCU];
+        int         channel_count; // number of blocks in MCU
+        int         component_count;
 
         std::string info;
 
         void (*read_8x8) (s16* block, const u8* input, int stride, int rows, int cols);
         void (*read)     (s16* block, const u8* input, int stride, int rows, int cols);
+        void (*downsample) (s16* dest, const s16* source);
 
-        jpeg_encode(SampleType sample, u32 width, u32 height, u32 stride, u32 quality);
+        jpeg_encode(SampleType sample, u32 width, u32 height, u32 stride, u32 quality, const ImageEncodeOptions& options);
         ~jpeg_encode();
 
         void init_quantization_tables(u32 quality);
+        void read_mcu(s16* block, const u8* input, int stride, int rows, int cols) const;
         void write_markers(BigEndianStream& p, SampleType sample, u32 width, u32 height);
+        void write_huffman_table(BigEndianStream& p, int tc, int th, const HuffmanCodes& codes);
+        void write_scan_header(BigEndianStream& p, const JPEGScan& scan);
     };
 
     struct EncodeBuffer : Buffer
@@ -451,6 +470,491 @@ namespace
         }
     };
 
+    // ----------------------------------------------------------------------------
+    // optimized huffman tables
+    // ----------------------------------------------------------------------------
+
+    struct HuffmanStatistics
+    {
+        u32 count[2][2][257]; // [dc, ac][table][symbol]
+
+        HuffmanStatistics()
+        {
+            std::memset(count, 0, sizeof(count));
+        }
+
+        void accumulate(const HuffmanStatistics& stats)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                for (int j = 0; j < 2; ++j)
+                {
+                    for (int k = 0; k < 256; ++k)
+                    {
+                        count[i][j][k] += stats.count[i][j][k];
+                    }
+                }
+            }
+        }
+
+        bool isUsed(int tc, int th) const
+        {
+            for (int k = 0; k < 256; ++k)
+            {
+                if (count[tc][th][k])
+                    return true;
+            }
+            return false;
+        }
+    };
+
+    struct HuffmanCodes
+    {
+        u8 bits[17]; // number of codes of each length
+        u8 value[256]; // symbols in increasing code length order
+        int count;
+
+        u16 code[256]; // code for each symbol
+        u8 size[256]; // code length for each symbol
+
+        void generate(const u32* frequency)
+        {
+            // Section K.2: generate optimal table with code length limited to 16 bits
+
+            constexpr int MAX_CLEN = 32;
+
+            u32 freq[257];
+            int codesize[257];
+            int others[257];
+            int clen[MAX_CLEN + 1];
+
+            for (int i = 0; i < 256; ++i)
+            {
+                freq[i] = frequency[i];
+                codesize[i] = 0;
+                others[i] = -1;
+            }
+
+            // reserve one code point so that no code consists of all ones
+            freq[256] = 1;
+            codesize[256] = 0;
+            others[256] = -1;
+
+            for (;;)
+            {
+                // find the smallest nonzero frequency; ties go to the larger symbol
+                int c1 = -1;
+                u32 v = 0xffffffff;
+                for (int i = 0; i <= 256; ++i)
+                {
+                    if (freq[i] && freq[i] <= v)
+                    {
+                        v = freq[i];
+                        c1 = i;
+                    }
+                }
+
+                // find the next smallest nonzero frequency
+                int c2 = -1;
+                v = 0xffffffff;
+                for (int i = 0; i <= 256; ++i)
+                {
+                    if (freq[i] && freq[i] <= v && i != c1)
+                    {
+                        v = freq[i];
+                        c2 = i;
+                    }
+                }
+
+                if (c2 < 0)
+                    break;
+
+                // merge the two trees
+                freq[c1] += freq[c2];
+                freq[c2] = 0;
+
+                ++codesize[c1];
+                while (others[c1] >= 0)
+                {
+                    c1 = others[c1];
+                    ++codesize[c1];
+                }
+
+                others[c1] = c2;
+
+                ++codesize[c2];
+                while (others[c2] >= 0)
+                {
+                    c2 = others[c2];
+                    ++codesize[c2];
+                }
+            }
+
+            std::memset(clen, 0, sizeof(clen));
+
+            for (int i = 0; i <= 256; ++i)
+            {
+                if (codesize[i])
+                {
+                    ++clen[std::min(codesize[i], MAX_CLEN)];
+                }
+            }
+
+            // Figure K.3: adjust the code lengths so that no code is longer than 16 bits
+            for (int i = MAX_CLEN; i > 16; --i)
+            {
+                while (clen[i] > 0)
+                {
+                    int j = i - 2;
+                    while (clen[j] == 0)
+                    {
+                        --j;
+                    }
+
+                    clen[i] -= 2;
+                    clen[i - 1]++;
+                    clen[j + 1] += 2;
+                    clen[j]--;
+                }
+            }
+
+            // remove the reserved code point from the longest code length
+            int i = 16;
+            while (clen[i] == 0)
+            {
+                --i;
+            }
+            clen[i]--;
+
+            bits[0] = 0;
+            for (int i = 1; i <= 16; ++i)
+            {
+                bits[i] = u8(clen[i]);
+            }
+
+            // Section K.2: sort the symbols by code length
+            count = 0;
+            for (int length = 1; length <= MAX_CLEN; ++length)
+            {
+                for (int symbol = 0; symbol < 256; ++symbol)
+                {
+                    if (codesize[symbol] == length)
+                    {
+                        value[count++] = u8(symbol);
+                    }
+                }
+            }
+
+            // Figure C.1 and C.2: generate the codes in code length order
+            std::memset(code, 0, sizeof(code));
+            std::memset(size, 0, sizeof(size));
+
+            u32 current_code = 0;
+            int p = 0;
+
+            for (int length = 1; length <= 16; ++length)
+            {
+                for (int j = 0; j < bits[length]; ++j)
+                {
+                    u8 symbol = value[p++];
+                    code[symbol] = u16(current_code++);
+                    size[symbol] = u8(length);
+                }
+                current_code <<= 1;
+            }
+        }
+    };
+
+    struct HuffmanCodeTables
+    {
+        HuffmanCodes codes[2][2]; // [dc, ac][table]
+    };
+
+    // ----------------------------------------------------------------------------
+    // scan encoder
+    // ----------------------------------------------------------------------------
+
+    /*
+        Encodes one scan (sequential or progressive) with explicitly built Huffman tables.
+        The same code is run twice: first with statistics attached to count the symbols
+        and then with the generated tables attached to emit the bitstream. The
+        restart marker after every MCU row keeps the rows independent so that both
+        passes can be run in parallel for each row.
+    */
+
+    struct JPEGScan
+    {
+        int components[3];
+        int count;
+        int Ss;
+        int Se;
+        int Ah;
+        int Al;
+    };
+
+    struct HuffmanScanEncoder : HuffmanEncoder
+    {
+        // maximum number of buffered correction bits in AC refinement
+        static constexpr int MAX_CORRECTION_BITS = 1000;
+
+        const JPEGScan& scan;
+        const HuffmanCodeTables* tables; // emit mode
+        HuffmanStatistics* statistics; // gather mode
+
+        u8* ptr = nullptr;
+
+        int eobrun = 0;
+        int BE = 0; // number of correction bits buffered for the pending eobrun
+        u8 correction[MAX_CORRECTION_BITS];
+
+        HuffmanScanEncoder(const JPEGScan& scan, const HuffmanCodeTables* tables, HuffmanStatistics* statistics)
+            : scan(scan)
+            , tables(tables)
+            , statistics(statistics)
+        {
+        }
+
+        void putSymbol(int tc, int th, int symbol)
+        {
+            if (statistics)
+            {
+                ++statistics->count[tc][th][symbol];
+            }
+            else
+            {
+                const HuffmanCodes& codes = tables->codes[tc][th];
+                ptr = putBits(ptr, codes.code[symbol], codes.size[symbol]);
+            }
+        }
+
+        void putValue(int value, int size)
+        {
+            if (!statistics && size)
+            {
+                ptr = putBits(ptr, value & ((1 << size) - 1), size);
+            }
+        }
+
+        void putCorrectionBits(const u8* bits, int count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                putValue(bits[i], 1);
+            }
+        }
+
+        void putEOBRun(int th)
+        {
+            if (eobrun > 0)
+            {
+                int size = u32_log2(eobrun);
+                putSymbol(1, th, size << 4);
+                putValue(eobrun, size);
+                eobrun = 0;
+
+                putCorrectionBits(correction, BE);
+                BE = 0;
+            }
+        }
+
+        void putCoefficient(int tc, int th, int run, int coeff)
+        {
+            u32 absCoeff = (coeff < 0) ? -coeff-- : coeff;
+            int size = absCoeff ? u32_log2(absCoeff) + 1 : 0;
+            putSymbol(tc, th, (run << 4) | size);
+            putValue(coeff, size);
+        }
+
+        void encodeSequential(int component, const s16* input)
+        {
+            const int th = component != 0;
+
+            int coeff = input[0] - last_dc_value[component];
+            last_dc_value[component] = input[0];
+            putCoefficient(0, th, 0, coeff);
+
+            int run = 0;
+
+            for (int i = 1; i < 64; ++i)
+            {
+                int coeff = input[zigzag_table_inverse[i]];
+                if (coeff)
+                {
+                    while (run > 15)
+                    {
+                        putSymbol(1, th, 0xf0);
+                        run -= 16;
+                    }
+
+                    putCoefficient(1, th, run, coeff);
+                    run = 0;
+                }
+                else
+                {
+                    ++run;
+                }
+            }
+
+            if (run)
+            {
+                putSymbol(1, th, 0x00);
+            }
+        }
+
+        void encodeDCFirst(int component, const s16* input)
+        {
+            // arithmetic shift right of the DC coefficient by Al (G.1.2.1)
+            int value = input[0] >> scan.Al;
+            int coeff = value - last_dc_value[component];
+            last_dc_value[component] = value;
+            putCoefficient(0, component != 0, 0, coeff);
+        }
+
+        void encodeDCRefine(int component, const s16* input)
+        {
+            MANGO_UNREFERENCED(component);
+            putValue((input[0] >> scan.Al) & 1, 1);
+        }
+
+        void encodeACFirst(int component, const s16* input)
+        {
+            const int th = component != 0;
+            int run = 0;
+
+            for (int k = scan.Ss; k <= scan.Se; ++k)
+            {
+                int coeff = input[zigzag_table_inverse[k]];
+
+                // point transform: divide the magnitude by 2^Al (G.1.2.2)
+                int value = coeff < 0 ? -((-coeff) >> scan.Al) : coeff >> scan.Al;
+                if (!value)
+                {
+                    ++run;
+                    continue;
+                }
+
+                putEOBRun(th);
+
+                while (run > 15)
+                {
+                    putSymbol(1, th, 0xf0);
+                    run -= 16;
+                }
+
+                putCoefficient(1, th, run, value);
+                run = 0;
+            }
+
+            if (run > 0)
+            {
+                ++eobrun;
+                if (eobrun == 0x7fff)
+                {
+                    putEOBRun(th);
+                }
+            }
+        }
+
+        void encodeACRefine(int component, const s16* input)
+        {
+            const int th = component != 0;
+
+            int absvalue[64];
+            int eob = 0;
+
+            // find the position of the last coefficient which becomes nonzero in this scan
+            for (int k = scan.Ss; k <= scan.Se; ++k)
+            {
+                int coeff = input[zigzag_table_inverse[k]];
+                int value = std::abs(coeff) >> scan.Al;
+                absvalue[k] = value;
+                if (value == 1)
+                {
+                    eob = k;
+                }
+            }
+
+            int run = 0;
+            int BR = 0; // number of correction bits buffered for this block
+            u8* buffer = correction + BE;
+
+            for (int k = scan.Ss; k <= scan.Se; ++k)
+            {
+                int value = absvalue[k];
+                if (!value)
+                {
+                    ++run;
+                    continue;
+                }
+
+                while (run > 15 && k <= eob)
+                {
+                    putEOBRun(th);
+                    putSymbol(1, th, 0xf0);
+                    run -= 16;
+                    putCorrectionBits(buffer, BR);
+                    buffer = correction;
+                    BR = 0;
+                }
+
+                if (value > 1)
+                {
+                    // previously nonzero coefficient: buffer the correction bit
+                    buffer[BR++] = u8(value & 1);
+                    continue;
+                }
+
+                // newly nonzero coefficient
+                putEOBRun(th);
+                putSymbol(1, th, (run << 4) | 1);
+                putValue(input[zigzag_table_inverse[k]] < 0 ? 0 : 1, 1);
+                putCorrectionBits(buffer, BR);
+                buffer = correction;
+                BR = 0;
+                run = 0;
+            }
+
+            if (run > 0 || BR > 0)
+            {
+                ++eobrun;
+                BE += BR;
+                if (eobrun == 0x7fff || BE > (MAX_CORRECTION_BITS - 64 + 1))
+                {
+                    putEOBRun(th);
+                }
+            }
+        }
+
+        void encode(int component, const s16* input)
+        {
+            if (scan.Ss == 0)
+            {
+                if (scan.Se == 63)
+                    encodeSequential(component, input);
+                else if (scan.Ah == 0)
+                    encodeDCFirst(component, input);
+                else
+                    encodeDCRefine(component, input);
+            }
+            else
+            {
+                if (scan.Ah == 0)
+                    encodeACFirst(component, input);
+                else
+                    encodeACRefine(component, input);
+            }
+        }
+
+        void finish()
+        {
+            putEOBRun(scan.components[0] != 0);
+            if (!statistics)
+            {
+                ptr = flush(ptr);
+            }
+        }
+    };
+
 #if defined(JPEG_ENABLE_SSE2)
 
 #if defined(JPEG_ENABLE_AVX2)
@@ -1546,29 +2050,128 @@ namespace
 #endif // JPEG_ENABLE_SSE4
 
     // ----------------------------------------------------------------------------
-    // jpeg_encode
+    // downsample
     // ----------------------------------------------------------------------------
 
-    jpeg_encode::jpeg_encode(SampleType sample, u32 width, u32 height, u32 stride, u32 quality)
-        : ILqt(64)
-        , ICqt(64)
-    {
-        MANGO_UNREFERENCED(stride);
+    // The chroma is read at full resolution into a 16x16 (4:2:0) or 16x8 (4:2:2)
+    // block with stride of 16 samples and box filtered into a 8x8 block.
 
-        int bytes_per_pixel = 0;
+#if defined(JPEG_ENABLE_SSE2)
 
-        channel_count = 0;
+    static
+    void downsample_420(s16* dest, const s16* source)
+    {
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i bias = _mm_set1_epi32(2);
 
-        channel[0].component = 1;
-        channel[0].qtable = ILqt;
+        for (int y = 0; y < 8; ++y)
+        {
+            const __m128i* s = reinterpret_cast<const __m128i*>(source + y * 32);
+            __m128i s0 = _mm_add_epi16(_mm_loadu_si128(s + 0), _mm_loadu_si128(s + 2));
+            __m128i s1 = _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_loadu_si128(s + 3));
+            __m128i t0 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s0, one), bias), 2);
+            __m128i t1 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s1, one), bias), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + y * 8), _mm_packs_epi32(t0, t1));
+        }
+    }
 
-        channel[1].component = 2;
-        channel[1].qtable = ICqt;
+    static
+    void downsample_422(s16* dest, const s16* source)
+    {
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i bias = _mm_set1_epi32(1);
 
-        channel[2].component = 3;
-        channel[2].qtable = ICqt;
+        for (int y = 0; y < 8; ++y)
+        {
+            const __m128i* s = reinterpret_cast<const __m128i*>(source + y * 16);
+            __m128i t0 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_loadu_si128(s + 0), one), bias), 1);
+            __m128i t1 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_loadu_si128(s + 1), one), bias), 1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + y * 8), _mm_packs_epi32(t0, t1));
+        }
+    }
 
-        read_8x8 = nullptr;
+#elif defined(JPEG_ENABLE_NEON)
+
+    static
+    void downsample_420(s16* dest, const s16* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            const s16* s = source + y * 32;
+            int16x8_t s0 = vaddq_s16(vld1q_s16(s + 0), vld1q_s16(s + 16));
+            int16x8_t s1 = vaddq_s16(vld1q_s16(s + 8), vld1q_s16(s + 24));
+            int16x4_t t0 = vrshrn_n_s32(vpaddlq_s16(s0), 2);
+            int16x4_t t1 = vrshrn_n_s32(vpaddlq_s16(s1), 2);
+            vst1q_s16(dest + y * 8, vcombine_s16(t0, t1));
+        }
+    }
+
+    static
+    void downsample_422(s16* dest, const s16* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            const s16* s = source + y * 16;
+            int16x4_t t0 = vrshrn_n_s32(vpaddlq_s16(vld1q_s16(s + 0)), 1);
+            int16x4_t t1 = vrshrn_n_s32(vpaddlq_s16(vld1q_s16(s + 8)), 1);
+            vst1q_s16(dest + y * 8, vcombine_s16(t0, t1));
+        }
+    }
+
+#else
+
+    static
+    void downsample_420(s16* dest, const s16* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            const s16* s0 = source + y * 32;
+            const s16* s1 = s0 + 16;
+            for (int x = 0; x < 8; ++x)
+            {
+                dest[x] = s16((s0[x * 2 + 0] + s0[x * 2 + 1] + s1[x * 2 + 0] + s1[x * 2 + 1] + 2) >> 2);
+            }
+            dest += 8;
+        }
+    }
+
+    static
+    void downsample_422(s16* dest, const s16* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            const s16* s = source + y * 16;
+            for (int x = 0; x < 8; ++x)
+            {
+                dest[x] = s16((s[x * 2 + 0] + s[x * 2 + 1] + 1) >> 1);
+            }
+            dest += 8;
+        }
+    }
+
+#endif
+
+    // ----------------------------------------------------------------------------
+    // jpeg_encode
+    // ----------------------------------------------------------------------------
+
+    jpeg_encode::jpeg_encode(SampleType sample, u32 width, u32 height, u32 stride, u32 quality, const ImageEncodeOptions& options)
+        : ILqt(64)
+        , ICqt(64)
+    {
+        MANGO_UNREFERENCED(stride);
+
+        progressive = options.progressive;
+        optimize = options.optimize || options.progressive;
+
+        this->width = width;
+        this->height = height;
+
+        bytes_per_pixel = 0;
+        component_count = 0;
+
+        read_8x8 = nullptr;
+        downsample = nullptr;
 
         u64 flags = getCPUFlags();
         MANGO_UNREFERENCED(flags);
@@ -1587,7 +2190,7 @@ namespace
 #endif
                 read = read_y_format;
                 bytes_per_pixel = 1;
-                channel_count = 1;
+                component_count = 1;
                 break;
 
             case JPEG_U8_BGR:
@@ -1600,7 +2203,7 @@ namespace
 #endif
                 read = read_bgr_format;
                 bytes_per_pixel = 3;
-                channel_count = 3;
+                component_count = 3;
                 break;
 
             case JPEG_U8_RGB:
@@ -1613,7 +2216,7 @@ namespace
 #endif
                 read = read_rgb_format;
                 bytes_per_pixel = 3;
-                channel_count = 3;
+                component_count = 3;
                 break;
 
             case JPEG_U8_BGRA:
@@ -1626,7 +2229,7 @@ namespace
 #endif
                 read = read_bgra_format;
                 bytes_per_pixel = 4;
-                channel_count = 3;
+                component_count = 3;
                 break;
 
             case JPEG_U8_RGBA:
@@ -1639,7 +2242,7 @@ namespace
 #endif
                 read = read_rgba_format;
                 bytes_per_pixel = 4;
-                channel_count = 3;
+                component_count = 3;
                 break;
         }
 
@@ -1657,11 +2260,64 @@ namespace
             info += sampler_name;
         }
 
-        mcu_width = 8;
-        mcu_height = 8;
+        if (progressive)
+        {
+            info += " Progressive";
+        }
+        else if (optimize)
+        {
+            info += " Optimized";
+        }
 
-        horizontal_mcus = (width + mcu_width - 1) >> 3;
-        vertical_mcus   = (height + mcu_height - 1) >> 3;
+        // chroma subsampling
+        hsf = 1;
+        vsf = 1;
+
+        if (component_count == 3)
+        {
+            switch (options.subsampling)
+            {
+                case 420:
+                    hsf = 2;
+                    vsf = 2;
+                    downsample = downsample_420;
+                    info += " 4:2:0";
+                    break;
+
+                case 422:
+                    hsf = 2;
+                    vsf = 1;
+                    downsample = downsample_422;
+                    info += " 4:2:2";
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        // MCU configuration: luminance blocks followed by the chroma blocks
+        channel_count = 0;
+
+        for (int i = 0; i < hsf * vsf; ++i)
+        {
+            channel[channel_count].component = 1;
+            channel[channel_count].qtable = ILqt;
+            ++channel_count;
+        }
+
+        for (int i = 1; i < component_count; ++i)
+        {
+            channel[channel_count].component = i + 1;
+            channel[channel_count].qtable = ICqt;
+            ++channel_count;
+        }
+
+        mcu_width = 8 * hsf;
+        mcu_height = 8 * vsf;
+
+        horizontal_mcus = (width + mcu_width - 1) / mcu_width;
+        vertical_mcus   = (height + mcu_height - 1) / mcu_height;
 
         rows_in_bottom_mcus = height - (vertical_mcus - 1) * mcu_height;
         cols_in_right_mcus  = width  - (horizontal_mcus - 1) * mcu_width;
@@ -1675,6 +2331,63 @@ namespace
     {
     }
 
+    void jpeg_encode::read_mcu(s16* block, const u8* input, int stride, int rows, int cols) const
+    {
+        if (!downsample)
+        {
+            auto func = (rows == 8 && cols == 8) ? read_8x8 : read;
+            func(block, input, stride, rows, cols);
+            return;
+        }
+
+        // full resolution chroma
+        s16 cb[256];
+        s16 cr[256];
+
+        for (int y = 0; y < vsf; ++y)
+        {
+            // blocks completely outside of the image replicate the last row
+            int y0 = y * 8;
+            int block_rows = std::min(rows - y0, 8);
+            if (block_rows <= 0)
+            {
+                y0 = rows - 1;
+                block_rows = 1;
+            }
+
+            for (int x = 0; x < hsf; ++x)
+            {
+                // blocks completely outside of the image replicate the last column
+                int x0 = x * 8;
+                int block_cols = std::min(cols - x0, 8);
+                if (block_cols <= 0)
+                {
+                    x0 = cols - 1;
+                    block_cols = 1;
+                }
+
+                const u8* source = input + y0 * stride + x0 * bytes_per_pixel;
+
+                s16 temp[BLOCK_SIZE * 3];
+
+                auto func = (block_rows == 8 && block_cols == 8) ? read_8x8 : read;
+                func(temp, source, stride, block_rows, block_cols);
+
+                std::memcpy(block + (y * hsf + x) * BLOCK_SIZE, temp, BLOCK_SIZE * sizeof(s16));
+
+                for (int i = 0; i < 8; ++i)
+                {
+                    std::memcpy(cb + (y * 8 + i) * 16 + x * 8, temp + BLOCK_SIZE * 1 + i * 8, 8 * sizeof(s16));
+                    std::memcpy(cr + (y * 8 + i) * 16 + x * 8, temp + BLOCK_SIZE * 2 + i * 8, 8 * sizeof(s16));
+                }
+            }
+        }
+
+        s16* chroma = block + hsf * vsf * BLOCK_SIZE;
+        downsample(chroma + BLOCK_SIZE * 0, cb);
+        downsample(chroma + BLOCK_SIZE * 1, cr);
+    }
+
     void jpeg_encode::init_quantization_tables(u32 quality)
     {
         for (int i = 0; i < 64; ++i)
@@ -1729,24 +2442,11 @@ namespace
         // Cqt table
         p.write(Cqt, 64);
 
-        // Start of frame marker
-        p.write16(0xffc0);
+        // Start of frame marker (baseline or progressive)
+        p.write16(progressive ? 0xffc2 : 0xffc0);
 
-        u8 number_of_components = 0;
-
-        switch (sample)
-        {
-            case JPEG_U8_Y:
-                number_of_components = 1;
-                break;
-
-            case JPEG_U8_RGB:
-            case JPEG_U8_BGR:
-            case JPEG_U8_BGRA:
-            case JPEG_U8_RGBA:
-                number_of_components = 3;
-                break;
-        }
+        MANGO_UNREFERENCED(sample);
+        u8 number_of_components = u8(component_count);
 
         u16 header_length = 8 + 3 * number_of_components;
 
@@ -1756,50 +2456,374 @@ namespace
         p.write16(u16(width)); // image width
         p.write8(number_of_components); // Nf
 
-        const u8 nfdata[] =
+        for (int i = 0; i < number_of_components; ++i)
         {
-            0x01, 0x11, 0x00, // component 1
-            0x00, 0x00, 0x00, // padding
-            0x01, 0x11, 0x00, // component 1
-            0x02, 0x11, 0x01, // component 2
-            0x03, 0x11, 0x01, // component 3
-        };
-
-        p.write(nfdata + (number_of_components - 1) * 3, number_of_components * 3);
+            u8 sampling = i ? 0x11 : u8((hsf << 4) | vsf);
+            p.write8(u8(i + 1)); // component
+            p.write8(sampling); // Hi, Vi
+            p.write8(i ? 0x01 : 0x00); // Tq
+        }
 
-        // huffman table(DHT)
-        p.write(marker_data, sizeof(marker_data));
+        if (!optimize)
+        {
+            // huffman table(DHT)
+            p.write(marker_data, sizeof(marker_data));
+        }
 
         // Define Restart Interval marker
+        restart_interval = horizontal_mcus;
         p.write16(0xffdd);
         p.write16(4);
-        p.write16(horizontal_mcus);
+        p.write16(u16(restart_interval));
+    }
 
+    void jpeg_encode::write_huffman_table(BigEndianStream& p, int tc, int th, const HuffmanCodes& codes)
+    {
+        // Define Huffman Table marker
+        p.write16(0xffc4);
+        p.write16(u16(2 + 1 + 16 + codes.count)); // length
+        p.write8(u8((tc << 4) | th)); // Tc, Th
+        p.write(codes.bits + 1, 16);
+        p.write(codes.value, codes.count);
+    }
+
+    void jpeg_encode::write_scan_header(BigEndianStream& p, const JPEGScan& scan)
+    {
         // Start of scan marker
         p.write16(0xffda);
-        p.write16(6 + number_of_components * 2); // header length
-        p.write8(number_of_components); // Ns
+        p.write16(u16(6 + scan.count * 2)); // header length
+        p.write8(u8(scan.count)); // Ns
+
+        for (int i = 0; i < scan.count; ++i)
+        {
+            int component = scan.components[i];
+            int td = component != 0;
+            int ta = component != 0;
+
+            if (progressive)
+            {
+                // DC and AC are in separate scans; unused selectors are zero
+                if (scan.Ss == 0)
+                {
+                    ta = 0;
+                    if (scan.Ah)
+                        td = 0;
+                }
+                else
+                {
+                    td = 0;
+                }
+            }
+
+            p.write8(u8(component + 1)); // Cs
+            p.write8(u8((td << 4) | ta)); // Td, Ta
+        }
+
+        p.write8(u8(scan.Ss));
+        p.write8(u8(scan.Se));
+        p.write8(u8((scan.Ah << 4) | scan.Al));
+    }
 
-        const u8 nsdata[] =
+    // ----------------------------------------------------------------------------
+    // encodeOptimized()
+    // ----------------------------------------------------------------------------
+
+    // progressive scan scripts: spectral selection and successive approximation
+    // (same as the libjpeg jpeg_simple_progression() scripts)
+
+    const JPEGScan g_progressive_scans_y [] =
+    {
+        { { 0 }, 1,  0,  0, 0, 1 },
+        { { 0 }, 1,  1,  5, 0, 2 },
+        { { 0 }, 1,  6, 63, 0, 2 },
+        { { 0 }, 1,  1, 63, 2, 1 },
+        { { 0 }, 1,  0,  0, 1, 0 },
+        { { 0 }, 1,  1, 63, 1, 0 },
+    };
+
+    const JPEGScan g_progressive_scans_ycbcr [] =
+    {
+        { { 0, 1, 2 }, 3,  0,  0, 0, 1 },
+        { { 0 },       1,  1,  5, 0, 2 },
+        { { 2 },       1,  1, 63, 0, 1 },
+        { { 1 },       1,  1, 63, 0, 1 },
+        { { 0 },       1,  6, 63, 0, 2 },
+        { { 0 },       1,  1, 63, 2, 1 },
+        { { 0, 1, 2 }, 3,  0,  0, 1, 0 },
+        { { 2 },       1,  1, 63, 1, 0 },
+        { { 1 },       1,  1, 63, 1, 0 },
+        { { 0 },       1,  1, 63, 1, 0 },
+    };
+
+    static
+    bool isLumaScan(const jpeg_encode& jp, const JPEGScan& scan)
+    {
+        // non-interleaved scan of subsampled luminance; the blocks are coded in raster order
+        return scan.count == 1 && scan.components[0] == 0 && (jp.hsf > 1 || jp.vsf > 1);
+    }
+
+    static
+    int getRestartInterval(const jpeg_encode& jp, const JPEGScan& scan)
+    {
+        // number of coded units in one MCU row
+        if (isLumaScan(jp, scan))
         {
-            0x01, 0x00,
-            0x02, 0x11,
-            0x03, 0x11,
+            return ceil_div(jp.width, 8) * jp.vsf;
+        }
+
+        return jp.horizontal_mcus;
+    }
+
+    static
+    void encodeScanRow(HuffmanScanEncoder& encoder, const jpeg_encode& jp, int y, const s16* data, Buffer* buffer)
+    {
+        constexpr int buffer_size = 8192;
+        constexpr int flush_threshold = buffer_size - 4096;
+
+        u8 huff_temp[buffer_size]; // encoding buffer
+        encoder.ptr = huff_temp;
+
+        auto flush = [&]
+        {
+            if (buffer && encoder.ptr - huff_temp > flush_threshold)
+            {
+                buffer->append(huff_temp, encoder.ptr - huff_temp);
+                encoder.ptr = huff_temp;
+            }
         };
 
-        p.write(nsdata, number_of_components * 2);
-        p.write8(0x00);
-        p.write8(0x3f);
-        p.write8(0x00);
+        const JPEGScan& scan = encoder.scan;
+
+        if (isLumaScan(jp, scan))
+        {
+            const int xblocks = ceil_div(jp.width, 8);
+            const int yblocks = ceil_div(jp.height, 8);
+
+            for (int by = 0; by < jp.vsf && y * jp.vsf + by < yblocks; ++by)
+            {
+                for (int bx = 0; bx < xblocks; ++bx)
+                {
+                    int mcu = bx / jp.hsf;
+                    int index = by * jp.hsf + bx % jp.hsf;
+                    encoder.encode(0, data + (mcu * jp.channel_count + index) * BLOCK_SIZE);
+                    flush();
+                }
+            }
+        }
+        else
+        {
+            for (int x = 0; x < jp.horizontal_mcus; ++x)
+            {
+                for (int i = 0; i < jp.channel_count; ++i)
+                {
+                    int component = jp.channel[i].component - 1;
+
+                    for (int j = 0; j < scan.count; ++j)
+                    {
+                        if (scan.components[j] == component)
+                        {
+                            encoder.encode(component, data + i * BLOCK_SIZE);
+                        }
+                    }
+                }
+
+                data += jp.channel_count * BLOCK_SIZE;
+                flush();
+            }
+        }
+
+        encoder.finish();
+
+        if (buffer)
+        {
+            buffer->append(huff_temp, encoder.ptr - huff_temp);
+        }
+    }
+
+    static
+    void encodeScan(jpeg_encode& jp, BigEndianStream& s, const JPEGScan& scan, const s16* coefficients)
+    {
+        const int mcu_stride = jp.horizontal_mcus * jp.channel_count * BLOCK_SIZE;
+
+        ConcurrentQueue queue;
+
+        HuffmanCodeTables tables;
+
+        // DC refinement scan is not huffman coded
+        if (scan.Ss != 0 || scan.Ah == 0)
+        {
+            // first pass: gather symbol statistics
+            std::vector<HuffmanStatistics> statistics(jp.vertical_mcus);
+
+            for (int y = 0; y < jp.vertical_mcus; ++y)
+            {
+                queue.enqueue([&jp, &scan, &statistics, coefficients, mcu_stride, y]
+                {
+                    HuffmanScanEncoder encoder(scan, nullptr, &statistics[y]);
+                    encodeScanRow(encoder, jp, y, coefficients + y * mcu_stride, nullptr);
+                });
+            }
+
+            queue.wait();
+
+            HuffmanStatistics total;
+
+            for (auto& stats : statistics)
+            {
+                total.accumulate(stats);
+            }
+
+            for (int tc = 0; tc < 2; ++tc)
+            {
+                for (int th = 0; th < 2; ++th)
+                {
+                    if (total.isUsed(tc, th))
+                    {
+                        tables.codes[tc][th].generate(total.count[tc][th]);
+                        jp.write_huffman_table(s, tc, th, tables.codes[tc][th]);
+                    }
+                }
+            }
+        }
+
+        int interval = getRestartInterval(jp, scan);
+        if (interval != jp.restart_interval)
+        {
+            // Define Restart Interval marker
+            s.write16(0xffdd);
+            s.write16(4);
+            s.write16(u16(interval));
+            jp.restart_interval = interval;
+        }
+
+        jp.write_scan_header(s, scan);
+
+        // second pass: encode with the optimized tables
+        std::vector<EncodeBuffer> buffers(jp.vertical_mcus);
+
+        for (int y = 0; y < jp.vertical_mcus; ++y)
+        {
+            queue.enqueue([&jp, &scan, &tables, &buffers, coefficients, mcu_stride, y]
+            {
+                EncodeBuffer& buffer = buffers[y];
+
+                HuffmanScanEncoder encoder(scan, &tables, nullptr);
+                encodeScanRow(encoder, jp, y, coefficients + y * mcu_stride, &buffer);
+
+                // mark buffer ready for writing
+                buffer.ready = true;
+            });
+        }
+
+        for (int y = 0; y < jp.vertical_mcus; ++y)
+        {
+            EncodeBuffer& buffer = buffers[y];
+
+            for ( ; !buffer.ready; )
+            {
+                // buffer is not processed yet; help the thread pool while waiting
+                queue.steal();
+            }
+
+            // write huffman bitstream
+            s.write(buffer, size_t(buffer.size()));
+
+            // write restart marker
+            int index = y & 7;
+            s.write16(0xffd0 + index);
+        }
+    }
+
+    static
+    void encodeOptimized(jpeg_encode& jp, const Surface& surface, BigEndianStream& s)
+    {
+        const int mcu_stride = jp.horizontal_mcus * jp.channel_count * BLOCK_SIZE;
+
+        // quantized DCT coefficients for the whole image; each scan is encoded from these
+        AlignedStorage<s16> coefficients(jp.vertical_mcus * mcu_stride);
+
+        ConcurrentQueue queue;
+
+        const u8* input = surface.image;
+        int stride = surface.stride;
+
+        for (int y = 0; y < jp.vertical_mcus; ++y)
+        {
+            int rows = (y < jp.vertical_mcus - 1) ? jp.mcu_height : jp.rows_in_bottom_mcus;
+            s16* output = coefficients + y * mcu_stride;
+
+            queue.enqueue([&jp, input, stride, rows, output]
+            {
+                const u8* image = input;
+                s16* dest = output;
+
+                for (int x = 0; x < jp.horizontal_mcus; ++x)
+                {
+                    s16 block[BLOCK_SIZE * JPEG_MAX_BLOCKS_IN_MCU];
+
+                    // read MCU data
+                    int cols = (x < jp.horizontal_mcus - 1) ? jp.mcu_width : jp.cols_in_right_mcus;
+                    jp.read_mcu(block, image, stride, rows, cols);
+
+                    for (int i = 0; i < jp.channel_count; ++i)
+                    {
+                        fdct(dest, block + i * BLOCK_SIZE, jp.channel[i].qtable);
+                        dest += BLOCK_SIZE;
+                    }
+
+                    image += jp.mcu_width_size;
+                }
+            });
+
+            input += surface.stride * jp.mcu_height;
+        }
+
+        queue.wait();
+
+        if (jp.progressive)
+        {
+            const JPEGScan* scans = g_progressive_scans_y;
+            int count = int(sizeof(g_progressive_scans_y) / sizeof(JPEGScan));
+
+            if (jp.component_count == 3)
+            {
+                scans = g_progressive_scans_ycbcr;
+                count = int(sizeof(g_progressive_scans_ycbcr) / sizeof(JPEGScan));
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                encodeScan(jp, s, scans[i], coefficients);
+            }
+        }
+        else
+        {
+            JPEGScan scan = { { 0, 1, 2 }, jp.component_count, 0, 63, 0, 0 };
+            encodeScan(jp, s, scan, coefficients);
+        }
     }
 
     // ----------------------------------------------------------------------------
     // encodeJPEG()
     // ----------------------------------------------------------------------------
 
-    void encodeJPEG(ImageEncodeStatus& status, const Surface& surface, Stream& stream, int quality, SampleType sample)
+    void encodeJPEG(ImageEncodeStatus& status, const Surface& surface, Stream& stream, int quality, SampleType sample, const ImageEncodeOptions& options)
     {
-        jpeg_encode jp(sample, surface.width, surface.height, surface.stride, quality);
+        jpeg_encode jp(sample, surface.width, surface.height, surface.stride, quality, options);
+
+        if (jp.optimize)
+        {
+            BigEndianStream s(stream);
+
+            jp.write_markers(s, sample, surface.width, surface.height);
+            encodeOptimized(jp, surface, s);
+
+            // EOI marker
+            s.write16(0xffd9);
+
+            status.info = jp.info;
+            return;
+        }
 
         const u8* input = surface.image;
         int stride = surface.stride;
@@ -1812,8 +2836,6 @@ namespace
         // encode MCUs
         for (int y = 0; y < jp.vertical_mcus; ++y)
         {
-            auto read_func = jp.read_8x8; // default: optimized 8x8 reader
-
             int rows;
             const int bottom_mcu = jp.vertical_mcus - 1;
             if (y < bottom_mcu)
@@ -1824,19 +2846,17 @@ namespace
             {
                 // clipping
                 rows = jp.rows_in_bottom_mcus;
-                read_func = jp.read; // clipping reader
             }
 
-            queue.enqueue([&jp, y, &buffers, input, stride, rows, read_func]
+            queue.enqueue([&jp, y, &buffers, input, stride, rows]
             {
-                auto read = read_func;
                 const u8* image = input;
 
                 HuffmanEncoder huffman;
                 EncodeBuffer& buffer = buffers[y];
 
-                constexpr int buffer_size = 2048;
-                constexpr int flush_threshold = buffer_size - 512;
+                constexpr int buffer_size = 8192;
+                constexpr int flush_threshold = buffer_size - 4096;
 
                 u8 huff_temp[buffer_size]; // encoding buffer
                 u8* ptr = huff_temp;
@@ -1854,13 +2874,12 @@ namespace
                     {
                         // clipping
                         cols = jp.cols_in_right_mcus;
-                        read = jp.read; // clipping reader
                     }
 
-                    s16 block[BLOCK_SIZE * 3];
+                    s16 block[BLOCK_SIZE * JPEG_MAX_BLOCKS_IN_MCU];
 
                     // read MCU data
-                    read(block, image, stride, rows, cols);
+                    jp.read_mcu(block, image, stride, rows, cols);
 
                     // encode the data in MCU
                     for (int i = 0; i < jp.channel_count; ++i)
@@ -1897,6 +2916,9 @@ namespace
         // writing marker data
         jp.write_markers(s, sample, surface.width, surface.height);
 
+        JPEGScan scan = { { 0, 1, 2 }, jp.component_count, 0, 63, 0, 0 };
+        jp.write_scan_header(s, scan);
+
         for (int y = 0; y < jp.vertical_mcus; ++y)
         {
             EncodeBuffer& buffer = buffers[y];
@@ -1944,12 +2966,12 @@ namespace jpeg {
         return result;
     }
 
-    ImageEncodeStatus encodeImage(Stream& stream, const Surface& surface, float quality)
+    ImageEncodeStatus encodeImage(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
         ImageEncodeStatus status;
 
         // configure quality
-        quality = clamp(1.0f - quality, 0.0f, 1.0f);
+        float quality = clamp(1.0f - options.quality, 0.0f, 1.0f);
         u32 iq = u32(std::pow(1.0f + quality, 11.0f) * 8.0f);
 
         SampleFormat sf = getSampleFormat(surface.format);
@@ -1957,14 +2979,14 @@ namespace jpeg {
         // encode
         if (surface.format == sf.format)
         {
-            encodeJPEG(status, surface, stream, iq, sf.sample);
+            encodeJPEG(status, surface, stream, iq, sf.sample, options);
             status.direct = true;
         }
         else
         {
             // convert source surface to format supported in the encoder
             Bitmap temp(surface, sf.format);
-            encodeJPEG(status, temp, stream, iq, sf.sample);
+            encodeJPEG(status, temp, stream, iq, sf.sample, options);
         }
 
         return status;
@@ -122,6 +122,63 @@ namespace jpeg {
             }
         }
 
+        // Compute combined lookup table which resolves the symbol and the magnitude
+        // bits following it with a single lookup. All possible magnitude bit patterns
+        // are expanded into the table so that the coefficient is already sign-extended.
+        // Resolving a second AC symbol from the leftover bits of the same lookup was
+        // measured to be no faster than one symbol per lookup, so only one is decoded.
+
+        std::memset(lookupFast, 0, sizeof(lookupFast));
+
+        p = 0;
+
+        for (int bits = 1; bits <= JPEG_HUFF_FAST_BITS; ++bits)
+        {
+            int isize = size[bits];
+
+            for (int i = 1; i <= isize; ++i)
+            {
+                int symbol = value[p];
+                u32 current_code = huffcode[p];
+                ++p;
+
+                if (symbol == 16)
+                {
+                    // lossless DC difference of 32768 has no magnitude bits
+                    continue;
+                }
+
+                int magnitude = symbol & 15;
+                int length = bits + magnitude;
+                if (length > JPEG_HUFF_FAST_BITS)
+                {
+                    // does not fit; the decoder will use the slow path
+                    continue;
+                }
+
+                int ishift = JPEG_HUFF_FAST_BITS - length;
+
+                for (int bitmask = 0; bitmask < (1 << magnitude); ++bitmask)
+                {
+                    int coeff = 0;
+                    if (magnitude)
+                    {
+                        coeff = bitmask < (1 << (magnitude - 1)) ? bitmask - (1 << magnitude) + 1 : bitmask;
+                    }
+
+                    s32 entry = s32((u32(coeff) << 16) | (symbol << 8) | length);
+
+                    int lookbits = ((current_code << magnitude) | bitmask) << ishift;
+
+                    int count = 1 << ishift;
+                    for (int mask = 0; mask < count; ++mask)
+                    {
+                        lookupFast[lookbits | mask] = entry;
+                    }
+                }
+            }
+        }
+
         return true;
     }
 
@@ -197,10 +254,23 @@ namespace jpeg {
             const HuffTable* ac = block->table.ac;
 
             // DC
-            int s = dc->decode(buffer);
-            if (s)
+            buffer.ensure16();
+            s32 entry = dc->lookupFast[buffer.peekBits(JPEG_HUFF_FAST_BITS)];
+
+            int s;
+
+            if (entry & 0xff)
             {
-                s = buffer.receive(s);
+                buffer.remain -= (entry & 0xff);
+                s = entry >> 16;
+            }
+            else
+            {
+                s = dc->decode(buffer);
+                if (s)
+                {
+                    s = buffer.receive(s);
+                }
             }
 
             s += huffman.last_dc_value[block->pred];
@@ -211,14 +281,30 @@ namespace jpeg {
             // AC
             for (int i = 1; i < 64; )
             {
-                int s = ac->decode(buffer);
-                int x = s & 15;
+                buffer.ensure16();
+                s32 entry = ac->lookupFast[buffer.peekBits(JPEG_HUFF_FAST_BITS)];
+
+                int s;
+                int coeff;
+
+                if (entry & 0xff)
+                {
+                    // symbol and magnitude resolved with one lookup
+                    buffer.remain -= (entry & 0xff);
+                    s = (entry >> 8) & 0xff;
+                    coeff = entry >> 16;
+                }
+                else
+                {
+                    s = ac->decode(buffer);
+                    int x = s & 15;
+                    coeff = x ? buffer.receive(x) : 0;
+                }
 
-                if (x)
+                if (s & 15)
                 {
                     i += (s >> 4);
-                    s = buffer.receive(x);
-                    output[zigzagTable[i++]] = s16(s);
+                    output[zigzagTable[i++]] = s16(coeff);
                 }
                 else
                 {
@@ -325,6 +325,279 @@ namespace jpeg {
         _mm_storeu_si128(d + 3, s3);
     }
 
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+
+    // ------------------------------------------------------------------------------------------------
+    // AVX2 / AVX-512 implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // The SSE2 implementation only uses lane-wise operations so the same algorithm is used to
+    // transform two (AVX2) or four (AVX-512) blocks at a time; each 128 bit lane holds one block.
+
+#define JPEG_IDCT_ROTATE_SIMD(P, V, dst0, dst1, x, y, c0, c1) \
+    V c0##_l = P##_unpacklo_epi16(x, y); \
+    V c0##_h = P##_unpackhi_epi16(x, y); \
+    V dst0##_l = P##_madd_epi16(c0##_l, c0); \
+    V dst0##_h = P##_madd_epi16(c0##_h, c0); \
+    V dst1##_l = P##_madd_epi16(c0##_l, c1); \
+    V dst1##_h = P##_madd_epi16(c0##_h, c1);
+
+#define JPEG_IDCT_WIDEN_SIMD(P, V, dst, in) \
+    V dst##_l = P##_srai_epi32(P##_unpacklo_epi16(zero, (in)), 4); \
+    V dst##_h = P##_srai_epi32(P##_unpackhi_epi16(zero, (in)), 4);
+
+#define JPEG_IDCT_WADD_SIMD(P, V, dst, a, b) \
+    V dst##_l = P##_add_epi32(a##_l, b##_l); \
+    V dst##_h = P##_add_epi32(a##_h, b##_h);
+
+#define JPEG_IDCT_WSUB_SIMD(P, V, dst, a, b) \
+    V dst##_l = P##_sub_epi32(a##_l, b##_l); \
+    V dst##_h = P##_sub_epi32(a##_h, b##_h);
+
+#define JPEG_IDCT_BFLY_SIMD(P, V, dst0, dst1, a, b, bias, norm) { \
+    V abiased_l = P##_add_epi32(a##_l, bias); \
+    V abiased_h = P##_add_epi32(a##_h, bias); \
+    JPEG_IDCT_WADD_SIMD(P, V, sum, abiased, b) \
+    JPEG_IDCT_WSUB_SIMD(P, V, diff, abiased, b) \
+    dst0 = P##_packs_epi32(P##_srai_epi32(sum_l, norm), P##_srai_epi32(sum_h, norm)); \
+    dst1 = P##_packs_epi32(P##_srai_epi32(diff_l, norm), P##_srai_epi32(diff_h, norm)); \
+    }
+
+#define JPEG_IDCT_IDCT_PASS_SIMD(P, V, bias, norm) { \
+    JPEG_IDCT_ROTATE_SIMD(P, V, t2e, t3e, v2, v6, r0_0, r0_1) \
+    V sum04 = P##_add_epi16(v0, v4); \
+    V dif04 = P##_sub_epi16(v0, v4); \
+    JPEG_IDCT_WIDEN_SIMD(P, V, t0e, sum04) \
+    JPEG_IDCT_WIDEN_SIMD(P, V, t1e, dif04) \
+    JPEG_IDCT_WADD_SIMD(P, V, x0, t0e, t3e) \
+    JPEG_IDCT_WSUB_SIMD(P, V, x3, t0e, t3e) \
+    JPEG_IDCT_WADD_SIMD(P, V, x1, t1e, t2e) \
+    JPEG_IDCT_WSUB_SIMD(P, V, x2, t1e, t2e) \
+    JPEG_IDCT_ROTATE_SIMD(P, V, y0o, y2o, v7, v3, r2_0, r2_1) \
+    JPEG_IDCT_ROTATE_SIMD(P, V, y1o, y3o, v5, v1, r3_0, r3_1) \
+    V sum17 = P##_add_epi16(v1, v7); \
+    V sum35 = P##_add_epi16(v3, v5); \
+    JPEG_IDCT_ROTATE_SIMD(P, V, y4o, y5o, sum17, sum35, r1_0, r1_1) \
+    JPEG_IDCT_WADD_SIMD(P, V, x4, y0o, y4o) \
+    JPEG_IDCT_WADD_SIMD(P, V, x5, y1o, y5o) \
+    JPEG_IDCT_WADD_SIMD(P, V, x6, y2o, y5o) \
+    JPEG_IDCT_WADD_SIMD(P, V, x7, y3o, y4o) \
+    JPEG_IDCT_BFLY_SIMD(P, V, v0, v7, x0, x7, bias, norm) \
+    JPEG_IDCT_BFLY_SIMD(P, V, v1, v6, x1, x6, bias, norm) \
+    JPEG_IDCT_BFLY_SIMD(P, V, v2, v5, x2, x5, bias, norm) \
+    JPEG_IDCT_BFLY_SIMD(P, V, v3, v4, x3, x4, bias, norm) \
+    }
+
+    // in-lane transpose of 8x8 16 bit values, followed by the 8 bit pack and transpose
+#define JPEG_IDCT_TRANSPOSE_SIMD(P, V) \
+    interleave16(v0, v4); \
+    interleave16(v2, v6); \
+    interleave16(v1, v5); \
+    interleave16(v3, v7); \
+    interleave16(v0, v2); \
+    interleave16(v1, v3); \
+    interleave16(v4, v6); \
+    interleave16(v5, v7); \
+    interleave16(v0, v1); \
+    interleave16(v2, v3); \
+    interleave16(v4, v5); \
+    interleave16(v6, v7);
+
+#define JPEG_IDCT_PACK_SIMD(P, V) \
+    V s0 = P##_packus_epi16(v0, v1); \
+    V s1 = P##_packus_epi16(v2, v3); \
+    V s2 = P##_packus_epi16(v4, v5); \
+    V s3 = P##_packus_epi16(v6, v7); \
+    interleave8(s0, s2); \
+    interleave8(s1, s3); \
+    interleave8(s0, s1); \
+    interleave8(s2, s3); \
+    interleave8(s0, s2); \
+    interleave8(s1, s3);
+
+    JPEG_TARGET_AVX2 static inline void interleave8(__m256i &a, __m256i &b)
+    {
+        __m256i c = a;
+        a = _mm256_unpacklo_epi8(a, b);
+        b = _mm256_unpackhi_epi8(c, b);
+    }
+
+    JPEG_TARGET_AVX2 static inline void interleave16(__m256i &a, __m256i &b)
+    {
+        __m256i c = a;
+        a = _mm256_unpacklo_epi16(a, b);
+        b = _mm256_unpackhi_epi16(c, b);
+    }
+
+    JPEG_TARGET_AVX2 static inline __m256i load2(const s16* p0, const s16* p1, int index)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p0) + index);
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p1) + index);
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+    }
+
+    JPEG_TARGET_AVX2 void idct2_avx2(u8* dest, const s16* data, const s16* qt0, const s16* qt1)
+    {
+        // Transform two consecutive blocks: data[0..63] -> dest[0..63], data[64..127] -> dest[64..127]
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i r0_0 = _mm256_broadcastsi128_si256(rot0_0);
+        const __m256i r0_1 = _mm256_broadcastsi128_si256(rot0_1);
+        const __m256i r1_0 = _mm256_broadcastsi128_si256(rot1_0);
+        const __m256i r1_1 = _mm256_broadcastsi128_si256(rot1_1);
+        const __m256i r2_0 = _mm256_broadcastsi128_si256(rot2_0);
+        const __m256i r2_1 = _mm256_broadcastsi128_si256(rot2_1);
+        const __m256i r3_0 = _mm256_broadcastsi128_si256(rot3_0);
+        const __m256i r3_1 = _mm256_broadcastsi128_si256(rot3_1);
+        const __m256i cbias = _mm256_broadcastsi128_si256(colBias);
+        const __m256i rbias = _mm256_broadcastsi128_si256(rowBias);
+
+        const s16* data0 = data;
+        const s16* data1 = data + 64;
+
+        // Load and dequantize
+        __m256i v0 = _mm256_mullo_epi16(load2(data0, data1, 0), load2(qt0, qt1, 0));
+        __m256i v1 = _mm256_mullo_epi16(load2(data0, data1, 1), load2(qt0, qt1, 1));
+        __m256i v2 = _mm256_mullo_epi16(load2(data0, data1, 2), load2(qt0, qt1, 2));
+        __m256i v3 = _mm256_mullo_epi16(load2(data0, data1, 3), load2(qt0, qt1, 3));
+        __m256i v4 = _mm256_mullo_epi16(load2(data0, data1, 4), load2(qt0, qt1, 4));
+        __m256i v5 = _mm256_mullo_epi16(load2(data0, data1, 5), load2(qt0, qt1, 5));
+        __m256i v6 = _mm256_mullo_epi16(load2(data0, data1, 6), load2(qt0, qt1, 6));
+        __m256i v7 = _mm256_mullo_epi16(load2(data0, data1, 7), load2(qt0, qt1, 7));
+
+        // IDCT columns
+        JPEG_IDCT_IDCT_PASS_SIMD(_mm256, __m256i, cbias, 10)
+
+        // Transpose
+        JPEG_IDCT_TRANSPOSE_SIMD(_mm256, __m256i)
+
+        // IDCT rows
+        JPEG_IDCT_IDCT_PASS_SIMD(_mm256, __m256i, rbias, 17)
+
+        // Pack to 8-bit integers and transpose
+        JPEG_IDCT_PACK_SIMD(_mm256, __m256i)
+
+        // Store
+        __m128i* d = reinterpret_cast<__m128i *>(dest);
+        _mm_storeu_si128(d + 0, _mm256_castsi256_si128(s0));
+        _mm_storeu_si128(d + 1, _mm256_castsi256_si128(s2));
+        _mm_storeu_si128(d + 2, _mm256_castsi256_si128(s1));
+        _mm_storeu_si128(d + 3, _mm256_castsi256_si128(s3));
+        _mm_storeu_si128(d + 4, _mm256_extracti128_si256(s0, 1));
+        _mm_storeu_si128(d + 5, _mm256_extracti128_si256(s2, 1));
+        _mm_storeu_si128(d + 6, _mm256_extracti128_si256(s1, 1));
+        _mm_storeu_si128(d + 7, _mm256_extracti128_si256(s3, 1));
+    }
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+
+#if defined(MANGO_COMPILER_GCC)
+    // GCC 12 warns about the self-initialized _mm512_undefined_epi32() in its own headers
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+    JPEG_TARGET_AVX512 static inline void interleave8(__m512i &a, __m512i &b)
+    {
+        __m512i c = a;
+        a = _mm512_unpacklo_epi8(a, b);
+        b = _mm512_unpackhi_epi8(c, b);
+    }
+
+    JPEG_TARGET_AVX512 static inline void interleave16(__m512i &a, __m512i &b)
+    {
+        __m512i c = a;
+        a = _mm512_unpacklo_epi16(a, b);
+        b = _mm512_unpackhi_epi16(c, b);
+    }
+
+    JPEG_TARGET_AVX512 static inline __m512i load4(const s16* p0, const s16* p1, const s16* p2, const s16* p3, int index)
+    {
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p0) + index));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p1) + index), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p2) + index), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p3) + index), 3);
+        return v;
+    }
+
+    JPEG_TARGET_AVX512 void idct4_avx512(u8* dest, const s16* data, const s16* qt0, const s16* qt1, const s16* qt2, const s16* qt3)
+    {
+        // Transform four consecutive blocks
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i r0_0 = _mm512_broadcast_i32x4(rot0_0);
+        const __m512i r0_1 = _mm512_broadcast_i32x4(rot0_1);
+        const __m512i r1_0 = _mm512_broadcast_i32x4(rot1_0);
+        const __m512i r1_1 = _mm512_broadcast_i32x4(rot1_1);
+        const __m512i r2_0 = _mm512_broadcast_i32x4(rot2_0);
+        const __m512i r2_1 = _mm512_broadcast_i32x4(rot2_1);
+        const __m512i r3_0 = _mm512_broadcast_i32x4(rot3_0);
+        const __m512i r3_1 = _mm512_broadcast_i32x4(rot3_1);
+        const __m512i cbias = _mm512_broadcast_i32x4(colBias);
+        const __m512i rbias = _mm512_broadcast_i32x4(rowBias);
+
+        const s16* data0 = data;
+        const s16* data1 = data + 64;
+        const s16* data2 = data + 128;
+        const s16* data3 = data + 192;
+
+        // Load and dequantize
+        __m512i v0 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 0), load4(qt0, qt1, qt2, qt3, 0));
+        __m512i v1 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 1), load4(qt0, qt1, qt2, qt3, 1));
+        __m512i v2 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 2), load4(qt0, qt1, qt2, qt3, 2));
+        __m512i v3 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 3), load4(qt0, qt1, qt2, qt3, 3));
+        __m512i v4 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 4), load4(qt0, qt1, qt2, qt3, 4));
+        __m512i v5 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 5), load4(qt0, qt1, qt2, qt3, 5));
+        __m512i v6 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 6), load4(qt0, qt1, qt2, qt3, 6));
+        __m512i v7 = _mm512_mullo_epi16(load4(data0, data1, data2, data3, 7), load4(qt0, qt1, qt2, qt3, 7));
+
+        // IDCT columns
+        JPEG_IDCT_IDCT_PASS_SIMD(_mm512, __m512i, cbias, 10)
+
+        // Transpose
+        JPEG_IDCT_TRANSPOSE_SIMD(_mm512, __m512i)
+
+        // IDCT rows
+        JPEG_IDCT_IDCT_PASS_SIMD(_mm512, __m512i, rbias, 17)
+
+        // Pack to 8-bit integers and transpose
+        JPEG_IDCT_PACK_SIMD(_mm512, __m512i)
+
+        // Store
+        __m128i* d = reinterpret_cast<__m128i *>(dest);
+        _mm_storeu_si128(d +  0, _mm512_extracti32x4_epi32(s0, 0));
+        _mm_storeu_si128(d +  1, _mm512_extracti32x4_epi32(s2, 0));
+        _mm_storeu_si128(d +  2, _mm512_extracti32x4_epi32(s1, 0));
+        _mm_storeu_si128(d +  3, _mm512_extracti32x4_epi32(s3, 0));
+        _mm_storeu_si128(d +  4, _mm512_extracti32x4_epi32(s0, 1));
+        _mm_storeu_si128(d +  5, _mm512_extracti32x4_epi32(s2, 1));
+        _mm_storeu_si128(d +  6, _mm512_extracti32x4_epi32(s1, 1));
+        _mm_storeu_si128(d +  7, _mm512_extracti32x4_epi32(s3, 1));
+        _mm_storeu_si128(d +  8, _mm512_extracti32x4_epi32(s0, 2));
+        _mm_storeu_si128(d +  9, _mm512_extracti32x4_epi32(s2, 2));
+        _mm_storeu_si128(d + 10, _mm512_extracti32x4_epi32(s1, 2));
+        _mm_storeu_si128(d + 11, _mm512_extracti32x4_epi32(s3, 2));
+        _mm_storeu_si128(d + 12, _mm512_extracti32x4_epi32(s0, 3));
+        _mm_storeu_si128(d + 13, _mm512_extracti32x4_epi32(s2, 3));
+        _mm_storeu_si128(d + 14, _mm512_extracti32x4_epi32(s1, 3));
+        _mm_storeu_si128(d + 15, _mm512_extracti32x4_epi32(s3, 3));
+    }
+
+#if defined(MANGO_COMPILER_GCC)
+    #pragma GCC diagnostic pop
+#endif
+
+#endif // JPEG_ENABLE_AVX512_KERNELS
+
+#undef JPEG_IDCT_ROTATE_SIMD
+#undef JPEG_IDCT_WIDEN_SIMD
+#undef JPEG_IDCT_WADD_SIMD
+#undef JPEG_IDCT_WSUB_SIMD
+#undef JPEG_IDCT_BFLY_SIMD
+#undef JPEG_IDCT_IDCT_PASS_SIMD
+#undef JPEG_IDCT_TRANSPOSE_SIMD
+#undef JPEG_IDCT_PACK_SIMD
+
+#endif // JPEG_ENABLE_AVX2_KERNELS
+
 #endif // JPEG_ENABLE_SSE2
 
 #if defined(JPEG_ENABLE_NEON)
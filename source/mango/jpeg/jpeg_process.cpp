@@ -33,6 +33,106 @@ namespace jpeg {
     g = (cb * -22479 + cr * -46596 + 8874368) >> 16; \
     b = (cb * 115671 - 14773120) >> 16;
 
+// ----------------------------------------------------------------------------
+// orientation
+// ----------------------------------------------------------------------------
+
+template <int N>
+void store_oriented(u8* dest, int stride, int xstep, const u8* src, int pitch, int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        const u8* s = src + y * pitch;
+        u8* d = dest + y * stride;
+
+        for (int x = 0; x < width; ++x)
+        {
+            std::memcpy(d, s + x * N, N);
+            d += xstep;
+        }
+    }
+}
+
+// The MCU scanlines are columns in the destination (stride is +4 or -4 bytes); 4x4
+// pixels are transposed in registers and stored as destination scanlines.
+void store_transposed32(u8* dest, int stride, int xstep, const u8* src, int pitch, int width, int height)
+{
+    const int xblocks = width & ~3;
+    const int yblocks = height & ~3;
+
+    for (int y = 0; y < yblocks; y += 4)
+    {
+        const u8* s = src + y * pitch;
+
+        // the reversed columns are stored from the last MCU scanline of the block
+        u8* d = dest + (stride < 0 ? y + 3 : y) * stride;
+
+        for (int x = 0; x < xblocks; x += 4)
+        {
+            simd::u32x4 r0 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + pitch * 0));
+            simd::u32x4 r1 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + pitch * 1));
+            simd::u32x4 r2 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + pitch * 2));
+            simd::u32x4 r3 = simd::u32x4_uload(reinterpret_cast<const u32*>(s + pitch * 3));
+
+            simd::u64x2 t0 = simd::reinterpret<simd::u64x2>(simd::unpacklo(r0, r1));
+            simd::u64x2 t1 = simd::reinterpret<simd::u64x2>(simd::unpacklo(r2, r3));
+            simd::u64x2 t2 = simd::reinterpret<simd::u64x2>(simd::unpackhi(r0, r1));
+            simd::u64x2 t3 = simd::reinterpret<simd::u64x2>(simd::unpackhi(r2, r3));
+
+            simd::u32x4 c0 = simd::reinterpret<simd::u32x4>(simd::unpacklo(t0, t1));
+            simd::u32x4 c1 = simd::reinterpret<simd::u32x4>(simd::unpackhi(t0, t1));
+            simd::u32x4 c2 = simd::reinterpret<simd::u32x4>(simd::unpacklo(t2, t3));
+            simd::u32x4 c3 = simd::reinterpret<simd::u32x4>(simd::unpackhi(t2, t3));
+
+            if (stride < 0)
+            {
+                c0 = simd::shuffle<3, 2, 1, 0>(c0);
+                c1 = simd::shuffle<3, 2, 1, 0>(c1);
+                c2 = simd::shuffle<3, 2, 1, 0>(c2);
+                c3 = simd::shuffle<3, 2, 1, 0>(c3);
+            }
+
+            simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 0), c0);
+            simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 1), c1);
+            simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 2), c2);
+            simd::u32x4_ustore(reinterpret_cast<u32*>(d + xstep * 3), c3);
+
+            s += 16;
+            d += xstep * 4;
+        }
+    }
+
+    // right and bottom edges of a clipped MCU
+    store_oriented<4>(dest + xblocks * xstep, stride, xstep, src + xblocks * 4, pitch, width - xblocks, yblocks);
+    store_oriented<4>(dest + yblocks * stride, stride, xstep, src + yblocks * pitch, pitch, width, height - yblocks);
+}
+
+void process_oriented(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    // The MCU is at most 32x32 pixels; some of the functions write the whole MCU
+    // even when it is clipped.
+    constexpr int pitch = 32 * 4;
+    alignas(16) u8 temp[pitch * 32];
+
+    state->process_block(temp, pitch, data, state, width, height);
+
+    switch (state->bytes_per_pixel)
+    {
+        case 1:
+            store_oriented<1>(dest, stride, state->xstep, temp, pitch, width, height);
+            break;
+        case 3:
+            store_oriented<3>(dest, stride, state->xstep, temp, pitch, width, height);
+            break;
+        case 4:
+            if (stride == 4 || stride == -4)
+                store_transposed32(dest, stride, state->xstep, temp, pitch, width, height);
+            else
+                store_oriented<4>(dest, stride, state->xstep, temp, pitch, width, height);
+            break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Generic C++ implementation
 // ----------------------------------------------------------------------------
@@ -651,6 +751,267 @@ void convert_ycbcr_rgba_8x1_sse2(u8* dest, __m128i y, __m128i cb, __m128i cr, __
 #undef FUNCTION_YCBCR_16x8
 #undef FUNCTION_YCBCR_16x16
 
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+
+// ------------------------------------------------------------------------------------------------
+// AVX2 implementation
+// ------------------------------------------------------------------------------------------------
+
+// Same arithmetic as the SSE2 implementation, the results are bit-exact. Each 128 bit lane
+// holds eight pixels so the two lanes convert 16 pixels at a time.
+
+#define JPEG_CONST_AVX2(x, y)  _mm256_broadcastsi128_si256(JPEG_CONST_SSE2(x, y))
+
+static inline JPEG_TARGET_AVX2
+void idct_blocks_avx2(u8* result, const s16* data, ProcessState* state, int count, int i = 0)
+{
+    for ( ; i < count - 1; i += 2)
+    {
+        idct2_avx2(result + i * 64, data + i * 64, state->block[i + 0].qt, state->block[i + 1].qt);
+    }
+
+    if (i < count)
+    {
+        state->idct(result + i * 64, data + i * 64, state->block[i].qt);
+    }
+}
+
+static inline JPEG_TARGET_AVX2
+void compute_rgb_avx2(__m256i& r, __m256i& g, __m256i& b, __m256i y, __m256i cb, __m256i cr, __m256i s0, __m256i s1, __m256i s2, __m256i rounding)
+{
+    __m256i zero = _mm256_setzero_si256();
+
+    __m256i r_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(y, cr), s0);
+    __m256i r_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(y, cr), s0);
+
+    __m256i b_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(y, cb), s1);
+    __m256i b_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(y, cb), s1);
+
+    __m256i g_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(cb, cr), s2);
+    __m256i g_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(cb, cr), s2);
+
+    g_l = _mm256_add_epi32(g_l, _mm256_slli_epi32(_mm256_unpacklo_epi16(y, zero), JPEG_PREC));
+    g_h = _mm256_add_epi32(g_h, _mm256_slli_epi32(_mm256_unpackhi_epi16(y, zero), JPEG_PREC));
+
+    r_l = _mm256_srai_epi32(_mm256_add_epi32(r_l, rounding), JPEG_PREC);
+    r_h = _mm256_srai_epi32(_mm256_add_epi32(r_h, rounding), JPEG_PREC);
+
+    b_l = _mm256_srai_epi32(_mm256_add_epi32(b_l, rounding), JPEG_PREC);
+    b_h = _mm256_srai_epi32(_mm256_add_epi32(b_h, rounding), JPEG_PREC);
+
+    g_l = _mm256_srai_epi32(_mm256_add_epi32(g_l, rounding), JPEG_PREC);
+    g_h = _mm256_srai_epi32(_mm256_add_epi32(g_h, rounding), JPEG_PREC);
+
+    r = _mm256_packs_epi32(r_l, r_h);
+    g = _mm256_packs_epi32(g_l, g_h);
+    b = _mm256_packs_epi32(b_l, b_h);
+
+    r = _mm256_packus_epi16(r, r);
+    g = _mm256_packus_epi16(g, g);
+    b = _mm256_packus_epi16(b, b);
+}
+
+static inline JPEG_TARGET_AVX2
+void convert_ycbcr_bgra_16x1_avx2(u8* dest0, u8* dest1, __m256i y, __m256i cb, __m256i cr, __m256i s0, __m256i s1, __m256i s2, __m256i rounding)
+{
+    __m256i r, g, b;
+    compute_rgb_avx2(r, g, b, y, cb, cr, s0, s1, s2, rounding);
+    __m256i a = _mm256_cmpeq_epi8(r, r);
+
+    __m256i ra = _mm256_unpacklo_epi8(r, a);
+    __m256i bg = _mm256_unpacklo_epi8(b, g);
+
+    __m256i bgra0 = _mm256_unpacklo_epi16(bg, ra);
+    __m256i bgra1 = _mm256_unpackhi_epi16(bg, ra);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest0), _mm256_permute2x128_si256(bgra0, bgra1, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest1), _mm256_permute2x128_si256(bgra0, bgra1, 0x31));
+}
+
+static inline JPEG_TARGET_AVX2
+void convert_ycbcr_rgba_16x1_avx2(u8* dest0, u8* dest1, __m256i y, __m256i cb, __m256i cr, __m256i s0, __m256i s1, __m256i s2, __m256i rounding)
+{
+    __m256i r, g, b;
+    compute_rgb_avx2(r, g, b, y, cb, cr, s0, s1, s2, rounding);
+    __m256i a = _mm256_cmpeq_epi8(r, r);
+
+    __m256i ba = _mm256_unpacklo_epi8(b, a);
+    __m256i rg = _mm256_unpacklo_epi8(r, g);
+
+    __m256i rgba0 = _mm256_unpacklo_epi16(rg, ba);
+    __m256i rgba1 = _mm256_unpackhi_epi16(rg, ba);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest0), _mm256_permute2x128_si256(rgba0, rgba1, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest1), _mm256_permute2x128_si256(rgba0, rgba1, 0x31));
+}
+
+// Generate YCBCR to BGRA functions
+#define IDCT_BLOCKS          idct_blocks_avx2
+#define INNERLOOP_YCBCR      convert_ycbcr_bgra_16x1_avx2
+#define XSTEP                32
+#define FUNCTION_YCBCR_8x8   process_ycbcr_bgra_8x8_avx2
+#define FUNCTION_YCBCR_16x8  process_ycbcr_bgra_16x8_avx2
+#define FUNCTION_YCBCR_16x16 process_ycbcr_bgra_16x16_avx2
+#include "jpeg_process_avx2.hpp"
+#undef IDCT_BLOCKS
+#undef INNERLOOP_YCBCR
+#undef XSTEP
+#undef FUNCTION_YCBCR_8x8
+#undef FUNCTION_YCBCR_16x8
+#undef FUNCTION_YCBCR_16x16
+
+// Generate YCBCR to RGBA functions
+#define IDCT_BLOCKS          idct_blocks_avx2
+#define INNERLOOP_YCBCR      convert_ycbcr_rgba_16x1_avx2
+#define XSTEP                32
+#define FUNCTION_YCBCR_8x8   process_ycbcr_rgba_8x8_avx2
+#define FUNCTION_YCBCR_16x8  process_ycbcr_rgba_16x8_avx2
+#define FUNCTION_YCBCR_16x16 process_ycbcr_rgba_16x16_avx2
+#include "jpeg_process_avx2.hpp"
+#undef IDCT_BLOCKS
+#undef INNERLOOP_YCBCR
+#undef XSTEP
+#undef FUNCTION_YCBCR_8x8
+#undef FUNCTION_YCBCR_16x8
+#undef FUNCTION_YCBCR_16x16
+
+#endif // JPEG_ENABLE_AVX2_KERNELS
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+
+// ------------------------------------------------------------------------------------------------
+// AVX-512 implementation
+// ------------------------------------------------------------------------------------------------
+
+// Four 128 bit lanes; two scanlines of 16 pixels are converted at a time.
+
+#if defined(MANGO_COMPILER_GCC)
+    // GCC 12 warns about the self-initialized _mm512_undefined_epi32() in its own headers
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#define JPEG_CONST_AVX512(x, y)  _mm512_broadcast_i32x4(JPEG_CONST_SSE2(x, y))
+
+static inline JPEG_TARGET_AVX512
+void idct_blocks_avx512(u8* result, const s16* data, ProcessState* state, int count)
+{
+    int i = 0;
+
+    for ( ; i < count - 3; i += 4)
+    {
+        idct4_avx512(result + i * 64, data + i * 64, state->block[i + 0].qt, state->block[i + 1].qt,
+                                                     state->block[i + 2].qt, state->block[i + 3].qt);
+    }
+
+    idct_blocks_avx2(result, data, state, count, i);
+}
+
+static inline JPEG_TARGET_AVX512
+void compute_rgb_avx512(__m512i& r, __m512i& g, __m512i& b, __m512i y, __m512i cb, __m512i cr, __m512i s0, __m512i s1, __m512i s2, __m512i rounding)
+{
+    __m512i zero = _mm512_setzero_si512();
+
+    __m512i r_l = _mm512_madd_epi16(_mm512_unpacklo_epi16(y, cr), s0);
+    __m512i r_h = _mm512_madd_epi16(_mm512_unpackhi_epi16(y, cr), s0);
+
+    __m512i b_l = _mm512_madd_epi16(_mm512_unpacklo_epi16(y, cb), s1);
+    __m512i b_h = _mm512_madd_epi16(_mm512_unpackhi_epi16(y, cb), s1);
+
+    __m512i g_l = _mm512_madd_epi16(_mm512_unpacklo_epi16(cb, cr), s2);
+    __m512i g_h = _mm512_madd_epi16(_mm512_unpackhi_epi16(cb, cr), s2);
+
+    g_l = _mm512_add_epi32(g_l, _mm512_slli_epi32(_mm512_unpacklo_epi16(y, zero), JPEG_PREC));
+    g_h = _mm512_add_epi32(g_h, _mm512_slli_epi32(_mm512_unpackhi_epi16(y, zero), JPEG_PREC));
+
+    r_l = _mm512_srai_epi32(_mm512_add_epi32(r_l, rounding), JPEG_PREC);
+    r_h = _mm512_srai_epi32(_mm512_add_epi32(r_h, rounding), JPEG_PREC);
+
+    b_l = _mm512_srai_epi32(_mm512_add_epi32(b_l, rounding), JPEG_PREC);
+    b_h = _mm512_srai_epi32(_mm512_add_epi32(b_h, rounding), JPEG_PREC);
+
+    g_l = _mm512_srai_epi32(_mm512_add_epi32(g_l, rounding), JPEG_PREC);
+    g_h = _mm512_srai_epi32(_mm512_add_epi32(g_h, rounding), JPEG_PREC);
+
+    r = _mm512_packs_epi32(r_l, r_h);
+    g = _mm512_packs_epi32(g_l, g_h);
+    b = _mm512_packs_epi32(b_l, b_h);
+
+    r = _mm512_packus_epi16(r, r);
+    g = _mm512_packus_epi16(g, g);
+    b = _mm512_packus_epi16(b, b);
+}
+
+static inline JPEG_TARGET_AVX512
+void store_scanlines_avx512(u8* dest0, u8* dest1, __m512i color0, __m512i color1)
+{
+    // lanes 0 and 1 are the first scanline, lanes 2 and 3 the second one
+    const __m512i index0 = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+    const __m512i index1 = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+    _mm512_storeu_si512(dest0, _mm512_permutex2var_epi64(color0, index0, color1));
+    _mm512_storeu_si512(dest1, _mm512_permutex2var_epi64(color0, index1, color1));
+}
+
+static inline JPEG_TARGET_AVX512
+void convert_ycbcr_bgra_16x2_avx512(u8* dest0, u8* dest1, __m512i y, __m512i cb, __m512i cr, __m512i s0, __m512i s1, __m512i s2, __m512i rounding)
+{
+    __m512i r, g, b;
+    compute_rgb_avx512(r, g, b, y, cb, cr, s0, s1, s2, rounding);
+    __m512i a = _mm512_set1_epi8(-1);
+
+    __m512i ra = _mm512_unpacklo_epi8(r, a);
+    __m512i bg = _mm512_unpacklo_epi8(b, g);
+
+    __m512i bgra0 = _mm512_unpacklo_epi16(bg, ra);
+    __m512i bgra1 = _mm512_unpackhi_epi16(bg, ra);
+
+    store_scanlines_avx512(dest0, dest1, bgra0, bgra1);
+}
+
+static inline JPEG_TARGET_AVX512
+void convert_ycbcr_rgba_16x2_avx512(u8* dest0, u8* dest1, __m512i y, __m512i cb, __m512i cr, __m512i s0, __m512i s1, __m512i s2, __m512i rounding)
+{
+    __m512i r, g, b;
+    compute_rgb_avx512(r, g, b, y, cb, cr, s0, s1, s2, rounding);
+    __m512i a = _mm512_set1_epi8(-1);
+
+    __m512i ba = _mm512_unpacklo_epi8(b, a);
+    __m512i rg = _mm512_unpacklo_epi8(r, g);
+
+    __m512i rgba0 = _mm512_unpacklo_epi16(rg, ba);
+    __m512i rgba1 = _mm512_unpackhi_epi16(rg, ba);
+
+    store_scanlines_avx512(dest0, dest1, rgba0, rgba1);
+}
+
+// Generate YCBCR to BGRA functions
+#define IDCT_BLOCKS          idct_blocks_avx512
+#define INNERLOOP_YCBCR      convert_ycbcr_bgra_16x2_avx512
+#define FUNCTION_YCBCR_16x8  process_ycbcr_bgra_16x8_avx512
+#define FUNCTION_YCBCR_16x16 process_ycbcr_bgra_16x16_avx512
+#include "jpeg_process_avx512.hpp"
+#undef IDCT_BLOCKS
+#undef INNERLOOP_YCBCR
+#undef FUNCTION_YCBCR_16x8
+#undef FUNCTION_YCBCR_16x16
+
+// Generate YCBCR to RGBA functions
+#define IDCT_BLOCKS          idct_blocks_avx512
+#define INNERLOOP_YCBCR      convert_ycbcr_rgba_16x2_avx512
+#define FUNCTION_YCBCR_16x8  process_ycbcr_rgba_16x8_avx512
+#define FUNCTION_YCBCR_16x16 process_ycbcr_rgba_16x16_avx512
+#include "jpeg_process_avx512.hpp"
+#undef IDCT_BLOCKS
+#undef INNERLOOP_YCBCR
+#undef FUNCTION_YCBCR_16x8
+#undef FUNCTION_YCBCR_16x16
+
+#if defined(MANGO_COMPILER_GCC)
+    #pragma GCC diagnostic pop
+#endif
+
+#endif // JPEG_ENABLE_AVX512_KERNELS
+
 #endif // JPEG_ENABLE_SSE2
 
 #if defined(JPEG_ENABLE_SSE4)
@@ -0,0 +1,117 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+
+// The idct results are stored in the same order as the blocks are in the MCU (block n at n * 64).
+// Each INNERLOOP_YCBCR call converts 16 pixels; pixels 0..7 are stored at dest0 and 8..15 at dest1.
+
+#ifdef FUNCTION_YCBCR_8x8
+JPEG_TARGET_AVX2
+void FUNCTION_YCBCR_8x8(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * 3];
+
+    IDCT_BLOCKS(result, data, state, 3); // Y, Cb, Cr
+
+    // color conversion
+    const __m256i s0 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+    const __m256i s1 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+    const __m256i s2 = JPEG_CONST_AVX2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+    const __m256i rounding = _mm256_set1_epi32(1 << (JPEG_PREC - 1));
+    const __m256i tosigned = _mm256_set1_epi16(-128);
+
+    for (int y = 0; y < 4; ++y)
+    {
+        // two scanlines per iteration
+        __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
+        __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
+        __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+
+        __m256i cb0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(cb), tosigned);
+        __m256i cr0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(cr), tosigned);
+
+        INNERLOOP_YCBCR(dest, dest + stride, _mm256_cvtepu8_epi16(yy), cb0, cr0, s0, s1, s2, rounding);
+        dest += stride * 2;
+    }
+
+    MANGO_UNREFERENCED(width);
+    MANGO_UNREFERENCED(height);
+}
+#endif
+
+#ifdef FUNCTION_YCBCR_16x8
+JPEG_TARGET_AVX2
+void FUNCTION_YCBCR_16x8(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * 4];
+
+    IDCT_BLOCKS(result, data, state, 4); // Y0, Y1, Cb, Cr
+
+    // color conversion
+    const __m256i s0 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+    const __m256i s1 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+    const __m256i s2 = JPEG_CONST_AVX2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+    const __m256i rounding = _mm256_set1_epi32(1 << (JPEG_PREC - 1));
+    const __m256i tosigned = _mm256_set1_epi16(-128);
+
+    for (int y = 0; y < 8; ++y)
+    {
+        __m128i y0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 0));
+        __m128i y1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 64));
+        __m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 128));
+        __m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 192));
+
+        // horizontal chroma upsampling
+        __m256i cb0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cb, cb)), tosigned);
+        __m256i cr0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cr, cr)), tosigned);
+        __m256i yy = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(y0, y1));
+
+        INNERLOOP_YCBCR(dest, dest + XSTEP, yy, cb0, cr0, s0, s1, s2, rounding);
+        dest += stride;
+    }
+
+    MANGO_UNREFERENCED(width);
+    MANGO_UNREFERENCED(height);
+}
+#endif
+
+#ifdef FUNCTION_YCBCR_16x16
+JPEG_TARGET_AVX2
+void FUNCTION_YCBCR_16x16(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * 6];
+
+    IDCT_BLOCKS(result, data, state, 6); // Y0, Y1, Y2, Y3, Cb, Cr
+
+    // color conversion
+    const __m256i s0 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+    const __m256i s1 = JPEG_CONST_AVX2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+    const __m256i s2 = JPEG_CONST_AVX2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+    const __m256i rounding = _mm256_set1_epi32(1 << (JPEG_PREC - 1));
+    const __m256i tosigned = _mm256_set1_epi16(-128);
+
+    for (int y = 0; y < 8; ++y)
+    {
+        const u8* luma = result + (y >> 2) * 128 + (y & 3) * 16;
+
+        __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma + 0));
+        __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma + 64));
+        __m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 256));
+        __m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 320));
+
+        // horizontal chroma upsampling; the same chroma is used for two scanlines
+        __m256i cb0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cb, cb)), tosigned);
+        __m256i cr0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cr, cr)), tosigned);
+
+        INNERLOOP_YCBCR(dest, dest + XSTEP, _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(y0, y1)), cb0, cr0, s0, s1, s2, rounding);
+        dest += stride;
+
+        INNERLOOP_YCBCR(dest, dest + XSTEP, _mm256_cvtepu8_epi16(_mm_unpackhi_epi64(y0, y1)), cb0, cr0, s0, s1, s2, rounding);
+        dest += stride;
+    }
+
+    MANGO_UNREFERENCED(width);
+    MANGO_UNREFERENCED(height);
+}
+#endif
@@ -0,0 +1,91 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+
+// The idct results are stored in the same order as the blocks are in the MCU (block n at n * 64).
+// Each INNERLOOP_YCBCR call converts two 16 pixel scanlines which are stored at dest0 and dest1.
+
+#ifdef FUNCTION_YCBCR_16x8
+JPEG_TARGET_AVX512
+void FUNCTION_YCBCR_16x8(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * 4];
+
+    IDCT_BLOCKS(result, data, state, 4); // Y0, Y1, Cb, Cr
+
+    // color conversion
+    const __m512i s0 = JPEG_CONST_AVX512(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+    const __m512i s1 = JPEG_CONST_AVX512(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+    const __m512i s2 = JPEG_CONST_AVX512(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+    const __m512i rounding = _mm512_set1_epi32(1 << (JPEG_PREC - 1));
+    const __m512i tosigned = _mm512_set1_epi16(-128);
+
+    for (int y = 0; y < 4; ++y)
+    {
+        // two scanlines per iteration
+        __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
+        __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
+        __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+        __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 192));
+
+        __m256i yy = _mm256_setr_m128i(_mm_unpacklo_epi64(y0, y1), _mm_unpackhi_epi64(y0, y1));
+
+        // horizontal chroma upsampling
+        __m256i cb0 = _mm256_setr_m128i(_mm_unpacklo_epi8(cb, cb), _mm_unpackhi_epi8(cb, cb));
+        __m256i cr0 = _mm256_setr_m128i(_mm_unpacklo_epi8(cr, cr), _mm_unpackhi_epi8(cr, cr));
+
+        __m512i cb1 = _mm512_add_epi16(_mm512_cvtepu8_epi16(cb0), tosigned);
+        __m512i cr1 = _mm512_add_epi16(_mm512_cvtepu8_epi16(cr0), tosigned);
+
+        INNERLOOP_YCBCR(dest, dest + stride, _mm512_cvtepu8_epi16(yy), cb1, cr1, s0, s1, s2, rounding);
+        dest += stride * 2;
+    }
+
+    MANGO_UNREFERENCED(width);
+    MANGO_UNREFERENCED(height);
+}
+#endif
+
+#ifdef FUNCTION_YCBCR_16x16
+JPEG_TARGET_AVX512
+void FUNCTION_YCBCR_16x16(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * 6];
+
+    IDCT_BLOCKS(result, data, state, 6); // Y0, Y1, Y2, Y3, Cb, Cr
+
+    // color conversion
+    const __m512i s0 = JPEG_CONST_AVX512(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+    const __m512i s1 = JPEG_CONST_AVX512(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+    const __m512i s2 = JPEG_CONST_AVX512(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+    const __m512i rounding = _mm512_set1_epi32(1 << (JPEG_PREC - 1));
+    const __m512i tosigned = _mm512_set1_epi16(-128);
+
+    for (int y = 0; y < 8; ++y)
+    {
+        // two scanlines per iteration; both use the same chroma
+        const u8* luma = result + (y >> 2) * 128 + (y & 3) * 16;
+
+        __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma + 0));
+        __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma + 64));
+        __m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 256));
+        __m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(result + y * 8 + 320));
+
+        __m256i yy = _mm256_setr_m128i(_mm_unpacklo_epi64(y0, y1), _mm_unpackhi_epi64(y0, y1));
+
+        // horizontal chroma upsampling
+        __m512i cb0 = _mm512_cvtepu8_epi16(_mm256_broadcastsi128_si256(_mm_unpacklo_epi8(cb, cb)));
+        __m512i cr0 = _mm512_cvtepu8_epi16(_mm256_broadcastsi128_si256(_mm_unpacklo_epi8(cr, cr)));
+
+        cb0 = _mm512_add_epi16(cb0, tosigned);
+        cr0 = _mm512_add_epi16(cr0, tosigned);
+
+        INNERLOOP_YCBCR(dest, dest + stride, _mm512_cvtepu8_epi16(yy), cb0, cr0, s0, s1, s2, rounding);
+        dest += stride * 2;
+    }
+
+    MANGO_UNREFERENCED(width);
+    MANGO_UNREFERENCED(height);
+}
+#endif
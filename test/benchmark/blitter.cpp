@@ -0,0 +1,160 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <mango/mango.hpp>
+
+using namespace mango;
+
+// Times the cached getBlitter() plans between the common formats and the cost of building
+// a Blitter per blit, which the cache removes from Surface::blit and the block compressors.
+
+namespace
+{
+
+    const int width = 1024;
+    const int height = 256;
+    const int passes = 9;
+
+    template <typename Func>
+    double measure(Func func)
+    {
+        double best = 1e30;
+
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            Timer timer;
+            func();
+            best = std::min(best, timer.time());
+        }
+
+        return best;
+    }
+
+    struct Pair
+    {
+        Format dest;
+        Format source;
+        const char* name;
+    };
+
+    void benchmark_convert(const Pair* pairs, int count)
+    {
+        std::vector<u8> input(width * height * 16);
+        std::vector<u8> output(width * height * 16);
+
+        u32 seed = 0x12345678;
+        for (u8& value : input)
+        {
+            // xorshift32
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            value = u8(seed >> 24);
+        }
+
+        printf("convert %d x %d:\n", width, height);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Pair& pair = pairs[i];
+            const Blitter& blitter = getBlitter(pair.dest, pair.source);
+
+            BlitRect rect;
+            rect.src.address = input.data();
+            rect.src.stride = width * pair.source.bytes();
+            rect.dest.address = output.data();
+            rect.dest.stride = width * pair.dest.bytes();
+            rect.width = width;
+            rect.height = height;
+
+            const double seconds = measure([&] {
+                blitter.convert(rect);
+            });
+
+            printf("  %-28s %-8s %8.3f ms %8.1f MPix/s\n", pair.name, blitter.path,
+                seconds * 1000.0, width * height / seconds / 1e6);
+        }
+    }
+
+    void benchmark_setup(const Pair* pairs, int count)
+    {
+        // a 4x4 block is the unit of work in the block compressors
+        const int blits = 10000;
+
+        u8 input[4 * 4 * 16] = { 0 };
+        u8 output[4 * 4 * 16];
+
+        printf("4x4 blits (%d per pair):\n", blits);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Pair& pair = pairs[i];
+
+            BlitRect rect;
+            rect.src.address = input;
+            rect.src.stride = 4 * pair.source.bytes();
+            rect.dest.address = output;
+            rect.dest.stride = 4 * pair.dest.bytes();
+            rect.width = 4;
+            rect.height = 4;
+
+            const double constructed = measure([&] {
+                for (int j = 0; j < blits; ++j)
+                {
+                    Blitter blitter(pair.dest, pair.source);
+                    blitter.convert(rect);
+                }
+            });
+
+            const double cached = measure([&] {
+                for (int j = 0; j < blits; ++j)
+                {
+                    getBlitter(pair.dest, pair.source).convert(rect);
+                }
+            });
+
+            printf("  %-28s Blitter %7.1f ns   getBlitter %7.1f ns\n", pair.name,
+                constructed * 1e9 / blits, cached * 1e9 / blits);
+        }
+    }
+
+} // namespace
+
+int main()
+{
+    static const Pair pairs[] =
+    {
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8, "B8G8R8A8 <- R8G8B8A8" },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8, "R8G8B8A8 <- B8G8R8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8,   "B8G8R8A8 <- B8G8R8" },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8,   "R8G8B8A8 <- B8G8R8" },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8,   "B8G8R8A8 <- R8G8B8" },
+        { FORMAT_R8G8B8A8, FORMAT_R8G8B8,   "R8G8B8A8 <- R8G8B8" },
+        { FORMAT_B8G8R8,   FORMAT_B8G8R8A8, "B8G8R8 <- B8G8R8A8" },
+        { FORMAT_R8G8B8,   FORMAT_R8G8B8A8, "R8G8B8 <- R8G8B8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_B5G6R5,   "B8G8R8A8 <- B5G6R5" },
+        { FORMAT_B5G6R5,   FORMAT_B8G8R8A8, "B5G6R5 <- B8G8R8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_B5G5R5A1, "B8G8R8A8 <- B5G5R5A1" },
+        { FORMAT_B8G8R8A8, FORMAT_B4G4R4A4, "B8G8R8A8 <- B4G4R4A4" },
+        { FORMAT_B8G8R8A8, FORMAT_L8,       "B8G8R8A8 <- L8" },
+        { FORMAT_B8G8R8A8, FORMAT_L8A8,     "B8G8R8A8 <- L8A8" },
+        { FORMAT_L8,       FORMAT_B8G8R8A8, "L8 <- B8G8R8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA16,   "B8G8R8A8 <- RGBA16" },
+        { FORMAT_RGBA16,   FORMAT_B8G8R8A8, "RGBA16 <- B8G8R8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA16F,  "B8G8R8A8 <- RGBA16F" },
+        { FORMAT_RGBA16F,  FORMAT_B8G8R8A8, "RGBA16F <- B8G8R8A8" },
+        { FORMAT_B8G8R8A8, FORMAT_RGBA32F,  "B8G8R8A8 <- RGBA32F" },
+        { FORMAT_RGBA32F,  FORMAT_B8G8R8A8, "RGBA32F <- B8G8R8A8" },
+    };
+
+    const int count = int(sizeof(pairs) / sizeof(pairs[0]));
+
+    benchmark_convert(pairs, count);
+    benchmark_setup(pairs, count);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <mango/mango.hpp>
+
+using namespace mango;
+
+// Times the block compressors at each quality level and reports the throughput in MPix/s.
+
+namespace
+{
+
+    const int width = 512;
+    const int height = 512;
+    const int passes = 3;
+
+    void generate(Surface& surface)
+    {
+        u32 random = 0x12345678;
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = surface.address<u8>(0, y);
+
+            for (int x = 0; x < width; ++x)
+            {
+                // xorshift32
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                const int noise = int(random >> 28) - 8;
+
+                // smooth gradients with some noise and a few hard edges
+                const int edge = ((x / 48) ^ (y / 48)) & 1 ? 64 : 0;
+
+                scan[x * 4 + 0] = u8(std::max(0, std::min(255, x / 2 + noise)));
+                scan[x * 4 + 1] = u8(std::max(0, std::min(255, y / 2 + edge + noise)));
+                scan[x * 4 + 2] = u8(std::max(0, std::min(255, (x + y) / 4 + noise)));
+                scan[x * 4 + 3] = u8(std::max(0, std::min(255, 255 - x / 4 - edge + noise)));
+            }
+        }
+    }
+
+    void benchmark(const Surface& source, TextureCompression compression, const char* name)
+    {
+        const TextureCompressionInfo info(compression);
+
+        const int blocks = ceil_div(width, info.width) * ceil_div(height, info.height);
+        std::vector<u8> buffer(blocks * info.bytes);
+
+        printf("  %-8s", name);
+
+        static const TextureCompressionQuality qualities[] =
+        {
+            TextureCompressionQuality::FAST,
+            TextureCompressionQuality::NORMAL,
+            TextureCompressionQuality::HIGH,
+        };
+
+        for (TextureCompressionQuality quality : qualities)
+        {
+            double best = 1e30;
+
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                Timer timer;
+                info.compress(Memory(buffer.data(), buffer.size()), source, quality);
+                best = std::min(best, timer.time());
+            }
+
+            printf(" %9.2f", double(width) * height / best / 1e6);
+        }
+
+        printf("\n");
+    }
+
+} // namespace
+
+int main()
+{
+    Bitmap source(width, height, Format(32, Format::UNORM, Format::RGBA, 8, 8, 8, 8));
+    generate(source);
+
+    printf("%d x %d, MPix/s:\n", width, height);
+    printf("  %-8s %9s %9s %9s\n", "", "FAST", "NORMAL", "HIGH");
+
+    benchmark(source, TextureCompression::BC1_UNORM, "BC1");
+    benchmark(source, TextureCompression::DXT3, "DXT3");
+    benchmark(source, TextureCompression::BC3_UNORM, "BC3");
+#ifdef MANGO_ENABLE_LICENSE_MICROSOFT
+    benchmark(source, TextureCompression::BC4_UNORM, "BC4");
+    benchmark(source, TextureCompression::BC5_UNORM, "BC5");
+    benchmark(source, TextureCompression::BC6H_UF16, "BC6H");
+    benchmark(source, TextureCompression::BC7_UNORM, "BC7");
+#endif
+
+    return 0;
+}
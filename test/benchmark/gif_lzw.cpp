@@ -0,0 +1,147 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <mango/mango.hpp>
+
+using namespace mango;
+using namespace mango::image;
+
+// Times the GIF encoder and decoder on indexed images of different compressibility.
+
+namespace
+{
+
+    const int width = 1920;
+    const int height = 1080;
+    const int passes = 5;
+
+    u32 random_state = 0x12345678;
+
+    u32 random_u32()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return random_state;
+    }
+
+    enum Content
+    {
+        SOLID,
+        FLAT,
+        DITHERED,
+        NOISE
+    };
+
+    void generate(Bitmap& bitmap, Content content)
+    {
+        for (int y = 0; y < bitmap.height; ++y)
+        {
+            u8* scan = bitmap.address<u8>(0, y);
+
+            for (int x = 0; x < bitmap.width; ++x)
+            {
+                u8 value = 0;
+
+                switch (content)
+                {
+                    case SOLID:
+                        value = 7;
+                        break;
+                    case FLAT:
+                        // large areas of a single color
+                        value = u8((x / 64 + (y / 48) * 3) & 0xff);
+                        break;
+                    case DITHERED:
+                        // gradient with an ordered dither between neighbouring colors
+                        value = u8(((x * 256 / bitmap.width) + ((x ^ y) & 1)) & 0xff);
+                        break;
+                    case NOISE:
+                        value = u8(random_u32());
+                        break;
+                }
+
+                scan[x] = value;
+            }
+        }
+    }
+
+    template <typename Func>
+    double measure(Func func)
+    {
+        double best = 1e30;
+
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            Timer timer;
+            func();
+            best = std::min(best, timer.time());
+        }
+
+        return best;
+    }
+
+    void benchmark(const char* name, Content content)
+    {
+        Bitmap source(width, height, IndexedFormat(8));
+        generate(source, content);
+
+        ImageEncodeOptions encodeOptions;
+        encodeOptions.palette.size = 256;
+        for (u32 i = 0; i < 256; ++i)
+        {
+            encodeOptions.palette[i] = ColorBGRA(i, i, i, 0xff);
+        }
+
+        ImageEncoder encoder(".gif");
+        MemoryStream stream;
+
+        const double encodeTime = measure([&] {
+            stream.seek(0, Stream::BEGIN);
+            encoder.encode(stream, source, encodeOptions);
+        });
+
+        Palette palette;
+        ImageDecodeOptions decodeOptions;
+        decodeOptions.palette = &palette;
+
+        Bitmap result(width, height, IndexedFormat(8));
+
+        // the decoder keeps the animation state so every pass needs a new one
+        const double decodeTime = measure([&] {
+            ImageDecoder decoder(stream, ".gif");
+            decoder.decode(result, decodeOptions);
+        });
+
+        bool match = true;
+        for (int y = 0; y < height; ++y)
+        {
+            match &= !std::memcmp(source.address<u8>(0, y), result.address<u8>(0, y), width);
+        }
+
+        const double mpixels = double(width) * height / 1e6;
+        printf("  %-10s %9d bytes   encode %7.2f ms %7.1f MPix/s   decode %7.2f ms %7.1f MPix/s%s\n",
+            name, int(stream.size()),
+            encodeTime * 1000.0, mpixels / encodeTime,
+            decodeTime * 1000.0, mpixels / decodeTime,
+            match ? "" : "  (round trip FAILED)");
+    }
+
+} // namespace
+
+int main()
+{
+    printf("GIF %d x %d, 8 bit indexed:\n", width, height);
+
+    benchmark("solid", SOLID);
+    benchmark("flat", FLAT);
+    benchmark("dithered", DITHERED);
+    benchmark("noise", NOISE);
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <mango/mango.hpp>
+#include "../../source/mango/jpeg/jpeg.hpp"
+
+using namespace mango;
+using namespace mango::jpeg;
+
+// Times the iDCT and the fused iDCT + YCbCr kernels of the JPEG decoder per MCU shape.
+
+namespace
+{
+
+    using ProcessFunc = void (*)(u8* dest, int stride, const s16* data, ProcessState* state, int width, int height);
+
+    const int mcus = 4096;
+    const int passes = 7;
+
+    u32 random_state = 0x12345678;
+
+    u32 random_u32()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return random_state;
+    }
+
+    struct Data
+    {
+        std::vector<s16> qt;
+        std::vector<s16> coefficients;
+        ProcessState state;
+
+        Data()
+            : qt(64 * JPEG_MAX_BLOCKS_IN_MCU)
+            , coefficients(64 * 6 * mcus)
+        {
+            for (s16& value : qt)
+            {
+                value = s16(1 + random_u32() % 16);
+            }
+
+            // typical coefficients: the energy is in the low frequencies
+            for (size_t i = 0; i < coefficients.size(); ++i)
+            {
+                const int zigzag = int(i % 64);
+                const int range = zigzag == 0 ? 128 : zigzag < 10 ? 16 : zigzag < 24 ? 4 : 0;
+                coefficients[i] = range ? s16(int(random_u32() % (range * 2 + 1)) - range) : 0;
+            }
+
+            std::memset(&state, 0, sizeof(state));
+            for (int i = 0; i < JPEG_MAX_BLOCKS_IN_MCU; ++i)
+            {
+                state.block[i].qt = qt.data() + i * 64;
+            }
+        }
+    };
+
+    template <typename Func>
+    double measure(Func func)
+    {
+        double best = 1e30;
+
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            Timer timer;
+            func();
+            best = std::min(best, timer.time());
+        }
+
+        return best;
+    }
+
+    void report(const char* shape, const char* name, double seconds, int pixels, u32 hash, u32 reference)
+    {
+        const double ns = seconds * 1e9 / mcus;
+        const double mpixels = double(mcus) * pixels / seconds / 1e6;
+        printf("  %-7s %-8s %8.1f ns / MCU %8.1f MPix/s%s\n", shape, name, ns, mpixels,
+            hash == reference ? "" : "  (output differs from SSE2)");
+    }
+
+    u32 hash_output(const std::vector<u8>& buffer)
+    {
+        u32 hash = 2166136261u;
+        for (u8 value : buffer)
+        {
+            hash = (hash ^ value) * 16777619u;
+        }
+        return hash;
+    }
+
+    void benchmark_idct(Data& data)
+    {
+        const int blocks = mcus * 6;
+        std::vector<u8> output(blocks * 64);
+
+        printf("iDCT (%d blocks):\n", blocks);
+
+        auto run = [&] (const char* name, std::function<void()> func, u32 reference) -> u32
+        {
+            const double seconds = measure(func);
+            const u32 hash = hash_output(output);
+            printf("  %-20s %8.2f ns / block%s\n", name, seconds * 1e9 / blocks,
+                hash == reference || !reference ? "" : "  (output differs from SSE2)");
+            return hash;
+        };
+
+        const s16* qt = data.qt.data();
+        const s16* source = data.coefficients.data();
+
+        u32 reference = 0;
+
+#if defined(JPEG_ENABLE_SSE2)
+        reference = run("SSE2", [&] {
+            for (int i = 0; i < blocks; ++i)
+                idct_sse2(output.data() + i * 64, source + i * 64, qt);
+        }, 0);
+#endif
+
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+        if (getCPUFlags() & INTEL_AVX2)
+        {
+            run("AVX2 (2 blocks)", [&] {
+                for (int i = 0; i < blocks; i += 2)
+                    idct2_avx2(output.data() + i * 64, source + i * 64, qt, qt);
+            }, reference);
+        }
+#endif
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+        if (getCPUFlags() & INTEL_AVX512BW)
+        {
+            run("AVX-512 (4 blocks)", [&] {
+                for (int i = 0; i < blocks; i += 4)
+                    idct4_avx512(output.data() + i * 64, source + i * 64, qt, qt, qt, qt);
+            }, reference);
+        }
+#endif
+
+        MANGO_UNREFERENCED(reference);
+        MANGO_UNREFERENCED(source);
+        MANGO_UNREFERENCED(qt);
+    }
+
+    void benchmark_ycbcr(Data& data, const char* shape, int xblock, int yblock,
+                         ProcessFunc sse2, ProcessFunc avx2, ProcessFunc avx512)
+    {
+        // MCUs are stored side by side in a 64 MCU wide strip
+        const int columns = 64;
+        const int stride = columns * xblock * 4;
+        std::vector<u8> output(stride * yblock);
+
+        auto run = [&] (ProcessFunc func) -> double
+        {
+            return measure([&] {
+                for (int i = 0; i < mcus; ++i)
+                {
+                    u8* dest = output.data() + (i % columns) * xblock * 4;
+                    func(dest, stride, data.coefficients.data() + i * 6 * 64, &data.state, xblock, yblock);
+                }
+            });
+        };
+
+        const int pixels = xblock * yblock;
+        u32 reference = 0;
+
+        if (sse2)
+        {
+            const double seconds = run(sse2);
+            reference = hash_output(output);
+            report(shape, "SSE2", seconds, pixels, reference, reference);
+        }
+
+        if (avx2 && (getCPUFlags() & INTEL_AVX2))
+        {
+            const double seconds = run(avx2);
+            report(shape, "AVX2", seconds, pixels, hash_output(output), reference);
+        }
+
+        if (avx512 && (getCPUFlags() & INTEL_AVX512BW))
+        {
+            const double seconds = run(avx512);
+            report(shape, "AVX-512", seconds, pixels, hash_output(output), reference);
+        }
+    }
+
+} // namespace
+
+int main()
+{
+    Data data;
+
+#if defined(JPEG_ENABLE_SSE2)
+    data.state.idct = idct_sse2;
+#else
+    data.state.idct = idct8;
+#endif
+
+    benchmark_idct(data);
+
+    printf("YCbCr to BGRA (%d MCUs):\n", mcus);
+
+    ProcessFunc sse2[3] = { nullptr, nullptr, nullptr };
+    ProcessFunc avx2[3] = { nullptr, nullptr, nullptr };
+    ProcessFunc avx512[3] = { nullptr, nullptr, nullptr };
+
+#if defined(JPEG_ENABLE_SSE2)
+    sse2[0] = process_ycbcr_bgra_8x8_sse2;
+    sse2[1] = process_ycbcr_bgra_16x8_sse2;
+    sse2[2] = process_ycbcr_bgra_16x16_sse2;
+#endif
+
+#if defined(JPEG_ENABLE_AVX2_KERNELS)
+    avx2[0] = process_ycbcr_bgra_8x8_avx2;
+    avx2[1] = process_ycbcr_bgra_16x8_avx2;
+    avx2[2] = process_ycbcr_bgra_16x16_avx2;
+#endif
+
+#if defined(JPEG_ENABLE_AVX512_KERNELS)
+    avx512[1] = process_ycbcr_bgra_16x8_avx512;
+    avx512[2] = process_ycbcr_bgra_16x16_avx512;
+#endif
+
+    benchmark_ycbcr(data, "8x8", 8, 8, sse2[0], avx2[0], avx512[0]);
+    benchmark_ycbcr(data, "16x8", 16, 8, sse2[1], avx2[1], avx512[1]);
+    benchmark_ycbcr(data, "16x16", 16, 16, sse2[2], avx2[2], avx512[2]);
+
+    return 0;
+}
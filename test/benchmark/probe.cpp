@@ -0,0 +1,146 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mango/mango.hpp>
+
+using namespace mango;
+using namespace mango::filesystem;
+
+// Reads the headers of every file in a directory tree and reports files per second:
+//   benchmark-probe <directory>
+// "decoder" maps the whole file and constructs an ImageDecoder for it, "probe" uses
+// probeImage() one file at a time and "probeImages" probes the files in the ThreadPool.
+
+namespace
+{
+
+    struct Directory
+    {
+        std::string pathname;
+        std::vector<std::string> files;
+    };
+
+    void scan(std::vector<Directory>& directories, const std::string& pathname)
+    {
+        Path path(pathname);
+
+        Directory directory;
+        directory.pathname = pathname;
+
+        for (auto& node : path)
+        {
+            if (node.isDirectory())
+            {
+                scan(directories, pathname + node.name);
+            }
+            else
+            {
+                directory.files.push_back(node.name);
+            }
+        }
+
+        directories.push_back(directory);
+    }
+
+    template <typename Func>
+    void run(const char* name, size_t count, Func func)
+    {
+        Timer timer;
+        size_t images = func();
+        double seconds = timer.time();
+
+        printf("  %-12s %8.3f s %10.0f files / s   (%zu / %zu images)\n",
+            name, seconds, count / seconds, images, count);
+    }
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <directory>\n", argv[0]);
+        return 1;
+    }
+
+    std::string root = argv[1];
+    if (root.back() != '/')
+    {
+        root += '/';
+    }
+
+    std::vector<Directory> directories;
+    scan(directories, root);
+
+    size_t count = 0;
+    for (auto& directory : directories)
+    {
+        count += directory.files.size();
+    }
+
+    printf("%zu files in %zu directories:\n", count, directories.size());
+
+    // the first pass warms up the file cache so that every method reads from memory
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        run("decoder", count, [&] {
+            size_t images = 0;
+
+            for (auto& directory : directories)
+            {
+                Path path(directory.pathname);
+
+                for (auto& filename : directory.files)
+                {
+                    try
+                    {
+                        File file(path, filename);
+                        ImageDecoder decoder(file, filename);
+                        images += decoder.isDecoder() && decoder.header().success;
+                    }
+                    catch (const Exception&)
+                    {
+                    }
+                }
+            }
+
+            return images;
+        });
+    }
+
+    run("probe", count, [&] {
+        size_t images = 0;
+
+        for (auto& directory : directories)
+        {
+            Path path(directory.pathname);
+
+            for (auto& filename : directory.files)
+            {
+                images += probeImage(path, filename).header.success;
+            }
+        }
+
+        return images;
+    });
+
+    run("probeImages", count, [&] {
+        size_t images = 0;
+
+        for (auto& directory : directories)
+        {
+            for (auto& probe : probeImages(Path(directory.pathname)))
+            {
+                images += probe.header.success;
+            }
+        }
+
+        return images;
+    });
+
+    return 0;
+}
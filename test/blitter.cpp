@@ -0,0 +1,169 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mango/mango.hpp>
+
+using namespace mango;
+
+// The integer innerloops must round every component exactly like round(v * dmax / smax).
+
+namespace
+{
+
+    u32 random_state = 0x12345678;
+
+    u8 random_byte()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return u8(random_state >> 24);
+    }
+
+    u64 load_pixel(const u8* src, int bytes)
+    {
+        u64 value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value |= u64(src[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    u64 convert_pixel(const Format& dest, const Format& source, u64 s)
+    {
+        u64 d = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // luminance is stored from the red component
+            if (!dest.size[i] || (dest.isLuminance() && (i == 1 || i == 2)))
+                continue;
+
+            const u64 dmax = (1ull << dest.size[i]) - 1;
+            u64 v = i == 3 ? dmax : 0;
+
+            if (source.size[i])
+            {
+                const u64 smax = (1ull << source.size[i]) - 1;
+                const u64 sv = (s >> source.offset[i]) & smax;
+                v = (sv * dmax * 2 + smax) / (smax * 2);
+            }
+
+            d |= v << dest.offset[i];
+        }
+
+        return d;
+    }
+
+    int test(const Format& dest, const Format& source, const char* destName, const char* sourceName)
+    {
+        const Blitter blitter(dest, source);
+        if (std::strcmp(blitter.path, "ssse3") && std::strcmp(blitter.path, "integer"))
+            return -1;
+
+        // odd width so that the scanline tail is converted too
+        const int width = 37;
+        const int height = 16;
+        const int sourceBytes = source.bytes();
+        const int destBytes = dest.bytes();
+
+        std::vector<u8> input(width * height * sourceBytes);
+        std::vector<u8> output(width * height * destBytes);
+
+        for (u8& value : input)
+        {
+            value = random_byte();
+        }
+
+        BlitRect rect;
+        rect.src.address = input.data();
+        rect.src.stride = width * sourceBytes;
+        rect.dest.address = output.data();
+        rect.dest.stride = width * destBytes;
+        rect.width = width;
+        rect.height = height;
+        blitter.convert(rect);
+
+        int mismatch = 0;
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            const u64 s = load_pixel(input.data() + i * sourceBytes, sourceBytes);
+            const u64 d = load_pixel(output.data() + i * destBytes, destBytes);
+            mismatch += d != convert_pixel(dest, source, s);
+        }
+
+        if (mismatch)
+        {
+            printf("%-8s %-12s <- %-12s FAILED (%d mismatched pixels)\n",
+                blitter.path, destName, sourceName, mismatch);
+        }
+
+        return mismatch ? 0 : 1;
+    }
+
+} // namespace
+
+int main()
+{
+    static const struct
+    {
+        Format format;
+        const char* name;
+    }
+    formats[] =
+    {
+        { FORMAT_B8G8R8,       "B8G8R8" },
+        { FORMAT_R8G8B8,       "R8G8B8" },
+        { FORMAT_B8G8R8A8,     "B8G8R8A8" },
+        { FORMAT_B8G8R8X8,     "B8G8R8X8" },
+        { FORMAT_R8G8B8A8,     "R8G8B8A8" },
+        { FORMAT_R8G8B8X8,     "R8G8B8X8" },
+        { FORMAT_BGRA_UNSIGNED_INT_8_8_8_8, "A8R8G8B8" },
+        { FORMAT_B5G6R5,       "B5G6R5" },
+        { FORMAT_B5G5R5X1,     "B5G5R5X1" },
+        { FORMAT_B5G5R5A1,     "B5G5R5A1" },
+        { FORMAT_B4G4R4A4,     "B4G4R4A4" },
+        { FORMAT_B4G4R4X4,     "B4G4R4X4" },
+        { FORMAT_B2G3R3,       "B2G3R3" },
+        { FORMAT_R10G10B10A2,  "R10G10B10A2" },
+        { FORMAT_B10G10R10A2,  "B10G10R10A2" },
+        { FORMAT_R16G16,       "R16G16" },
+        { FORMAT_A8,           "A8" },
+        { FORMAT_R16,          "R16" },
+        { FORMAT_RGB16,        "RGB16" },
+        { FORMAT_RGBA16,       "RGBA16" },
+        { FORMAT_L8,           "L8" },
+        { FORMAT_L8A8,         "L8A8" },
+        { FORMAT_L4A4,         "L4A4" },
+        { FORMAT_L16,          "L16" },
+        { FORMAT_L16A16,       "L16A16" },
+    };
+
+    const int count = int(sizeof(formats) / sizeof(formats[0]));
+
+    int tested = 0;
+    int passed = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = 0; j < count; ++j)
+        {
+            const int result = test(formats[i].format, formats[j].format, formats[i].name, formats[j].name);
+            if (result >= 0)
+            {
+                ++tested;
+                passed += result;
+            }
+        }
+    }
+
+    printf("%d / %d integer conversions passed\n", passed, tested);
+    return passed == tested ? 0 : 1;
+}
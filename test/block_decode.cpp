@@ -0,0 +1,91 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mango/mango.hpp>
+
+using namespace mango;
+
+// The row decoders must produce exactly the same pixels as the block decoders.
+
+namespace
+{
+
+    u32 random_state = 0x12345678;
+
+    u8 random_byte()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return u8(random_state >> 24);
+    }
+
+    bool test(TextureCompression compression, const char* name)
+    {
+        const TextureCompressionInfo info(compression);
+        if (!info.decode)
+        {
+            printf("%-24s no decoder\n", name);
+            return false;
+        }
+
+        const int count = 64;
+        const int pixelSize = info.format.bytes();
+        const int stride = count * info.width * pixelSize;
+
+        std::vector<u8> blocks(count * info.bytes);
+        std::vector<u8> row(stride * info.height, 0);
+        std::vector<u8> reference(stride * info.height, 0);
+
+        int mismatch = 0;
+
+        for (int iteration = 0; iteration < 256; ++iteration)
+        {
+            for (u8& value : blocks)
+            {
+                value = random_byte();
+            }
+
+            info.decodeRow(row.data(), blocks.data(), stride, count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                u8* output = reference.data() + i * info.width * pixelSize;
+                info.decode(info, output, blocks.data() + i * info.bytes, stride);
+            }
+
+            for (size_t i = 0; i < row.size(); ++i)
+            {
+                mismatch += row[i] != reference[i];
+            }
+        }
+
+        printf("%-24s %s (%d mismatched bytes)\n", name, mismatch ? "FAILED" : "passed", mismatch);
+        return mismatch == 0;
+    }
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+
+    success &= test(TextureCompression::DXT1, "DXT1");
+    success &= test(TextureCompression::DXT1_ALPHA1, "DXT1_ALPHA1");
+    success &= test(TextureCompression::DXT3, "DXT3");
+    success &= test(TextureCompression::DXT5, "DXT5");
+    success &= test(TextureCompression::AMD_3DC_X, "AMD_3DC_X");
+    success &= test(TextureCompression::AMD_3DC_XY, "AMD_3DC_XY");
+#ifdef MANGO_ENABLE_LICENSE_APACHE
+    success &= test(TextureCompression::ETC1_RGB, "ETC1_RGB");
+    success &= test(TextureCompression::ETC2_RGB, "ETC2_RGB");
+    success &= test(TextureCompression::ETC2_RGBA, "ETC2_RGBA");
+#endif
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mango/mango.hpp>
+
+using namespace mango;
+
+// Encode and decode a synthetic RGBA image and check the PSNR of the result.
+
+namespace
+{
+
+    const int width = 64;
+    const int height = 64;
+
+    enum Alpha
+    {
+        OPAQUE,
+        GRADIENT,
+        BINARY // the transparent pixels are zero as in the punch-through formats
+    };
+
+    void generate(Surface& surface, Alpha alpha)
+    {
+        u32 random = 0x12345678;
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = surface.address<u8>(0, y);
+
+            for (int x = 0; x < width; ++x)
+            {
+                // xorshift32
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                const int noise = int(random >> 29) - 4;
+
+                scan[x * 4 + 0] = u8(std::max(0, std::min(255, x * 4 + noise)));
+                scan[x * 4 + 1] = u8(std::max(0, std::min(255, y * 4 + noise)));
+                scan[x * 4 + 2] = u8(std::max(0, std::min(255, (x + y) * 2 + noise)));
+                scan[x * 4 + 3] = u8(std::max(0, std::min(255, 255 - x * 3 - y + noise)));
+
+                if (alpha == OPAQUE)
+                {
+                    scan[x * 4 + 3] = 255;
+                }
+                else if (alpha == BINARY)
+                {
+                    const int dx = x - 24;
+                    const int dy = y - 40;
+                    const bool transparent = dx * dx + dy * dy < 300;
+                    u32 color;
+                    std::memcpy(&color, scan + x * 4, 4);
+                    color = transparent ? 0 : color | 0xff000000;
+                    std::memcpy(scan + x * 4, &color, 4);
+                }
+            }
+        }
+    }
+
+    // the PSNR is measured over the first components of each pixel; the formats with fewer
+    // components decode the missing ones as constants
+    bool test(TextureCompression compression, const char* name, Alpha alpha, double threshold, int components = 4)
+    {
+        const TextureCompressionInfo info(compression);
+
+        Bitmap source(width, height, Format(32, Format::UNORM, Format::RGBA, 8, 8, 8, 8));
+        generate(source, alpha);
+
+        // 6x6 blocks do not divide the image; the partial blocks are stored too
+        const int blocks = ceil_div(width, info.width) * ceil_div(height, info.height);
+        std::vector<u8> buffer(blocks * info.bytes);
+
+        TextureCompressionStatus status = info.compress(Memory(buffer.data(), buffer.size()), source);
+        if (!status)
+        {
+            printf("%-24s FAILED (%s)\n", name, status.info.c_str());
+            return false;
+        }
+
+        Bitmap result(width, height, source.format);
+        status = info.decompress(result, ConstMemory(buffer.data(), buffer.size()));
+        if (!status)
+        {
+            printf("%-24s FAILED (%s)\n", name, status.info.c_str());
+            return false;
+        }
+
+        double error = 0.0;
+        int alphaMismatch = 0;
+
+        for (int y = 0; y < height; ++y)
+        {
+            const u8* a = source.address<u8>(0, y);
+            const u8* b = result.address<u8>(0, y);
+
+            for (int x = 0; x < width * 4; ++x)
+            {
+                if ((x & 3) >= components)
+                    continue;
+
+                const double d = double(a[x]) - double(b[x]);
+                error += d * d;
+
+                if ((x & 3) == 3 && a[x] != b[x])
+                {
+                    ++alphaMismatch;
+                }
+            }
+        }
+
+        const double mse = error / (width * height * components);
+        const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+        // binary alpha must survive exactly
+        const bool success = psnr >= threshold && (alpha != BINARY || !alphaMismatch);
+
+        printf("%-24s %s (%.2f dB, minimum %.1f dB", name, success ? "passed" : "FAILED", psnr, threshold);
+        if (alpha == BINARY)
+        {
+            printf(", %d alpha mismatches", alphaMismatch);
+        }
+        printf(")\n");
+        return success;
+    }
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+
+    success &= test(TextureCompression::DXT1, "DXT1", OPAQUE, 38.0);
+    success &= test(TextureCompression::DXT1_ALPHA1, "DXT1_ALPHA1", OPAQUE, 36.0);
+    success &= test(TextureCompression::DXT3, "DXT3", GRADIENT, 36.0);
+    success &= test(TextureCompression::DXT5, "DXT5", GRADIENT, 36.0);
+#ifdef MANGO_ENABLE_LICENSE_APACHE
+    success &= test(TextureCompression::ETC2_RGB, "ETC2_RGB", OPAQUE, 36.0);
+    success &= test(TextureCompression::ETC2_RGB_ALPHA1, "ETC2_RGB_ALPHA1", BINARY, 36.0);
+    success &= test(TextureCompression::ETC2_RGBA, "ETC2_RGBA", GRADIENT, 36.0);
+    success &= test(TextureCompression::EAC_R11, "EAC_R11", OPAQUE, 48.0, 1);
+    success &= test(TextureCompression::EAC_RG11, "EAC_RG11", OPAQUE, 48.0, 2);
+    success &= test(TextureCompression::ASTC_RGBA_4x4, "ASTC 4x4", GRADIENT, 36.0);
+    success &= test(TextureCompression::ASTC_RGBA_6x6, "ASTC 6x6", GRADIENT, 30.0);
+    success &= test(TextureCompression::ASTC_RGBA_8x8, "ASTC 8x8", GRADIENT, 29.0);
+#endif
+#ifdef MANGO_ENABLE_LICENSE_MICROSOFT
+    success &= test(TextureCompression::BC7_UNORM, "BC7", OPAQUE, 44.0);
+    success &= test(TextureCompression::BC7_UNORM, "BC7 alpha", GRADIENT, 39.0);
+    success &= test(TextureCompression::BC6H_UF16, "BC6H", OPAQUE, 37.0, 3);
+#endif
+
+    return success ? 0 : 1;
+}
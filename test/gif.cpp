@@ -0,0 +1,344 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mango/mango.hpp>
+
+using namespace mango;
+using namespace mango::image;
+
+// Round trips indexed images through the GIF encoder and the LZW decoder. The large images are
+// encoded as several strips with clear codes between them; the hand written streams cover the
+// KwKwK code and a code stream which keeps going after the dictionary is full without a clear.
+
+namespace
+{
+
+    u32 random_state = 0x12345678;
+
+    u32 random_u32()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return random_state;
+    }
+
+    Palette make_palette()
+    {
+        Palette palette;
+        palette.size = 256;
+
+        for (u32 i = 0; i < 256; ++i)
+        {
+            palette[i] = ColorBGRA(i, 255 - i, (i * 7) & 0xff, 0xff);
+        }
+
+        return palette;
+    }
+
+    bool decode(const char* name, ConstMemory memory, const Bitmap& source)
+    {
+        ImageDecoder decoder(memory, ".gif");
+
+        Palette palette;
+        ImageDecodeOptions options;
+        options.palette = &palette;
+
+        Bitmap result(source.width, source.height, IndexedFormat(8));
+        std::memset(result.image, 0xff, result.stride * result.height);
+
+        ImageDecodeStatus status = decoder.decode(result, options);
+        if (!status)
+        {
+            printf("%-24s FAILED (%s)\n", name, status.info.c_str());
+            return false;
+        }
+
+        int mismatch = 0;
+
+        for (int y = 0; y < source.height; ++y)
+        {
+            const u8* a = source.address<u8>(0, y);
+            const u8* b = result.address<u8>(0, y);
+
+            for (int x = 0; x < source.width; ++x)
+            {
+                mismatch += a[x] != b[x];
+            }
+        }
+
+        printf("%-24s %s (%d x %d, %d bytes, %d mismatched pixels)\n", name,
+            mismatch ? "FAILED" : "passed", source.width, source.height, int(memory.size), mismatch);
+        return !mismatch;
+    }
+
+    // ------------------------------------------------------------
+    // encoder round trip
+    // ------------------------------------------------------------
+
+    bool test_encoder(const char* name, const Bitmap& bitmap)
+    {
+        ImageEncodeOptions options;
+        options.palette = make_palette();
+
+        MemoryStream stream;
+        ImageEncoder encoder(".gif");
+        ImageEncodeStatus status = encoder.encode(stream, bitmap, options);
+        if (!status)
+        {
+            printf("%-24s FAILED (%s)\n", name, status.info.c_str());
+            return false;
+        }
+
+        return decode(name, stream, bitmap);
+    }
+
+    // ------------------------------------------------------------
+    // hand written code streams
+    // ------------------------------------------------------------
+
+    struct CodeWriter
+    {
+        std::vector<u8> bytes;
+        u32 data = 0;
+        int bits = 0;
+
+        void write(int code, int size)
+        {
+            data |= u32(code) << bits;
+            bits += size;
+
+            while (bits >= 8)
+            {
+                bytes.push_back(u8(data));
+                data >>= 8;
+                bits -= 8;
+            }
+        }
+
+        void flush()
+        {
+            if (bits > 0)
+            {
+                bytes.push_back(u8(data));
+            }
+        }
+    };
+
+    // LZW encoder which starts with a clear code and never emits another one; once the
+    // dictionary is full the remaining codes are 12 bits and refer to the existing strings.
+    struct StreamEncoder
+    {
+        int kwkwk = 0;      // codes which refer to the string they define
+        int after_full = 0; // codes written after the dictionary is full
+
+        std::vector<u8> encode(const u8* pixels, int count)
+        {
+            const int clear = 256;
+            const int eoi = 257;
+
+            std::vector<s16> table(4096 * 256, -1);
+            CodeWriter writer;
+
+            // the state of the decoder, which decides the code size
+            int available = clear + 2;
+            int codesize = 9;
+            int written = 0;
+
+            auto emit = [&] (int code)
+            {
+                if (written > 0 && code == available && available < 4096)
+                    ++kwkwk;
+                if (available == 4096)
+                    ++after_full;
+
+                writer.write(code, codesize);
+
+                if (written > 0 && code != eoi && available < 4096)
+                    ++available;
+                ++written;
+
+                if (available > (1 << codesize) - 1 && available < 4095)
+                    ++codesize;
+            };
+
+            writer.write(clear, codesize);
+
+            int next = clear + 2;
+            int prefix = pixels[0];
+
+            for (int i = 1; i < count; ++i)
+            {
+                const u8 symbol = pixels[i];
+                const int code = table[prefix * 256 + symbol];
+
+                if (code >= 0)
+                {
+                    prefix = code;
+                    continue;
+                }
+
+                emit(prefix);
+
+                if (next < 4096)
+                {
+                    table[prefix * 256 + symbol] = s16(next++);
+                }
+
+                prefix = symbol;
+            }
+
+            emit(prefix);
+            emit(eoi);
+            writer.flush();
+
+            return writer.bytes;
+        }
+    };
+
+    std::vector<u8> make_file(int width, int height, const std::vector<u8>& codes)
+    {
+        std::vector<u8> file;
+
+        auto write8 = [&] (int value) { file.push_back(u8(value)); };
+        auto write16 = [&] (int value) { write8(value & 0xff); write8(value >> 8); };
+
+        for (const char* s = "GIF89a"; *s; ++s)
+            write8(*s);
+
+        // screen descriptor with a 256 color global palette
+        write16(width);
+        write16(height);
+        write8(0xf7);
+        write8(0);
+        write8(0);
+
+        const Palette palette = make_palette();
+        for (int i = 0; i < 256; ++i)
+        {
+            write8(palette[i].r);
+            write8(palette[i].g);
+            write8(palette[i].b);
+        }
+
+        // image descriptor
+        write8(0x2c);
+        write16(0);
+        write16(0);
+        write16(width);
+        write16(height);
+        write8(0);
+
+        // minimum code size and the data sub-blocks
+        write8(8);
+
+        for (size_t offset = 0; offset < codes.size(); offset += 255)
+        {
+            const size_t size = std::min(size_t(255), codes.size() - offset);
+            write8(int(size));
+            file.insert(file.end(), codes.begin() + offset, codes.begin() + offset + size);
+        }
+
+        write8(0);
+        write8(0x3b);
+
+        return file;
+    }
+
+    bool test_stream(const char* name, const Bitmap& bitmap, bool kwkwk, bool full)
+    {
+        std::vector<u8> pixels;
+        for (int y = 0; y < bitmap.height; ++y)
+        {
+            const u8* scan = bitmap.address<u8>(0, y);
+            pixels.insert(pixels.end(), scan, scan + bitmap.width);
+        }
+
+        StreamEncoder encoder;
+        const std::vector<u8> codes = encoder.encode(pixels.data(), int(pixels.size()));
+
+        // make sure that the stream exercises the case it was written for
+        if ((kwkwk && !encoder.kwkwk) || (full && !encoder.after_full))
+        {
+            printf("%-24s FAILED (%d KwKwK codes, %d codes after a full dictionary)\n",
+                name, encoder.kwkwk, encoder.after_full);
+            return false;
+        }
+
+        const std::vector<u8> file = make_file(bitmap.width, bitmap.height, codes);
+        return decode(name, ConstMemory(file.data(), file.size()), bitmap);
+    }
+
+    // ------------------------------------------------------------
+    // images
+    // ------------------------------------------------------------
+
+    Bitmap make_noise(int width, int height, int colors)
+    {
+        Bitmap bitmap(width, height, IndexedFormat(8));
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = bitmap.address<u8>(0, y);
+            for (int x = 0; x < width; ++x)
+            {
+                scan[x] = u8(random_u32() % colors);
+            }
+        }
+
+        return bitmap;
+    }
+
+    Bitmap make_graphics(int width, int height)
+    {
+        // flat areas and runs which produce long dictionary strings
+        Bitmap bitmap(width, height, IndexedFormat(8));
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = bitmap.address<u8>(0, y);
+            for (int x = 0; x < width; ++x)
+            {
+                scan[x] = u8((x / 37 + y / 11) & 0xff);
+            }
+        }
+
+        return bitmap;
+    }
+
+    Bitmap make_solid(int width, int height, u8 value)
+    {
+        Bitmap bitmap(width, height, IndexedFormat(8));
+
+        for (int y = 0; y < height; ++y)
+        {
+            std::memset(bitmap.address<u8>(0, y), value, width);
+        }
+
+        return bitmap;
+    }
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+
+    // more than 1M pixels: the encoder splits the frame into strips
+    success &= test_encoder("noise", make_noise(1200, 1000, 256));
+    success &= test_encoder("graphics", make_graphics(1600, 1000));
+    success &= test_encoder("solid", make_solid(1100, 1000, 7));
+    success &= test_encoder("small", make_noise(13, 7, 4));
+
+    success &= test_stream("KwKwK", make_solid(100, 3, 1), true, false);
+    success &= test_stream("graphics KwKwK", make_graphics(300, 40), true, false);
+    success &= test_stream("no clear when full", make_noise(400, 300, 16), false, true);
+    success &= test_stream("no clear when full, runs", make_graphics(2000, 500), false, true);
+
+    return success ? 0 : 1;
+}
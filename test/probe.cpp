@@ -0,0 +1,120 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2020 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include <string>
+#include <mango/mango.hpp>
+
+using namespace mango;
+using namespace mango::filesystem;
+
+// probeImage() must return the same header as ImageDecoder::header() for the same file,
+// from memory, from a file and when the filename extension does not match the content.
+
+namespace
+{
+
+    u32 random_state = 0x12345678;
+
+    u8 random_byte()
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return u8(random_state >> 24);
+    }
+
+    bool compare(const ImageHeader& a, const ImageHeader& b)
+    {
+        return a.success == b.success &&
+               a.width == b.width &&
+               a.height == b.height &&
+               a.depth == b.depth &&
+               a.levels == b.levels &&
+               a.faces == b.faces &&
+               a.palette == b.palette &&
+               a.format == b.format &&
+               a.compression == b.compression;
+    }
+
+    bool check(const char* extension, const char* source, const ImageProbe& probe, const ImageHeader& header)
+    {
+        bool success = compare(probe.header, header) && probe.extension == extension && probe.orientation == 1;
+
+        printf("%-6s %-8s %s (%d x %d, %s)\n", extension, source, success ? "passed" : "FAILED",
+            probe.header.width, probe.header.height,
+            probe.header.success ? probe.extension.c_str() : probe.header.info.c_str());
+
+        return success;
+    }
+
+    bool test(const char* extension, bool signature, int width, int height)
+    {
+        Bitmap bitmap(width, height, Format(32, Format::UNORM, Format::RGBA, 8, 8, 8, 8));
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = bitmap.address<u8>(0, y);
+            for (int x = 0; x < width * 4; ++x)
+            {
+                scan[x] = random_byte();
+            }
+        }
+
+        MemoryStream stream;
+        ImageEncoder encoder(extension);
+        ImageEncodeStatus status = encoder.encode(stream, bitmap, ImageEncodeOptions());
+        if (!status)
+        {
+            printf("%-6s %-8s FAILED (%s)\n", extension, "encode", status.info.c_str());
+            return false;
+        }
+
+        const std::string filename = std::string("probe-test") + extension;
+
+        ImageDecoder decoder(stream, filename);
+        const ImageHeader header = decoder.header();
+
+        bool success = header.success && header.width == width && header.height == height;
+
+        success &= check(extension, "memory", probeImage(stream, filename), header);
+
+        if (signature)
+        {
+            // the decoder is selected from the content
+            success &= check(extension, "renamed", probeImage(stream, "probe-test.dat"), header);
+        }
+
+        // larger files are probed from the beginning of the file
+        {
+            FileStream file(filename, Stream::WRITE);
+            file.write(stream);
+        }
+
+        success &= check(extension, "file", probeImage(Path(""), filename), header);
+        std::remove(filename.c_str());
+
+        return success;
+    }
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+
+    // noise does not compress; the larger images do not fit in the probe window
+    success &= test(".png", true, 61, 37);
+    success &= test(".png", true, 400, 300);
+    success &= test(".jpg", true, 61, 37);
+    success &= test(".jpg", true, 400, 300);
+    success &= test(".bmp", true, 61, 37);
+    success &= test(".bmp", true, 400, 300);
+    success &= test(".gif", true, 61, 37);
+    success &= test(".tga", false, 61, 37);
+    success &= test(".tga", false, 400, 300);
+
+    return success ? 0 : 1;
+}